@@ -14,6 +14,7 @@
 #include "server.h"
 #include "client.h"
 #include "tier0/vprof.h"
+#include "vstdlib/IKeyValuesSystem.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -41,66 +42,340 @@ static ConVar net_showevents( "net_showevents", "0", FCVAR_CHEAT, "Dump game eve
 
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CGameEventManager, IGameEventManager2, INTERFACEVERSION_GAMEEVENTSMANAGER2, s_GameEventManager );
 
+// events kept for reuse per descriptor, a handful covers events fired from inside listeners
+#define MAX_POOLED_EVENTS	16
+
 CGameEvent::CGameEvent( CGameEventDescriptor *descriptor )
 {
 	Assert( descriptor );
 	m_pDescriptor = descriptor;
-	m_pDataKeys = new KeyValues( descriptor->name );
+	m_pExtraKeys = NULL;
+	m_pDataKeys = NULL;
+	m_nSerializedBits = -1;
+
+	m_nSlots = descriptor->fields.Count();
+	m_pSlots = m_nSlots ? new GameEventSlot_t[m_nSlots] : NULL;
+	for ( int i = 0; i < m_nSlots; i++ )
+	{
+		m_pSlots[i].type = VALUE_NONE;
+		m_pSlots[i].pszValue = m_pSlots[i].szValue;
+	}
 }
 
 CGameEvent::~CGameEvent()
 {
-	m_pDataKeys->deleteThis();
+	Clear();
+	delete [] m_pSlots;
+}
+
+void CGameEvent::Clear()
+{
+	for ( int i = 0; i < m_nSlots; i++ )
+	{
+		ClearSlot( m_pSlots[i] );
+	}
+
+	if ( m_pExtraKeys )
+	{
+		m_pExtraKeys->deleteThis();
+		m_pExtraKeys = NULL;
+	}
+
+	OnChanged();
+}
+
+void CGameEvent::ClearSlot( GameEventSlot_t &slot )
+{
+	if ( slot.pszValue != slot.szValue )
+	{
+		delete [] slot.pszValue;
+		slot.pszValue = slot.szValue;
+	}
+
+	slot.type = VALUE_NONE;
+}
+
+void CGameEvent::OnChanged()
+{
+	m_nSerializedBits = -1;
+
+	if ( m_pDataKeys )
+	{
+		m_pDataKeys->deleteThis();
+		m_pDataKeys = NULL;
+	}
+}
+
+// keys the descriptor doesn't declare are kept in KeyValues, like all keys used to be.
+// An empty key name addresses the event itself, which also needs the KeyValues.
+KeyValues *CGameEvent::GetExtraKeys( bool bCreate )
+{
+	if ( !m_pExtraKeys && bCreate )
+	{
+		m_pExtraKeys = new KeyValues( m_pDescriptor->name );
+	}
+
+	return m_pExtraKeys;
+}
+
+void CGameEvent::SetSlotString( GameEventSlot_t &slot, const char *value )
+{
+	if ( !value )
+	{
+		value = "";
+	}
+
+	if ( slot.type == VALUE_STRING && slot.pszValue == value )
+		return;
+
+	int len = Q_strlen( value ) + 1;
+
+	if ( len <= (int)sizeof( slot.szValue ) )
+	{
+		// value may point into this slot, so copy before freeing anything
+		Q_memmove( slot.szValue, value, len );
+
+		if ( slot.pszValue != slot.szValue )
+		{
+			delete [] slot.pszValue;
+			slot.pszValue = slot.szValue;
+		}
+	}
+	else
+	{
+		char *pszValue = new char[len];
+		Q_memcpy( pszValue, value, len );
+
+		if ( slot.pszValue != slot.szValue )
+		{
+			delete [] slot.pszValue;
+		}
+		slot.pszValue = pszValue;
+	}
+
+	slot.type = VALUE_STRING;
+}
+
+// converts the value to a string and keeps it that way, as KeyValues::GetString does
+const char *CGameEvent::GetSlotString( GameEventSlot_t &slot )
+{
+	char buf[64];
+
+	switch ( slot.type )
+	{
+	case VALUE_INT:
+		Q_snprintf( buf, sizeof( buf ), "%d", slot.iValue );
+		SetSlotString( slot, buf );
+		break;
+	case VALUE_FLOAT:
+		Q_snprintf( buf, sizeof( buf ), "%f", slot.flValue );
+		SetSlotString( slot, buf );
+		break;
+	default:
+		break;
+	}
+
+	return slot.pszValue;
+}
+
+int CGameEvent::GetIntField( int field, int defaultValue )
+{
+	Assert( field >= 0 && field < m_nSlots );
+	if ( field < 0 || field >= m_nSlots )
+		return defaultValue;
+
+	GameEventSlot_t &slot = m_pSlots[field];
+
+	switch ( slot.type )
+	{
+	case VALUE_INT:		return slot.iValue;
+	case VALUE_FLOAT:	return (int)slot.flValue;
+	case VALUE_STRING:	return atoi( slot.pszValue );
+	default:			return defaultValue;
+	}
+}
+
+float CGameEvent::GetFloatField( int field, float defaultValue )
+{
+	Assert( field >= 0 && field < m_nSlots );
+	if ( field < 0 || field >= m_nSlots )
+		return defaultValue;
+
+	GameEventSlot_t &slot = m_pSlots[field];
+
+	switch ( slot.type )
+	{
+	case VALUE_INT:		return (float)slot.iValue;
+	case VALUE_FLOAT:	return slot.flValue;
+	case VALUE_STRING:	return (float)atof( slot.pszValue );
+	default:			return defaultValue;
+	}
+}
+
+const char *CGameEvent::GetStringField( int field, const char *defaultValue )
+{
+	Assert( field >= 0 && field < m_nSlots );
+	if ( field < 0 || field >= m_nSlots )
+		return defaultValue;
+
+	GameEventSlot_t &slot = m_pSlots[field];
+
+	if ( slot.type == VALUE_NONE )
+		return defaultValue;
+
+	return GetSlotString( slot );
+}
+
+void CGameEvent::SetIntField( int field, int value )
+{
+	Assert( field >= 0 && field < m_nSlots );
+	if ( field < 0 || field >= m_nSlots )
+		return;
+
+	GameEventSlot_t &slot = m_pSlots[field];
+
+	ClearSlot( slot );
+	slot.type = VALUE_INT;
+	slot.iValue = value;
+	OnChanged();
+}
+
+void CGameEvent::SetFloatField( int field, float value )
+{
+	Assert( field >= 0 && field < m_nSlots );
+	if ( field < 0 || field >= m_nSlots )
+		return;
+
+	GameEventSlot_t &slot = m_pSlots[field];
+
+	ClearSlot( slot );
+	slot.type = VALUE_FLOAT;
+	slot.flValue = value;
+	OnChanged();
+}
+
+void CGameEvent::SetStringField( int field, const char *value )
+{
+	Assert( field >= 0 && field < m_nSlots );
+	if ( field < 0 || field >= m_nSlots )
+		return;
+
+
+	SetSlotString( m_pSlots[field], value );
+	OnChanged();
+}
+
+// field of the event's slot for keyName, -1 if the descriptor doesn't declare it or
+// declared it after this event was created
+int CGameEvent::FindSlot( const char *keyName ) const
+{
+	int field = m_pDescriptor->FindField( keyName );
+	return ( field < m_nSlots ) ? field : -1;
 }
 
 bool CGameEvent::GetBool( const char *keyName, bool defaultValue)
 {
-	return m_pDataKeys->GetInt( keyName, defaultValue ) != 0;
+	return GetInt( keyName, defaultValue ) != 0;
 }
 
 int CGameEvent::GetInt( const char *keyName, int defaultValue)
 {
-	return m_pDataKeys->GetInt( keyName, defaultValue );
+	int field = FindSlot( keyName );
+	if ( field >= 0 )
+		return GetIntField( field, defaultValue );
+
+	KeyValues *pExtraKeys = GetExtraKeys( !keyName || !keyName[0] );
+	return pExtraKeys ? pExtraKeys->GetInt( keyName, defaultValue ) : defaultValue;
 }
 
 float CGameEvent::GetFloat( const char *keyName, float defaultValue )
 {
-	return m_pDataKeys->GetFloat( keyName, defaultValue );
+	int field = FindSlot( keyName );
+	if ( field >= 0 )
+		return GetFloatField( field, defaultValue );
+
+	KeyValues *pExtraKeys = GetExtraKeys( !keyName || !keyName[0] );
+	return pExtraKeys ? pExtraKeys->GetFloat( keyName, defaultValue ) : defaultValue;
 }
 
 const char *CGameEvent::GetString( const char *keyName, const char *defaultValue )
 {
-	return m_pDataKeys->GetString( keyName, defaultValue );
+	int field = FindSlot( keyName );
+	if ( field >= 0 )
+		return GetStringField( field, defaultValue );
+
+	KeyValues *pExtraKeys = GetExtraKeys( !keyName || !keyName[0] );
+	return pExtraKeys ? pExtraKeys->GetString( keyName, defaultValue ) : defaultValue;
 }
 
 void CGameEvent::SetBool( const char *keyName, bool value )
 {
-	m_pDataKeys->SetInt( keyName, value?1:0 );
+	SetInt( keyName, value?1:0 );
 }
 
 void CGameEvent::SetInt( const char *keyName, int value )
 {
-	m_pDataKeys->SetInt( keyName, value );
+	int field = FindSlot( keyName );
+	if ( field >= 0 )
+	{
+		SetIntField( field, value );
+		return;
+	}
+
+	GetExtraKeys( true )->SetInt( keyName, value );
+	OnChanged();
 }
 
 void CGameEvent::SetFloat( const char *keyName, float value )
 {
-	m_pDataKeys->SetFloat( keyName, value );
+	int field = FindSlot( keyName );
+	if ( field >= 0 )
+	{
+		SetFloatField( field, value );
+		return;
+	}
+
+	GetExtraKeys( true )->SetFloat( keyName, value );
+	OnChanged();
 }
 
 void CGameEvent::SetString( const char *keyName, const char *value )
 {
-	m_pDataKeys->SetString( keyName, value );
+	int field = FindSlot( keyName );
+	if ( field >= 0 )
+	{
+		SetStringField( field, value );
+		return;
+	}
+
+	GetExtraKeys( true )->SetString( keyName, value );
+	OnChanged();
 }
 
 bool CGameEvent::IsEmpty( const char *keyName )
 {
-	return m_pDataKeys->IsEmpty( keyName );
+	if ( !keyName || !keyName[0] )
+	{
+		// is there any data at all
+		for ( int i = 0; i < m_nSlots; i++ )
+		{
+			if ( m_pSlots[i].type != VALUE_NONE )
+				return false;
+		}
+
+		return !m_pExtraKeys || m_pExtraKeys->IsEmpty();
+	}
+
+	int field = FindSlot( keyName );
+	if ( field >= 0 )
+		return m_pSlots[field].type == VALUE_NONE;
+
+	return !m_pExtraKeys || m_pExtraKeys->IsEmpty( keyName );
 }
 
 const char *CGameEvent::GetName() const
 {
-	return m_pDataKeys->GetName();
+	return m_pDescriptor->name;
 }
 
 bool CGameEvent::IsLocal() const
@@ -113,7 +388,137 @@ bool CGameEvent::IsReliable() const
 	return m_pDescriptor->reliable;
 }
 
-CGameEventManager::CGameEventManager()
+KeyValues *CGameEvent::GetDataKeys()
+{
+	if ( m_pDataKeys )
+		return m_pDataKeys;
+
+	m_pDataKeys = new KeyValues( m_pDescriptor->name );
+
+	int nSlots = MIN( m_nSlots, m_pDescriptor->fields.Count() );
+	for ( int i = 0; i < nSlots; i++ )
+	{
+		const GameEventSlot_t &slot = m_pSlots[i];
+		const char *keyName = m_pDescriptor->fields[i].name;
+
+		switch ( slot.type )
+		{
+		case VALUE_INT:		m_pDataKeys->SetInt( keyName, slot.iValue ); break;
+		case VALUE_FLOAT:	m_pDataKeys->SetFloat( keyName, slot.flValue ); break;
+		case VALUE_STRING:	m_pDataKeys->SetString( keyName, slot.pszValue ); break;
+		default: break;
+		}
+	}
+
+	if ( m_pExtraKeys )
+	{
+		FOR_EACH_SUBKEY( m_pExtraKeys, pKey )
+		{
+			m_pDataKeys->AddSubKey( pKey->MakeCopy() );
+		}
+	}
+
+	return m_pDataKeys;
+}
+
+void CGameEvent::SetDataKeys( KeyValues *keys )
+{
+	Clear();
+
+	FOR_EACH_SUBKEY( keys, pKey )
+	{
+		int field = FindSlot( pKey->GetName() );
+
+		switch ( field >= 0 ? pKey->GetDataType() : KeyValues::TYPE_NONE )
+		{
+		case KeyValues::TYPE_INT:		SetIntField( field, pKey->GetInt() ); break;
+		case KeyValues::TYPE_FLOAT:		SetFloatField( field, pKey->GetFloat() ); break;
+		case KeyValues::TYPE_STRING:	SetStringField( field, pKey->GetString() ); break;
+		default:
+			// undeclared, or a type the slots don't hold
+			GetExtraKeys( true )->AddSubKey( pKey->MakeCopy() );
+			break;
+		}
+	}
+
+	// legacy listeners get the exact keys they were fired with
+	OnChanged();
+	m_pDataKeys = keys;
+}
+
+void CGameEvent::CopyFrom( CGameEvent *pOther )
+{
+	Assert( m_pDescriptor == pOther->m_pDescriptor && m_nSlots == pOther->m_nSlots );
+
+	Clear();
+
+	int nSlots = MIN( m_nSlots, pOther->m_nSlots );
+	for ( int i = 0; i < nSlots; i++ )
+	{
+		const GameEventSlot_t &src = pOther->m_pSlots[i];
+		GameEventSlot_t &dst = m_pSlots[i];
+
+		if ( src.type == VALUE_STRING )
+		{
+			SetSlotString( dst, src.pszValue );
+		}
+		else
+		{
+			dst.type = src.type;
+			dst.iValue = src.iValue;
+		}
+	}
+
+	if ( pOther->m_pExtraKeys )
+	{
+		m_pExtraKeys = pOther->m_pExtraKeys->MakeCopy();
+	}
+}
+
+void CGameEventDescriptor::BuildFields()
+{
+	// pooled events have the old layout
+	PurgeFreeEvents();
+
+	fields.RemoveAll();
+
+	if ( !keys )
+		return;
+
+	FOR_EACH_SUBKEY( keys, pKey )
+	{
+		CGameEventField &field = fields[ fields.AddToTail() ];
+		field.symbol = pKey->GetNameSymbol();
+		field.name = pKey->GetName();
+		field.type = pKey->GetInt();
+	}
+}
+
+void CGameEventDescriptor::PurgeFreeEvents()
+{
+	freeEvents.PurgeAndDeleteElements();
+}
+
+int CGameEventDescriptor::FindField( const char *keyName ) const
+{
+	if ( !keyName || !keyName[0] )
+		return -1;
+
+	// the symbol table does the case insensitive compare, after that it's integers
+	intp symbol = KeyValues::CallGetSymbolForString( keyName, false );
+	if ( symbol == INVALID_KEY_SYMBOL )
+		return -1;
+
+	for ( int i = 0; i < fields.Count(); i++ )
+	{
+		if ( fields[i].symbol == symbol )
+			return i;
+	}
+
+	return -1;
+}
+
+CGameEventManager::CGameEventManager() : m_EventMap( k_eDictCompareTypeCaseSensitive )
 {
 	Reset();
 }
@@ -152,9 +557,12 @@ void CGameEventManager::Reset()
 		}
 					
 		e.listeners.Purge();	// remove listeners
+		e.PurgeFreeEvents();
 	}
 
 	m_GameEvents.Purge();
+	m_EventMap.RemoveAll();
+	RebuildEventIdMap();
 	m_Listeners.PurgeAndDeleteElements();
 	m_EventFiles.RemoveAll();
 	m_EventFileNames.RemoveAll();
@@ -192,19 +600,15 @@ void CGameEventManager::WriteEventList(SVC_GameEventList *msg)
 		msg->m_DataOut.WriteUBitLong( descriptor.eventid, MAX_EVENT_BITS );
 		msg->m_DataOut.WriteString( descriptor.name );
 		
-		KeyValues *key = descriptor.keys->GetFirstSubKey(); 
-
-		while ( key )
+		for ( int j = 0; j < descriptor.fields.Count(); j++ )
 		{
-			int type = key->GetInt();
+			const CGameEventField &field = descriptor.fields[j];
 
-			if ( type != TYPE_LOCAL )
+			if ( field.type != TYPE_LOCAL )
 			{
-				msg->m_DataOut.WriteUBitLong( type, 3 );
-				msg->m_DataOut.WriteString( key->GetName() );
+				msg->m_DataOut.WriteUBitLong( field.type, 3 );
+				msg->m_DataOut.WriteString( field.name );
 			}
-
-			key = key->GetNextKey();
 		}
 
 		msg->m_DataOut.WriteUBitLong( TYPE_LOCAL, 3 ); // end marker
@@ -258,9 +662,12 @@ bool CGameEventManager::ParseEventList(SVC_GameEventList *msg)
 			datatype = msg->m_DataIn.ReadUBitLong( 3 );
 		}
 
+		descriptor->BuildFields();
 		descriptor->eventid = id;
 	}
 
+	RebuildEventIdMap();
+
 	// force client to answer what events he listens to
 	m_bClientListenersChanged = true;
 
@@ -304,8 +711,18 @@ void CGameEventManager::WriteListenEventList(CLC_ListenEvents *msg)
 	}
 }
 
-IGameEvent *CGameEventManager::CreateEvent( CGameEventDescriptor *descriptor )
+CGameEvent *CGameEventManager::CreateEvent( CGameEventDescriptor *descriptor )
 {
+	if ( descriptor->freeEvents.Count() )
+	{
+		CGameEvent *event = descriptor->freeEvents.Tail();
+		descriptor->freeEvents.RemoveMultipleFromTail( 1 );
+
+		// descriptors move when m_GameEvents grows
+		event->m_pDescriptor = descriptor;
+		return event;
+	}
+
 	return new CGameEvent ( descriptor );
 }
 
@@ -330,7 +747,7 @@ IGameEvent *CGameEventManager::CreateEvent( const char *name, bool bForce )
 	}
 
 	// create & return the new event 
-	return new CGameEvent ( descriptor );
+	return CreateEvent( descriptor );
 }
 
 bool CGameEventManager::FireEvent( IGameEvent *event, bool bServerOnly )
@@ -350,14 +767,9 @@ IGameEvent *CGameEventManager::DuplicateEvent( IGameEvent *event )
 	if ( !gameEvent )
 		return NULL;
 
-	// create new instance
-	CGameEvent *newEvent = new CGameEvent ( gameEvent->m_pDescriptor );
-
-	// free keys
-	newEvent->m_pDataKeys->deleteThis();
-
-	// and make copy
-	newEvent->m_pDataKeys = gameEvent->m_pDataKeys->MakeCopy();
+	// create new instance and copy the data over
+	CGameEvent *newEvent = CreateEvent( gameEvent->m_pDescriptor );
+	newEvent->CopyFrom( gameEvent );
 
 	return newEvent;
 }
@@ -369,22 +781,19 @@ void CGameEventManager::ConPrintEvent( IGameEvent *event)
 	if ( !descriptor )
 		return;
 
-	KeyValues *key = descriptor->keys->GetFirstSubKey(); 
+	CGameEvent *gameEvent = static_cast<CGameEvent*>( event );
 
-	while ( key )
+	for ( int i = 0; i < descriptor->fields.Count(); i++ )
 	{
-		const char * keyName = key->GetName();
+		const char * keyName = descriptor->fields[i].name;
 
-		int type = key->GetInt();
-
-		switch ( type )
+		switch ( descriptor->fields[i].type )
 		{
-		case TYPE_LOCAL : ConMsg( "- \"%s\" = \"%s\" (local)\n", keyName, event->GetString(keyName) ); break;
-		case TYPE_STRING : ConMsg( "- \"%s\" = \"%s\"\n", keyName, event->GetString(keyName) ); break;
-		case TYPE_FLOAT : ConMsg( "- \"%s\" = \"%.2f\"\n", keyName, event->GetFloat(keyName) ); break;
-		default: ConMsg( "- \"%s\" = \"%i\"\n", keyName, event->GetInt(keyName) ); break;
+		case TYPE_LOCAL : ConMsg( "- \"%s\" = \"%s\" (local)\n", keyName, gameEvent->GetStringField( i ) ); break;
+		case TYPE_STRING : ConMsg( "- \"%s\" = \"%s\"\n", keyName, gameEvent->GetStringField( i ) ); break;
+		case TYPE_FLOAT : ConMsg( "- \"%s\" = \"%.2f\"\n", keyName, gameEvent->GetFloatField( i ) ); break;
+		default: ConMsg( "- \"%s\" = \"%i\"\n", keyName, gameEvent->GetIntField( i ) ); break;
 		}
-		key = key->GetNextKey();
 	}
 }
 
@@ -458,7 +867,7 @@ bool CGameEventManager::FireEventIntern( IGameEvent *event, bool bServerOnly, bo
 			IGameEventListener *pCallback = static_cast<IGameEventListener*>(listener->m_pCallback);
 			CGameEvent *pEvent = static_cast<CGameEvent*>(event);
 
-			pCallback->FireGameEvent( pEvent->m_pDataKeys );
+			pCallback->FireGameEvent( pEvent->GetDataKeys() );
 		}
 		else
 		{
@@ -483,45 +892,60 @@ bool CGameEventManager::SerializeEvent( IGameEvent *event, bf_write* buf )
 
 	Assert( descriptor );
 
-	buf->WriteUBitLong( descriptor->eventid, MAX_EVENT_BITS );
-
-	// now iterate trough all fields described in gameevents.res and put them in the buffer
+	CGameEvent *gameEvent = static_cast<CGameEvent*>( event );
 
-	KeyValues * key = descriptor->keys->GetFirstSubKey();
+	buf->WriteUBitLong( descriptor->eventid, MAX_EVENT_BITS );
 
-	if ( net_showevents.GetInt() > 2 )
-	{
-		DevMsg("Serializing event '%s' (%i):\n", descriptor->name, descriptor->eventid );
-	}
-	
-	while ( key )
+	// the field data is the same for every client the event goes to, so it's only
+	// encoded again after the event changed
+	if ( gameEvent->m_nSerializedBits < 0 || net_showevents.GetInt() > 2 )
 	{
-		const char * keyName = key->GetName();
-
-		int type = key->GetInt();
+		byte data[MAX_EVENT_BYTES];
+		bf_write fields( "CGameEventManager::SerializeEvent", data, sizeof( data ) );
 
 		if ( net_showevents.GetInt() > 2 )
 		{
-			DevMsg(" - %s (%i)\n", keyName, type );
+			DevMsg("Serializing event '%s' (%i):\n", descriptor->name, descriptor->eventid );
 		}
 
-		//Make sure every key is used in the event
-		// Assert( event->FindKey(keyName) && "GameEvent field not found in passed KeyValues" );
+		// now iterate trough all fields described in gameevents.res and put them in the buffer
+		for ( int i = 0; i < descriptor->fields.Count(); i++ )
+		{
+			int type = descriptor->fields[i].type;
 
-		// see s_GameEnventTypeMap for index
-		switch ( type )
+			if ( net_showevents.GetInt() > 2 )
+			{
+				DevMsg(" - %s (%i)\n", descriptor->fields[i].name, type );
+			}
+
+			// see s_GameEnventTypeMap for index
+			switch ( type )
+			{
+				case TYPE_LOCAL : break; // don't network this guy
+				case TYPE_STRING: fields.WriteString( gameEvent->GetStringField( i, "" ) ); break;
+				case TYPE_FLOAT : fields.WriteFloat( gameEvent->GetFloatField( i, 0.0f ) ); break;
+				case TYPE_LONG	: fields.WriteLong( gameEvent->GetIntField( i, 0 ) ); break;
+				case TYPE_SHORT	: fields.WriteShort( gameEvent->GetIntField( i, 0 ) ); break;
+				case TYPE_BYTE	: fields.WriteByte( gameEvent->GetIntField( i, 0 ) ); break;
+				case TYPE_BOOL	: fields.WriteOneBit( gameEvent->GetIntField( i, 0 ) ); break;
+				default: DevMsg(1, "CGameEventManager: unkown type %i for key '%s'.\n", type, descriptor->fields[i].name ); break;
+			}
+		}
+
+		if ( fields.IsOverflowed() )
 		{
-			case TYPE_LOCAL : break; // don't network this guy
-			case TYPE_STRING: buf->WriteString( event->GetString( keyName, "") ); break;
-			case TYPE_FLOAT : buf->WriteFloat( event->GetFloat( keyName, 0.0f) ); break;
-			case TYPE_LONG	: buf->WriteLong( event->GetInt( keyName, 0) ); break;
-			case TYPE_SHORT	: buf->WriteShort( event->GetInt( keyName, 0) ); break;
-			case TYPE_BYTE	: buf->WriteByte( event->GetInt( keyName, 0) ); break;
-			case TYPE_BOOL	: buf->WriteOneBit( event->GetInt( keyName, 0) ); break;
-			default: DevMsg(1, "CGameEventManager: unkown type %i for key '%s'.\n", type, key->GetName() ); break;
+			buf->SetOverflowFlag();
+			return false;
 		}
 
-		key = key->GetNextKey();
+		gameEvent->m_SerializedData.EnsureCapacity( fields.GetNumBytesWritten() );
+		Q_memcpy( gameEvent->m_SerializedData.Base(), data, fields.GetNumBytesWritten() );
+		gameEvent->m_nSerializedBits = fields.GetNumBitsWritten();
+	}
+
+	if ( gameEvent->m_nSerializedBits > 0 )
+	{
+		buf->WriteBits( gameEvent->m_SerializedData.Base(), gameEvent->m_nSerializedBits );
 	}
 
 	return !buf->IsOverflowed();
@@ -545,7 +969,7 @@ IGameEvent *CGameEventManager::UnserializeEvent( bf_read *buf)
 	}
 
 	// create new event
-	IGameEvent *event = CreateEvent( descriptor );
+	CGameEvent *event = CreateEvent( descriptor );
 
 	if ( !event )
 	{
@@ -553,29 +977,23 @@ IGameEvent *CGameEventManager::UnserializeEvent( bf_read *buf)
 		return NULL;
 	}
 
-	KeyValues * key = descriptor->keys->GetFirstSubKey(); 
-
-	while ( key )
+	for ( int i = 0; i < descriptor->fields.Count(); i++ )
 	{
-		const char * keyName = key->GetName();
-
-		int type = key->GetInt();
+		int type = descriptor->fields[i].type;
 
 		switch ( type )
 		{
 			case TYPE_LOCAL		: break; // ignore 
 			case TYPE_STRING	: if ( buf->ReadString( databuf, sizeof(databuf) ) )
-									event->SetString( keyName, databuf );
+									event->SetStringField( i, databuf );
 								  break;
-			case TYPE_FLOAT		: event->SetFloat( keyName, buf->ReadFloat() ); break;
-			case TYPE_LONG		: event->SetInt( keyName, buf->ReadLong() ); break;
-			case TYPE_SHORT		: event->SetInt( keyName, buf->ReadShort() ); break;
-			case TYPE_BYTE		: event->SetInt( keyName, buf->ReadByte() ); break;
-			case TYPE_BOOL		: event->SetInt( keyName, buf->ReadOneBit() ); break;
-			default: DevMsg(1, "CGameEventManager: unknown type %i for key '%s'.\n", type, key->GetName() ); break;
+			case TYPE_FLOAT		: event->SetFloatField( i, buf->ReadFloat() ); break;
+			case TYPE_LONG		: event->SetIntField( i, buf->ReadLong() ); break;
+			case TYPE_SHORT		: event->SetIntField( i, buf->ReadShort() ); break;
+			case TYPE_BYTE		: event->SetIntField( i, buf->ReadByte() ); break;
+			case TYPE_BOOL		: event->SetIntField( i, buf->ReadOneBit() ); break;
+			default: DevMsg(1, "CGameEventManager: unknown type %i for key '%s'.\n", type, descriptor->fields[i].name ); break;
 		}
-
-		key = key->GetNextKey();
 	}
 
 	return event;
@@ -690,6 +1108,8 @@ void CGameEventManager::ReloadEventDefinitions()
 	{
 		m_GameEvents[j].eventid = j;
 	}
+
+	RebuildEventIdMap();
 }
 
 bool CGameEventManager::AddListener( IGameEventListener2 *listener, const char *event, bool bServerSide )
@@ -769,11 +1189,14 @@ bool CGameEventManager::RegisterEvent( KeyValues * event)
 		AssertMsg2( V_strlen( event->GetName() ) <= MAX_EVENT_NAME_LENGTH, "Event named '%s' exceeds maximum name length %d", event->GetName(), MAX_EVENT_NAME_LENGTH );
 
 		Q_strncpy( descriptor->name, event->GetName(), MAX_EVENT_NAME_LENGTH );	
+
+		m_EventMap.Insert( descriptor->name, index );
 	}
 	else
 	{
 		// descriptor already know, but delete old definitions
-		descriptor->keys->deleteThis();
+		if ( descriptor->keys )
+			descriptor->keys->deleteThis();
 	}
 
 	// create new descriptor keys
@@ -821,6 +1244,8 @@ bool CGameEventManager::RegisterEvent( KeyValues * event)
 		
 		subkey = subkey->GetNextKey();
 	}
+
+	descriptor->BuildFields();
 	
 	return true;
 }
@@ -837,18 +1262,31 @@ CGameEventDescriptor *CGameEventManager::GetEventDescriptor(IGameEvent *event)
 
 CGameEventDescriptor *CGameEventManager::GetEventDescriptor(int eventid) // returns event name or NULL
 {
-	if ( eventid < 0 )
+	if ( eventid < 0 || eventid >= MAX_EVENT_NUMBER )
 		return NULL;
 
+	int index = m_EventIdMap[eventid];
+
+	return ( index >= 0 ) ? &m_GameEvents[index] : NULL;
+}
+
+void CGameEventManager::RebuildEventIdMap()
+{
+	for ( int i = 0; i < MAX_EVENT_NUMBER; i++ )
+	{
+		m_EventIdMap[i] = -1;
+	}
+
 	for ( int i = 0; i < m_GameEvents.Count(); i++ )
 	{
-		CGameEventDescriptor *descriptor = &m_GameEvents[i];
+		int eventid = m_GameEvents[i].eventid;
 
-		if ( descriptor->eventid == eventid )
-			return descriptor;
+		// first descriptor with an id wins, same as searching the list
+		if ( eventid >= 0 && eventid < MAX_EVENT_NUMBER && m_EventIdMap[eventid] < 0 )
+		{
+			m_EventIdMap[eventid] = i;
+		}
 	}
-
-	return NULL;
 }
 
 void CGameEventManager::FreeEvent( IGameEvent *event )
@@ -856,6 +1294,23 @@ void CGameEventManager::FreeEvent( IGameEvent *event )
 	if ( !event )
 		return;
 
+	CGameEvent *gameEvent = dynamic_cast<CGameEvent*>( event );
+
+	if ( gameEvent )
+	{
+		CGameEventDescriptor *descriptor = gameEvent->m_pDescriptor;
+
+		// only pool events that still match a live descriptor's layout
+		if ( descriptor >= m_GameEvents.Base() && descriptor < m_GameEvents.Base() + m_GameEvents.Count() &&
+			 gameEvent->m_nSlots == descriptor->fields.Count() &&
+			 descriptor->freeEvents.Count() < MAX_POOLED_EVENTS )
+		{
+			gameEvent->Clear();
+			descriptor->freeEvents.AddToTail( gameEvent );
+			return;
+		}
+	}
+
 	delete event;
 }
 
@@ -864,15 +1319,12 @@ CGameEventDescriptor *CGameEventManager::GetEventDescriptor(const char * name)
 	if ( !name || !name[0] )
 		return NULL;
 
-	for (int i=0; i < m_GameEvents.Count(); i++ )
-	{
-		CGameEventDescriptor *descriptor = &m_GameEvents[i];
+	int index = m_EventMap.Find( name );
 
-		if ( Q_strcmp( descriptor->name, name ) == 0 )
-			return descriptor;
-	}
+	if ( index == m_EventMap.InvalidIndex() )
+		return NULL;
 
-	return NULL;
+	return &m_GameEvents[ m_EventMap[index] ];
 }
 
 bool CGameEventManager::AddListenerAll( void *listener, int nListenerType )
@@ -18,9 +18,11 @@
 #include <KeyValues.h>
 #include <networkstringtabledefs.h>
 #include <utlsymbol.h>
+#include <utldict.h>
 
 class SVC_GameEventList;
 class CLC_ListenEvents;
+class CGameEvent;
 
 class CGameEventCallback
 {
@@ -29,6 +31,15 @@ public:
 	int					m_nListenerType;	// client or server side ?
 };
 
+// one declared data field of an event, compiled from the descriptor keys
+class CGameEventField
+{
+public:
+	intp		symbol;		// KeyValues symbol of the field name, so lookups stay case insensitive
+	const char	*name;		// points into the KeyValues symbol table
+	int			type;		// CGameEventManager::TYPE_*
+};
+
 class CGameEventDescriptor
 {
 public:
@@ -41,6 +52,13 @@ public:
 		reliable = true;
 	}
 
+	// compiles keys into fields, events created before this are no longer valid
+	void BuildFields();
+	void PurgeFreeEvents();
+
+	// slot index of a declared field or -1, resolve once and reuse for repeated access
+	int FindField( const char *keyName ) const;
+
 public:
 	char		name[MAX_EVENT_NAME_LENGTH];	// name of this event
 	int			eventid;	// network index number, -1 = not networked
@@ -48,6 +66,24 @@ public:
 	bool		local;		// local event, never tell clients about that
 	bool		reliable;	// send this event as reliable message
     CUtlVector<CGameEventCallback*>	listeners;	// registered listeners
+	CUtlVector<CGameEventField>		fields;		// slot layout of events, in keys order
+	CUtlVector<CGameEvent*>			freeEvents;	// pooled events with this layout
+};
+
+// value of one field in a CGameEvent. Short strings are stored inline so that
+// setting and converting values doesn't touch the heap.
+#define GAMEEVENT_SLOT_STRING_LENGTH	48
+
+struct GameEventSlot_t
+{
+	char	type;		// CGameEvent::VALUE_*
+	union
+	{
+		int		iValue;
+		float	flValue;
+	};
+	char	*pszValue;	// points at szValue, or a heap copy of a long string
+	char	szValue[GAMEEVENT_SLOT_STRING_LENGTH];
 };
 
 class CGameEvent : public IGameEvent
@@ -57,6 +93,14 @@ public:
 	CGameEvent( CGameEventDescriptor *descriptor );
 	virtual ~CGameEvent();
 
+	enum
+	{
+		VALUE_NONE = 0,	// not set
+		VALUE_INT,
+		VALUE_FLOAT,
+		VALUE_STRING
+	};
+
 	const char *GetName() const;
 	bool  IsEmpty(const char *keyName = NULL);
 	bool  IsLocal() const;
@@ -71,9 +115,43 @@ public:
 	void SetInt( const char *keyName, int value );
 	void SetFloat( const char *keyName, float value );
 	void SetString( const char *keyName, const char *value );
-	
+
+	// direct slot access for callers that resolved a field with CGameEventDescriptor::FindField
+	int   GetIntField( int field, int defaultValue = 0 );
+	float GetFloatField( int field, float defaultValue = 0.0f );
+	const char *GetStringField( int field, const char *defaultValue = "" );
+	void SetIntField( int field, int value );
+	void SetFloatField( int field, float value );
+	void SetStringField( int field, const char *value );
+
+	// KeyValues form of the event data, for legacy listeners. Valid until the event changes
+	KeyValues *GetDataKeys();
+	// replaces the event data with keys and takes ownership of them
+	void SetDataKeys( KeyValues *keys );
+
+	void CopyFrom( CGameEvent *pOther );
+	void Clear();	// back to a freshly created event
+
 	CGameEventDescriptor	*m_pDescriptor;
-	KeyValues				*m_pDataKeys;
+
+private:
+	friend class CGameEventManager;
+
+	KeyValues *GetExtraKeys( bool bCreate );
+	int FindSlot( const char *keyName ) const;
+	void SetSlotString( GameEventSlot_t &slot, const char *value );
+	const char *GetSlotString( GameEventSlot_t &slot );
+	void ClearSlot( GameEventSlot_t &slot );
+	void OnChanged();
+
+	GameEventSlot_t			*m_pSlots;		// one per m_pDescriptor->fields
+	int						m_nSlots;
+	KeyValues				*m_pExtraKeys;	// keys the descriptor doesn't declare, usually NULL
+	KeyValues				*m_pDataKeys;	// built by GetDataKeys(), usually NULL
+
+	// serialized fields, reused for every client this event is sent to
+	CUtlMemory<byte>		m_SerializedData;
+	int						m_nSerializedBits;	// -1 if not serialized since the last change
 };
 
 class CGameEventManager : public IGameEventManager2
@@ -145,7 +223,7 @@ public:
 	
 protected:
 
-	IGameEvent *CreateEvent( CGameEventDescriptor *descriptor );
+	CGameEvent *CreateEvent( CGameEventDescriptor *descriptor );
 	bool RegisterEvent( KeyValues * keys );
 	void UnregisterEvent(int index);
 	bool FireEventIntern( IGameEvent *event, bool bServerSide, bool bClientOnly );
@@ -156,7 +234,12 @@ protected:
 	CUtlSymbolTable						m_EventFiles;	// list of all loaded event files
 	CUtlVector<CUtlSymbol>				m_EventFileNames; 
 
+	CUtlDict<int, int>					m_EventMap;	// event name to m_GameEvents index
+	short								m_EventIdMap[MAX_EVENT_NUMBER];	// eventid to m_GameEvents index, -1 if unknown
+
 	bool	m_bClientListenersChanged;	// true every time client changed listeners
+
+	void RebuildEventIdMap();
 };
 
 extern CGameEventManager &g_GameEventManager;
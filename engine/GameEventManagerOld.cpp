@@ -115,8 +115,7 @@ bool CGameEventManagerOld::FireEventIntern( KeyValues *keys, bool bServerSideOnl
 	if ( !event )
 		return false;
 
-	event->m_pDataKeys->deleteThis();
-	event->m_pDataKeys = keys;
+	event->SetDataKeys( keys );
 
 	if ( bClientSideOnly )
 	{
@@ -6,10 +6,60 @@
 //=============================================================================//
 #include "quakedef.h"
 #include "networkstringtableitem.h"
+#include "mempool.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
+// User data is mostly small (player info, model precache flags), so it's
+// allocated from pools of 16 to 1024 byte blocks. Anything bigger goes to the heap.
+#define USERDATA_POOL_MIN_SHIFT		4
+#define USERDATA_POOL_MAX_SHIFT		10
+#define USERDATA_POOL_COUNT			( USERDATA_POOL_MAX_SHIFT - USERDATA_POOL_MIN_SHIFT + 1 )
+
+static CUtlMemoryPool *s_pUserDataPools[USERDATA_POOL_COUNT];
+
+static int UserDataPoolIndex( int length )
+{
+	int nPool = 0;
+	while ( ( 1 << ( nPool + USERDATA_POOL_MIN_SHIFT ) ) < length )
+	{
+		nPool++;
+	}
+	return nPool;
+}
+
+unsigned char *CNetworkStringTableItem::AllocUserData( int length )
+{
+	Assert( length > 0 );
+
+	if ( length > ( 1 << USERDATA_POOL_MAX_SHIFT ) )
+		return new unsigned char[ALIGN_VALUE( length, 4 )];
+
+	int nPool = UserDataPoolIndex( length );
+	if ( !s_pUserDataPools[nPool] )
+	{
+		int nBlockSize = 1 << ( nPool + USERDATA_POOL_MIN_SHIFT );
+		s_pUserDataPools[nPool] = new CUtlMemoryPool( nBlockSize, MAX( 4096 / nBlockSize, 4 ), CUtlMemoryPool::GROW_SLOW, "CNetworkStringTableItem" );
+	}
+
+	return (unsigned char *)s_pUserDataPools[nPool]->Alloc();
+}
+
+void CNetworkStringTableItem::FreeUserData( unsigned char *pData, int length )
+{
+	if ( !pData )
+		return;
+
+	if ( length > ( 1 << USERDATA_POOL_MAX_SHIFT ) )
+	{
+		delete[] pData;
+		return;
+	}
+
+	s_pUserDataPools[ UserDataPoolIndex( length ) ]->Free( pData );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -22,6 +72,9 @@ CNetworkStringTableItem::CNetworkStringTableItem( void )
 #ifndef SHARED_NET_STRING_TABLES
 	m_nTickCreated = 0;
 	m_pChangeList = NULL;
+	m_pPrevUserData = NULL;
+	m_nPrevUserDataLength = 0;
+	m_nTickPrevChanged = 0;
 #endif
 }
 
@@ -39,20 +92,18 @@ CNetworkStringTableItem::~CNetworkStringTableItem( void )
 		{
 			itemchange_s item = m_pChangeList->Element( i );
 
-			if ( item.data )
-				delete[] item.data;
+			FreeUserData( item.data, item.length );
 		}
 
 		delete m_pChangeList; // destructor calls Purge()
 
 		m_pUserData = NULL;
 	}
+
+	FreeUserData( m_pPrevUserData, m_nPrevUserDataLength );
 #endif
 		
-	if ( m_pUserData )
-	{
-		delete[] m_pUserData;
-	}
+	FreeUserData( m_pUserData, m_nUserDataLength );
 }
 
 #ifndef SHARED_NET_STRING_TABLES
@@ -93,10 +144,7 @@ void CNetworkStringTableItem::UpdateChangeList( int tick, int length, const void
 		if ( item.tick == tick )
 		{
 			// two changes within same tick frame, remove last change from list
-			if ( item.data )
-			{
-				delete[] item.data;
-			}
+			FreeUserData( item.data, item.length );
 
 			m_pChangeList->Remove( count-1 );
 		}
@@ -109,7 +157,7 @@ void CNetworkStringTableItem::UpdateChangeList( int tick, int length, const void
 
 	if ( userData && length )
 	{
-		item.data = new unsigned char[length];
+		item.data = AllocUserData( length );
 		item.length = length;
 		Q_memcpy( item.data, userData, length );
 	}
@@ -160,6 +208,19 @@ int CNetworkStringTableItem::RestoreTick( int tick )
 
 	return m_nTickChanged;
 }
+
+const void *CNetworkStringTableItem::GetDeltaBase( int tick_ack, int *length ) const
+{
+	// the client must have had the item, and already have acked the previous change
+	if ( m_pChangeList || !m_pPrevUserData || tick_ack < 0 || 
+		 m_nTickCreated > tick_ack || m_nTickPrevChanged > tick_ack || m_nTickChanged <= tick_ack )
+	{
+		return NULL;
+	}
+
+	*length = m_nPrevUserDataLength;
+	return m_pPrevUserData;
+}
 #endif
 
 //-----------------------------------------------------------------------------
@@ -192,14 +253,27 @@ bool CNetworkStringTableItem::SetUserData( int tick, int length, const void *use
 		return false; // old & new data are equal
 	}
 
-	if ( m_pUserData )
-		delete[] m_pUserData;
+#ifndef SHARED_NET_STRING_TABLES
+	if ( m_nTickChanged != tick )
+	{
+		// keep the old data as delta base, clients that acked it only need the difference.
+		// more changes during this tick keep the data from before the tick.
+		FreeUserData( m_pPrevUserData, m_nPrevUserDataLength );
+		m_pPrevUserData = m_pUserData;
+		m_nPrevUserDataLength = m_nUserDataLength;
+		m_nTickPrevChanged = m_nTickChanged;
+	}
+	else
+#endif
+	{
+		FreeUserData( m_pUserData, m_nUserDataLength );
+	}
 
 	m_nUserDataLength = length;
 
 	if ( length > 0 )
 	{
-		m_pUserData = new unsigned char[ALIGN_VALUE( length, 4 )];
+		m_pUserData = AllocUserData( length );
 		Q_memcpy( m_pUserData, userData, length );
 	}
 	else
@@ -703,6 +703,9 @@ bool CBaseClient::SendServerInfo( void )
 	serverinfo.m_nPlayerSlot = m_nClientSlot; // own slot number
 
 	m_Server->FillServerInfo( serverinfo ); // fill rest of info message
+
+	// older clients only accept the protocol they connected with
+	serverinfo.m_nProtocol = m_NetChannel->GetProtocolVersion();
 	
 	serverinfo.WriteToBuffer( msg );
 
@@ -722,7 +725,7 @@ bool CBaseClient::SendServerInfo( void )
 
 	// write stringtable baselines
 #ifndef SHARED_NET_STRING_TABLES
-	m_Server->m_StringTables->WriteBaselines( msg );
+	m_Server->m_StringTables->WriteBaselines( msg, m_NetChannel->GetProtocolVersion() );
 #endif
 	
 	// Write replicated ConVars to non-listen server clients only
@@ -1195,7 +1198,7 @@ write_again:
 	if ( !g_pLocalNetworkBackdoor )
 	{
 		// Update shared client/server string tables. Must be done before sending entities
-		m_Server->m_StringTables->WriteUpdateMessage( this, GetMaxAckTickCount(), msg );
+		m_Server->m_StringTables->WriteUpdateMessage( this, GetMaxAckTickCount(), msg, m_NetChannel->GetProtocolVersion() );
 	}
 #endif
 
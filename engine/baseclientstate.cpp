@@ -1391,7 +1391,7 @@ bool CBaseClientState::ProcessCreateStringTable( SVC_CreateStringTable *msg )
 			if ( bSuccess )
 			{
 				bf_read data( uncompressedBuffer, uncompressedSize );
-				table->ParseUpdate( data, msg->m_nNumEntries );
+				table->ParseUpdate( data, msg->m_nNumEntries, GetDemoProtocolVersion() );
 			}
 
 			delete[] uncompressedBuffer;
@@ -1406,7 +1406,7 @@ bool CBaseClientState::ProcessCreateStringTable( SVC_CreateStringTable *msg )
 	}
 	else
 	{
-		table->ParseUpdate( msg->m_DataIn, msg->m_nNumEntries );
+		table->ParseUpdate( msg->m_DataIn, msg->m_nNumEntries, GetDemoProtocolVersion() );
 	}
 
 #endif
@@ -1435,7 +1435,7 @@ bool CBaseClientState::ProcessUpdateStringTable( SVC_UpdateStringTable *msg )
 		CNetworkStringTable *table = (CNetworkStringTable*)
 			m_StringTableContainer->GetTable( msg->m_nTableID );
 
-		table->ParseUpdate( msg->m_DataIn, msg->m_nChangedEntries );
+		table->ParseUpdate( msg->m_DataIn, msg->m_nChangedEntries, GetDemoProtocolVersion() );
 	}
 	else
 	{
@@ -531,7 +531,7 @@ IClient *CBaseServer::ConnectClient ( netadr_t &adr, int protocol, int challenge
 	COM_TimestampedLog( "CBaseServer::ConnectClient:  NET_CreateNetChannel" );
 
 	// create network channel
-	INetChannel * netchan = NET_CreateNetChannel( m_Socket, &adr, adr.ToString(), client );
+	INetChannel * netchan = NET_CreateNetChannel( m_Socket, &adr, adr.ToString(), client, false, protocol );
 
 	if ( !netchan )
 	{
@@ -1399,7 +1399,8 @@ Make sure connecting client is using proper protocol
 */
 bool CBaseServer::CheckProtocol( netadr_t &adr, int nProtocol, int clientChallenge )
 {
-	if ( nProtocol != PROTOCOL_VERSION )
+	// protocol 25 clients only lack string table user data deltas, which aren't sent to them
+	if ( nProtocol != PROTOCOL_VERSION && nProtocol != PROTOCOL_VERSION_25 )
 	{
 		// Client is newer than server
 		if ( nProtocol > PROTOCOL_VERSION )
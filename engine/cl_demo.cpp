@@ -43,6 +43,7 @@
 static ConVar demo_recordcommands( "demo_recordcommands", "1", FCVAR_CHEAT, "Record commands typed at console into .dem files." );
 static ConVar demo_quitafterplayback( "demo_quitafterplayback", "0", 0, "Quits game after demo playback." );
 static ConVar demo_debug( "demo_debug", "0", 0, "Demo debug info." );
+static ConVar demo_keyframes( "demo_keyframes", "1", 0, "Use demo keyframes to jump close to the target tick when skipping." );
 static ConVar demo_interpolateview( "demo_interpolateview", "1", 0, "Do view interpolation during dem playback." );
 static ConVar demo_pauseatservertick( "demo_pauseatservertick", "0", 0, "Pauses demo playback at server tick" );
 static ConVar timedemo_runcount( "timedemo_runcount", "0", 0, "Runs time demo X number of times." );
@@ -118,7 +119,7 @@ static bool IsControlCommand( unsigned char cmd )
 {
 	return ( (cmd == dem_signon) || (cmd == dem_stop) ||
 		     (cmd == dem_synctick) || (cmd == dem_datatables ) ||
-			 (cmd == dem_stringtables) );
+			 (cmd == dem_stringtables) || (cmd == dem_keyframe) );
 }
 
 
@@ -941,12 +942,81 @@ void CDemoPlayer::SkipToTick( int tick, bool bRelative, bool bPause )
 	}
 
 	m_nSkipToTick = tick;
+	m_bSeekToKeyframe = demo_keyframes.GetBool() && m_DemoFile.m_Keyframes.Count() > 0;
 	ETWMark1I( "DemoPlayer: SkipToTick", tick );
 
 	if ( bPause )
 		PausePlayback( -1 );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Moves the read position to the last keyframe before tick, if that
+//			gets us further than reading on from where we are
+//-----------------------------------------------------------------------------
+bool CDemoPlayer::SeekToKeyframe( int tick )
+{
+	int i = m_DemoFile.FindKeyframe( tick );
+	if ( i < 0 )
+		return false;
+
+	const demokeyframe_t &keyframe = m_DemoFile.m_Keyframes[i];
+	if ( keyframe.tick <= GetPlaybackTick() )
+		return false;
+
+	if ( demo_debug.GetBool() )
+	{
+		Msg( "Seeking to keyframe at tick %d for tick %d\n", keyframe.tick, tick );
+	}
+
+	m_DemoFile.SeekTo( keyframe.offset, true );
+	m_nKeyframeOffset = keyframe.offset;
+
+	// queued view info is from the part we skipped
+	m_DestCmdInfo.RemoveAll();
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Replaces entity baselines and string tables with the ones stored
+//			in a keyframe, see CHLTVDemoRecorder::WriteKeyframe
+//-----------------------------------------------------------------------------
+void CDemoPlayer::RestoreKeyframe( CUtlBuffer &state )
+{
+	bf_read buf( "CDemoPlayer::RestoreKeyframe", state.Base(), state.TellPut() );
+
+	cl.FreeEntityBaselines();
+
+	int nBaseline = buf.ReadOneBit();
+	int nEntities = buf.ReadUBitVar();
+	for ( int i = 0; i < nEntities; i++ )
+	{
+		int nEntity = buf.ReadUBitLong( MAX_EDICT_BITS );
+		int nClass = buf.ReadUBitVar();
+		int nBits = buf.ReadUBitVar();
+
+		if ( nClass >= cl.m_nServerClasses || nBits > MAX_PACKEDENTITY_DATA * 8 || buf.IsOverflowed() )
+		{
+			Host_Error( "Error parsing entity baselines of keyframe during demo playback." );
+			return;
+		}
+
+		ALIGN4 char packedData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
+		buf.ReadBits( packedData, nBits );
+
+		ClientClass *pClass = cl.m_pServerClasses[nClass].m_pClientClass;
+		if ( pClass )
+		{
+			cl.SetEntityBaseline( nBaseline, pClass, nEntity, packedData, Bits2Bytes( nBits ) );
+		}
+	}
+
+	if ( !networkStringTableContainerClient->ReadStringTables( buf ) )
+	{
+		Host_Error( "Error parsing string tables of keyframe during demo playback." );
+	}
+}
+
 void CDemoPlayer::SetEndTick( int tick )
 {
 	if ( tick < 0 )
@@ -1024,6 +1094,14 @@ bool CDemoPlayer::ParseAheadForInterval( int curtick, int intervalticks )
 					m_DemoFile.ReadStringTables( NULL );
 				}
 				break;
+			case dem_keyframe:
+				{
+					m_DemoFile.ReadKeyframe( NULL );
+					m_DemoFile.ReadCmdInfo( nextinfo );
+					m_DemoFile.ReadSequenceInfo( dummy, dummy );
+					m_DemoFile.ReadRawData( NULL, 0 );
+				}
+				break;
 			default:
 				{
 					swallowmessages = false;
@@ -1037,7 +1115,7 @@ bool CDemoPlayer::ParseAheadForInterval( int curtick, int intervalticks )
 
 		// we read now a dem_packet
 		m_DemoFile.ReadCmdInfo( nextinfo );
-		m_DemoFile.ReadSequenceInfo( dummy, dummy ); 
+		m_DemoFile.ReadSequenceInfo( dummy, dummy );
 		m_DemoFile.ReadRawData( NULL, 0 );
 
 		DemoCommandQueue entry;
@@ -1122,6 +1200,14 @@ netpacket_t *CDemoPlayer::ReadPacket( void )
 	if ( CheckPausedPlayback() )
 		return NULL;
 
+	// wait until a reload for skipping backwards got through the signon data
+	if ( m_bSeekToKeyframe && IsSkipping() && cl.IsActive() &&
+		 ( m_nSkipToTick & SKIP_TO_TICK_FLAG ) != SKIP_TO_TICK_FLAG )
+	{
+		m_bSeekToKeyframe = false;
+		SeekToKeyframe( m_nSkipToTick );
+	}
+
 	bool bStopReading = false;
 	
 	while ( !bStopReading )
@@ -1273,6 +1359,41 @@ netpacket_t *CDemoPlayer::ReadPacket( void )
 				free( data );
 			}
 			break;
+		case dem_keyframe:
+			{
+				if ( curpos != m_nKeyframeOffset )
+				{
+					// only needed when seeking, the packets around it hold the same state
+					int dummy;
+					democmdinfo_t info;
+					m_DemoFile.ReadKeyframe( NULL );
+					m_DemoFile.ReadCmdInfo( info );
+					m_DemoFile.ReadSequenceInfo( dummy, dummy );
+					m_DemoFile.ReadRawData( NULL, 0 );
+					break;
+				}
+
+				if ( demo_debug.GetBool() )
+				{
+					Msg( "%d dem_keyframe\n", tick );
+				}
+
+				m_nKeyframeOffset = -1;
+
+				CUtlBuffer state;
+				if ( m_DemoFile.ReadKeyframe( &state ) < 0 )
+				{
+					Host_Error( "Error reading keyframe during demo playback." );
+					return NULL;
+				}
+
+				RestoreKeyframe( state );
+
+				// the full entity update follows, hand it out like a dem_packet
+				bStopReading = true;
+				m_nStartTick = host_tickcount - tick;
+			}
+			break;
 		case dem_usercmd:
 			{
 
@@ -1620,6 +1741,8 @@ CDemoPlayer::CDemoPlayer()
 	m_bLoading = false;
 	m_bPlaybackPaused = false;
 	m_nSkipToTick = -1;
+	m_bSeekToKeyframe = false;
+	m_nKeyframeOffset = -1;
 	m_nSkipPacketsPlayed = 0;
 	m_nSnapshotTick = 0;
 	m_SnapshotFilename[0] = 0;
@@ -1672,6 +1795,13 @@ bool CDemoPlayer::StartPlayback( const char *filename, bool bAsTimeDemo )
 	
 	ConMsg ("Playing demo from %s.\n", filename);
 
+	m_bSeekToKeyframe = false;
+	m_nKeyframeOffset = -1;
+	if ( m_DemoFile.ReadKeyframeIndex() && demo_debug.GetBool() )
+	{
+		Msg( "Demo has %d keyframes\n", m_DemoFile.m_Keyframes.Count() );
+	}
+
 	// Now read in the directory structure.
 	m_bPlayingBack = true;
 	cl.m_nSignonState= SIGNONSTATE_CONNECTED;
@@ -78,6 +78,8 @@ public:	// other public functions
 	void	WriteTimeDemoResults( void );
 	bool	ParseAheadForInterval( int curtick, int intervalticks );
 	void	InterpolateDemoCommand( int targettick, DemoCommandQueue& prev, DemoCommandQueue& next );
+	bool	SeekToKeyframe( int tick );
+	void	RestoreKeyframe( CUtlBuffer &state );
 
 protected:
 	bool	OverrideView( democmdinfo_t& info );
@@ -97,6 +99,8 @@ public:
 	int				m_nSkipToTick;	// skip to tick ASAP, -1 = off
 	int				m_nEndTick; // if nonzero, stop playback once we reach this tick
 	bool			m_bLoading; // true if demo is loading
+	bool			m_bSeekToKeyframe; // jump to the keyframe before m_nSkipToTick once connected
+	int				m_nKeyframeOffset; // keyframe we jumped to and still have to restore, -1 = none
 
 	unsigned		m_nSkipPacketsPlayed; // Track consecutive skip packets returned to avoid excess
 
@@ -2564,6 +2564,14 @@ void CDemoSmootherPanel::ParseSmoothingInfo( CDemoFile &demoFile, CSmoothingCont
 					demoFile.ReadStringTables( NULL );
 				}
 				break;
+			case dem_keyframe:
+				{
+					demoFile.ReadKeyframe( NULL );
+					demoFile.ReadCmdInfo( info );
+					demoFile.ReadSequenceInfo( dummy, dummy );
+					demoFile.ReadRawData( NULL, 0 );
+				}
+				break;
 			case dem_usercmd:
 				{
 					demoFile.ReadUserCmd( NULL, dummy );
@@ -16,6 +16,7 @@ CClientFrame::CClientFrame( CFrameSnapshot *pSnapshot )
 {
 	last_entity = 0;
 	transmit_always = NULL;	// bit array used only by HLTV and replay client
+	m_bTransmitAlwaysInArena = false;
 	from_baseline = NULL;
 	tick_count = pSnapshot->m_nTickCount;
 	m_pSnapshot = NULL;
@@ -27,6 +28,7 @@ CClientFrame::CClientFrame( int tickcount )
 {
 	last_entity = 0;
 	transmit_always = NULL;	// bit array used only by HLTV and replay client
+	m_bTransmitAlwaysInArena = false;
 	from_baseline = NULL;
 	tick_count = tickcount;
 	m_pSnapshot = NULL;
@@ -37,6 +39,7 @@ CClientFrame::CClientFrame( void )
 {
 	last_entity = 0;
 	transmit_always = NULL;	// bit array used only by HLTV and replay client
+	m_bTransmitAlwaysInArena = false;
 	from_baseline = NULL;
 	tick_count = 0;
 	m_pSnapshot = NULL;
@@ -56,13 +59,18 @@ void CClientFrame::Init( CFrameSnapshot *pSnapshot )
 
 CClientFrame::~CClientFrame()
 {
-	SetSnapshot( NULL );	// Release our reference to the snapshot.
-
 	if ( transmit_always != NULL )
 	{
-		delete transmit_always;
+		// arena memory goes away with the snapshot
+		if ( !m_bTransmitAlwaysInArena )
+		{
+			delete transmit_always;
+		}
 		transmit_always = NULL;
+		m_bTransmitAlwaysInArena = false;
 	}
+
+	SetSnapshot( NULL );	// Release our reference to the snapshot.
 }
 
 void CClientFrame::SetSnapshot( CFrameSnapshot *pSnapshot )
@@ -70,6 +78,9 @@ void CClientFrame::SetSnapshot( CFrameSnapshot *pSnapshot )
 	if ( m_pSnapshot == pSnapshot )
 		return;
 
+	// transmit_always lives in the current snapshot's arena
+	Assert( !m_bTransmitAlwaysInArena );
+
 	if( pSnapshot )
 		pSnapshot->AddReference();
 
@@ -90,12 +101,28 @@ void CClientFrame::CopyFrame( CClientFrame &frame )
 
 	if ( frame.transmit_always )
 	{
-		Assert( transmit_always == NULL );
-		transmit_always = new CBitVec<MAX_EDICTS>;
+		AllocTransmitAlways();
 		*transmit_always = *(frame.transmit_always);
 	}
 }
 
+void CClientFrame::AllocTransmitAlways()
+{
+	Assert( transmit_always == NULL );
+
+	if ( m_pSnapshot )
+	{
+		void *pMem = m_pSnapshot->m_pArena->Alloc( sizeof( CBitVec<MAX_EDICTS> ) );
+		transmit_always = Construct( (CBitVec<MAX_EDICTS> *)pMem );
+		m_bTransmitAlwaysInArena = true;
+	}
+	else
+	{
+		transmit_always = new CBitVec<MAX_EDICTS>;
+		m_bTransmitAlwaysInArena = false;
+	}
+}
+
 CClientFrame *CClientFrameManager::GetClientFrame( int nTick, bool bExact )
 {
 	if ( nTick < 0 )
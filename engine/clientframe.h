@@ -33,6 +33,9 @@ public:
 	inline CFrameSnapshot*	GetSnapshot() const { return m_pSnapshot; };
 	void					SetSnapshot( CFrameSnapshot *pSnapshot );
 	void					CopyFrame( CClientFrame &frame );
+
+	// Sets up transmit_always, in the snapshot's arena when there is a snapshot
+	void					AllocTransmitAlways();
 	virtual bool		IsMemPoolAllocated() { return true; }
 
 public:
@@ -54,6 +57,8 @@ private:
 	// for the frame number this packed entity corresponds to
 	// m_pSnapshot MUST be private to force using SetSnapshot(), see reference counters
 	CFrameSnapshot		*m_pSnapshot;
+
+	bool				m_bTransmitAlwaysInArena;
 };
 
 // TODO substitute CClientFrameManager with an intelligent structure (Tree, hash, cache, etc)
@@ -1157,21 +1157,20 @@ void CollisionBSPData_LoadDispInfo( CCollisionBSPData *pBSPData )
 		pDispIndexToFaceIndex[pFaces->dispinfo] = (unsigned short)i;
     }
 
+	// Trees built for an earlier load of the same map
+	bool bCached = CM_LoadDispCollCache( pBSPData, face_lump_to_load );
+
 	// Load one dispinfo from disk at a time and set it up.
 	int iCurVert = 0;
 	int iCurTri = 0;
 	CDispVert tempVerts[MAX_DISPVERTS];
 	CDispTri  tempTris[MAX_DISPTRIS];
 
-	int nSize = 0;
-	int nCacheSize = 0;
-	int nPowerCount[3] = { 0, 0, 0 };
-
 	CMapLoadHelper lhDispInfo( LUMP_DISPINFO );
 	CMapLoadHelper lhDispVerts( LUMP_DISP_VERTS );
 	CMapLoadHelper lhDispTris( LUMP_DISP_TRIS );
 
-	for ( i = 0; i < coreDispCount; ++i )
+	for ( i = 0; i < coreDispCount && !bCached; ++i )
 	{
 		// Find the face associated with this dispinfo
 		unsigned short nFaceIndex = pDispIndexToFaceIndex[i];
@@ -1248,12 +1247,20 @@ void CollisionBSPData_LoadDispInfo( CCollisionBSPData *pBSPData )
 
 		// new collision
 		pDispTree->Create( &coreDisp );
+	}
+
+	// Bounds and surface props of the trees that were created, the surface
+	// props come from the materials and aren't cached
+	for ( i = 0; i < coreDispCount; ++i )
+	{
+		CDispCollTree *pDispTree = &g_pDispCollTrees[i];
+		if ( pDispTree->GetPower() == 0 )
+			continue;
+
 		g_pDispBounds[i].Init(pDispTree->m_mins, pDispTree->m_maxs, pDispTree->m_iCounter, pDispTree->GetContents());
-		nSize += pDispTree->GetMemorySize();
-		nCacheSize += pDispTree->GetCacheMemorySize();
-		nPowerCount[pDispTree->GetPower()-2]++;
 
 		// Surface props.
+		pFaces = &pFaceList[ pDispIndexToFaceIndex[i] ];
 		texinfo_t *pTex = &pTexinfoList[pFaces->texinfo];
 		if ( pTex->texdata >= 0 )
 		{
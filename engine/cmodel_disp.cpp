@@ -16,6 +16,12 @@
 #include "tier0/fasttimer.h"
 #include "vphysics_interface.h"
 #include "vphysics/virtualmesh.h"
+#include "modelloader.h"
+#include "sysexternal.h"
+#include "filesystem_engine.h"
+#include "filesystem.h"
+#include "checksum_crc.h"
+#include "tier1/convar.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -180,6 +186,183 @@ private:
 	CUtlVector<unsigned short> m_leafCount;
 };
 
+//=============================================================================
+//
+// Displacement Collision Cache
+//
+// Building the displacement collision trees and pushing them down the bsp is
+// most of the collision setup of a map. Both are stored in maps/cache/ after
+// the first load and read back as long as the lumps they were built from are
+// unchanged. The file holds the trees and leaf lists as they are in memory, so
+// loading it is a read and a copy into the hunk.
+//
+static ConVar map_dispcoll_cache( "map_dispcoll_cache", "1", 0, "Store built displacement collision trees in maps/cache/ and reuse them when the same map is loaded again." );
+
+#define DISPCOLL_CACHE_ID			(('C'<<24)+('C'<<16)+('D'<<8)+'D')
+#define DISPCOLL_CACHE_VERSION		1
+
+struct DispCollCacheHeader_t
+{
+	int			id;
+	int			version;
+	CRC32_t		mapCRC;				// of the lumps the trees and leaf lists are built from
+	CRC32_t		dataCRC;			// of everything past the header
+	int			treeCount;
+	int			leafCount;
+	int			dispListCount;
+	int			structSizes[4];		// Vector, CDispCollTri, CDispCollNode, CDispCollLeaf
+};
+
+static CRC32_t s_DispCollMapCRC;
+static CUtlBuffer s_DispCollCache;		// positioned at the leaf lists once the trees are loaded
+static bool s_bDispCollCacheLoaded;
+
+static void DispCollCache_InitHeader( DispCollCacheHeader_t &header )
+{
+	memset( &header, 0, sizeof( header ) );
+	header.id = DISPCOLL_CACHE_ID;
+	header.version = DISPCOLL_CACHE_VERSION;
+	header.mapCRC = s_DispCollMapCRC;
+	header.treeCount = g_DispCollTreeCount;
+	header.structSizes[0] = sizeof( Vector );
+	header.structSizes[1] = sizeof( CDispCollTri );
+	header.structSizes[2] = sizeof( CDispCollNode );
+	header.structSizes[3] = sizeof( CDispCollLeaf );
+}
+
+static void DispCollCache_GetFilename( CCollisionBSPData *pBSPData, char *pszFilename, int nMaxLen )
+{
+	char szMapName[MAX_PATH];
+	Q_FileBase( pBSPData->map_name, szMapName, sizeof( szMapName ) );
+	Q_snprintf( pszFilename, nMaxLen, "maps/cache/%s.dcc", szMapName );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads the displacement collision trees from the cache if it was
+//			written for the same lumps. The leaf lists are picked up by
+//			CM_DispTreeLeafnum.
+//-----------------------------------------------------------------------------
+bool CM_LoadDispCollCache( CCollisionBSPData *pBSPData, int nFaceLump )
+{
+	s_bDispCollCacheLoaded = false;
+	s_DispCollCache.Purge();
+
+	static const int s_CacheLumps[] = { LUMP_DISPINFO, LUMP_DISP_VERTS, LUMP_DISP_TRIS, LUMP_VERTEXES, LUMP_EDGES, LUMP_SURFEDGES, LUMP_PLANES, LUMP_NODES, LUMP_LEAFS };
+	CRC32_Init( &s_DispCollMapCRC );
+	CRC32_ProcessBuffer( &s_DispCollMapCRC, &nFaceLump, sizeof( nFaceLump ) );
+	for ( int i = 0; i <= ARRAYSIZE( s_CacheLumps ); i++ )
+	{
+		CMapLoadHelper lh( ( i < ARRAYSIZE( s_CacheLumps ) ) ? s_CacheLumps[i] : nFaceLump );
+		int nSize = lh.LumpSize();
+		CRC32_ProcessBuffer( &s_DispCollMapCRC, &nSize, sizeof( nSize ) );
+		CRC32_ProcessBuffer( &s_DispCollMapCRC, lh.LumpBase(), nSize );
+	}
+	CRC32_Final( &s_DispCollMapCRC );
+
+	if ( !map_dispcoll_cache.GetBool() )
+		return false;
+
+	char szFilename[MAX_PATH];
+	DispCollCache_GetFilename( pBSPData, szFilename, sizeof( szFilename ) );
+	if ( !g_pFileSystem->ReadFile( szFilename, "DEFAULT_WRITE_PATH", s_DispCollCache ) )
+		return false;
+
+	DispCollCacheHeader_t expected, header;
+	DispCollCache_InitHeader( expected );
+	s_DispCollCache.Get( &header, sizeof( header ) );
+	expected.dataCRC = header.dataCRC;
+	expected.leafCount = header.leafCount;
+	expected.dispListCount = header.dispListCount;
+	if ( !s_DispCollCache.IsValid() || memcmp( &header, &expected, sizeof( header ) ) ||
+		 CRC32_ProcessSingleBuffer( s_DispCollCache.PeekGet(), s_DispCollCache.GetBytesRemaining() ) != header.dataCRC )
+	{
+		s_DispCollCache.Purge();
+		return false;
+	}
+
+	// Make sure all trees are there before the first one is touched, the hunk
+	// memory of a tree can only be allocated once
+	int nStart = s_DispCollCache.TellGet();
+	for ( int i = 0; i < g_DispCollTreeCount; i++ )
+	{
+		int nPower = s_DispCollCache.GetInt();
+		if ( ( nPower != 0 && ( nPower < 2 || nPower > 4 ) ) || s_DispCollCache.GetBytesRemaining() < CDispCollTree::GetBufferSize( nPower ) - (int)sizeof( int ) )
+		{
+			s_DispCollCache.Purge();
+			return false;
+		}
+		s_DispCollCache.SeekGet( CUtlBuffer::SEEK_CURRENT, CDispCollTree::GetBufferSize( nPower ) - sizeof( int ) );
+	}
+	s_DispCollCache.SeekGet( CUtlBuffer::SEEK_HEAD, nStart );
+
+	for ( int i = 0; i < g_DispCollTreeCount; i++ )
+	{
+		if ( !g_pDispCollTrees[i].LoadFromBuffer( s_DispCollCache ) )
+		{
+			Sys_Error( "CM_LoadDispCollCache: bad displacement in %s!", szFilename );
+		}
+	}
+
+	s_bDispCollCacheLoaded = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the trees and leaf lists of a map that was built from the bsp
+//-----------------------------------------------------------------------------
+static void CM_SaveDispCollCache( CCollisionBSPData *pBSPData )
+{
+	DispCollCacheHeader_t header;
+	DispCollCache_InitHeader( header );
+	header.leafCount = pBSPData->numleafs;
+	header.dispListCount = pBSPData->numdisplist;
+
+	CUtlBuffer buf;
+	buf.Put( &header, sizeof( header ) );
+	for ( int i = 0; i < g_DispCollTreeCount; i++ )
+	{
+		g_pDispCollTrees[i].SaveToBuffer( buf );
+	}
+	for ( int i = 0; i < pBSPData->numleafs; i++ )
+	{
+		buf.PutUnsignedShort( pBSPData->map_leafs[i].dispListStart );
+		buf.PutUnsignedShort( pBSPData->map_leafs[i].dispCount );
+	}
+	buf.Put( pBSPData->map_dispList.Base(), header.dispListCount * sizeof( unsigned short ) );
+
+	header.dataCRC = CRC32_ProcessSingleBuffer( (byte *)buf.Base() + sizeof( header ), buf.TellPut() - sizeof( header ) );
+	memcpy( buf.Base(), &header, sizeof( header ) );
+
+	char szFilename[MAX_PATH];
+	DispCollCache_GetFilename( pBSPData, szFilename, sizeof( szFilename ) );
+	g_pFileSystem->CreateDirHierarchy( "maps/cache", "DEFAULT_WRITE_PATH" );
+	if ( !g_pFileSystem->WriteFile( szFilename, "DEFAULT_WRITE_PATH", buf ) )
+	{
+		DevMsg( "Couldn't write displacement collision cache %s\n", szFilename );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Takes the leaf lists from the cache loaded with the trees
+//-----------------------------------------------------------------------------
+static bool CM_LoadDispCollCacheLeafList( CCollisionBSPData *pBSPData )
+{
+	int nLeafBytes = pBSPData->numleafs * 2 * sizeof( unsigned short );
+	if ( s_DispCollCache.GetBytesRemaining() < nLeafBytes )
+		return false;
+
+	int count = ( s_DispCollCache.GetBytesRemaining() - nLeafBytes ) / sizeof( unsigned short );
+	for ( int i = 0; i < pBSPData->numleafs; i++ )
+	{
+		pBSPData->map_leafs[i].dispListStart = s_DispCollCache.GetUnsignedShort();
+		pBSPData->map_leafs[i].dispCount = s_DispCollCache.GetUnsignedShort();
+	}
+	pBSPData->map_dispList.Attach( count, (unsigned short*)Hunk_Alloc( sizeof(unsigned short) * count, false ) );
+	pBSPData->numdisplist = count;
+	s_DispCollCache.Get( pBSPData->map_dispList.Base(), sizeof(unsigned short) * count );
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 void CM_DispTreeLeafnum( CCollisionBSPData *pBSPData )
@@ -188,6 +371,15 @@ void CM_DispTreeLeafnum( CCollisionBSPData *pBSPData )
 	if( g_DispCollTreeCount == 0 )
 		return;
 
+	if ( s_bDispCollCacheLoaded )
+	{
+		s_bDispCollCacheLoaded = false;
+		bool bLoaded = CM_LoadDispCollCacheLeafList( pBSPData );
+		s_DispCollCache.Purge();
+		if ( bLoaded )
+			return;
+	}
+
 	for ( int i = 0; i < pBSPData->numleafs; i++ )
 	{
 		pBSPData->map_leafs[i].dispCount = 0;
@@ -203,7 +395,13 @@ void CM_DispTreeLeafnum( CCollisionBSPData *pBSPData )
 	}
 	int count = leafBuilder.GetDispListCount();
 	pBSPData->map_dispList.Attach( count, (unsigned short*)Hunk_Alloc( sizeof(unsigned short) * count, false ) );
+	pBSPData->numdisplist = count;
 	leafBuilder.WriteLeafList( pBSPData->map_dispList.Base() );
+
+	if ( map_dispcoll_cache.GetBool() )
+	{
+		CM_SaveDispCollCache( pBSPData );
+	}
 }
 
 //-----------------------------------------------------------------------------
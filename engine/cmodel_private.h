@@ -468,6 +468,7 @@ extern csurface_t dispSurf;
 void DispCollTrees_FreeLeafList( CCollisionBSPData *pBSPData );
 
 // setup
+bool CM_LoadDispCollCache( CCollisionBSPData *pBSPData, int nFaceLump );
 void CM_DispTreeLeafnum( CCollisionBSPData *pBSPData );
 
 // collision
@@ -9,6 +9,7 @@
 #include <utlbuffer.h>
 
 #include "demofile.h"
+#include "demostream.h"
 #include "filesystem_engine.h"
 #include "demo.h"
 #include "proto_version.h"
@@ -53,7 +54,10 @@ int CDbgPrint::s_nIndent = 0;
 CDemoFile::CDemoFile() :
 	m_pBuffer( NULL ),
 	m_bAllowHeaderWrite( true ),
-	m_bIsStreamBuffer( false )
+	m_bIsStreamBuffer( false ),
+	m_bIsBlockBuffer( false ),
+	m_pWriter( NULL ),
+	m_nCommittedBytes( 0 )
 {
 }
 
@@ -159,7 +163,8 @@ void CDemoFile::WriteCmdHeader( unsigned char cmd, int tick )
 		"dem_usercmd",
 		"dem_datatables",
 		"dem_stop",
-		"dem_stringtables"
+		"dem_stringtables",
+		"dem_keyframe"
 	};
 
 	DemoFileDbg( "WriteCmdHeader()..." );
@@ -229,6 +234,8 @@ unsigned int CDemoFile::GetCurPos( bool bRead )
 		return 0;
 	if ( bRead )
 		return m_pBuffer->TellGet();
+	if ( m_pWriter )
+		return m_nCommittedBytes + m_pBuffer->TellPut();
 	return m_pBuffer->TellPut();
 }
 
@@ -332,6 +339,8 @@ void CDemoFile::SeekTo( int position, bool bRead )
 	}
 	else
 	{
+		// committed frames are gone already
+		Assert( !m_pWriter );
 		m_pBuffer->SeekPut( CUtlBuffer::SEEK_HEAD, position );
 	}
 }
@@ -409,6 +418,13 @@ void CDemoFile::WriteDemoHeader()
 		DevMsg( "\n" );
 	}
 
+	if ( m_pWriter )
+	{
+		// the writer thread puts it at the start of the file
+		m_pWriter->SetHeader( m_DemoHeader );
+		return;
+	}
+
 	// Swaps endianness, goes to file start and writes header
 	demoheader_t littleEndianHeader = *((demoheader_t*)&m_DemoHeader);
 	ByteSwap_demoheader_t( littleEndianHeader );
@@ -454,7 +470,9 @@ demoheader_t *CDemoFile::ReadDemoHeader()
 		return NULL;
 	}
 
-	if ( ( m_DemoHeader.demoprotocol > DEMO_PROTOCOL) ||
+	// newer protocols aren't successive versions, each one is its own format
+	int nFormatProtocol = m_bIsBlockBuffer ? DEMO_PROTOCOL_BLOCKS : DEMO_PROTOCOL_KEYFRAMES;
+	if ( ( m_DemoHeader.demoprotocol > DEMO_PROTOCOL && m_DemoHeader.demoprotocol != nFormatProtocol ) ||
 		 ( m_DemoHeader.demoprotocol < 2 ) )
 	{
 		ConMsg ("ERROR: demo file protocol %i outdated, engine vnoteersion is %i \n", 
@@ -466,6 +484,167 @@ demoheader_t *CDemoFile::ReadDemoHeader()
 	return &m_DemoHeader;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Starts a dem_keyframe command and remembers it for the index
+// Input  : *state - entity baselines and string tables
+//			tick - 
+//-----------------------------------------------------------------------------
+void CDemoFile::WriteKeyframe( bf_write *state, int tick )
+{
+	DemoFileDbg( "WriteKeyframe()\n" );
+	MEM_ALLOC_CREDIT();
+
+	if ( !m_pBuffer || !m_pBuffer->IsValid() )
+	{
+		DevMsg("CDemoFile::WriteKeyframe: Haven't opened file yet!\n" );
+		return;
+	}
+
+	demokeyframe_t &keyframe = m_Keyframes[ m_Keyframes.AddToTail() ];
+	keyframe.tick = tick;
+	keyframe.offset = GetCurPos( false );
+
+	WriteCmdHeader( dem_keyframe, tick );
+
+	WriteRawData( (char*)state->GetBasePointer(), state->GetNumBytesWritten() );
+}
+
+int CDemoFile::ReadKeyframe( CUtlBuffer *pState )
+{
+	Assert( m_pBuffer && m_pBuffer->IsValid() );
+
+	if ( !pState )
+		return ReadRawData( NULL, 0 ); // skip data
+
+	int size = m_pBuffer->GetInt();
+	if ( size < 0 || size > 2 * DEMO_FILE_MAX_STRINGTABLE_SIZE || !m_pBuffer->IsValid() )
+	{
+		DevMsg("CDemoFile::ReadKeyframe: invalid keyframe size (%i).\n", size );
+		return -1;
+	}
+
+	pState->Purge();
+	pState->EnsureCapacity( size );
+	m_pBuffer->Get( pState->Base(), size );
+	pState->SeekPut( CUtlBuffer::SEEK_HEAD, size );
+
+	return size;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Appends the keyframe index. Must come after dem_stop.
+//-----------------------------------------------------------------------------
+void CDemoFile::WriteKeyframeIndex()
+{
+	DemoFileDbg( "WriteKeyframeIndex()\n" );
+
+	if ( !m_pBuffer || !m_pBuffer->IsValid() || !m_Keyframes.Count() )
+		return;
+
+	FOR_EACH_VEC( m_Keyframes, i )
+	{
+		demokeyframe_t keyframe = m_Keyframes[i];
+		ByteSwap_demokeyframe_t( keyframe );
+		m_pBuffer->Put( &keyframe, sizeof( keyframe ) );
+	}
+
+	demokeyframetrailer_t trailer;
+	trailer.id = DEMO_KEYFRAMES_ID;
+	trailer.numkeyframes = m_Keyframes.Count();
+	ByteSwap_demokeyframetrailer_t( trailer );
+	m_pBuffer->Put( &trailer, sizeof( trailer ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads the keyframe index from the end of the demo, if it has one.
+//			Leaves the read position where it was.
+//-----------------------------------------------------------------------------
+bool CDemoFile::ReadKeyframeIndex()
+{
+	m_Keyframes.RemoveAll();
+
+	// plain demos with keyframes are DEMO_PROTOCOL_KEYFRAMES, compressed ones may have them too
+	if ( !m_pBuffer || !m_pBuffer->IsValid() || m_DemoHeader.demoprotocol <= DEMO_PROTOCOL )
+		return false;
+
+	int nSize = GetSize();
+	if ( nSize < (int)( sizeof( demoheader_t ) + sizeof( demokeyframetrailer_t ) ) )
+		return false;
+
+	int nStartPos = m_pBuffer->TellGet();
+
+	demokeyframetrailer_t trailer;
+	m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, nSize - sizeof( trailer ) );
+	m_pBuffer->Get( &trailer, sizeof( trailer ) );
+	ByteSwap_demokeyframetrailer_t( trailer );
+
+	// the count comes from the file, bound it before it goes into any size math
+	int nMaxKeyframes = ( nSize - (int)sizeof( demoheader_t ) - (int)sizeof( trailer ) ) / (int)sizeof( demokeyframe_t );
+	bool bOk = m_pBuffer->IsValid() && trailer.id == DEMO_KEYFRAMES_ID &&
+		trailer.numkeyframes > 0 && trailer.numkeyframes <= nMaxKeyframes;
+
+	int nIndexPos = bOk ? nSize - (int)sizeof( trailer ) - trailer.numkeyframes * (int)sizeof( demokeyframe_t ) : 0;
+
+	if ( bOk )
+	{
+		m_Keyframes.SetCount( trailer.numkeyframes );
+		m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, nIndexPos );
+		m_pBuffer->Get( m_Keyframes.Base(), trailer.numkeyframes * sizeof( demokeyframe_t ) );
+		bOk = m_pBuffer->IsValid();
+
+		int nLastTick = 0;
+		for ( int i = 0; bOk && i < m_Keyframes.Count(); i++ )
+		{
+			demokeyframe_t &keyframe = m_Keyframes[i];
+			ByteSwap_demokeyframe_t( keyframe );
+
+			bOk = keyframe.tick >= nLastTick && 
+				keyframe.offset >= (int)sizeof( demoheader_t ) && keyframe.offset < nIndexPos;
+			nLastTick = keyframe.tick;
+		}
+	}
+
+	if ( bOk )
+	{
+		// make sure the index really points at keyframes
+		m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, m_Keyframes[0].offset );
+		bOk = m_pBuffer->GetUnsignedChar() == dem_keyframe && m_pBuffer->IsValid();
+	}
+
+	if ( !bOk )
+	{
+		m_Keyframes.RemoveAll();
+	}
+
+	m_pBuffer->SeekGet( CUtlBuffer::SEEK_HEAD, nStartPos );
+
+	return bOk;
+}
+
+int CDemoFile::FindKeyframe( int tick )
+{
+	int nLow = 0;
+	int nHigh = m_Keyframes.Count() - 1;
+
+	if ( nHigh < 0 || m_Keyframes[0].tick > tick )
+		return -1;
+
+	while ( nLow < nHigh )
+	{
+		int nMid = ( nLow + nHigh + 1 ) / 2;
+		if ( m_Keyframes[nMid].tick <= tick )
+		{
+			nLow = nMid;
+		}
+		else
+		{
+			nHigh = nMid - 1;
+		}
+	}
+
+	return nLow;
+}
+
 void CDemoFile::WriteFileBytes( FileHandle_t fh, int length )
 {
 	DemoFileDbg( "WriteFileBytes()\n" );
@@ -495,6 +674,7 @@ bool CDemoFile::Open(const char *name, bool bReadOnly, bool bMemoryBuffer, int n
 
 	m_szFileName[0] = 0;  // clear name
 	Q_memset( &m_DemoHeader, 0, sizeof(m_DemoHeader) ); // and demo header
+	m_Keyframes.RemoveAll();
 
 	// This is used by replay, which manually writes a header.
 	m_bAllowHeaderWrite = bAllowHeaderWrite;
@@ -506,6 +686,12 @@ bool CDemoFile::Open(const char *name, bool bReadOnly, bool bMemoryBuffer, int n
 		m_pBuffer = new CUtlBuffer( nBufferSize, nBufferSize, 0 );
 		m_bIsStreamBuffer = false;
 	}
+	else if ( bReadOnly && CDemoBlockReadBuffer::IsBlockDemo( name ) )
+	{
+		m_pBuffer = new CDemoBlockReadBuffer( name );
+		m_bIsStreamBuffer = false;
+		m_bIsBlockBuffer = true;
+	}
 	else
 	{
 		m_pBuffer = new CUtlStreamBuffer( name, NULL, bReadOnly ? CUtlBuffer::READ_ONLY : 0, false );
@@ -536,23 +722,94 @@ bool CDemoFile::IsOpen()
 	return m_pBuffer && m_pBuffer->IsValid();
 }
 
+bool CDemoFile::OpenAsync( const char *name, bool bCompress )
+{
+	if ( m_pBuffer && m_pBuffer->IsValid() )
+	{
+		ConMsg ("CDemoFile::OpenAsync: file already open.\n");
+		return false;
+	}
+
+	m_szFileName[0] = 0;  // clear name
+	Q_memset( &m_DemoHeader, 0, sizeof(m_DemoHeader) ); // and demo header
+	m_Keyframes.RemoveAll();
+
+	m_bAllowHeaderWrite = true;
+
+	m_pWriter = new CDemoStreamWriter;
+	if ( !m_pWriter->Open( name, bCompress ) )
+	{
+		ConMsg ("CDemoFile::OpenAsync: couldn't open file %s for writing.\n", name );
+		delete m_pWriter;
+		m_pWriter = NULL;
+		return false;
+	}
+
+	// frames are collected here until they're committed, the header is
+	// kept by the writer
+	m_pBuffer = new CUtlBuffer( 0, 64 * 1024, 0 );
+	m_pBuffer->SetBigEndian( false );
+	m_bIsStreamBuffer = false;
+	m_bIsBlockBuffer = false;
+	m_nCommittedBytes = sizeof( demoheader_t );
+
+	Q_strncpy( m_szFileName, name, sizeof(m_szFileName) );
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Passes everything written since the last commit to the writer
+//			thread. Does nothing for demos that aren't recorded asynchronously.
+//-----------------------------------------------------------------------------
+void CDemoFile::CommitFrame()
+{
+	if ( !m_pWriter || !m_pBuffer )
+		return;
+
+	int nLength = m_pBuffer->TellPut();
+	if ( nLength <= 0 )
+		return;
+
+	m_pWriter->QueueFrame( m_pBuffer->Base(), nLength );
+	m_nCommittedBytes += nLength;
+	m_pBuffer->Clear();
+}
+
 void CDemoFile::Close()
 {
+	if ( m_pWriter )
+	{
+		// blocks until the writer has finished the file
+		CommitFrame();
+		m_pWriter->Close();
+		delete m_pWriter;
+		m_pWriter = NULL;
+	}
+
 	// CUtlBuffer base class does NOT have a virtual destructor!
 	if ( m_bIsStreamBuffer )
 	{
 		// Destructor will call Close() as needed
 		delete static_cast<CUtlStreamBuffer*>(m_pBuffer);
 	}
+	else if ( m_bIsBlockBuffer )
+	{
+		delete static_cast<CDemoBlockReadBuffer*>(m_pBuffer);
+	}
 	else
 	{
 		delete m_pBuffer;
 	}
 	m_pBuffer = NULL;
+	m_bIsStreamBuffer = false;
+	m_bIsBlockBuffer = false;
 }
 
 int CDemoFile::GetSize()
 {
+	if ( m_pWriter )
+		return m_nCommittedBytes + m_pBuffer->TellPut();
 	return m_pBuffer->TellMaxPut();
 }
 
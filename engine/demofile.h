@@ -28,6 +28,7 @@
 // Forward declarations
 //-----------------------------------------------------------------------------
 class IDemoBuffer;
+class CDemoStreamWriter;
 
 //-----------------------------------------------------------------------------
 // Demo file 
@@ -42,6 +43,12 @@ public:
 	bool	IsOpen();
 	void	Close();
 
+	// Records through a background writer thread. Everything written is kept in
+	// memory until CommitFrame() hands it to the writer. bCompress stores the
+	// demo as DEMO_PROTOCOL_BLOCKS.
+	bool	OpenAsync( const char *name, bool bCompress );
+	void	CommitFrame();
+
 	void	SeekTo( int position, bool bRead );
 	unsigned int GetCurPos( bool bRead );
 	int		GetSize();
@@ -73,6 +80,16 @@ public:
 	void	WriteDemoHeader();
 	demoheader_t *ReadDemoHeader();
 
+	// A keyframe holds the entity baselines and string tables at a tick. The
+	// caller follows it with a full entity update, written like a dem_packet.
+	void	WriteKeyframe( bf_write *state, int tick );
+	int		ReadKeyframe( CUtlBuffer *pState ); // NULL skips the state
+
+	// Keyframe index behind dem_stop
+	void	WriteKeyframeIndex();
+	bool	ReadKeyframeIndex();
+	int		FindKeyframe( int tick ); // last keyframe at or before tick, -1 if none
+
 	void	WriteFileBytes( FileHandle_t fh, int length );
 
 	// Returns the PROTOCOL_VERSION used when .dem was recorded
@@ -80,9 +97,13 @@ public:
 public:
 	char			m_szFileName[MAX_PATH];	//name of current demo file
 	demoheader_t    m_DemoHeader;  //general demo info
+	CUtlVector< demokeyframe_t > m_Keyframes;
 	CUtlBuffer		*m_pBuffer;
 	bool			m_bAllowHeaderWrite;
 	bool			m_bIsStreamBuffer;
+	bool			m_bIsBlockBuffer;		// reading a DEMO_PROTOCOL_BLOCKS file
+	CDemoStreamWriter *m_pWriter;			// set when opened with OpenAsync
+	int				m_nCommittedBytes;		// bytes handed to m_pWriter so far
 };
 
 #endif // DEMOFILE_H
@@ -0,0 +1,488 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Background demo writer and block compressed demo reader
+//
+//=============================================================================//
+
+#include <tier0/dbg.h>
+#include <tier1/strtools.h>
+
+#include "demostream.h"
+#include "filesystem_engine.h"
+#include "common.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+
+//-----------------------------------------------------------------------------
+// CDemoStreamWriter
+//-----------------------------------------------------------------------------
+CDemoStreamWriter::CDemoStreamWriter() :
+	m_Block( DEMO_BLOCK_SIZE, DEMO_BLOCK_SIZE, 0 )
+{
+	SetName( "DemoWriter" );
+	m_bThreadShouldExit = false;
+	m_bHeaderDirty = false;
+	m_bCompress = false;
+	m_hFile = FILESYSTEM_INVALID_HANDLE;
+	m_nDataOffset = 0;
+	m_nFileOffset = 0;
+	Q_memset( &m_Header, 0, sizeof( m_Header ) );
+}
+
+CDemoStreamWriter::~CDemoStreamWriter()
+{
+	Close();
+}
+
+bool CDemoStreamWriter::Open( const char *pszFilename, bool bCompress )
+{
+	Assert( m_hFile == FILESYSTEM_INVALID_HANDLE && !IsAlive() );
+
+	m_hFile = g_pFileSystem->Open( pszFilename, "wb" );
+	if ( m_hFile == FILESYSTEM_INVALID_HANDLE )
+		return false;
+
+	m_bCompress = bCompress;
+	m_bThreadShouldExit = false;
+	m_bHeaderDirty = false;
+	m_nQueued = 0;
+	m_nHandled = 0;
+	m_Block.Clear();
+	m_Index.RemoveAll();
+
+	// reserve room for the header, it's written once it's known
+	Q_memset( &m_Header, 0, sizeof( m_Header ) );
+	g_pFileSystem->Write( &m_Header, sizeof( m_Header ), m_hFile );
+
+	m_nDataOffset = sizeof( demoheader_t );
+	m_nFileOffset = sizeof( demoheader_t );
+
+	if ( m_bCompress )
+	{
+		// the header is the first block, stored so it can be rewritten in place
+		demoblock_t &block = m_Index[ m_Index.AddToTail() ];
+		block.dataoffset = 0;
+		block.datalength = sizeof( demoheader_t );
+		block.fileoffset = 0;
+		block.filelength = sizeof( demoheader_t );
+		block.flags = FDEMOBLOCK_STORED;
+	}
+
+	if ( !Start() )
+	{
+		// frames are written on the calling thread instead
+		DevMsg( "CDemoStreamWriter::Open: couldn't start writer thread.\n" );
+	}
+
+	return true;
+}
+
+void CDemoStreamWriter::Close()
+{
+	if ( m_hFile == FILESYSTEM_INVALID_HANDLE )
+		return;
+
+	if ( IsAlive() )
+	{
+		// the thread finishes the file before it exits
+		m_bThreadShouldExit = true;
+		m_WakeEvent.Set();
+		Join();
+	}
+	else
+	{
+		ProcessFrames();
+		Finish();
+	}
+
+	m_FreeFrames.Purge();
+	m_Index.Purge();
+	m_Compressed.Purge();
+}
+
+void CDemoStreamWriter::QueueFrame( const void *pData, int nLength )
+{
+	Assert( m_hFile != FILESYSTEM_INVALID_HANDLE );
+
+	if ( nLength <= 0 )
+		return;
+
+	// don't let the queue grow without bounds if the disk can't keep up
+	while ( m_nQueued - m_nHandled >= DEMO_MAX_QUEUED_FRAMES && IsAlive() )
+	{
+		m_WakeEvent.Set();
+		m_DrainedEvent.Wait( 50 );
+	}
+
+	DemoFrame_t *pFrame = m_FreeFrames.GetObject();
+	pFrame->data.EnsureCapacity( nLength );
+	Q_memcpy( pFrame->data.Base(), pData, nLength );
+	pFrame->nLength = nLength;
+
+	++m_nQueued;
+	m_QueuedFrames.PushItem( pFrame );
+
+	if ( IsAlive() )
+	{
+		m_WakeEvent.Set();
+	}
+	else
+	{
+		ProcessFrames();
+	}
+}
+
+void CDemoStreamWriter::SetHeader( const demoheader_t &header )
+{
+	AUTO_LOCK( m_HeaderMutex );
+	m_Header = header;
+	m_bHeaderDirty = true;
+}
+
+int CDemoStreamWriter::Run()
+{
+	for ( ;; )
+	{
+		m_WakeEvent.Wait( 100 );
+
+		ProcessFrames();
+
+		if ( m_bThreadShouldExit )
+		{
+			ProcessFrames();
+			Finish();
+			break;
+		}
+	}
+
+	return 0;
+}
+
+void CDemoStreamWriter::ProcessFrames()
+{
+	if ( m_bHeaderDirty )
+	{
+		// keep the header on disk current, the file is still usable if we never get to close it
+		WriteHeader();
+	}
+
+	DemoFrame_t *pFrame;
+	while ( m_QueuedFrames.PopItem( &pFrame ) )
+	{
+		WriteFrame( pFrame );
+		m_FreeFrames.PutObject( pFrame );
+		++m_nHandled;
+	}
+
+	m_DrainedEvent.Set();
+}
+
+void CDemoStreamWriter::WriteFrame( DemoFrame_t *pFrame )
+{
+	if ( !m_bCompress )
+	{
+		g_pFileSystem->Write( pFrame->data.Base(), pFrame->nLength, m_hFile );
+		m_nDataOffset += pFrame->nLength;
+		m_nFileOffset += pFrame->nLength;
+		return;
+	}
+
+	// frames are never split, so every block starts on a command boundary
+	m_Block.Put( pFrame->data.Base(), pFrame->nLength );
+	if ( m_Block.TellPut() >= DEMO_BLOCK_SIZE )
+	{
+		WriteBlock();
+	}
+}
+
+void CDemoStreamWriter::WriteBlock()
+{
+	int nLength = m_Block.TellPut();
+	if ( nLength <= 0 )
+		return;
+
+	unsigned int nCompressed = COM_GetIdealDestinationCompressionBufferSize_Snappy( nLength );
+	m_Compressed.EnsureCapacity( nCompressed );
+
+	demoblock_t block;
+	block.dataoffset = m_nDataOffset;
+	block.datalength = nLength;
+	block.fileoffset = m_nFileOffset;
+
+	const void *pData;
+	if ( COM_BufferToBufferCompress_Snappy( m_Compressed.Base(), &nCompressed, m_Block.Base(), nLength ) &&
+		 (int)nCompressed < nLength )
+	{
+		pData = m_Compressed.Base();
+		block.filelength = nCompressed;
+		block.flags = FDEMOBLOCK_COMPRESSED;
+	}
+	else
+	{
+		pData = m_Block.Base();
+		block.filelength = nLength;
+		block.flags = FDEMOBLOCK_STORED;
+	}
+
+	g_pFileSystem->Write( pData, block.filelength, m_hFile );
+
+	m_Index.AddToTail( block );
+	m_nDataOffset += block.datalength;
+	m_nFileOffset += block.filelength;
+
+	m_Block.Clear();
+}
+
+void CDemoStreamWriter::WriteIndex()
+{
+	demoblocktrailer_t trailer;
+	trailer.id = DEMO_BLOCKS_ID;
+	trailer.numblocks = m_Index.Count();
+	trailer.indexoffset = m_nFileOffset;
+	trailer.datalength = m_nDataOffset;
+
+	FOR_EACH_VEC( m_Index, i )
+	{
+		demoblock_t block = m_Index[i];
+		ByteSwap_demoblock_t( block );
+		g_pFileSystem->Write( &block, sizeof( block ), m_hFile );
+	}
+
+	ByteSwap_demoblocktrailer_t( trailer );
+	g_pFileSystem->Write( &trailer, sizeof( trailer ), m_hFile );
+
+	m_nFileOffset += m_Index.Count() * sizeof( demoblock_t ) + sizeof( demoblocktrailer_t );
+}
+
+void CDemoStreamWriter::WriteHeader()
+{
+	demoheader_t header;
+	{
+		AUTO_LOCK( m_HeaderMutex );
+		header = m_Header;
+		m_bHeaderDirty = false;
+	}
+
+	if ( m_bCompress )
+	{
+		header.demoprotocol = DEMO_PROTOCOL_BLOCKS;
+	}
+
+	ByteSwap_demoheader_t( header );
+
+	g_pFileSystem->Seek( m_hFile, 0, FILESYSTEM_SEEK_HEAD );
+	g_pFileSystem->Write( &header, sizeof( header ), m_hFile );
+	g_pFileSystem->Seek( m_hFile, m_nFileOffset, FILESYSTEM_SEEK_HEAD );
+}
+
+void CDemoStreamWriter::Finish()
+{
+	if ( m_bCompress )
+	{
+		WriteBlock();
+		WriteIndex();
+	}
+
+	WriteHeader();
+
+	g_pFileSystem->Close( m_hFile );
+	m_hFile = FILESYSTEM_INVALID_HANDLE;
+}
+
+
+//-----------------------------------------------------------------------------
+// CDemoBlockReadBuffer
+//-----------------------------------------------------------------------------
+CDemoBlockReadBuffer::CDemoBlockReadBuffer( const char *pszFilename ) :
+	BaseClass( 0, 0, READ_ONLY )
+{
+	SetUtlBufferOverflowFuncs( &CDemoBlockReadBuffer::BlockGetOverflow, &CDemoBlockReadBuffer::BlockPutOverflow );
+
+	m_nFirstLoaded = -1;
+	m_nLastLoaded = -1;
+	m_nMaxPut = 0;
+
+	m_hFile = g_pFileSystem->Open( pszFilename, "rb" );
+	if ( m_hFile == FILESYSTEM_INVALID_HANDLE )
+	{
+		m_Error |= FILE_OPEN_ERROR;
+		return;
+	}
+
+	if ( !ReadIndex() || !LoadBlocks( 0, 0 ) )
+	{
+		ConMsg( "%s has a damaged block index.\n", pszFilename );
+		m_Error |= FILE_FORMAT_ERROR;
+	}
+}
+
+CDemoBlockReadBuffer::~CDemoBlockReadBuffer()
+{
+	if ( m_hFile != FILESYSTEM_INVALID_HANDLE )
+	{
+		g_pFileSystem->Close( m_hFile );
+	}
+}
+
+bool CDemoBlockReadBuffer::IsBlockDemo( const char *pszFilename )
+{
+	FileHandle_t hFile = g_pFileSystem->Open( pszFilename, "rb" );
+	if ( hFile == FILESYSTEM_INVALID_HANDLE )
+		return false;
+
+	demoheader_t header;
+	bool bOk = g_pFileSystem->Read( &header, sizeof( header ), hFile ) == sizeof( header );
+	g_pFileSystem->Close( hFile );
+
+	ByteSwap_demoheader_t( header );
+
+	return bOk && !Q_strncmp( header.demofilestamp, DEMO_HEADER_ID, sizeof( header.demofilestamp ) ) &&
+		header.demoprotocol == DEMO_PROTOCOL_BLOCKS;
+}
+
+bool CDemoBlockReadBuffer::ReadIndex()
+{
+	int nFileSize = g_pFileSystem->Size( m_hFile );
+	if ( nFileSize < (int)( sizeof( demoheader_t ) + sizeof( demoblocktrailer_t ) ) )
+		return false;
+
+	demoblocktrailer_t trailer;
+	g_pFileSystem->Seek( m_hFile, nFileSize - sizeof( trailer ), FILESYSTEM_SEEK_HEAD );
+	if ( g_pFileSystem->Read( &trailer, sizeof( trailer ), m_hFile ) != sizeof( trailer ) )
+		return false;
+
+	ByteSwap_demoblocktrailer_t( trailer );
+
+	// the trailer comes from the file, bound it before doing any size math with it
+	int nIndexEnd = nFileSize - (int)sizeof( trailer );
+	if ( trailer.id != DEMO_BLOCKS_ID || trailer.numblocks <= 0 || trailer.numblocks > nIndexEnd / (int)sizeof( demoblock_t ) ||
+		 trailer.indexoffset < 0 || trailer.indexoffset > nIndexEnd ||
+		 (int64)trailer.indexoffset + (int64)trailer.numblocks * (int64)sizeof( demoblock_t ) != (int64)nIndexEnd )
+		return false;
+
+	m_Index.SetCount( trailer.numblocks );
+	g_pFileSystem->Seek( m_hFile, trailer.indexoffset, FILESYSTEM_SEEK_HEAD );
+	if ( g_pFileSystem->Read( m_Index.Base(), trailer.numblocks * sizeof( demoblock_t ), m_hFile ) != trailer.numblocks * (int)sizeof( demoblock_t ) )
+		return false;
+
+	// blocks must cover the stream without gaps and lie in front of the index
+	int64 nDataOffset = 0;
+	FOR_EACH_VEC( m_Index, i )
+	{
+		demoblock_t &block = m_Index[i];
+		ByteSwap_demoblock_t( block );
+
+		if ( block.dataoffset != nDataOffset || block.datalength <= 0 || block.filelength <= 0 ||
+			 block.fileoffset < 0 || (int64)block.fileoffset + block.filelength > trailer.indexoffset )
+			return false;
+
+		if ( block.flags == FDEMOBLOCK_STORED && block.filelength != block.datalength )
+			return false;
+
+		nDataOffset += block.datalength;
+	}
+
+	if ( nDataOffset != trailer.datalength )
+		return false;
+
+	m_nMaxPut = trailer.datalength;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the block that holds the given stream offset
+//-----------------------------------------------------------------------------
+int CDemoBlockReadBuffer::FindBlock( int nDataOffset ) const
+{
+	int nLow = 0;
+	int nHigh = m_Index.Count() - 1;
+
+	while ( nLow < nHigh )
+	{
+		int nMid = ( nLow + nHigh + 1 ) / 2;
+		if ( m_Index[nMid].dataoffset <= nDataOffset )
+		{
+			nLow = nMid;
+		}
+		else
+		{
+			nHigh = nMid - 1;
+		}
+	}
+
+	return nLow;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Decompresses a range of blocks into the buffer memory
+//-----------------------------------------------------------------------------
+bool CDemoBlockReadBuffer::LoadBlocks( int nFirst, int nLast )
+{
+	if ( nFirst == m_nFirstLoaded && nLast == m_nLastLoaded )
+		return true;
+
+	m_nFirstLoaded = -1;
+	m_nLastLoaded = -1;
+
+	int nLength = m_Index[nLast].dataoffset + m_Index[nLast].datalength - m_Index[nFirst].dataoffset;
+
+	// CheckGet treats all allocated memory as loaded, so the size has to match exactly
+	if ( m_Memory.NumAllocated() != nLength )
+	{
+		m_Memory.Purge();
+		m_Memory.EnsureCapacity( nLength );
+	}
+
+	byte *pDest = m_Memory.Base();
+	for ( int i = nFirst; i <= nLast; ++i )
+	{
+		const demoblock_t &block = m_Index[i];
+
+		g_pFileSystem->Seek( m_hFile, block.fileoffset, FILESYSTEM_SEEK_HEAD );
+
+		if ( block.flags & FDEMOBLOCK_COMPRESSED )
+		{
+			m_Compressed.EnsureCapacity( block.filelength );
+			if ( g_pFileSystem->Read( m_Compressed.Base(), block.filelength, m_hFile ) != block.filelength )
+				return false;
+
+			unsigned int nDecompressed = block.datalength;
+			if ( !COM_BufferToBufferDecompress( pDest, &nDecompressed, m_Compressed.Base(), block.filelength ) ||
+				 (int)nDecompressed != block.datalength )
+				return false;
+		}
+		else
+		{
+			if ( g_pFileSystem->Read( pDest, block.datalength, m_hFile ) != block.datalength )
+				return false;
+		}
+
+		pDest += block.datalength;
+	}
+
+	m_nOffset = m_Index[nFirst].dataoffset;
+	m_nFirstLoaded = nFirst;
+	m_nLastLoaded = nLast;
+	return true;
+}
+
+bool CDemoBlockReadBuffer::BlockGetOverflow( int nSize )
+{
+	if ( m_Index.Count() == 0 )
+		return false;
+
+	// nSize is negative when seeking
+	int nStart = TellGet();
+	int nEnd = MIN( nStart + MAX( nSize, 1 ), m_nMaxPut );
+	if ( nStart >= nEnd )
+		return false;
+
+	return LoadBlocks( FindBlock( nStart ), FindBlock( nEnd - 1 ) );
+}
+
+bool CDemoBlockReadBuffer::BlockPutOverflow( int nSize )
+{
+	return false;
+}
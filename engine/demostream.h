@@ -0,0 +1,124 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Background demo writer and block compressed demo reader
+//
+//=============================================================================//
+
+#ifndef DEMOSTREAM_H
+#define DEMOSTREAM_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/threadtools.h"
+#include "tier0/tslist.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/utlvector.h"
+#include "filesystem.h"
+#include "demofile/demoformat.h"
+
+#define DEMO_MAX_QUEUED_FRAMES	256		// game thread waits for the writer beyond this
+
+struct DemoFrame_t
+{
+	CUtlMemory< byte >	data;	// kept around when the frame is recycled
+	int					nLength;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Owns the file of a demo that is being recorded. The game thread
+//			hands over finished frames, the writer thread compresses them into
+//			blocks and does all file IO.
+//-----------------------------------------------------------------------------
+class CDemoStreamWriter : public CThread
+{
+public:
+	CDemoStreamWriter();
+	~CDemoStreamWriter();
+
+	bool	Open( const char *pszFilename, bool bCompress );
+
+	// writes whatever is still queued, the index and the final header
+	void	Close();
+
+	// copies the frame, blocks if the writer is too far behind
+	void	QueueFrame( const void *pData, int nLength );
+
+	// header to write at the start of the file once the demo is closed
+	void	SetHeader( const demoheader_t &header );
+
+	bool	IsCompressed() const { return m_bCompress; }
+
+private:
+	virtual int Run();
+
+	void	ProcessFrames();
+	void	WriteFrame( DemoFrame_t *pFrame );
+	void	WriteBlock();
+	void	WriteIndex();
+	void	WriteHeader();
+	void	Finish();
+
+	CTSQueue< DemoFrame_t * >	m_QueuedFrames;
+	CTSPool< DemoFrame_t >		m_FreeFrames;
+
+	CThreadEvent				m_WakeEvent;
+	CThreadEvent				m_DrainedEvent;
+	volatile bool				m_bThreadShouldExit;
+	volatile bool				m_bHeaderDirty;
+
+	CInterlockedInt				m_nQueued;
+	CInterlockedInt				m_nHandled;
+
+	CThreadFastMutex			m_HeaderMutex;
+	demoheader_t				m_Header;
+
+	bool						m_bCompress;
+	FileHandle_t				m_hFile;
+
+	// writer thread only
+	int							m_nDataOffset;		// length of the uncompressed stream so far
+	int							m_nFileOffset;
+	CUtlBuffer					m_Block;			// uncompressed bytes of the current block
+	CUtlMemory< byte >			m_Compressed;
+	CUtlVector< demoblock_t >	m_Index;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Read only view of a DEMO_PROTOCOL_BLOCKS file as the plain command
+//			stream. Only the blocks around the get position are kept
+//			decompressed, seeking uses the block index.
+//-----------------------------------------------------------------------------
+class CDemoBlockReadBuffer : public CUtlBuffer
+{
+	typedef CUtlBuffer BaseClass;
+
+public:
+	CDemoBlockReadBuffer( const char *pszFilename );
+	~CDemoBlockReadBuffer();
+
+	// true if the file starts with a demo header for DEMO_PROTOCOL_BLOCKS
+	static bool IsBlockDemo( const char *pszFilename );
+
+private:
+	enum
+	{
+		FILE_OPEN_ERROR = MAX_ERROR_FLAG << 1,
+		FILE_FORMAT_ERROR = MAX_ERROR_FLAG << 2,
+	};
+
+	bool	ReadIndex();
+	int		FindBlock( int nDataOffset ) const;
+	bool	LoadBlocks( int nFirst, int nLast );
+
+	bool	BlockGetOverflow( int nSize );
+	bool	BlockPutOverflow( int nSize );
+
+	FileHandle_t				m_hFile;
+	CUtlVector< demoblock_t >	m_Index;
+	CUtlMemory< byte >			m_Compressed;
+	int							m_nFirstLoaded;
+	int							m_nLastLoaded;
+};
+
+#endif // DEMOSTREAM_H
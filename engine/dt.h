@@ -337,6 +337,34 @@ public:
 };
 
 
+// ----------------------------------------------------------------------------- //
+// CSendEncodeRun
+// SendTable_Encode walks a precompiled list of these instead of calling every prop's
+// proxy. A run is a range of consecutive flat props that live under the same
+// datatable proxy and whose values can be read straight out of the struct.
+// ----------------------------------------------------------------------------- //
+enum SendEncodeRunType_t
+{
+	SENDENCODE_GENERIC=0,	// Call the prop's proxy and its g_PropTypeFns encoder.
+	SENDENCODE_INT8,
+	SENDENCODE_INT16,
+	SENDENCODE_INT32,
+	SENDENCODE_UINT8,
+	SENDENCODE_UINT16,
+	SENDENCODE_FLOAT,
+	SENDENCODE_VECTOR
+};
+
+class CSendEncodeRun
+{
+public:
+	unsigned short	m_iFirstProp;
+	unsigned short	m_nProps;
+	unsigned char	m_iProxy;	// Index into CDatatableStack::m_pProxies.
+	unsigned char	m_Type;		// SendEncodeRunType_t.
+};
+
+
 // ----------------------------------------------------------------------------- //
 // CSendTablePrecalc
 // ----------------------------------------------------------------------------- //
@@ -410,6 +438,11 @@ public:
 	
 	// Map prop offsets to indices for properties that can use it.
 	CUtlMap<unsigned short, unsigned short> m_PropOffsetToIndexMap;
+
+	// The encode program built by SendTable_Init. m_PropOffsets mirrors m_Props so the
+	// typed runs don't have to touch the SendProps to find their data.
+	CUtlVector<CSendEncodeRun>	m_EncodeRuns;
+	CUtlVector<int>				m_PropOffsets;
 };
 
 
@@ -85,6 +85,11 @@ typedef struct
 
 extern PropTypeFns g_PropTypeFns[DPT_NUMSendPropTypes];
 
+// The encoders behind g_PropTypeFns that SendTable_Encode's typed runs call directly.
+void Int_Encode( const unsigned char *pStruct, DVariant *pVar, const SendProp *pProp, bf_write *pOut, int objectID );
+void Float_Encode( const unsigned char *pStruct, DVariant *pVar, const SendProp *pProp, bf_write *pOut, int objectID );
+void Vector_Encode( const unsigned char *pStruct, DVariant *pVar, const SendProp *pProp, bf_write *pOut, int objectID );
+
 
 // This is used for comparing packed buffers. Just extracts the raw bits for the 
 // data and returns the number of bits used to encode the data.
@@ -17,6 +17,7 @@
 #include "dt_stack.h"
 #include "common.h"
 #include "packed_entity.h"
+#include "convar.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -29,6 +30,13 @@ class CSendNode;
 
 extern bool Sendprop_UsingDebugWatch();
 
+ConVar dt_UseEncodePrograms( 
+	"dt_UseEncodePrograms", 
+	"1", 
+	0, 
+	"Encode entities with the per-table encode programs built by SendTable_Init instead of calling every prop's proxy." 
+	);
+
 
 // This stack doesn't actually call any proxies. It uses the CSendProxyRecipients to tell
 // what can be sent to the specified client.
@@ -316,6 +324,101 @@ static FORCEINLINE void SendTable_EncodeProp( CEncodeInfo * pInfo, unsigned long
 }
 
 
+// Runs of props with a standard proxy read their values straight out of the struct,
+// the same way the proxy would, and call the type's encoder directly.
+template< class T >
+static FORCEINLINE void SendTable_EncodeIntRun( CEncodeInfo *pInfo, const CSendTablePrecalc *pPrecalc, const unsigned char *pBase, int iProp, int iEndProp )
+{
+	const SendProp * const *pProps = pPrecalc->m_Props.Base();
+	const int *pOffsets = pPrecalc->m_PropOffsets.Base();
+	bf_write *pOut = pInfo->m_DeltaBitsWriter.GetBitBuf();
+	int objectID = pInfo->GetObjectID();
+
+	DVariant var;
+	for ( ; iProp < iEndProp; iProp++ )
+	{
+		var.m_Int = *(const T*)( pBase + pOffsets[iProp] );
+		pInfo->m_DeltaBitsWriter.WritePropIndex( iProp );
+		Int_Encode( pBase, &var, pProps[iProp], pOut, objectID );
+	}
+}
+
+static FORCEINLINE void SendTable_EncodeFloatRun( CEncodeInfo *pInfo, const CSendTablePrecalc *pPrecalc, const unsigned char *pBase, int iProp, int iEndProp )
+{
+	const SendProp * const *pProps = pPrecalc->m_Props.Base();
+	const int *pOffsets = pPrecalc->m_PropOffsets.Base();
+	bf_write *pOut = pInfo->m_DeltaBitsWriter.GetBitBuf();
+	int objectID = pInfo->GetObjectID();
+
+	DVariant var;
+	for ( ; iProp < iEndProp; iProp++ )
+	{
+		var.m_Float = *(const float*)( pBase + pOffsets[iProp] );
+		pInfo->m_DeltaBitsWriter.WritePropIndex( iProp );
+		Float_Encode( pBase, &var, pProps[iProp], pOut, objectID );
+	}
+}
+
+static FORCEINLINE void SendTable_EncodeVectorRun( CEncodeInfo *pInfo, const CSendTablePrecalc *pPrecalc, const unsigned char *pBase, int iProp, int iEndProp )
+{
+	const SendProp * const *pProps = pPrecalc->m_Props.Base();
+	const int *pOffsets = pPrecalc->m_PropOffsets.Base();
+	bf_write *pOut = pInfo->m_DeltaBitsWriter.GetBitBuf();
+	int objectID = pInfo->GetObjectID();
+
+	DVariant var;
+	for ( ; iProp < iEndProp; iProp++ )
+	{
+		const float *pVector = (const float*)( pBase + pOffsets[iProp] );
+		var.m_Vector[0] = pVector[0];
+		var.m_Vector[1] = pVector[1];
+		var.m_Vector[2] = pVector[2];
+		pInfo->m_DeltaBitsWriter.WritePropIndex( iProp );
+		Vector_Encode( pBase, &var, pProps[iProp], pOut, objectID );
+	}
+}
+
+
+// Writes the same bits as calling SendTable_EncodeProp for each prop with a valid proxy.
+static void SendTable_EncodeProgram( CEncodeInfo *pInfo, const CSendTablePrecalc *pPrecalc )
+{
+	const CSendEncodeRun *pRun = pPrecalc->m_EncodeRuns.Base();
+	const CSendEncodeRun *pEndRun = pRun + pPrecalc->m_EncodeRuns.Count();
+
+	for ( ; pRun < pEndRun; pRun++ )
+	{
+		// The whole run lives under this datatable proxy, skip it if the proxy turned it off.
+		const unsigned char *pBase = pInfo->m_pProxies[pRun->m_iProxy];
+		if ( !pBase )
+			continue;
+
+		int iProp = pRun->m_iFirstProp;
+		int iEndProp = iProp + pRun->m_nProps;
+
+		switch ( pRun->m_Type )
+		{
+			case SENDENCODE_INT8:	SendTable_EncodeIntRun<char>( pInfo, pPrecalc, pBase, iProp, iEndProp ); break;
+			case SENDENCODE_INT16:	SendTable_EncodeIntRun<short>( pInfo, pPrecalc, pBase, iProp, iEndProp ); break;
+			case SENDENCODE_INT32:	SendTable_EncodeIntRun<int>( pInfo, pPrecalc, pBase, iProp, iEndProp ); break;
+			case SENDENCODE_UINT8:	SendTable_EncodeIntRun<unsigned char>( pInfo, pPrecalc, pBase, iProp, iEndProp ); break;
+			case SENDENCODE_UINT16:	SendTable_EncodeIntRun<unsigned short>( pInfo, pPrecalc, pBase, iProp, iEndProp ); break;
+			case SENDENCODE_FLOAT:	SendTable_EncodeFloatRun( pInfo, pPrecalc, pBase, iProp, iEndProp ); break;
+			case SENDENCODE_VECTOR:	SendTable_EncodeVectorRun( pInfo, pPrecalc, pBase, iProp, iEndProp ); break;
+
+			default:
+			{
+				for ( ; iProp < iEndProp; iProp++ )
+				{
+					pInfo->SeekToProp( iProp );
+					SendTable_EncodeProp( pInfo, iProp );
+				}
+			}
+			break;
+		}
+	}
+}
+
+
 static bool SendTable_IsPropZero( CEncodeInfo *pInfo, unsigned long iProp )
 {
 	const SendProp *pProp = pInfo->GetCurProp();
@@ -428,6 +531,12 @@ bool SendTable_Encode(
 	info.m_pRecipients = pRecipients;	// optional buffer to store the bits for which clients get what data.
 
 	info.Init();
+
+	if ( !bNonZeroOnly && dt_UseEncodePrograms.GetBool() )
+	{
+		SendTable_EncodeProgram( &info, pPrecalc );
+		return !pOut->IsOverflowed();
+	}
 	
 	int iNumProps = pPrecalc->GetNumProps();
 
@@ -742,7 +851,75 @@ static void SendTable_CalcNextVectorElems( SendTable *pTable )
 }
 
 
-static bool SendTable_InitTable( SendTable *pTable )
+// Props whose proxy is one of the standard ones can be encoded without calling it.
+static SendEncodeRunType_t SendTable_GetEncodeRunType( const SendProp *pProp, const CStandardSendProxies *pSendProxies )
+{
+	SendVarProxyFn fn = pProp->GetProxyFn();
+
+	switch ( pProp->GetType() )
+	{
+		case DPT_Int:
+			if ( fn == pSendProxies->m_Int8ToInt32 )
+				return SENDENCODE_INT8;
+			else if ( fn == pSendProxies->m_Int16ToInt32 )
+				return SENDENCODE_INT16;
+			else if ( fn == pSendProxies->m_Int32ToInt32 || fn == pSendProxies->m_UInt32ToInt32 )
+				return SENDENCODE_INT32;
+			else if ( fn == pSendProxies->m_UInt8ToInt32 )
+				return SENDENCODE_UINT8;
+			else if ( fn == pSendProxies->m_UInt16ToInt32 )
+				return SENDENCODE_UINT16;
+			break;
+
+		case DPT_Float:
+			if ( fn == pSendProxies->m_FloatToFloat )
+				return SENDENCODE_FLOAT;
+			break;
+
+		case DPT_Vector:
+			if ( fn == pSendProxies->m_VectorToVector )
+				return SENDENCODE_VECTOR;
+			break;
+	}
+
+	return SENDENCODE_GENERIC;
+}
+
+
+// Splits the flat props into runs of one encode type under one datatable proxy. The runs
+// have to stay in prop order since the delta bits writer only moves forward.
+static void SendTable_BuildEncodeProgram( CSendTablePrecalc *pPrecalc, const CStandardSendProxies *pSendProxies )
+{
+	int nProps = pPrecalc->GetNumProps();
+
+	pPrecalc->m_EncodeRuns.Purge();
+	pPrecalc->m_PropOffsets.SetCount( nProps );
+
+	for ( int iProp=0; iProp < nProps; iProp++ )
+	{
+		const SendProp *pProp = pPrecalc->GetProp( iProp );
+		pPrecalc->m_PropOffsets[iProp] = pProp->GetOffset();
+
+		unsigned char iProxy = pPrecalc->m_PropProxyIndices[iProp];
+		unsigned char type = (unsigned char)SendTable_GetEncodeRunType( pProp, pSendProxies );
+
+		int nRuns = pPrecalc->m_EncodeRuns.Count();
+		if ( nRuns && pPrecalc->m_EncodeRuns[nRuns-1].m_iProxy == iProxy && pPrecalc->m_EncodeRuns[nRuns-1].m_Type == type )
+		{
+			pPrecalc->m_EncodeRuns[nRuns-1].m_nProps++;
+			continue;
+		}
+
+		CSendEncodeRun &run = pPrecalc->m_EncodeRuns[pPrecalc->m_EncodeRuns.AddToTail()];
+		run.m_iFirstProp = iProp;
+		run.m_nProps = 1;
+		run.m_iProxy = iProxy;
+		run.m_Type = type;
+	}
+}
+
+
+static bool SendTable_InitTable( SendTable *pTable, const CStandardSendProxies *pSendProxies )
 {
 	if( pTable->m_pPrecalc )
 		return true;
@@ -764,6 +941,7 @@ static bool SendTable_InitTable( SendTable *pTable )
 		return false;
 
 	SendTable_Validate( pPrecalc );
+	SendTable_BuildEncodeProgram( pPrecalc, pSendProxies );
 	return true;
 }
 
@@ -904,16 +1082,19 @@ void SendTable_PrintStats( void )
 
 
 
-bool SendTable_Init( SendTable **pTables, int nTables )
+bool SendTable_Init( SendTable **pTables, int nTables, const CStandardSendProxies *pSendProxies )
 {
 	ErrorIfNot( g_SendTables.Count() == 0,
 		("SendTable_Init: called twice.")
 	);
 
+	if ( !pSendProxies )
+		pSendProxies = &g_StandardSendProxies;
+
 	// Initialize them all.
 	for ( int i=0; i < nTables; i++ )
 	{
-		if ( !SendTable_InitTable( pTables[i] ) )
+		if ( !SendTable_InitTable( pTables[i], pSendProxies ) )
 			return false;
 	}
 
@@ -28,7 +28,9 @@ class CStandardSendProxies;
 // ------------------------------------------------------------------------ //
 
 // Precalculate data that enables the SendTable to be used to encode data.
-bool		SendTable_Init( SendTable **pTables, int nTables );
+// pSendProxies are the standard proxies of the module the tables came from, props that
+// use them get encoded without calling the proxy. Defaults to the engine's own.
+bool		SendTable_Init( SendTable **pTables, int nTables, const CStandardSendProxies *pSendProxies = NULL );
 void		SendTable_Term();
 CRC32_t		SendTable_GetCRC();
 int			SendTable_GetNum();
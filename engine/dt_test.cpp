@@ -60,6 +60,8 @@
 #ifdef _DEBUG
 
 
+extern ConVar dt_UseEncodePrograms;
+
 
 class DTTestSub2Sub
 {
@@ -932,6 +934,23 @@ void RunDataTableTest()
 			Assert(false);
 		}
 
+		// The encode program must write exactly the same bits as calling each prop's proxy.
+		ALIGN4 unsigned char proxyEncoded[4096] ALIGN4_POST;
+		bf_write bfProxyEncoded( "RunDataTableTest->bfProxyEncoded", proxyEncoded, sizeof(proxyEncoded) );
+		bool bUseEncodePrograms = dt_UseEncodePrograms.GetBool();
+		dt_UseEncodePrograms.SetValue( !bUseEncodePrograms );
+		if( !SendTable_Encode( pSendTable, &dtServer, &bfProxyEncoded, -1, NULL ) )
+		{
+			Assert(false);
+		}
+		dt_UseEncodePrograms.SetValue( bUseEncodePrograms );
+
+		int nFullBytes = bfFullEncoded.GetNumBitsWritten() >> 3;
+		int nTailBits = bfFullEncoded.GetNumBitsWritten() & 7;
+		Verify( bfProxyEncoded.GetNumBitsWritten() == bfFullEncoded.GetNumBitsWritten() );
+		Verify( memcmp( proxyEncoded, fullEncoded, nFullBytes ) == 0 );
+		Verify( ( ( proxyEncoded[nFullBytes] ^ fullEncoded[nFullBytes] ) & ( ( 1 << nTailBits ) - 1 ) ) == 0 );
+
 
 		ALIGN4 unsigned char deltaEncoded[4096] ALIGN4_POST;
 		bf_write bfDeltaEncoded( "RunDataTableTest->bfDeltaEncoded", deltaEncoded, sizeof(deltaEncoded) );
@@ -51,6 +51,48 @@ public:
 	unsigned int	m_nNodeCluster;  // if (1<<31) is set it's a node, otherwise a cluster
 };
 
+#define SNAPSHOT_ARENA_BLOCK_SIZE		( 16 * 1024 )	// smallest block, larger allocations get a block of their own
+#define SNAPSHOT_ARENA_MAX_FREE_BLOCKS	128				// blocks kept around for the next snapshots
+
+struct SnapshotArenaBlock_t
+{
+	SnapshotArenaBlock_t	*m_pNext;
+	int						m_nSize;	// usable bytes after the header
+	int						m_nUsed;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Memory of one tick snapshot. The snapshot arrays, HLTV frame bits and
+//  the data of entities packed during the tick are carved from blocks that the
+//  manager recycles. Packed entities hold a reference since they can outlive
+//  the snapshot, all blocks go back at once when the last reference drops.
+//-----------------------------------------------------------------------------
+class CFrameSnapshotArena
+{
+	DECLARE_FIXEDSIZE_ALLOCATOR_MT( CFrameSnapshotArena );
+
+public:
+							CFrameSnapshotArena();
+							~CFrameSnapshotArena();
+
+	// Thread safe, returns 16 byte aligned memory that lives as long as the arena
+	void*					Alloc( int nBytes );
+
+	void					AddReference();
+	void					ReleaseReference();
+
+	// Set once the owning snapshot is deleted. Packed entities still in
+	// here move to the current arena when they're reused.
+	bool					IsRetired() const { return m_bRetired; }
+	void					Retire() { m_bRetired = true; }
+
+private:
+	CThreadFastMutex		m_Mutex;
+	SnapshotArenaBlock_t	*m_pBlocks;		// block being filled comes first
+	CInterlockedInt			m_nReferences;
+	volatile bool			m_bRetired;
+};
+
 typedef struct
 {
 	PackedEntity	*pEntity;	// original packed entity
@@ -105,6 +147,9 @@ public:
 
 	CUtlVector<int>			m_iExplicitDeleteSlots;
 
+	// Everything above that is allocated per tick comes from here
+	CFrameSnapshotArena		*m_pArena;
+
 private:
 
 	// Snapshots auto-delete themselves when their refcount goes to zero.
@@ -118,6 +163,7 @@ private:
 class CFrameSnapshotManager
 {
 	friend class CFrameSnapshot;
+	friend class CFrameSnapshotArena;
 
 public:
 	CFrameSnapshotManager( void );
@@ -166,6 +212,11 @@ public:
 private:
 	void	DeleteFrameSnapshot( CFrameSnapshot* pSnapshot );
 
+	// Recycled blocks for snapshot arenas
+	SnapshotArenaBlock_t	*AllocArenaBlock( int nMinSize );
+	void					FreeArenaBlocks( SnapshotArenaBlock_t *pBlocks );
+	void					PurgeArenaBlocks();
+
 	CUtlLinkedList<CFrameSnapshot*, unsigned short>		m_FrameSnapshots;
 	CClassMemoryPool< PackedEntity >					m_PackedEntitiesPool;
 
@@ -179,6 +230,10 @@ private:
 	CThreadFastMutex		m_WriteMutex;
 
 	CUtlVector<int>			m_iExplicitDeleteSlots;
+
+	CThreadFastMutex		m_ArenaMutex;
+	SnapshotArenaBlock_t	*m_pFreeArenaBlocks;
+	int						m_nFreeArenaBlocks;
 };
 
 extern CFrameSnapshotManager *framesnapshotmanager;
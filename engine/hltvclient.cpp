@@ -477,7 +477,7 @@ void CHLTVClient::SendSnapshot( CClientFrame * pFrame )
 	tickmsg.WriteToBuffer( msg );
 
 	// Update shared client/server string tables. Must be done before sending entities
-	m_Server->m_StringTables->WriteUpdateMessage( NULL, GetMaxAckTickCount(), msg );
+	m_Server->m_StringTables->WriteUpdateMessage( NULL, GetMaxAckTickCount(), msg, m_NetChannel->GetProtocolVersion() );
 
 	// TODO delta cache whole snapshots, not just packet entities. then use net_Align
 	// send entity update, delta compressed if deltaFrame != NULL
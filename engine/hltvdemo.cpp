@@ -23,6 +23,8 @@
 #include "server.h"
 #include "networkstringtableclient.h"
 #include "vcrmode.h"
+#include "framesnapshot.h"
+#include "server_class.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -30,6 +32,10 @@
 
 extern CNetworkStringTableContainer *networkStringTableContainerServer;
 
+static ConVar tv_demo_async( "tv_demo_async", "1", 0, "Write SourceTV demos from a background thread." );
+static ConVar tv_demo_keyframe_interval( "tv_demo_keyframe_interval", "15", 0, "Seconds between SourceTV demo keyframes, which let playback jump to a tick without reading everything in front of it (0 = off).", true, 0, false, 0 );
+static ConVar tv_demo_compress( "tv_demo_compress", "0", 0, "Store SourceTV demos in compressed blocks. Older clients and tools can't play these." );
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -62,7 +68,11 @@ void CHLTVDemoRecorder::StartRecording( const char *filename, bool bContinuously
 {
 	StopRecording();	// stop if we're already recording
 	
-	if ( !m_DemoFile.Open( filename, false ) )
+	bool bOpened = tv_demo_async.GetBool() ?
+		m_DemoFile.OpenAsync( filename, tv_demo_compress.GetBool() ) :
+		m_DemoFile.Open( filename, false );
+
+	if ( !bOpened )
 	{
 		ConMsg ("StartRecording: couldn't open demo file %s.\n", filename );
 		return;
@@ -101,11 +111,13 @@ void CHLTVDemoRecorder::StartRecording( const char *filename, bool bContinuously
 	// Demo playback should read this as an incoming message.
 	// Write the client's realtime value out so we can synchronize the reads.
 	m_DemoFile.WriteCmdHeader( dem_synctick, 0 );
+	m_DemoFile.CommitFrame();
 
 	m_bIsRecording = true;
 
 	m_SequenceInfo = 1;
 	m_nDeltaTick = -1;
+	m_nLastKeyframeTick = 0;
 }
 
 bool CHLTVDemoRecorder::IsRecording()
@@ -121,6 +133,8 @@ void CHLTVDemoRecorder::StopRecording()
 	// Demo playback should read this as an incoming message.
 	m_DemoFile.WriteCmdHeader( dem_stop, GetRecordingTick() );
 
+	m_DemoFile.WriteKeyframeIndex();
+
 	// update demo header info
 	m_DemoFile.m_DemoHeader.playback_ticks = GetRecordingTick();
 	m_DemoFile.m_DemoHeader.playback_time =  host_state.interval_per_tick *	GetRecordingTick();
@@ -384,6 +398,117 @@ void CHLTVDemoRecorder::WriteFrame( CHLTVFrame *pFrame )
 
 	// write packet to demo file
 	WriteMessages( dem_packet, msg ); 
+
+	if ( tv_demo_keyframe_interval.GetFloat() > 0 &&
+		 GetRecordingTick() - m_nLastKeyframeTick >= TIME_TO_TICKS( tv_demo_keyframe_interval.GetFloat() ) )
+	{
+		WriteKeyframe( pFrame );
+	}
+
+	m_DemoFile.CommitFrame();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes everything a player needs to continue playback from this
+//			frame: entity baselines, string tables and a full entity update.
+//-----------------------------------------------------------------------------
+void CHLTVDemoRecorder::WriteKeyframe( CHLTVFrame *pFrame )
+{
+	CBaseClient *pClient = hltv->m_MasterClient;
+
+	m_nLastKeyframeTick = GetRecordingTick();
+
+	// entity baselines and string tables, grow the buffer like RecordStringTables
+	void *data = NULL;
+	int dataLen = 512 * 1024;
+	bf_write state;
+	while ( dataLen <= DEMO_FILE_MAX_STRINGTABLE_SIZE )
+	{
+		data = realloc( data, dataLen );
+		state.StartWriting( data, dataLen );
+		state.SetDebugName( "CHLTVDemoRecorder_Keyframe" );
+		state.SetAssertOnOverflow( false );
+
+		CFrameSnapshot *pBaseline = pClient->m_pBaseline;
+		int nEntities = 0;
+		for ( int i = 0; pBaseline && i < pBaseline->m_nNumEntities; i++ )
+		{
+			if ( framesnapshotmanager->GetPackedEntity( pBaseline, i ) )
+				nEntities++;
+		}
+
+		state.WriteOneBit( pClient->m_nBaselineUsed );
+		state.WriteUBitVar( nEntities );
+		for ( int i = 0; pBaseline && i < pBaseline->m_nNumEntities; i++ )
+		{
+			PackedEntity *pPacked = framesnapshotmanager->GetPackedEntity( pBaseline, i );
+			if ( !pPacked )
+				continue;
+
+			Assert( !pPacked->IsCompressed() );
+			state.WriteUBitLong( i, MAX_EDICT_BITS );
+			state.WriteUBitVar( pPacked->m_pServerClass->m_ClassID );
+			state.WriteUBitVar( pPacked->GetNumBits() );
+			state.WriteBits( pPacked->GetData(), pPacked->GetNumBits() );
+		}
+
+		networkStringTableContainerServer->WriteStringTables( state );
+
+		if ( !state.IsOverflowed() )
+			break;
+
+		dataLen *= 2;
+	}
+
+	if ( dataLen > DEMO_FILE_MAX_STRINGTABLE_SIZE )
+	{
+		Warning( "Failed to write SourceTV demo keyframe, string tables are bigger than max string table size\n" );
+		free( data );
+		return;
+	}
+
+	ALIGN4 byte		buffer[ NET_MAX_PAYLOAD ] ALIGN4_POST;
+	bf_write	msg( "CHLTVDemo::WriteKeyframe", buffer, sizeof( buffer ) );
+
+	NET_Tick tickmsg( pFrame->tick_count, host_frametime_unbounded, host_frametime_stddeviation );
+	tickmsg.WriteToBuffer( msg );
+
+	// full update against the class baselines. Don't let it start a baseline
+	// update for the master client, the regular packets own that.
+	int nBaselineUpdateTick = pClient->m_nBaselineUpdateTick;
+	pClient->m_nBaselineUpdateTick = pFrame->tick_count;
+	sv.WriteDeltaEntities( pClient, pFrame, NULL, msg );
+	pClient->m_nBaselineUpdateTick = nBaselineUpdateTick;
+
+	if ( msg.IsOverflowed() )
+	{
+		Warning( "Failed to write SourceTV demo keyframe, entity update overflowed\n" );
+		free( data );
+		return;
+	}
+
+	// fill last bits in last byte with NOP if necessary
+	int nRemainingBits = msg.GetNumBitsWritten() % 8;
+	if ( nRemainingBits > 0 &&  nRemainingBits <= (8-NETMSG_TYPE_BITS) )
+	{
+		msg.WriteUBitLong( net_NOP, NETMSG_TYPE_BITS );
+	}
+
+	m_DemoFile.WriteKeyframe( &state, GetRecordingTick() );
+
+	// demos without keyframes stay readable by older players, StopRecording writes the header
+	m_DemoFile.m_DemoHeader.demoprotocol = DEMO_PROTOCOL_KEYFRAMES;
+
+	democmdinfo_t info;
+	Q_memset( &info, 0, sizeof( info ) );
+	m_DemoFile.WriteCmdInfo( info );
+
+	// same sequence numbers as the packet in front of it, so the one after still follows
+	m_DemoFile.WriteSequenceInfo( m_SequenceInfo - 1, m_SequenceInfo - 1 );
+
+	m_DemoFile.WriteRawData( (char*)msg.GetBasePointer(), msg.GetNumBytesWritten() );
+
+	free( data );
 }
 
 void CHLTVDemoRecorder::WriteMessages( unsigned char cmd, bf_write &message )
@@ -453,5 +578,6 @@ void CHLTVDemoRecorder::RecordPacket()
 	{
 		WriteMessages( dem_packet, m_MessageData );
 		m_MessageData.Reset(); // clear message buffer
+		m_DemoFile.CommitFrame();
 	}
 }
@@ -51,6 +51,7 @@ public:
 	void	WriteServerInfo();
 	int		WriteSignonData();  // write all necessary signon data and returns written bytes
 	void	WriteMessages( unsigned char cmd, bf_write &message );
+	void	WriteKeyframe( CHLTVFrame *pFrame );
 	int		GetMaxAckTickCount();
 
 public:
@@ -62,6 +63,7 @@ public:
 	int				m_SequenceInfo;
 	int				m_nDeltaTick;	
 	int				m_nSignonTick;
+	int				m_nLastKeyframeTick;
 	bf_write		m_MessageData; // temp buffer for all network messages
 };
 
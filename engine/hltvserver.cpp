@@ -87,6 +87,93 @@ ConVar tv_debug( "tv_debug", "0", 0, "SourceTV debug info." );
 ConVar tv_title( "tv_title", "SourceTV", 0, "Set title for SourceTV spectator UI", tv_title_changed_f );
 static ConVar tv_deltacache( "tv_deltacache", "2", 0, "Enable delta entity bit stream cache" );
 static ConVar tv_relayvoice( "tv_relayvoice", "1", 0, "Relay voice data: 0=off, 1=on" );
+static ConVar tv_framecompress( "tv_framecompress", "1", 0, "Compress frames waiting in the SourceTV delay buffer" );
+
+#define HLTV_COMPRESS_AGE		2.0f	// seconds a frame stays unpacked after it was added
+#define HLTV_COMPRESS_AHEAD		1.0f	// don't pack frames this close to broadcast time
+#define HLTV_COMPRESS_MIN_BYTES	64		// not worth it for smaller frames
+
+//-----------------------------------------------------------------------------
+// Purpose: Size class pools for the message buffers of stored frames. Frames
+//			come and go at snapshot rate for the whole delay, this keeps them
+//			off the heap and tells us what the delay buffer costs.
+//-----------------------------------------------------------------------------
+#define HLTV_POOL_MIN_SIZE		64		// smallest size class
+#define HLTV_POOL_CLASSES		9		// up to 16k, larger buffers come from the heap
+
+class CHLTVFrameBufferPool
+{
+public:
+	CHLTVFrameBufferPool()
+	{
+		for ( int i = 0; i < HLTV_POOL_CLASSES; i++ )
+		{
+			m_pPools[i] = new CUtlMemoryPool( HLTV_POOL_MIN_SIZE << i, 64, CUtlMemoryPool::GROW_SLOW, "CHLTVFrameBufferPool", 4 );
+		}
+		m_nHeapBytes = 0;
+	}
+
+	~CHLTVFrameBufferPool()
+	{
+		for ( int i = 0; i < HLTV_POOL_CLASSES; i++ )
+		{
+			delete m_pPools[i];
+		}
+	}
+
+	char *Alloc( int nBytes )
+	{
+		int nClass = GetSizeClass( nBytes );
+		if ( nClass < HLTV_POOL_CLASSES )
+			return (char*)m_pPools[nClass]->Alloc();
+
+		m_nHeapBytes += nBytes;
+		return new char[nBytes];
+	}
+
+	void Free( char *pBuffer, int nBytes )
+	{
+		int nClass = GetSizeClass( nBytes );
+		if ( nClass < HLTV_POOL_CLASSES )
+		{
+			m_pPools[nClass]->Free( pBuffer );
+			return;
+		}
+
+		m_nHeapBytes -= nBytes;
+		delete[] pBuffer;
+	}
+
+	// bytes handed out, pool blocks are counted with their full size
+	int GetAllocatedBytes() const
+	{
+		int nBytes = m_nHeapBytes;
+		for ( int i = 0; i < HLTV_POOL_CLASSES; i++ )
+		{
+			nBytes += m_pPools[i]->Count() * m_pPools[i]->BlockSize();
+		}
+		return nBytes;
+	}
+
+private:
+	int GetSizeClass( int nBytes ) const
+	{
+		int nClass = 0;
+		while ( nClass < HLTV_POOL_CLASSES && ( HLTV_POOL_MIN_SIZE << nClass ) < nBytes )
+		{
+			nClass++;
+		}
+		return nClass;
+	}
+
+	CUtlMemoryPool	*m_pPools[HLTV_POOL_CLASSES];
+	int				m_nHeapBytes;
+};
+
+static CHLTVFrameBufferPool s_FrameBuffers;
+static CUtlMemory<char> s_FrameScratch;	// pack/unpack space, main thread only
+
+DEFINE_FIXEDSIZE_ALLOCATOR( CHLTVFrame, 256, CUtlMemoryPool::GROW_SLOW );
 
 CDeltaEntityCache::CDeltaEntityCache()
 {
@@ -361,7 +448,10 @@ void CHLTVServer::InitClientRecvTables()
 
 CHLTVFrame::CHLTVFrame()
 {
-	
+	m_pCompressed = NULL;
+	m_nCompressedSize = 0;
+	m_nReliableBits = 0;
+	m_nUnreliableBits = 0;
 }
 
 CHLTVFrame::~CHLTVFrame()
@@ -379,6 +469,9 @@ void CHLTVFrame::Reset( void )
 
 bool CHLTVFrame::HasData( void )
 {
+	if ( m_pCompressed )
+		return true;
+
 	for ( int i=0; i<HLTV_BUFFER_MAX; i++ )
 	{
 		if ( m_Messages[i].GetNumBitsWritten() > 0 )
@@ -396,7 +489,7 @@ void CHLTVFrame::CopyHLTVData( CHLTVFrame &frame )
 	if ( bits > 0 )
 	{
 		int bytes = PAD_NUMBER( Bits2Bytes(bits), 4 );
-		m_Messages[HLTV_BUFFER_RELIABLE].StartWriting( new char[ bytes ], bytes, bits );
+		m_Messages[HLTV_BUFFER_RELIABLE].StartWriting( s_FrameBuffers.Alloc( bytes ), bytes, bits );
 		Q_memcpy( m_Messages[HLTV_BUFFER_RELIABLE].GetBasePointer(), frame.m_Messages[HLTV_BUFFER_RELIABLE].GetBasePointer(), bytes );
 	}
 
@@ -412,7 +505,7 @@ void CHLTVFrame::CopyHLTVData( CHLTVFrame &frame )
 	{
 		// collapse all unreliable buffers in one
 		int bytes = PAD_NUMBER( Bits2Bytes(bits), 4 );
-		m_Messages[HLTV_BUFFER_UNRELIABLE].StartWriting( new char[ bytes ], bytes );
+		m_Messages[HLTV_BUFFER_UNRELIABLE].StartWriting( s_FrameBuffers.Alloc( bytes ), bytes );
 		m_Messages[HLTV_BUFFER_UNRELIABLE].WriteBits( frame.m_Messages[HLTV_BUFFER_UNRELIABLE].GetData(), frame.m_Messages[HLTV_BUFFER_UNRELIABLE].GetNumBitsWritten() ); 
 		m_Messages[HLTV_BUFFER_UNRELIABLE].WriteBits( frame.m_Messages[HLTV_BUFFER_TEMPENTS].GetData(), frame.m_Messages[HLTV_BUFFER_TEMPENTS].GetNumBitsWritten() ); 
 		m_Messages[HLTV_BUFFER_UNRELIABLE].WriteBits( frame.m_Messages[HLTV_BUFFER_SOUNDS].GetData(), frame.m_Messages[HLTV_BUFFER_SOUNDS].GetNumBitsWritten() ); 
@@ -428,7 +521,7 @@ void CHLTVFrame::AllocBuffers( void )
 	for ( int i=0; i < HLTV_BUFFER_MAX; i++ )
 	{
 		Assert( m_Messages[i].GetBasePointer() == NULL );
-		m_Messages[i].StartWriting( new char[NET_MAX_PAYLOAD], NET_MAX_PAYLOAD);
+		m_Messages[i].StartWriting( s_FrameBuffers.Alloc( NET_MAX_PAYLOAD ), NET_MAX_PAYLOAD );
 	}
 }
 
@@ -440,10 +533,113 @@ void CHLTVFrame::FreeBuffers( void )
 
 		if ( msg.GetBasePointer() )
 		{
-			delete[] msg.GetBasePointer();
+			s_FrameBuffers.Free( (char*)msg.GetBasePointer(), msg.GetMaxNumBits() / 8 );
 			msg.StartWriting( NULL, 0 );
 		}
 	}
+
+	if ( m_pCompressed )
+	{
+		s_FrameBuffers.Free( m_pCompressed, m_nCompressedSize );
+		m_pCompressed = NULL;
+		m_nCompressedSize = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Replaces the message buffers of a stored frame with one compressed
+//			block. Returns false if the frame stays as it is.
+//-----------------------------------------------------------------------------
+bool CHLTVFrame::Compress( void )
+{
+	if ( m_pCompressed )
+		return true;
+
+	// stored frames only have these two, see CopyHLTVData
+	Assert( !m_Messages[HLTV_BUFFER_DIRECTOR].GetBasePointer() && !m_Messages[HLTV_BUFFER_VOICE].GetBasePointer() );
+	Assert( !m_Messages[HLTV_BUFFER_SOUNDS].GetBasePointer() && !m_Messages[HLTV_BUFFER_TEMPENTS].GetBasePointer() );
+
+	bf_write &reliable = m_Messages[HLTV_BUFFER_RELIABLE];
+	bf_write &unreliable = m_Messages[HLTV_BUFFER_UNRELIABLE];
+
+	int nReliableBytes = Bits2Bytes( reliable.GetNumBitsWritten() );
+	int nUnreliableBytes = Bits2Bytes( unreliable.GetNumBitsWritten() );
+	int nSize = nReliableBytes + nUnreliableBytes;
+
+	if ( nSize < HLTV_COMPRESS_MIN_BYTES )
+		return false;
+
+	unsigned int nCompressedSize = COM_GetIdealDestinationCompressionBufferSize_Snappy( nSize );
+	s_FrameScratch.EnsureCapacity( nSize + nCompressedSize );
+
+	char *pData = s_FrameScratch.Base();
+	char *pCompressed = pData + nSize;
+
+	if ( nReliableBytes )
+		Q_memcpy( pData, reliable.GetBasePointer(), nReliableBytes );
+	if ( nUnreliableBytes )
+		Q_memcpy( pData + nReliableBytes, unreliable.GetBasePointer(), nUnreliableBytes );
+
+	if ( !COM_BufferToBufferCompress_Snappy( pCompressed, &nCompressedSize, pData, nSize ) ||
+		 (int)nCompressedSize >= nSize )
+		return false;
+
+	m_nReliableBits = reliable.GetNumBitsWritten();
+	m_nUnreliableBits = unreliable.GetNumBitsWritten();
+
+	FreeBuffers();
+
+	m_nCompressedSize = nCompressedSize;
+	m_pCompressed = s_FrameBuffers.Alloc( m_nCompressedSize );
+	Q_memcpy( m_pCompressed, pCompressed, m_nCompressedSize );
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Restores the message buffers before the frame gets broadcast
+//-----------------------------------------------------------------------------
+void CHLTVFrame::Uncompress( void )
+{
+	if ( !m_pCompressed )
+		return;
+
+	int nReliableBytes = Bits2Bytes( m_nReliableBits );
+	int nUnreliableBytes = Bits2Bytes( m_nUnreliableBits );
+	unsigned int nSize = nReliableBytes + nUnreliableBytes;
+
+	s_FrameScratch.EnsureCapacity( nSize );
+
+	char *pData = s_FrameScratch.Base();
+	char *pCompressed = m_pCompressed;
+	int nCompressedSize = m_nCompressedSize;
+
+	m_pCompressed = NULL;
+	m_nCompressedSize = 0;
+
+	if ( !COM_BufferToBufferDecompress( pData, &nSize, pCompressed, nCompressedSize ) ||
+		 nSize != (unsigned int)( nReliableBytes + nUnreliableBytes ) )
+	{
+		Warning( "SourceTV failed to uncompress frame %i.\n", tick_count );
+		s_FrameBuffers.Free( pCompressed, nCompressedSize );
+		return;
+	}
+
+	s_FrameBuffers.Free( pCompressed, nCompressedSize );
+
+	if ( m_nReliableBits > 0 )
+	{
+		int bytes = PAD_NUMBER( nReliableBytes, 4 );
+		m_Messages[HLTV_BUFFER_RELIABLE].StartWriting( s_FrameBuffers.Alloc( bytes ), bytes, m_nReliableBits );
+		Q_memcpy( m_Messages[HLTV_BUFFER_RELIABLE].GetBasePointer(), pData, nReliableBytes );
+	}
+
+	if ( m_nUnreliableBits > 0 )
+	{
+		int bytes = PAD_NUMBER( nUnreliableBytes, 4 );
+		m_Messages[HLTV_BUFFER_UNRELIABLE].StartWriting( s_FrameBuffers.Alloc( bytes ), bytes, m_nUnreliableBits );
+		Q_memcpy( m_Messages[HLTV_BUFFER_UNRELIABLE].GetBasePointer(), pData + nReliableBytes, nUnreliableBytes );
+	}
 }
 
 CHLTVServer::CHLTVServer()
@@ -1358,6 +1554,9 @@ CClientFrame *CHLTVServer::AddNewFrame( CClientFrame *clientFrame )
 	// add frame to HLTV server
 	AddClientFrame( hltvFrame );
 
+	m_CompressQueue.Insert( hltvFrame );
+	CompressFrames();
+
 	if ( IsMasterProxy() && m_DemoRecorder.IsRecording() )
 	{
 		m_DemoRecorder.WriteFrame( &m_HLTVFrame );
@@ -1370,6 +1569,53 @@ CClientFrame *CHLTVServer::AddNewFrame( CClientFrame *clientFrame )
 	return hltvFrame;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Compresses frames that wait for their broadcast time, they get
+//			uncompressed again in UpdateTick
+//-----------------------------------------------------------------------------
+void CHLTVServer::CompressFrames( void )
+{
+	int nAgeTicks = HLTV_COMPRESS_AGE / m_flTickInterval;
+	int nAheadTicks = HLTV_COMPRESS_AHEAD / m_flTickInterval;
+
+	// the queue only holds frames younger than HLTV_COMPRESS_AGE. UpdateTick
+	// deletes frames 16 seconds behind broadcast time, so these are still valid.
+	while ( m_CompressQueue.Count() > 0 )
+	{
+		CHLTVFrame *pFrame = m_CompressQueue.Head();
+
+		if ( pFrame->tick_count > m_nLastTick - nAgeTicks )
+			break;
+
+		m_CompressQueue.RemoveAtHead();
+
+		if ( tv_framecompress.GetBool() && !IsPlayingBack() && pFrame->tick_count > m_nTickCount + nAheadTicks )
+		{
+			pFrame->Compress();
+		}
+	}
+}
+
+void CHLTVServer::GetFrameBufferStats( int &nFrames, int &nCompressed, int &nBytes, float &flSeconds )
+{
+	nFrames = 0;
+	nCompressed = 0;
+
+	CHLTVFrame *pFirst = (CHLTVFrame*) GetClientFrame( 0, false );
+
+	for ( CHLTVFrame *pFrame = pFirst; pFrame; pFrame = (CHLTVFrame*) pFrame->m_pNext )
+	{
+		nFrames++;
+
+		if ( pFrame->IsCompressed() )
+			nCompressed++;
+	}
+
+	// snapshots aren't counted, the master proxy shares them with the game server
+	nBytes = nFrames * sizeof( CHLTVFrame ) + s_FrameBuffers.GetAllocatedBytes();
+	flSeconds = pFirst ? ( m_nLastTick - pFirst->tick_count ) * m_flTickInterval : 0.0f;
+}
+
 void CHLTVServer::SendClientMessages ( bool bSendSnapshots )
 {
 	// build individual updates
@@ -1608,6 +1854,24 @@ void CHLTVServer::UpdateTick( void )
 	if ( m_CurrentFrame == newFrame )
 		return;	// current frame didn't change
 
+	// unpack all frames up to the new one, clients get the messages of each
+	CHLTVFrame *pFrame = newFrame;
+
+	if ( m_CurrentFrame && m_CurrentFrame->tick_count < newFrame->tick_count )
+	{
+		pFrame = (CHLTVFrame*) m_CurrentFrame->m_pNext;
+	}
+
+	while ( pFrame )
+	{
+		pFrame->Uncompress();
+
+		if ( pFrame == newFrame )
+			break;
+
+		pFrame = (CHLTVFrame*) pFrame->m_pNext;
+	}
+
 	m_CurrentFrame = newFrame;
 	m_nTickCount = m_CurrentFrame->tick_count;
 	
@@ -1674,6 +1938,7 @@ void CHLTVServer::Clear( void )
 	m_vPVSOrigin.Init();
 		
 	DeleteClientFrames( -1 );
+	m_CompressQueue.RemoveAll();
 
 	m_DeltaCache.Flush();
 	m_FrameCache.RemoveAll();
@@ -1732,6 +1997,7 @@ void CHLTVServer::Changelevel()
 	InactivateClients();
 
 	DeleteClientFrames(-1);
+	m_CompressQueue.RemoveAll();
 
 	m_CurrentFrame = NULL;
 }
@@ -1949,6 +2215,17 @@ void CHLTVServer::ReadCompleteDemoFile()
 				free( data );
 			}
 			break;
+		case dem_keyframe:
+			{
+				// the packets around it hold the same state
+				int dummy;
+				democmdinfo_t info;
+				m_DemoFile.ReadKeyframe( NULL );
+				m_DemoFile.ReadCmdInfo( info );
+				m_DemoFile.ReadSequenceInfo( dummy, dummy );
+				m_DemoFile.ReadRawData( NULL, 0 );
+			}
+			break;
 		case dem_usercmd:
 			{
 				char bufferIn[256];
@@ -2201,6 +2478,13 @@ CON_COMMAND( tv_status, "Show SourceTV server status." )
 	ConMsg("Total Slots %i, Spectators %i, Proxies %i\n", 
 		slots, clients-proxies, proxies);
 
+	int nFrames, nCompressed, nBytes;
+	float flSeconds;
+	hltv->GetFrameBufferStats( nFrames, nCompressed, nBytes, flSeconds );
+
+	ConMsg("Frame buffer %i frames (%i compressed), %.1f MB, %.1f KB per second of delay\n",
+		nFrames, nCompressed, nBytes / (1024.0f*1024.0f), flSeconds > 0 ? nBytes / ( 1024.0f * flSeconds ) : 0.0f );
+
 	if ( hltv->m_DemoRecorder.IsRecording() )
 	{
 		ConMsg("Recording to \"%s\", length %s.\n", hltv->m_DemoRecorder.GetDemoFile()->m_szFileName, 
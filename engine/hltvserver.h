@@ -18,6 +18,8 @@
 #include "networkstringtable.h"
 #include <ihltv.h>
 #include <convar.h>
+#include <mempool.h>
+#include <utlqueue.h>
 
 #define HLTV_BUFFER_DIRECTOR		0	// director commands
 #define	HLTV_BUFFER_RELIABLE		1	// reliable messages
@@ -47,10 +49,23 @@ public:
 	void	CopyHLTVData( CHLTVFrame &frame );
 	virtual bool IsMemPoolAllocated() { return false; }
 
+	// packs the messages of a stored frame while it waits in the delay buffer
+	bool	Compress();
+	void	Uncompress();
+	bool	IsCompressed() const { return m_pCompressed != NULL; }
+
 public:
 
 	// message buffers:
 	bf_write	m_Messages[HLTV_BUFFER_MAX];
+
+private:
+	char		*m_pCompressed;		// reliable & unreliable messages while compressed
+	int			m_nCompressedSize;
+	int			m_nReliableBits;
+	int			m_nUnreliableBits;
+
+	DECLARE_FIXEDSIZE_ALLOCATOR( CHLTVFrame );
 };
 
 struct CFrameCacheEntry_s
@@ -187,6 +202,7 @@ public:
 	bool	DispatchToRelay( CHLTVClient *pClient);
 	bf_write *GetBuffer( int nBuffer);
 	CClientFrame *GetDeltaFrame( int nTick );
+	void	GetFrameBufferStats( int &nFrames, int &nCompressed, int &nBytes, float &flSeconds );
 		
 	inline  CHLTVClient* Client( int i ) { return static_cast<CHLTVClient*>(m_Clients[i]); }
 
@@ -205,6 +221,7 @@ private:
 	void		FreeClientRecvTables();
 	void		ReadCompleteDemoFile();
 	void		ResyncDemoClock();
+	void		CompressFrames();
 
 #ifndef NO_STEAM
 	void		ReplyInfo( const netadr_t &adr );
@@ -246,6 +263,7 @@ public:
 
 	CDeltaEntityCache				m_DeltaCache;
 	CUtlVector<CFrameCacheEntry_s>	m_FrameCache;
+	CUtlQueue<CHLTVFrame*>			m_CompressQueue;	// stored frames not yet old enough to compress
 
 	// demoplayer stuff:
 	CDemoFile		m_DemoFile;		// for demo playback
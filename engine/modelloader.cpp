@@ -56,6 +56,7 @@
 #include "optimize.h"
 #include "networkstringtable.h"
 #include "tier1/callqueue.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -76,6 +77,8 @@ static ConVar mod_offline_hdr_switch( "mod_offline_hdr_switch", CONVAR_DEFAULT_M
                                       "pathways." );
 static ConVar mod_touchalldata( "mod_touchalldata", "1", 0, "Touch model data during level startup" );
 static ConVar mod_forcetouchdata( "mod_forcetouchdata", "1", 0, "Forces all model file data into cache on model load." );
+static ConVar mod_mapfile_mmap( "mod_mapfile_mmap", "1", 0, "Map .bsp files into memory and use their lumps in place instead of reading each one." );
+static ConVar mod_mapfile_decodejobs( "mod_mapfile_decodejobs", "1", 0, "Decompress the lumps of memory mapped .bsp files on the job pool while the map loads." );
 ConVar mat_excludetextures( "mat_excludetextures", "0", FCVAR_CHEAT );
 
 ConVar r_unloadlightmaps( "r_unloadlightmaps", "0", FCVAR_CHEAT );
@@ -395,6 +398,18 @@ static char				s_szMapName[128];
 static worldbrushdata_t	*s_pMap = NULL;
 static int				s_nMapLoadRecursion = 0;
 static CUtlBuffer		s_MapBuffer;
+static void				*s_pMappedFile = NULL;	// s_MapBuffer points into this mapping of the .bsp
+static uint64			s_nMappedFileSize = 0;
+
+// Compressed lumps of a mapped .bsp, decompressed on the job pool. They are
+// kept until the load context shuts down so collision and render share them.
+struct decodedlump_t
+{
+	CJob				*pJob;
+	byte				*pData;
+	int					nSize;
+};
+static decodedlump_t s_DecodedLumps[ HEADER_LUMPS ];
 
 int s_MapVersion = 0;
 
@@ -421,6 +436,87 @@ int CMapLoadHelper::GetRefCount()
 	return s_nMapLoadRecursion;
 }
 
+//-----------------------------------------------------------------------------
+// Maps the opened bsp into s_MapBuffer. Maps inside pack files and
+// anything that doesn't match what we read through the filesystem keep
+// using the file handle.
+//-----------------------------------------------------------------------------
+void CMapLoadHelper::MapFileIntoMemory( void )
+{
+	char szFullPath[MAX_PATH];
+	PathTypeQuery_t pathType = PATH_IS_NORMAL;
+	if ( !g_pFileSystem->RelativePathToFullPath_safe( s_szMapName, NULL, szFullPath, FILTER_NONE, &pathType ) ||
+		 IS_PACKFILE( pathType ) )
+	{
+		return;
+	}
+
+	uint64 nSize = 0;
+	void *pData = Plat_MapFile( szFullPath, &nSize );
+	if ( !pData )
+		return;
+
+	if ( nSize > INT_MAX || nSize != g_pFileSystem->Size( s_MapFileHandle ) ||
+		 V_memcmp( pData, &s_MapHeader, sizeof( dheader_t ) ) )
+	{
+		Plat_UnmapFile( pData, nSize );
+		return;
+	}
+
+	s_pMappedFile = pData;
+	s_nMappedFileSize = nSize;
+	s_MapBuffer.SetExternalBuffer( pData, (int)nSize, (int)nSize );
+}
+
+void CMapLoadHelper::DecodeLumpJob( int lumpId )
+{
+	lump_t *pLump = &s_MapHeader.lumps[ lumpId ];
+	byte *pCompressed = (byte *)s_MapBuffer.Base() + pLump->fileofs;
+
+	// leave anything odd to the regular path, it knows how to complain
+	if ( !CLZMA::IsCompressed( pCompressed ) || CLZMA::GetActualSize( pCompressed ) != (unsigned int)pLump->uncompressedSize )
+		return;
+
+	byte *pData = (byte *)malloc( pLump->uncompressedSize );
+	if ( CLZMA::Uncompress( pCompressed, pData ) != (unsigned int)pLump->uncompressedSize )
+	{
+		free( pData );
+		return;
+	}
+
+	s_DecodedLumps[ lumpId ].pData = pData;
+	s_DecodedLumps[ lumpId ].nSize = pLump->uncompressedSize;
+}
+
+//-----------------------------------------------------------------------------
+// Starts decompressing all compressed lumps of a memory mapped bsp. Lump
+// helpers wait for the job of the lump they need only, so the loaders keep
+// running while the rest is still in flight.
+//-----------------------------------------------------------------------------
+void CMapLoadHelper::StartLumpDecode( void )
+{
+	if ( !s_pMappedFile || !mod_mapfile_decodejobs.GetBool() || !g_pThreadPool || !g_pThreadPool->NumThreads() )
+		return;
+
+	for ( int i = 0; i < HEADER_LUMPS; i++ )
+	{
+		lump_t *pLump = &s_MapHeader.lumps[ i ];
+
+		// the pack lump is never compressed as a whole, game lumps compress their entries
+		if ( i == LUMP_PAKFILE || i == LUMP_GAME_LUMP || pLump->uncompressedSize <= 0 )
+			continue;
+
+		if ( s_MapLumpFiles[i].file != FILESYSTEM_INVALID_HANDLE || s_DecodedLumps[i].pJob || s_DecodedLumps[i].pData )
+			continue;
+
+		if ( pLump->fileofs < 0 || pLump->filelen < (int)sizeof( lzma_header_t ) ||
+			 (uint64)pLump->fileofs + pLump->filelen > s_nMappedFileSize )
+			continue;
+
+		s_DecodedLumps[i].pJob = g_pThreadPool->QueueCall( &CMapLoadHelper::DecodeLumpJob, i );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Setup a BSP loading context, maintains a ref count.	
 //-----------------------------------------------------------------------------
@@ -473,6 +569,12 @@ void CMapLoadHelper::Init( model_t *pMapModel, const char *loadname )
 
 	s_MapVersion = s_MapHeader.version;
 
+	// use the lumps in place if the bsp is a plain file on disk
+	if ( IsPC() && mod_mapfile_mmap.GetBool() )
+	{
+		MapFileIntoMemory();
+	}
+
 	V_strcpy_safe( s_szLoadName, loadname );
 
 	// Store map version, but only do it once so that the communication between the engine and Hammer isn't broken. The map version
@@ -615,12 +717,33 @@ void CMapLoadHelper::Shutdown( void )
 		V_memset( &s_MapLumpFiles, 0, sizeof( s_MapLumpFiles ) );
 	}
 
+	for ( int i = 0; i < HEADER_LUMPS; i++ )
+	{
+		decodedlump_t &lump = s_DecodedLumps[i];
+		if ( lump.pJob )
+		{
+			lump.pJob->WaitForFinishAndRelease();
+		}
+		if ( lump.pData )
+		{
+			free( lump.pData );
+		}
+	}
+	V_memset( &s_DecodedLumps, 0, sizeof( s_DecodedLumps ) );
+
 	s_szLoadName[ 0 ] = 0;
 	V_memset( &s_MapHeader, 0, sizeof( s_MapHeader ) );
 	s_pMap = NULL;
 
 	// discard from memory
-	if ( s_MapBuffer.Base() )
+	if ( s_pMappedFile )
+	{
+		Plat_UnmapFile( s_pMappedFile, s_nMappedFileSize );
+		s_pMappedFile = NULL;
+		s_nMappedFileSize = 0;
+		s_MapBuffer.SetExternalBuffer( NULL, 0, 0 );
+	}
+	else if ( s_MapBuffer.Base() )
 	{
 		free( s_MapBuffer.Base() );
 		s_MapBuffer.SetExternalBuffer( NULL, 0, 0 );
@@ -797,9 +920,30 @@ CMapLoadHelper::CMapLoadHelper( int lumpToLoad )
 		return;
 	}
 
-	if ( s_MapBuffer.Base() )
+	decodedlump_t &decoded = s_DecodedLumps[ lumpToLoad ];
+	if ( decoded.pJob )
+	{
+		decoded.pJob->WaitForFinishAndRelease();
+		decoded.pJob = NULL;
+	}
+
+	if ( decoded.pData )
+	{
+		// decompressed ahead of time, owned by the load context
+		m_pData = decoded.pData;
+		m_nLumpSize = decoded.nSize;
+		return;
+	}
+
+	if ( s_MapBuffer.Base() && fileToUse == s_MapFileHandle )
 	{
 		// bsp is in memory
+		// compare against the space left after the offset, the sum can overflow on a bad bsp
+		if ( m_nLumpOffset < 0 || m_nLumpSize < 0 || m_nLumpSize > s_MapBuffer.TellMaxPut() - m_nLumpOffset )
+		{
+			Sys_Error( "Can't load lump %i, it is outside of the map file!!!", lumpToLoad );
+		}
+
 		m_pData = (unsigned char*)s_MapBuffer.Base() + m_nLumpOffset;
 	}
 	else
@@ -4471,6 +4615,11 @@ void CModelLoader::Map_LoadModel( model_t *mod )
 		Warning( "Map '%s' lacks exepected HDR data! 360 does not support accurate LDR visuals.", m_szLoadName );
 	}
 
+	// Open the map before the collision model, so both share the mapped
+	// file and the lumps decompressed in the background
+	CMapLoadHelper::Init( mod, m_szLoadName );
+	CMapLoadHelper::StartLumpDecode();
+
 	// Load the collision model
 	COM_TimestampedLog( "  CM_LoadMap" );
 	unsigned int checksum;
@@ -4479,7 +4628,6 @@ void CModelLoader::Map_LoadModel( model_t *mod )
 	// Load the map
 	mod->type = mod_brush;
 	mod->nLoadFlags |= FMODELLOADER_LOADED;
-	CMapLoadHelper::Init( mod, m_szLoadName );
 
 	COM_TimestampedLog( "  Mod_LoadVertices" );
 	Mod_LoadVertices();
@@ -187,6 +187,9 @@ public:
 	// Free the lighting lump (increases free memory during loading on 360)
 	static void			FreeLightingLump();
 
+	// Decompress the lumps of a memory mapped bsp on the job pool
+	static void			StartLumpDecode();
+
 	// Returns the size of a particular lump without loading it
 	static int			LumpSize( int lumpId );
 	static int			LumpOffset( int lumpId );
@@ -196,6 +199,9 @@ public:
 	void				LoadLumpData( int offset, int size, void *pData );
 
 private:
+	static void			MapFileIntoMemory();
+	static void			DecodeLumpJob( int lumpId );
+
 	int					m_nLumpSize;
 	int					m_nLumpOffset;
 	int					m_nLumpVersion;
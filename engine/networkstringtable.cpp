@@ -13,6 +13,7 @@
 #include "net.h"
 #include "filesystem_engine.h"
 #include "baseclient.h"
+#include "server.h"
 #include "vprof.h"
 #include <tier1/utlstring.h>
 #include <tier1/utlhashtable.h>
@@ -24,6 +25,11 @@ ConVar sv_dumpstringtables( "sv_dumpstringtables", "0", FCVAR_CHEAT );
 ConVar sv_compressstringtablebaselines_threshhold( "sv_compressstringtablebaselines_threshold", "2048", 0, "Minimum size (in bytes) for stringtablebaseline buffer to be compressed." );
 
 #define SUBSTRING_BITS	5
+
+// unchanged bytes between two changed ones are resent when the gap is
+// shorter than this, a new run header costs more
+#define USERDATA_DELTA_MIN_GAP	3
+
 struct StringHistoryEntry
 {
 	char string[ (1<<SUBSTRING_BITS) ];
@@ -67,6 +73,94 @@ static int GetBestPreviousString( CUtlVector< StringHistoryEntry >& history, cha
 	return bestindex;
 }
 
+#ifndef SHARED_NET_STRING_TABLES
+//-----------------------------------------------------------------------------
+// Purpose: Writes user data as runs of changed bytes against the data the 
+//			client already has, after a set delta bit. Returns false if that
+//			isn't smaller than sending the whole thing, nothing is written then.
+//-----------------------------------------------------------------------------
+static bool WriteUserDataDelta( bf_write &buf, const byte *pOld, int nOldLength, const byte *pNew, int nNewLength )
+{
+	byte deltabuf[ CNetworkStringTableItem::MAX_USERDATA_SIZE + 1024 ];
+	bf_write delta( "WriteUserDataDelta", deltabuf, sizeof( deltabuf ) );
+
+	delta.WriteUBitLong( nNewLength, CNetworkStringTableItem::MAX_USERDATA_BITS );
+
+	int pos = 0;
+	while ( pos < nNewLength )
+	{
+		// skip what the client has already
+		int start = pos;
+		while ( pos < nNewLength && pos < nOldLength && pNew[pos] == pOld[pos] )
+		{
+			pos++;
+		}
+
+		if ( pos == nNewLength )
+			break;
+
+		// find the end of this run of changes
+		int runEnd = pos;
+		for ( int i = pos; i < nNewLength && ( i - runEnd ) < USERDATA_DELTA_MIN_GAP; i++ )
+		{
+			if ( i >= nOldLength || pNew[i] != pOld[i] )
+			{
+				runEnd = i + 1;
+			}
+		}
+
+		delta.WriteOneBit( 1 );
+		delta.WriteUBitVar( pos - start );
+		delta.WriteUBitVar( runEnd - pos );
+		delta.WriteBytes( pNew + pos, runEnd - pos );
+		pos = runEnd;
+	}
+
+	delta.WriteOneBit( 0 );
+
+	// full update is the length plus the data
+	if ( delta.IsOverflowed() || delta.GetNumBitsWritten() >= CNetworkStringTableItem::MAX_USERDATA_BITS + nNewLength * 8 )
+		return false;
+
+	buf.WriteOneBit( 1 );
+	buf.WriteBits( deltabuf, delta.GetNumBitsWritten() );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Inverse of WriteUserDataDelta, returns the new length or -1 if the
+//			delta doesn't fit the old data
+//-----------------------------------------------------------------------------
+static int ReadUserDataDelta( bf_read &buf, const byte *pOld, int nOldLength, byte *pNew )
+{
+	int nNewLength = buf.ReadUBitLong( CNetworkStringTableItem::MAX_USERDATA_BITS );
+	int pos = 0;
+
+	while ( buf.ReadOneBit() )
+	{
+		int nSkip = buf.ReadUBitVar();
+		int nChanged = buf.ReadUBitVar();
+
+		if ( ( nSkip > 0 && pos + nSkip > nOldLength ) || pos + nSkip + nChanged > nNewLength || buf.IsOverflowed() )
+			return -1;
+
+		Q_memcpy( pNew + pos, pOld + pos, nSkip );
+		pos += nSkip;
+
+		buf.ReadBytes( pNew + pos, nChanged );
+		pos += nChanged;
+	}
+
+	// the rest is unchanged
+	if ( pos < nNewLength && nNewLength > nOldLength )
+		return -1;
+
+	Q_memcpy( pNew + pos, pOld + pos, nNewLength - pos );
+
+	return nNewLength;
+}
+#endif
+
 bool CNetworkStringTable_LessFunc( FileNameHandle_t const &a, FileNameHandle_t const &b )
 {
 	return a < b;
@@ -220,6 +314,19 @@ CNetworkStringTable::CNetworkStringTable( TABLEID id, const char *tableName, int
 	m_nLastChangedTick = 0;
 	m_bChangeHistoryEnabled = false;
 	m_bLocked = false;
+	m_nChangeSerial = 0;
+
+#ifndef SHARED_NET_STRING_TABLES
+	for ( int i = 0; i < UPDATE_CACHE_SIZE; i++ )
+	{
+		m_UpdateCache[i].nTickAck = -1;
+		m_UpdateCache[i].nChangeSerial = -1;
+		m_UpdateCache[i].nProtocol = -1;
+	}
+	m_nNextUpdateCache = 0;
+#endif
+
+	ResetStats();
 
 	m_nMaxEntries = maxentries;
 	m_nEntryBits = Q_log2( m_nMaxEntries );
@@ -330,6 +437,8 @@ CNetworkStringTable::~CNetworkStringTable( void )
 //-----------------------------------------------------------------------------
 void CNetworkStringTable::DeleteAllStrings( void )
 {
+	m_nChangeSerial++;
+
 	delete m_pItems;
 	if ( m_bIsFilenames )
 	{
@@ -440,6 +549,7 @@ void CNetworkStringTable::RestoreTick(int tick)
 	// TODO optimize this, most of the time the tables doens't really change
 
 	m_nLastChangedTick = 0;
+	m_nChangeSerial++;
 
 	int count = m_pItems->Count();
 		
@@ -499,7 +609,56 @@ void CNetworkStringTable::UpdateMirrorTable( int tick_ack  )
 	}
 }
 
-int CNetworkStringTable::WriteUpdate( CBaseClient *client, bf_write &buf, int tick_ack )
+int CNetworkStringTable::WriteUpdate( CBaseClient *client, bf_write &buf, int tick_ack, int nProtocol )
+{
+	// traced clients need the per entry output, don't use the cache for them
+	bool bUseCache = !client || !client->IsTracing();
+
+	if ( bUseCache )
+	{
+		for ( int i = 0; i < UPDATE_CACHE_SIZE; i++ )
+		{
+			UpdateCache_t &cache = m_UpdateCache[i];
+
+			if ( cache.nTickAck != tick_ack || cache.nChangeSerial != m_nChangeSerial || cache.nProtocol != nProtocol )
+				continue;
+
+			buf.WriteBits( cache.data.Base(), cache.nBits );
+			AddUpdateStats( cache.nBits, cache.nDeltaSavedBits, true );
+			return cache.nEntries;
+		}
+	}
+
+	int nStartBit = buf.GetNumBitsWritten();
+	int nDeltaSavedBits = 0;
+	int entriesUpdated = WriteUpdateInternal( client, buf, tick_ack, nProtocol, &nDeltaSavedBits );
+	int nBits = buf.GetNumBitsWritten() - nStartBit;
+
+	AddUpdateStats( nBits, nDeltaSavedBits, false );
+
+	if ( bUseCache && !buf.IsOverflowed() )
+	{
+		UpdateCache_t &cache = m_UpdateCache[m_nNextUpdateCache];
+		m_nNextUpdateCache = ( m_nNextUpdateCache + 1 ) % UPDATE_CACHE_SIZE;
+
+		cache.nTickAck = tick_ack;
+		cache.nChangeSerial = m_nChangeSerial;
+		cache.nProtocol = nProtocol;
+		cache.nEntries = entriesUpdated;
+		cache.nBits = nBits;
+		cache.nDeltaSavedBits = nDeltaSavedBits;
+		cache.data.EnsureCapacity( Bits2Bytes( nBits ) + 4 );
+
+		// copy what was just written, it may not start on a byte boundary
+		bf_read written( buf.GetBasePointer(), buf.GetNumBytesWritten() );
+		written.Seek( nStartBit );
+		written.ReadBits( cache.data.Base(), nBits );
+	}
+
+	return entriesUpdated;
+}
+
+int CNetworkStringTable::WriteUpdateInternal( CBaseClient *client, bf_write &buf, int tick_ack, int nProtocol, int *pDeltaSavedBits )
 {
 	CUtlVector< StringHistoryEntry > history;
 
@@ -570,11 +729,30 @@ int CNetworkStringTable::WriteUpdate( CBaseClient *client, bf_write &buf, int ti
 				// Don't have to send length, it was sent as part of the table definition
 				buf.WriteBits( pUserData, GetUserDataSizeBits() );
 			}
-			else
+			else if ( nProtocol <= PROTOCOL_VERSION_25 )
 			{
+				// older clients don't know about deltas
 				buf.WriteUBitLong( len, CNetworkStringTableItem::MAX_USERDATA_BITS );
 				buf.WriteBits( pUserData, len*8 );
 			}
+			else
+			{
+				// send the changed bytes only if the client has the previous data
+				int nBaseLength = 0;
+				const void *pBase = p->GetDeltaBase( tick_ack, &nBaseLength );
+				int nDeltaStartBit = buf.GetNumBitsWritten();
+
+				if ( pBase && WriteUserDataDelta( buf, (const byte *)pBase, nBaseLength, (const byte *)pUserData, len ) )
+				{
+					*pDeltaSavedBits += CNetworkStringTableItem::MAX_USERDATA_BITS + len*8 + 1 - ( buf.GetNumBitsWritten() - nDeltaStartBit );
+				}
+				else
+				{
+					buf.WriteOneBit( 0 );
+					buf.WriteUBitLong( len, CNetworkStringTableItem::MAX_USERDATA_BITS );
+					buf.WriteBits( pUserData, len*8 );
+				}
+			}
 		}
 		else
 		{
@@ -611,7 +789,7 @@ int CNetworkStringTable::WriteUpdate( CBaseClient *client, bf_write &buf, int ti
 //-----------------------------------------------------------------------------
 // Purpose: Parse string update
 //-----------------------------------------------------------------------------
-void CNetworkStringTable::ParseUpdate( bf_read &buf, int entries )
+void CNetworkStringTable::ParseUpdate( bf_read &buf, int entries, int nProtocol )
 {
 	int lastEntry = -1;
 
@@ -678,6 +856,23 @@ void CNetworkStringTable::ParseUpdate( bf_read &buf, int entries )
 				tempbuf[nBytes-1] = 0; // be safe, clear last byte
 				buf.ReadBits( tempbuf, GetUserDataSizeBits() );
 			}
+			else if ( nProtocol > PROTOCOL_VERSION_25 && buf.ReadOneBit() )
+			{
+				// changed bytes against the data we have
+				if ( entryIndex >= GetNumStrings() )
+				{
+					Host_Error( "Server sent user data delta for new string %i in table %s\n", entryIndex, GetTableName() );
+				}
+
+				int nBaseLength = 0;
+				const void *pBase = GetStringUserData( entryIndex, &nBaseLength );
+				nBytes = ReadUserDataDelta( buf, (const byte *)pBase, pBase ? nBaseLength : 0, tempbuf );
+
+				if ( nBytes < 0 )
+				{
+					Host_Error( "Server sent bogus user data delta for string %i in table %s\n", entryIndex, GetTableName() );
+				}
+			}
 			else
 			{
 				nBytes = buf.ReadUBitLong( CNetworkStringTableItem::MAX_USERDATA_BITS );
@@ -744,6 +939,27 @@ void CNetworkStringTable::CopyStringTable(CNetworkStringTable * table)
 
 #endif
 
+void CNetworkStringTable::ResetStats( void )
+{
+	Q_memset( &m_Stats, 0, sizeof( m_Stats ) );
+	m_Stats.nTick = -1;
+}
+
+void CNetworkStringTable::DumpStats( void )
+{
+	if ( !m_Stats.nUpdates )
+		return;
+
+	ConMsg( "%-24s %7i %6i %10.1f %9i %11lld %10lld\n",
+		GetTableName(),
+		m_Stats.nUpdates,
+		m_Stats.nCacheHits,
+		m_Stats.nTicks ? (float)Bits2Bytes( m_Stats.nTotalBits ) / m_Stats.nTicks : 0.0f,
+		Bits2Bytes( m_Stats.nPeakBits ),
+		(long long)Bits2Bytes( m_Stats.nTotalBits ),
+		(long long)Bits2Bytes( m_Stats.nDeltaSavedBits ) );
+}
+
 void CNetworkStringTable::TriggerCallbacks( int tick_ack )
 {
 	if ( m_changeFunc == NULL )
@@ -939,6 +1155,10 @@ int CNetworkStringTable::AddString( bool bIsServer, const char *string, int leng
 		{
 			DataChanged( i, item );
 		}
+		else if ( bHasChanged )
+		{
+			m_nChangeSerial++;
+		}
 	}
 
 	return i;
@@ -1016,6 +1236,7 @@ void CNetworkStringTable::DataChanged( int stringNumber, CNetworkStringTableItem
 
 	// Mark table as changed
 	m_nLastChangedTick = m_nTickCount;
+	m_nChangeSerial++;
 	
 	// Invoke callback if one was installed
 	
@@ -1033,6 +1254,27 @@ void CNetworkStringTable::DataChanged( int stringNumber, CNetworkStringTableItem
 
 #ifndef SHARED_NET_STRING_TABLES
 
+void CNetworkStringTable::AddUpdateStats( int nBits, int nDeltaSavedBits, bool bCached )
+{
+	if ( m_Stats.nTick != m_nTickCount )
+	{
+		m_Stats.nTick = m_nTickCount;
+		m_Stats.nCurrentBits = 0;
+		m_Stats.nTicks++;
+	}
+
+	m_Stats.nCurrentBits += nBits;
+	m_Stats.nPeakBits = MAX( m_Stats.nPeakBits, m_Stats.nCurrentBits );
+	m_Stats.nUpdates++;
+	m_Stats.nTotalBits += nBits;
+	m_Stats.nDeltaSavedBits += nDeltaSavedBits;
+
+	if ( bCached )
+	{
+		m_Stats.nCacheHits++;
+	}
+}
+
 void CNetworkStringTable::WriteStringTable( bf_write& buf )
 {
 	int numstrings = m_pItems->Count();
@@ -1228,7 +1470,7 @@ void CNetworkStringTable::Dump( void )
 
 #ifndef SHARED_NET_STRING_TABLES
 
-bool CNetworkStringTable::WriteBaselines( SVC_CreateStringTable &msg, char *msg_buffer, int msg_buffer_size )
+bool CNetworkStringTable::WriteBaselines( SVC_CreateStringTable &msg, char *msg_buffer, int msg_buffer_size, int nProtocol )
 {
 	VPROF_BUDGET( "CNetworkStringTable::WriteBaselines", VPROF_BUDGETGROUP_OTHER_NETWORKING );
 	msg.m_DataOut.StartWriting( msg_buffer, msg_buffer_size );
@@ -1242,7 +1484,7 @@ bool CNetworkStringTable::WriteBaselines( SVC_CreateStringTable &msg, char *msg_
 	msg.m_nUserDataSizeBits		= GetUserDataSizeBits();
 
 	// tick = -1 ensures that all entries are updated = baseline
-	int entries = WriteUpdate( NULL, msg.m_DataOut, -1 );
+	int entries = WriteUpdate( NULL, msg.m_DataOut, -1, nProtocol );
 
 	return entries == msg.m_nNumEntries;
 }
@@ -1393,7 +1635,7 @@ int CNetworkStringTableContainer::GetNumTables( void ) const
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
-void CNetworkStringTableContainer::WriteBaselines( bf_write &buf )
+void CNetworkStringTableContainer::WriteBaselines( bf_write &buf, int nProtocol )
 {
 	VPROF_BUDGET( "CNetworkStringTableContainer::WriteBaselines", VPROF_BUDGETGROUP_OTHER_NETWORKING );
 
@@ -1411,7 +1653,7 @@ void CNetworkStringTableContainer::WriteBaselines( bf_write &buf )
 		CNetworkStringTable *table = (CNetworkStringTable*) GetTable( i );
 
 		int before = buf.GetNumBytesWritten();
-		if ( !table->WriteBaselines( msg, msg_buffer, msg_buffer_size ) )
+		if ( !table->WriteBaselines( msg, msg_buffer, msg_buffer_size, nProtocol ) )
 		{
 			Host_Error( "Index error writing string table baseline %s\n", table->GetTableName() );
 		}
@@ -1511,7 +1753,7 @@ bool CNetworkStringTableContainer::ReadStringTables( bf_read& buf )
 // Input  : *cl - 
 //			*msg - 
 //-----------------------------------------------------------------------------
-void CNetworkStringTableContainer::WriteUpdateMessage( CBaseClient *client, int tick_ack, bf_write &buf )
+void CNetworkStringTableContainer::WriteUpdateMessage( CBaseClient *client, int tick_ack, bf_write &buf, int nProtocol )
 {
 	VPROF_BUDGET( "CNetworkStringTableContainer::WriteUpdateMessage", VPROF_BUDGETGROUP_OTHER_NETWORKING );
 
@@ -1532,7 +1774,7 @@ void CNetworkStringTableContainer::WriteUpdateMessage( CBaseClient *client, int
 
 		msg.m_DataOut.StartWriting( buffer, NET_MAX_PAYLOAD );
 		msg.m_nTableID = table->GetTableId();
-		msg.m_nChangedEntries = table->WriteUpdate( client, msg.m_DataOut, tick_ack );
+		msg.m_nChangedEntries = table->WriteUpdate( client, msg.m_DataOut, tick_ack, nProtocol );
 
 		Assert( msg.m_nChangedEntries > 0 ); // don't send unnecessary empty updates
 
@@ -1648,3 +1890,38 @@ void CNetworkStringTableContainer::Dump( void )
 		m_Tables[ i ]->Dump();
 	}
 }
+
+void CNetworkStringTableContainer::DumpStats( void )
+{
+	ConMsg( "%-24s %7s %6s %10s %9s %11s %10s\n", "table", "updates", "cached", "bytes/tick", "peak/tick", "total bytes", "delta save" );
+
+	for ( int i = 0; i < m_Tables.Count(); i++ )
+	{
+		m_Tables[ i ]->DumpStats();
+	}
+}
+
+void CNetworkStringTableContainer::ResetStats( void )
+{
+	for ( int i = 0; i < m_Tables.Count(); i++ )
+	{
+		m_Tables[ i ]->ResetStats();
+	}
+}
+
+CON_COMMAND( sv_stringtable_stats, "Shows bytes per tick sent for each server string table. Use 'reset' to clear." )
+{
+	if ( !sv.IsActive() || !sv.m_StringTables )
+	{
+		ConMsg( "sv_stringtable_stats: server not running\n" );
+		return;
+	}
+
+	if ( args.ArgC() > 1 && !Q_stricmp( args[1], "reset" ) )
+	{
+		sv.m_StringTables->ResetStats();
+		return;
+	}
+
+	sv.m_StringTables->DumpStats();
+}
@@ -16,6 +16,7 @@
 #include <utldict.h>
 #include <utlbuffer.h>
 #include "tier1/bitbuf.h"
+#include "proto_version.h"
 
 class SVC_CreateStringTable;
 class CBaseClient;
@@ -75,8 +76,8 @@ public:
 public:
 	
 #ifndef SHARED_NET_STRING_TABLES
-	int				WriteUpdate( CBaseClient *client, bf_write &buf, int tick_ack );
-	void			ParseUpdate( bf_read &buf, int entries );
+	int				WriteUpdate( CBaseClient *client, bf_write &buf, int tick_ack, int nProtocol = PROTOCOL_VERSION );
+	void			ParseUpdate( bf_read &buf, int entries, int nProtocol = PROTOCOL_VERSION );
 
 	// HLTV change history & rollback
 	void			EnableRollback();
@@ -90,7 +91,7 @@ public:
 	void			WriteStringTable( bf_write& buf );
 	bool			ReadStringTable( bf_read& buf );
 
-	bool			WriteBaselines( SVC_CreateStringTable &msg, char *msg_buffer, int msg_buffer_size );
+	bool			WriteBaselines( SVC_CreateStringTable &msg, char *msg_buffer, int msg_buffer_size, int nProtocol = PROTOCOL_VERSION );
 #endif
 
 	void			TriggerCallbacks( int tick_ack  );
@@ -100,6 +101,10 @@ public:
 	// debug ouptput
 	virtual void	Dump( void );
 	virtual void	Lock( bool bLock );
+
+	// update size statistics
+	void			DumpStats( void );
+	void			ResetStats( void );
 	
 	void SetAllowClientSideAddString( bool state );
 	pfnStringChanged	GetCallback();
@@ -110,6 +115,11 @@ protected:
 	// Destroy string table
 	void			DeleteAllStrings( void );
 
+#ifndef SHARED_NET_STRING_TABLES
+	int				WriteUpdateInternal( CBaseClient *client, bf_write &buf, int tick_ack, int nProtocol, int *pDeltaSavedBits );
+	void			AddUpdateStats( int nBits, int nDeltaSavedBits, bool bCached );
+#endif
+
 	CNetworkStringTable( const CNetworkStringTable & ); // not implemented, not allowed
 
 	TABLEID					m_id;
@@ -139,6 +149,43 @@ protected:
 
 	INetworkStringDict		*m_pItems;
 	INetworkStringDict		*m_pItemsClientSide;	 // For m_bAllowClientSideAddString, these items are non-networked and are referenced by a negative string index!!!
+
+	// bumped whenever an entry changes, invalidates the update cache
+	int						m_nChangeSerial;
+
+#ifndef SHARED_NET_STRING_TABLES
+	// Encoded updates are the same for all clients that acked the same tick,
+	// so the last few are kept around like snapshots are.
+	enum { UPDATE_CACHE_SIZE = 4 };
+
+	struct UpdateCache_t
+	{
+		int					nTickAck;
+		int					nChangeSerial;
+		int					nProtocol;			// the update format depends on it
+		int					nEntries;
+		int					nBits;
+		int					nDeltaSavedBits;
+		CUtlMemory< byte >	data;
+	};
+
+	UpdateCache_t			m_UpdateCache[UPDATE_CACHE_SIZE];
+	int						m_nNextUpdateCache;
+#endif
+
+	struct UpdateStats_t
+	{
+		int					nTick;				// tick nCurrentBits belongs to
+		int					nCurrentBits;		// bits sent during nTick
+		int					nPeakBits;			// most bits sent during one tick
+		int					nTicks;				// ticks with updates
+		int					nUpdates;			// updates written
+		int					nCacheHits;			// updates copied from the cache
+		int64				nTotalBits;
+		int64				nDeltaSavedBits;	// user data bits saved by sending deltas
+	};
+
+	UpdateStats_t			m_Stats;
 };
 
 //-----------------------------------------------------------------------------
@@ -179,8 +226,9 @@ public:
 	void		WriteStringTables( bf_write& buf );
 	bool		ReadStringTables( bf_read& buf );
 
-	void		WriteUpdateMessage( CBaseClient *client, int tick_ack, bf_write &buf );
-	void		WriteBaselines( bf_write &buf );
+	// nProtocol is the receiver's network protocol, older clients don't get user data deltas
+	void		WriteUpdateMessage( CBaseClient *client, int tick_ack, bf_write &buf, int nProtocol = PROTOCOL_VERSION );
+	void		WriteBaselines( bf_write &buf, int nProtocol = PROTOCOL_VERSION );
 	void		DirectUpdate( int tick_ack );	// fill mirror table directly with updates
 #endif
 
@@ -195,6 +243,8 @@ public:
 	
 	// Print table data to console
 	void		Dump( void );
+	void		DumpStats( void );
+	void		ResetStats( void );
 	// Sets the lock and returns the previous lock state
 	bool		Lock( bool bLock );
 
@@ -45,6 +45,10 @@ public:
 	void 			UpdateChangeList( int tick, int length, const void *userData );
 	int				RestoreTick( int tick );
 	inline int		GetTickCreated( void ) const { return m_nTickCreated; }
+
+	// Returns the user data a client that acked tick_ack has for this item, 
+	// or NULL if that isn't known and the full user data must be sent
+	const void		*GetDeltaBase( int tick_ack, int *length ) const;
 #endif
 	
 	bool			SetUserData( int tick, int length, const void *userdata );
@@ -55,6 +59,10 @@ public:
 	// void			SetTickCount( int count ) ;
 	inline int		GetTickChanged( void ) const { return m_nTickChanged; }
 
+	// user data blocks come from size class pools, shared by all tables
+	static unsigned char *AllocUserData( int length );
+	static void		FreeUserData( unsigned char *pData, int length );
+
 public:
 	unsigned char	*m_pUserData;
 	int				m_nUserDataLength;
@@ -63,6 +71,11 @@ public:
 #ifndef SHARED_NET_STRING_TABLES
 	int				m_nTickCreated;
 	CUtlVector< itemchange_s > *m_pChangeList;	
+
+	// user data before the last change, base for delta updates
+	unsigned char	*m_pPrevUserData;
+	int				m_nPrevUserDataLength;
+	int				m_nTickPrevChanged;
 #endif
 };
 
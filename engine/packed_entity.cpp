@@ -18,6 +18,7 @@
 #include "dt_send.h"
 #include "dt_send_eng.h"
 #include "server_class.h"
+#include "framesnapshot.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -30,6 +31,7 @@
 PackedEntity::PackedEntity()
 {
 	m_pData = NULL;
+	m_pArena = NULL;
 	m_pChangeFrameList = NULL;
 	m_nSnapshotCreationTick = 0;
 	m_nShouldCheckCreationTick = 0;
@@ -47,14 +49,39 @@ PackedEntity::~PackedEntity()
 }
 
 
-bool PackedEntity::AllocAndCopyPadded( const void *pData, unsigned long size )
+void PackedEntity::FreeData()
+{
+	if ( m_pArena )
+	{
+		m_pArena->ReleaseReference();
+		m_pArena = NULL;
+		m_pData = NULL;
+	}
+	else if ( m_pData )
+	{
+		free(m_pData);
+		m_pData = NULL;
+	}
+}
+
+
+bool PackedEntity::AllocAndCopyPadded( const void *pData, unsigned long size, CFrameSnapshotArena *pArena )
 {
 	FreeData();
 	
 	unsigned long nBytes = PAD_NUMBER( size, 4 );
 
 	// allocate the memory
-	m_pData = malloc( nBytes );
+	if ( pArena )
+	{
+		m_pData = pArena->Alloc( nBytes );
+		m_pArena = pArena;
+		m_pArena->AddReference();
+	}
+	else
+	{
+		m_pData = malloc( nBytes );
+	}
 
 	if ( !m_pData )
 	{
@@ -69,6 +96,22 @@ bool PackedEntity::AllocAndCopyPadded( const void *pData, unsigned long size )
 }
 
 
+void PackedEntity::MoveDataToArena( CFrameSnapshotArena *pArena )
+{
+	if ( !m_pArena || m_pArena == pArena || !m_pArena->IsRetired() )
+		return;
+
+	int nBytes = Bits2Bytes( GetNumBits() );
+	void *pNewData = pArena->Alloc( nBytes );
+	Q_memcpy( pNewData, m_pData, nBytes );
+	pArena->AddReference();
+
+	m_pArena->ReleaseReference();
+	m_pArena = pArena;
+	m_pData = pNewData;
+}
+
+
 int PackedEntity::GetPropsChangedAfterTick( int iTick, int *iOutProps, int nMaxOutProps )
 {
 	if ( m_pChangeFrameList )
@@ -49,6 +49,7 @@ class RecvTable;
 class ServerClass;
 class ClientClass;
 class IChangeFrameList;
+class CFrameSnapshotArena;
 
 
 
@@ -73,8 +74,11 @@ public:
 	void		FreeData();
 
 	// Copy the data into the PackedEntity's data and make sure the # bytes allocated is
-	// an integer multiple of 4.
-	bool		AllocAndCopyPadded( const void *pData, unsigned long size );
+	// an integer multiple of 4. With an arena the data lives in the snapshot's memory.
+	bool		AllocAndCopyPadded( const void *pData, unsigned long size, CFrameSnapshotArena *pArena = NULL );
+
+	// Copies arena data over to pArena if the arena it's in has been retired
+	void		MoveDataToArena( CFrameSnapshotArena *pArena );
 
 	// These are like Get/Set, except SnagChangeFrameList clears out the
 	// PackedEntity's pointer since the usage model in sv_main is to keep
@@ -117,6 +121,7 @@ private:
 	CUtlVector<CSendProxyRecipients>	m_Recipients;
 
 	void				*m_pData;				// Packed data.
+	CFrameSnapshotArena	*m_pArena;				// Holds m_pData, NULL if it was malloc'ed
 	int					m_nBits;				// Number of bits used to encode.
 	IChangeFrameList	*m_pChangeFrameList;	// Only the most current 
 
@@ -158,15 +163,6 @@ inline void* PackedEntity::GetData()
 	return m_pData;
 }
 
-inline void PackedEntity::FreeData()
-{
-	if ( m_pData )
-	{
-		free(m_pData);
-		m_pData = NULL;
-	}
-}
-
 inline void PackedEntity::SetChangeFrameList( IChangeFrameList *pList )
 {
 	Assert( !m_pChangeFrameList );
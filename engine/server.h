@@ -23,6 +23,7 @@
 #include "precache.h"
 #include "sv_client.h"
 #include "baseserver.h"
+#include "bitvec.h"
 #include <ihltvdirector.h>
 
 
@@ -40,6 +41,13 @@ ServerClass* SV_FindServerClass( const char *pName );
 ServerClass* SV_FindServerClass( int index );
 
 
+// how long loading a preloaded model took
+struct ModelLoadTime_t
+{
+	int		nIndex;
+	float	flTime;
+};
+
 //=============================================================================
 
 // Max # of master servers this server can be associated with
@@ -135,6 +143,13 @@ public:
 	model_t		*GetModel( int index );
 	int			LookupModelIndex( char const *name );
 
+	// Models precached with RES_PRELOAD while the level spawns are collected,
+	// their files are read asynchronously and they get loaded in one go once
+	// the game dll is done precaching
+	void		BeginModelPrecacheBatch( void );
+	void		FinishModelPrecacheBatch( void );
+	void		PrintModelLoadTimes( int nCount );
+
 	// Accessors to model precaching stuff
 	int			PrecacheSound( char const *name, int flags );
 	char const	*GetSound( int index );
@@ -155,6 +170,10 @@ public:
 private:
 	void		SetHibernating( bool bHibernating );
 
+	void		QueueModelPrecache( int index, char const *name );
+	model_t		*LoadPrecacheModel( int index, char const *name );
+	void		ClearModelPrecacheBatch( void );
+
 	CPrecacheItem	model_precache[ MAX_MODELS ];
 	CPrecacheItem	generic_precache[ MAX_GENERIC ];
 	CPrecacheItem	sound_precache[ MAX_SOUNDS ];
@@ -167,6 +186,12 @@ private:
 
 	INetworkStringTable *m_pDynamicModelsTable;
 
+	bool						m_bBatchModelPrecache;
+	FileCacheHandle_t			m_hModelPrecacheFiles;	// async reads of the pending models
+	CUtlVector< int >			m_PendingModelPrecache;
+	CBitVec< MAX_MODELS >		m_PendingModelBits;
+	CUtlVector< ModelLoadTime_t > m_ModelLoadTimes;		// this level, in load order
+
 	CPureServerWhitelist *m_pPureServerWhitelist;
 	bool m_bHibernating; 	// Are we hibernating.  Hibernation makes server process consume approx 0 CPU when no clients are connected
 };
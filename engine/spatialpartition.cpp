@@ -32,6 +32,8 @@
 #include "bitvec.h"
 #include "host.h"
 #include "tier1/mempool.h"
+#include "vstdlib/jobthread.h"
+#include "vstdlib/random.h"
 
 #ifdef _PS3
 #include "tls_ps3.h"
@@ -42,6 +44,7 @@
 
 class CVoxelTree;
 class CIntersectSweptBox;
+class CIntersectBoxBatch;
 
 #define SPHASH_LEVEL_SKIP	2
 
@@ -109,9 +112,43 @@ struct EntityInfo_t
 	char						m_nLevel[NUM_TREES];	// Which level voxel tree is it in?
 	unsigned short				m_nVisitBit[NUM_TREES];
 	intp						m_iLeafList[NUM_TREES];	// Index into the leaf pool - leaf list for entity (m_aLeafList).
+	short						m_nTriggerCells[4];		// Columns in the trigger grid (x0, y0, x1, y1), see CTriggerGrid.
+	int32 volatile				m_nBoundsVersion;		// Odd while m_vecMin/m_vecMax are being written, see GetElementBounds.
 };
 
 
+//-----------------------------------------------------------------------------
+// A move that stays in the same voxels doesn't take the tree's write lock,
+// it only publishes the new bounds. Readers copy them and retry if a write
+// was in progress or happened in between.
+//-----------------------------------------------------------------------------
+inline void SetElementBounds( EntityInfo_t &info, const Vector &vecMin, const Vector &vecMax )
+{
+	ThreadInterlockedIncrement( &info.m_nBoundsVersion );
+	info.m_vecMin = vecMin;
+	info.m_vecMax = vecMax;
+	ThreadInterlockedIncrement( &info.m_nBoundsVersion );
+}
+
+inline void GetElementBounds( const EntityInfo_t &info, Vector &vecMin, Vector &vecMax )
+{
+	for ( ;; )
+	{
+		int32 nVersion = info.m_nBoundsVersion;
+		if ( !( nVersion & 1 ) )
+		{
+			ThreadMemoryBarrier();
+			vecMin = info.m_vecMin;
+			vecMax = info.m_vecMax;
+			ThreadMemoryBarrier();
+			if ( info.m_nBoundsVersion == nVersion )
+				return;
+		}
+		ThreadPause();
+	}
+}
+
+
 struct LeafListData_t
 {
 	UtlHashFixedHandle_t		m_hVoxel;	// Voxel handle the entity is in.
@@ -120,7 +157,72 @@ struct LeafListData_t
 
 typedef CUtlFixedLinkedList<LeafListData_t>	CLeafList;
 
-typedef CVarBitVec CPartitionVisits;
+//-----------------------------------------------------------------------------
+// Elements one query has already reported, indexed by EntityInfo_t::m_nVisitBit.
+// Every query takes a new stamp, so nothing has to be cleared between queries.
+// Only the thread running the query touches it.
+//-----------------------------------------------------------------------------
+class CPartitionVisits
+{
+public:
+	CPartitionVisits() : m_nStamp( 0 )
+	{
+	}
+
+	void Begin( int nVisitBits )
+	{
+		if ( m_Stamps.Count() < nVisitBits )
+		{
+			Grow( nVisitBits );
+		}
+
+		if ( ++m_nStamp == 0 )
+		{
+			// Wrapped, stamps from long ago would match again
+			memset( m_Stamps.Base(), 0, m_Stamps.Count() * sizeof( uint32 ) );
+			m_nStamp = 1;
+		}
+	}
+
+	// Returns false if the element was visited by this query already
+	bool Visit( int nVisitBit )
+	{
+		// Inserted by another thread since the query started
+		if ( nVisitBit >= m_Stamps.Count() )
+		{
+			Grow( nVisitBit + 1 );
+		}
+
+		if ( m_Stamps[nVisitBit] == m_nStamp )
+			return false;
+
+		m_Stamps[nVisitBit] = m_nStamp;
+		return true;
+	}
+
+private:
+	void Grow( int nCount )
+	{
+		int nOldCount = m_Stamps.Count();
+		m_Stamps.AddMultipleToTail( nCount - nOldCount );
+		memset( m_Stamps.Base() + nOldCount, 0, ( nCount - nOldCount ) * sizeof( uint32 ) );
+	}
+
+	CUtlVector<uint32>	m_Stamps;
+	uint32				m_nStamp;
+};
+
+//-----------------------------------------------------------------------------
+// Query state of one thread in a voxel tree. Written on every query by that
+// thread alone, so each one gets a cache line of its own.
+//-----------------------------------------------------------------------------
+struct PartitionReader_t
+{
+	int32 volatile		m_nReadCount;		// read locks held on the tree
+	int					m_nDepth;			// nested queries running
+	CPartitionVisits	*m_pVisits;			// visits of the innermost query
+	byte				m_pad[128 - 2 * sizeof( int32 ) - sizeof( CPartitionVisits * )];
+};
 
 //-----------------------------------------------------------------------------
 // Used when rendering the various levels of the voxel hash
@@ -180,6 +282,9 @@ public:
 	bool EnumerateElementsInBox( SpatialPartitionListMask_t listMask, Voxel_t vmin, Voxel_t vmax, const Vector& mins, const Vector& maxs, IPartitionEnumerator* pIterator );
 	bool EnumerateElementsAlongRay( SpatialPartitionListMask_t listMask, const Ray_t& ray, const Vector &vecInvDelta, const Vector &vecEnd, IPartitionEnumerator* pIterator );
 	bool EnumerateElementsAtPoint( SpatialPartitionListMask_t listMask, Voxel_t v, const Vector& pt, IPartitionEnumerator* pIterator );
+
+	// Bulk version of EnumerateElementsInBox, returns false once the list is full
+	bool GetElementsInBox( SpatialPartitionListMask_t listMask, Voxel_t vmin, Voxel_t vmax, CIntersectBoxBatch &batch );
 	
 	// Inserts/Removes a handle from the tree.
 	void InsertIntoTree( SpatialPartitionHandle_t hPartition, Voxel_t voxelMin, Voxel_t voxelMax );
@@ -225,6 +330,9 @@ public:
 	template <class T> bool EnumerateElementsInSingleVoxel( Voxel_t voxel, const T &intersectTest, SpatialPartitionListMask_t listMask, IPartitionEnumerator* pIterator );
 
 	bool EnumerateElementsAlongRay_ExtrudedRaySlice( SpatialPartitionListMask_t listMask, IPartitionEnumerator *pIterator, const CIntersectSweptBox &intersectSweptBox,	int voxelMin[3], int voxelMax[3], int iAxis, int *pStep );
+
+	// Adds the candidates of one voxel to the batch
+	bool GetElementsInVoxel( Voxel_t voxel, SpatialPartitionListMask_t listMask, bool bCheckVisit, CIntersectBoxBatch &batch );
 private:
 	bool EnumerateElementsAlongRay_Ray( SpatialPartitionListMask_t listMask, const Ray_t &ray, const Vector &vecInvDelta, const Vector &vecEnd, IPartitionEnumerator* pIterator );
 	bool EnumerateElementsAlongRay_ExtrudedRay( SpatialPartitionListMask_t listMask, const Ray_t &ray, const Vector &vecInvDelta, const Vector &vecEnd, IPartitionEnumerator* pIterator );
@@ -264,6 +372,7 @@ public:
 	virtual void EnumerateElementsInSphere( SpatialPartitionListMask_t listMask, const Vector& origin, float radius, bool coarseTest, IPartitionEnumerator* pIterator );
 	virtual void EnumerateElementsAlongRay( SpatialPartitionListMask_t listMask, const Ray_t& ray, bool coarseTest, IPartitionEnumerator* pIterator );
 	virtual void EnumerateElementsAtPoint( SpatialPartitionListMask_t listMask, const Vector& pt, bool coarseTest, IPartitionEnumerator* pIterator );
+	int GetElementsInBox( SpatialPartitionListMask_t listMask, const Vector& mins, const Vector& maxs, IHandleEntity **pList, int nMaxCount );
 
 	virtual void RenderAllObjectsInTree( float flTime );
 	virtual void RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const Vector &vecPlayerMax, float flTime );
@@ -290,11 +399,14 @@ public:
 	void RemoveFromTree( SpatialPartitionHandle_t hPartition );
 	void UpdateListMask( SpatialPartitionHandle_t hPartition );
 
-	void LockForWrite()		{ m_lock.LockForWrite(); }
-	void UnlockWrite()		{ m_lock.UnlockWrite(); }
+	// Readers only write to their own PartitionReader_t, a writer waits until
+	// no other thread holds a read lock. Read locks this thread holds are
+	// suspended while it writes, LockForWrite returns them for UnlockWrite.
+	int LockForWrite();
+	void UnlockWrite( int nSuspendedReads );
 
-	void LockForRead()		{ m_lock.LockForRead(); }
-	void UnlockRead()		{ m_lock.UnlockRead(); }
+	void LockForRead();
+	void UnlockRead();
 
 	// Ray casting
 	bool EnumerateElementsAlongRay_Ray( SpatialPartitionListMask_t listMask, const Ray_t &ray, const Vector &vecInvDelta, const Vector &vecEnd, IPartitionEnumerator *pIterator );
@@ -312,12 +424,50 @@ private:
 	CVoxelHash*							m_pVoxelHash;
 	CLeafList							m_aLeafList;								// Pool - Linked list(multilist) of leaves per entity.
 	int									m_TreeId;
-	CPartitionVisits *                  m_pVisits[MAX_THREADS_SUPPORTED];
+	PartitionReader_t					m_Readers[MAX_THREADS_SUPPORTED];
+	CUtlVector<CPartitionVisits *>		m_VisitStack[MAX_THREADS_SUPPORTED];	// per nesting depth, reused
 	CSpatialPartition *					m_pOwner;
 	CUtlVector<unsigned short>			m_AvailableVisitBits;
 	unsigned short						m_nNextVisitBit;
-	CTSPool<CPartitionVisits>			m_FreeVisits;
-	CThreadSpinRWLock					m_lock;
+	int32 volatile						m_nWriting;
+	CThreadFastMutex					m_WriteMutex;
+};
+
+//-----------------------------------------------------------------------------
+// Coarse grid of columns holding only the server triggers. Queries for triggers
+// alone go here instead of walking every solid entity in the voxels they touch.
+//-----------------------------------------------------------------------------
+#define TRIGGERGRID_CELL_SHIFT		9			// 512 unit columns
+#define TRIGGERGRID_CELL_COUNT		( (int)( MAX_COORD_FLOAT - MIN_COORD_FLOAT ) >> TRIGGERGRID_CELL_SHIFT )
+#define TRIGGERGRID_MAX_CELLS		64			// bigger triggers are tested by every query
+
+#define TRIGGERGRID_NOT_LINKED		-1
+#define TRIGGERGRID_LARGE			-2
+
+class CTriggerGrid
+{
+public:
+	void Init( CSpatialPartition *pOwner );
+	void Shutdown( void );
+
+	// Links or relinks an element after its lists, bounds or tree membership changed
+	void Update( SpatialPartitionHandle_t hPartition );
+
+	void EnumerateElementsInBox( const Vector& mins, const Vector& maxs, IPartitionEnumerator* pIterator );
+	void EnumerateElementsAlongRay( const Ray_t& ray, IPartitionEnumerator* pIterator );
+
+private:
+	template <class T> void EnumerateElements( const Vector &vecMin, const Vector &vecMax, const T &intersectTest, IPartitionEnumerator* pIterator );
+
+	static int CellFromCoord( float flCoord );
+	void ComputeCells( const Vector &vecMin, const Vector &vecMax, short *pCells );
+	void Link( SpatialPartitionHandle_t hPartition, const short *pCells );
+	void Unlink( SpatialPartitionHandle_t hPartition, const short *pCells );
+
+	CSpatialPartition						*m_pOwner;
+	CUtlVector<SpatialPartitionHandle_t>	m_Cells[TRIGGERGRID_CELL_COUNT * TRIGGERGRID_CELL_COUNT];
+	CUtlVector<SpatialPartitionHandle_t>	m_LargeElements;
+	CThreadSpinRWLock						m_lock;
 };
 
 //-----------------------------------------------------------------------------
@@ -376,6 +526,8 @@ public:
 	virtual void EnumerateElementsInSphere( SpatialPartitionListMask_t listMask, const Vector& origin, float radius, bool coarseTest, IPartitionEnumerator* pIterator );
 	virtual void EnumerateElementsAlongRay( SpatialPartitionListMask_t listMask, const Ray_t& ray, bool coarseTest, IPartitionEnumerator* pIterator );
 	virtual void EnumerateElementsAtPoint( SpatialPartitionListMask_t listMask, const Vector& pt, bool coarseTest, IPartitionEnumerator* pIterator );
+	virtual int GetElementsInBox( SpatialPartitionListMask_t listMask, const Vector& mins, const Vector& maxs, IHandleEntity **pList, int nMaxCount );
+	virtual int GetElementsInSphere( SpatialPartitionListMask_t listMask, const Vector& origin, float radius, IHandleEntity **pList, int nMaxCount );
 
 	virtual void RenderAllObjectsInTree( float flTime );
 	virtual void RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const Vector &vecPlayerMax, float flTime );
@@ -403,6 +555,7 @@ private:
 	CThreadFastMutex										m_HandlesMutex;
 
 	CVoxelTree												m_VoxelTrees[NUM_TREES];
+	CTriggerGrid											m_TriggerGrid;
 
 	IPartitionQueryCallback									*m_pQueryCallback[MAX_QUERY_CALLBACK];		// Query callbacks.
 	int														m_nQueryCallbackCount;						// Number of query callbacks.
@@ -438,31 +591,64 @@ inline int CVoxelTree::GetTreeId() const
 inline CPartitionVisits *CVoxelTree::GetVisits()
 {
 	int nThread = g_nThreadID;
-	return m_pVisits[nThread];
+	return m_Readers[nThread].m_pVisits;
 }
 
 inline CPartitionVisits *CVoxelTree::BeginVisit()
 {
 	int nThread = g_nThreadID;
-	CPartitionVisits *pPrev = m_pVisits[nThread];
-	CPartitionVisits *pVisits = m_FreeVisits.GetObject();
-	if ( pVisits->GetNumBits() < m_nNextVisitBit )
-	{
-		pVisits->Resize( m_nNextVisitBit, true );
-	}
-	else
+	PartitionReader_t &reader = m_Readers[nThread];
+	CUtlVector<CPartitionVisits *> &visitStack = m_VisitStack[nThread];
+	if ( reader.m_nDepth == visitStack.Count() )
 	{
-		pVisits->ClearAll();
+		MEM_ALLOC_CREDIT();
+		visitStack.AddToTail( new CPartitionVisits );
 	}
-	m_pVisits[g_nThreadID] = pVisits;
+
+	CPartitionVisits *pPrev = reader.m_pVisits;
+	CPartitionVisits *pVisits = visitStack[reader.m_nDepth++];
+	pVisits->Begin( m_nNextVisitBit );
+	reader.m_pVisits = pVisits;
 	return pPrev;
 }
 
 inline void CVoxelTree::EndVisit( CPartitionVisits *pPrev )
 {
-	int nThread = g_nThreadID;
-	m_FreeVisits.PutObject( m_pVisits[nThread] );
-	m_pVisits[nThread] = pPrev;
+	PartitionReader_t &reader = m_Readers[g_nThreadID];
+	--reader.m_nDepth;
+	reader.m_pVisits = pPrev;
+}
+
+inline void CVoxelTree::LockForRead()
+{
+	PartitionReader_t &reader = m_Readers[g_nThreadID];
+
+	// Nested in a query on this thread, a writer is already waiting for us
+	if ( reader.m_nReadCount )
+	{
+		++reader.m_nReadCount;
+		return;
+	}
+
+	for ( ;; )
+	{
+		// The interlocked store orders against the writer's check of the count
+		ThreadInterlockedExchange( &reader.m_nReadCount, 1 );
+		if ( !m_nWriting )
+			return;
+
+		ThreadInterlockedExchange( &reader.m_nReadCount, 0 );
+		while ( m_nWriting )
+		{
+			ThreadPause();
+		}
+	}
+}
+
+inline void CVoxelTree::UnlockRead()
+{
+	Assert( m_Readers[g_nThreadID].m_nReadCount > 0 );
+	ThreadInterlockedDecrement( &m_Readers[g_nThreadID].m_nReadCount );
 }
 
 inline CVoxelTree *CSpatialPartition::VoxelTree( SpatialPartitionListMask_t listMask )
@@ -972,14 +1158,7 @@ public:
 
 	bool Visit( SpatialPartitionHandle_t hPartition, EntityInfo_t &hInfo ) const
 	{
-		int nVisitBit = hInfo.m_nVisitBit[m_iTree];
-		if ( m_pVisits->IsBitSet( nVisitBit ) )
-		{
-			return false;
-		}
-
-		m_pVisits->Set( nVisitBit );
-		return true;
+		return m_pVisits->Visit( hInfo.m_nVisitBit[m_iTree] );
 	}
 
 private:
@@ -1096,6 +1275,82 @@ private:
 	fltx4 m_f4Extents;
 };
 
+//-----------------------------------------------------------------------------
+// Box test for the bulk queries. Candidates are queued with their bounds
+// transposed so four of them are tested against the box at once, the ones
+// that pass are written to the caller's list in the order they were added.
+//-----------------------------------------------------------------------------
+class CIntersectBoxBatch : public CPartitionVisitor
+{
+public:
+	CIntersectBoxBatch( CVoxelTree *pPartition, const Vector &vecMins, const Vector &vecMaxs, IHandleEntity **pList, int nMaxCount ) : 
+		CPartitionVisitor( pPartition ), m_pList( pList ), m_nMaxCount( nMaxCount ), m_nCount( 0 ), m_nQueued( 0 )
+	{
+		for ( int i = 0; i < 3; ++i )
+		{
+			m_f4BoxMins[i] = ReplicateX4( vecMins[i] );
+			m_f4BoxMaxs[i] = ReplicateX4( vecMaxs[i] );
+		}
+	}
+
+	// Returns false once the list is full
+	bool Add( const EntityInfo_t &info )
+	{
+		Vector vecMin, vecMax;
+		GetElementBounds( info, vecMin, vecMax );
+		Assert( vecMin.x <= vecMax.x );
+		Assert( vecMin.y <= vecMax.y );
+		Assert( vecMin.z <= vecMax.z );
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			m_flMins[i][m_nQueued] = vecMin[i];
+			m_flMaxs[i][m_nQueued] = vecMax[i];
+		}
+		m_pQueued[m_nQueued++] = info.m_pHandleEntity;
+
+		if ( m_nQueued == 4 )
+		{
+			Flush();
+		}
+		return ( m_nCount < m_nMaxCount );
+	}
+
+	void Flush()
+	{
+		if ( !m_nQueued )
+			return;
+
+		fltx4 f4Hit = AndSIMD( CmpLeSIMD( LoadAlignedSIMD( m_flMins[0] ), m_f4BoxMaxs[0] ), CmpGeSIMD( LoadAlignedSIMD( m_flMaxs[0] ), m_f4BoxMins[0] ) );
+		f4Hit = AndSIMD( f4Hit, AndSIMD( CmpLeSIMD( LoadAlignedSIMD( m_flMins[1] ), m_f4BoxMaxs[1] ), CmpGeSIMD( LoadAlignedSIMD( m_flMaxs[1] ), m_f4BoxMins[1] ) ) );
+		f4Hit = AndSIMD( f4Hit, AndSIMD( CmpLeSIMD( LoadAlignedSIMD( m_flMins[2] ), m_f4BoxMaxs[2] ), CmpGeSIMD( LoadAlignedSIMD( m_flMaxs[2] ), m_f4BoxMins[2] ) ) );
+
+		// Lanes past m_nQueued hold whatever was queued before
+		int nHitMask = TestSignSIMD( f4Hit );
+		for ( int i = 0; i < m_nQueued && m_nCount < m_nMaxCount; ++i )
+		{
+			if ( nHitMask & ( 1 << i ) )
+			{
+				m_pList[m_nCount++] = m_pQueued[i];
+			}
+		}
+		m_nQueued = 0;
+	}
+
+	int Count() const { return m_nCount; }
+
+private:
+	fltx4			m_f4BoxMins[3];
+	fltx4			m_f4BoxMaxs[3];
+	ALIGN16 float	m_flMins[3][4] ALIGN16_POST;
+	ALIGN16 float	m_flMaxs[3][4] ALIGN16_POST;
+	IHandleEntity	*m_pQueued[4];
+	IHandleEntity	**m_pList;
+	int				m_nMaxCount;
+	int				m_nCount;
+	int				m_nQueued;
+};
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
@@ -1129,7 +1384,9 @@ bool CVoxelHash::EnumerateElementsInVoxel( Voxel_t voxel, const T &intersectTest
 			continue;
 
 		// Intersection test
-		if ( !intersectTest.Intersects( hInfo.m_vecMin.Base(), hInfo.m_vecMax.Base() ) )
+		Vector vecMin, vecMax;
+		GetElementBounds( hInfo, vecMin, vecMax );
+		if ( !intersectTest.Intersects( vecMin.Base(), vecMax.Base() ) )
 			continue;
 
 		// Okay, this one is good...
@@ -1172,7 +1429,9 @@ bool CVoxelHash::EnumerateElementsInSingleVoxel( Voxel_t voxel, const T &interse
 				continue;
 
 			// Keep going if there's no collision
-			if ( !intersectTest.Intersects( hInfo.m_vecMin.Base(), hInfo.m_vecMax.Base() ) )
+			Vector vecMin, vecMax;
+			GetElementBounds( hInfo, vecMin, vecMax );
+			if ( !intersectTest.Intersects( vecMin.Base(), vecMax.Base() ) )
 				continue;
 
 			// Okay, this one is good...
@@ -1239,6 +1498,74 @@ bool CVoxelHash::EnumerateElementsInBox( SpatialPartitionListMask_t listMask,
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Same filtering as EnumerateElementsInVoxel, the box test is left to
+//			the batch
+//-----------------------------------------------------------------------------
+bool CVoxelHash::GetElementsInVoxel( Voxel_t voxel, SpatialPartitionListMask_t listMask, bool bCheckVisit, CIntersectBoxBatch &batch )
+{
+	UtlHashFixedHandle_t hHash = m_aVoxelHash.Find( voxel.uiVoxel );
+	if ( hHash == m_aVoxelHash.InvalidHandle() )
+		return true;
+
+	for ( intp i = m_aVoxelHash.Element( hHash ); i != m_aEntityList.InvalidIndex(); i = m_aEntityList.Next(i) )
+	{
+		SpatialPartitionHandle_t handle = m_aEntityList[i].m_handle;
+		if ( handle == PARTITION_INVALID_HANDLE )
+			continue;
+
+		if ( !( listMask & m_aEntityList[i].m_nListMask ) )
+			continue;
+
+		EntityInfo_t &hInfo = m_pTree->EntityInfo( handle );
+		if ( hInfo.m_flags & ENTITY_HIDDEN )
+			continue;
+
+		// Only one voxel per level means nothing can show up twice
+		if ( bCheckVisit && !batch.Visit( handle, hInfo ) )
+			continue;
+
+		if ( !batch.Add( hInfo ) )
+			return false;
+	}
+
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+bool CVoxelHash::GetElementsInBox( SpatialPartitionListMask_t listMask, Voxel_t vmin, Voxel_t vmax, CIntersectBoxBatch &batch )
+{
+	if ( vmin.uiVoxel == vmax.uiVoxel )
+		return GetElementsInVoxel( vmin, listMask, false, batch );
+
+	Voxel_t vdelta;
+	vdelta.uiVoxel = vmax.uiVoxel - vmin.uiVoxel;
+	int cx = vdelta.bitsVoxel.x;
+	int cy = vdelta.bitsVoxel.y;
+	int cz = vdelta.bitsVoxel.z;
+
+	Voxel_t voxel;
+	voxel.bitsVoxel.x = vmin.bitsVoxel.x;
+	for ( int iX = 0; iX <= cx; ++iX, ++voxel.bitsVoxel.x )
+	{
+		voxel.bitsVoxel.y = vmin.bitsVoxel.y;
+		for ( int iY = 0; iY <= cy; ++iY, ++voxel.bitsVoxel.y )
+		{
+			voxel.bitsVoxel.z = vmin.bitsVoxel.z;
+			for ( int iZ = 0; iZ <= cz; ++iZ, ++voxel.bitsVoxel.z )
+			{
+				if ( !GetElementsInVoxel( voxel, listMask, true, batch ) )
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
@@ -1623,7 +1950,9 @@ bool CVoxelHash::EnumerateElementsAtPoint( SpatialPartitionListMask_t listMask,
 				continue;
 
 			// Keep going if there's no collision
-			if ( !IsPointInBox( pt, hInfo.m_vecMin, hInfo.m_vecMax ) )
+			Vector vecMin, vecMax;
+			GetElementBounds( hInfo, vecMin, vecMax );
+			if ( !IsPointInBox( pt, vecMin, vecMax ) )
 				continue;
 
 			// Okay, this one is good...
@@ -1905,7 +2234,7 @@ void CVoxelHash::RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const V
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
 
-CVoxelTree::CVoxelTree() : m_pVoxelHash( NULL ), m_pOwner( NULL ), m_nNextVisitBit( 0 )
+CVoxelTree::CVoxelTree() : m_pVoxelHash( NULL ), m_pOwner( NULL ), m_nNextVisitBit( 0 ), m_nWriting( 0 )
 {
 	// Compute max number of levels
 	m_nLevelCount = 0;
@@ -1929,6 +2258,50 @@ CVoxelTree::CVoxelTree() : m_pVoxelHash( NULL ), m_pOwner( NULL ), m_nNextVisitB
 CVoxelTree::~CVoxelTree()
 {
 	delete[] m_pVoxelHash;
+
+	for ( int i = 0; i < MAX_THREADS_SUPPORTED; ++i )
+	{
+		m_VisitStack[i].PurgeAndDeleteElements();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Waits until the other threads are out of the tree
+//-----------------------------------------------------------------------------
+int CVoxelTree::LockForWrite()
+{
+	// A query callback on this thread may move elements. Its read locks have
+	// to go, or a writer waiting for them would never get the lock we wait for.
+	PartitionReader_t &self = m_Readers[g_nThreadID];
+	int nSuspendedReads = self.m_nReadCount;
+	if ( nSuspendedReads )
+	{
+		ThreadInterlockedExchange( &self.m_nReadCount, 0 );
+	}
+
+	m_WriteMutex.Lock();
+	ThreadInterlockedExchange( &m_nWriting, 1 );
+	for ( int i = 0; i < MAX_THREADS_SUPPORTED; ++i )
+	{
+		while ( m_Readers[i].m_nReadCount )
+		{
+			ThreadPause();
+		}
+	}
+	return nSuspendedReads;
+}
+
+void CVoxelTree::UnlockWrite( int nSuspendedReads )
+{
+	ThreadInterlockedExchange( &m_nWriting, 0 );
+	m_WriteMutex.Unlock();
+
+	if ( nSuspendedReads )
+	{
+		LockForRead();
+		m_Readers[g_nThreadID].m_nReadCount = nSuspendedReads;
+	}
 }
 
 
@@ -1950,8 +2323,8 @@ void CVoxelTree::Init( CSpatialPartition *pOwner, int iTree, const Vector &world
 	m_pOwner = pOwner;
 	m_TreeId = iTree;
 
-	// Reset the enumeration id.
-	memset( m_pVisits, 0, sizeof( m_pVisits ) );
+	// Reset the per thread query state.
+	memset( m_Readers, 0, sizeof( m_Readers ) );
 
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
@@ -2022,39 +2395,34 @@ void CVoxelTree::InsertIntoTree( SpatialPartitionHandle_t hPartition, const Vect
 			RemoveFromTree( hPartition );
 		}
 	}
-	// Set/update the entity bounding box.
-	info.m_vecMin = vecMin;
-	info.m_vecMax = vecMax;
 
-	if ( bDoInsert )
+	if ( !bDoInsert )
 	{
-		bool bWasReading = ( m_pVisits[g_nThreadID] != NULL );
-		if ( bWasReading )
-		{
-			// If we're recursing in this thread, need to release our read lock to allow ourselves to write
-			UnlockRead();
-		}
-		m_lock.LockForWrite();
+		// Same voxels, so only the bounds change. Readers on other threads
+		// pick them up through the bounds version, no need to wait them out.
+		SetElementBounds( info, vecMin, vecMax );
+		return;
+	}
 
-		// if these have changed we need to insert
-		info.m_voxelMin = voxelMin;
-		info.m_voxelMax = voxelMax;
-		if ( m_AvailableVisitBits.Count() )
-		{
-			info.m_nVisitBit[m_TreeId] = m_AvailableVisitBits.Tail();
-			m_AvailableVisitBits.Remove( m_AvailableVisitBits.Count() - 1 );
-		}
-		else
-		{
-			info.m_nVisitBit[m_TreeId] = m_nNextVisitBit++;
-		}
-		m_pVoxelHash[nLevel].InsertIntoTree( hPartition, voxelMin, voxelMax );
-		m_lock.UnlockWrite();
-		if ( bWasReading )
-		{
-			LockForRead();
-		}
+	int nSuspendedReads = LockForWrite();
+
+	SetElementBounds( info, vecMin, vecMax );
+
+	// if these have changed we need to insert
+	info.m_voxelMin = voxelMin;
+	info.m_voxelMax = voxelMax;
+	if ( m_AvailableVisitBits.Count() )
+	{
+		info.m_nVisitBit[m_TreeId] = m_AvailableVisitBits.Tail();
+		m_AvailableVisitBits.Remove( m_AvailableVisitBits.Count() - 1 );
+	}
+	else
+	{
+		info.m_nVisitBit[m_TreeId] = m_nNextVisitBit++;
 	}
+	m_pVoxelHash[nLevel].InsertIntoTree( hPartition, voxelMin, voxelMax );
+
+	UnlockWrite( nSuspendedReads );
 }
 
 
@@ -2068,23 +2436,11 @@ void CVoxelTree::RemoveFromTree( SpatialPartitionHandle_t hPartition )
 	int nLevel = info.m_nLevel[GetTreeId()];
 	if ( nLevel >= 0 )
 	{
-		bool bWasReading = ( m_pVisits[g_nThreadID] != NULL );
-		if ( bWasReading )
-		{
-			// If we're recursing in this thread, need to release our read lock to allow ourselves to write
-			UnlockRead();
-		}
-
-		m_lock.LockForWrite();
+		int nSuspendedReads = LockForWrite();
 		m_pVoxelHash[nLevel].RemoveFromTree( hPartition );
 		m_AvailableVisitBits.AddToTail( info.m_nVisitBit[m_TreeId] );
 		info.m_nVisitBit[m_TreeId] = (unsigned short)-1;
-		m_lock.UnlockWrite();
-
-		if ( bWasReading )
-		{
-			LockForRead();
-		}
+		UnlockWrite( nSuspendedReads );
 	}
 }
 
@@ -2094,9 +2450,9 @@ void CVoxelTree::UpdateListMask( SpatialPartitionHandle_t hPartition )
 	int nLevel = info.m_nLevel[GetTreeId()];
 	if ( nLevel >= 0 )
 	{
-		m_lock.LockForRead();
+		LockForRead();
 		m_pVoxelHash[nLevel].UpdateListMask( hPartition );
-		m_lock.UnlockRead();
+		UnlockRead();
 	}
 }
 
@@ -2149,12 +2505,12 @@ void CVoxelTree::EnumerateElementsInBox( SpatialPartitionListMask_t listMask,
 	// Callbacks.
 	CPartitionVisits *pPrevVisits = BeginVisit();
 
-	m_lock.LockForRead();
+	LockForRead();
 	Voxel_t vs = m_pVoxelHash[0].VoxelIndexFromPoint( mins );
 	Voxel_t ve = m_pVoxelHash[0].VoxelIndexFromPoint( maxs );
 	if ( !m_pVoxelHash[0].EnumerateElementsInBox( listMask, vs, ve, mins, maxs, pIterator ) )
 	{
-		m_lock.UnlockRead();
+		UnlockRead();
 		EndVisit( pPrevVisits );
 		return;
 	}
@@ -2163,7 +2519,7 @@ void CVoxelTree::EnumerateElementsInBox( SpatialPartitionListMask_t listMask,
 	ve = ConvertToNextLevel( ve );
 	if ( !m_pVoxelHash[1].EnumerateElementsInBox( listMask, vs, ve, mins, maxs, pIterator ) )
 	{
-		m_lock.UnlockRead();
+		UnlockRead();
 		EndVisit( pPrevVisits );
 		return;
 	}
@@ -2172,7 +2528,7 @@ void CVoxelTree::EnumerateElementsInBox( SpatialPartitionListMask_t listMask,
 	ve = ConvertToNextLevel( ve );
 	if ( !m_pVoxelHash[2].EnumerateElementsInBox( listMask, vs, ve, mins, maxs, pIterator ) )
 	{
-		m_lock.UnlockRead();
+		UnlockRead();
 		EndVisit( pPrevVisits );
 		return;
 	}
@@ -2181,7 +2537,7 @@ void CVoxelTree::EnumerateElementsInBox( SpatialPartitionListMask_t listMask,
 	ve = ConvertToNextLevel( ve );
 	m_pVoxelHash[3].EnumerateElementsInBox( listMask, vs, ve, mins, maxs, pIterator );
 
-	m_lock.UnlockRead();
+	UnlockRead();
 	EndVisit( pPrevVisits );
 }
 
@@ -2203,30 +2559,73 @@ void CVoxelTree::EnumerateElementsInSphere( SpatialPartitionListMask_t listMask,
 
 
 //-----------------------------------------------------------------------------
-// Purpose:
+// Purpose: Walks the voxels like EnumerateElementsInBox, but collects into
+//			pList instead of calling an enumerator
 //-----------------------------------------------------------------------------
-bool CVoxelTree::EnumerateElementsAlongRay_Ray( SpatialPartitionListMask_t listMask, 
-											   const Ray_t &ray, const Vector &vecInvDelta, const Vector &vecEnd, IPartitionEnumerator *pIterator )
+int CVoxelTree::GetElementsInBox( SpatialPartitionListMask_t listMask, const Vector& vecMins, const Vector& vecMaxs, IHandleEntity **pList, int nMaxCount )
 {
-	// Find the voxel start + end
-	Voxel_t voxelStart = m_pVoxelHash[0].VoxelIndexFromPoint( ray.m_Start );
-	Voxel_t voxelEnd = m_pVoxelHash[0].VoxelIndexFromPoint( vecEnd );
+	VPROF( "BoxTest/SphereTest" );
 
-	bool bSingleVoxel = ( voxelStart.uiVoxel == voxelEnd.uiVoxel );
-	CIntersectRay intersectRay( this, ray, vecInvDelta );
+	if ( listMask == 0 || nMaxCount <= 0 )
+		return 0;
 
-	// Optimization: Look for single voxel rays
-	if ( bSingleVoxel )
-	{
-		if ( !m_pVoxelHash[0].EnumerateElementsInSingleVoxel( voxelStart, intersectRay, listMask, pIterator ) )
-			return false;
-		voxelStart = ConvertToNextLevel( voxelStart );
-		if ( !m_pVoxelHash[1].EnumerateElementsInSingleVoxel( voxelStart, intersectRay, listMask, pIterator ) )
-			return false;
-		voxelStart = ConvertToNextLevel( voxelStart );
-		if ( !m_pVoxelHash[2].EnumerateElementsInSingleVoxel( voxelStart, intersectRay, listMask, pIterator ) )
-			return false;
-		voxelStart = ConvertToNextLevel( voxelStart );
+	// Clamp bounds to extant space
+	Vector mins, maxs;
+	VectorMax( vecMins, s_PartitionMin, mins );
+	VectorMin( mins, s_PartitionMax, mins );
+
+	VectorMax( vecMaxs, s_PartitionMin, maxs );
+	VectorMin( maxs, s_PartitionMax, maxs );
+
+	CPartitionVisits *pPrevVisits = BeginVisit();
+	CIntersectBoxBatch batch( this, mins, maxs, pList, nMaxCount );
+
+	LockForRead();
+	Voxel_t vs = m_pVoxelHash[0].VoxelIndexFromPoint( mins );
+	Voxel_t ve = m_pVoxelHash[0].VoxelIndexFromPoint( maxs );
+	for ( int i = 0; i < m_nLevelCount; ++i )
+	{
+		if ( i != 0 )
+		{
+			vs = ConvertToNextLevel( vs );
+			ve = ConvertToNextLevel( ve );
+		}
+		if ( !m_pVoxelHash[i].GetElementsInBox( listMask, vs, ve, batch ) )
+			break;
+	}
+	batch.Flush();
+	UnlockRead();
+
+	EndVisit( pPrevVisits );
+	return batch.Count();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+bool CVoxelTree::EnumerateElementsAlongRay_Ray( SpatialPartitionListMask_t listMask, 
+											   const Ray_t &ray, const Vector &vecInvDelta, const Vector &vecEnd, IPartitionEnumerator *pIterator )
+{
+	// Find the voxel start + end
+	Voxel_t voxelStart = m_pVoxelHash[0].VoxelIndexFromPoint( ray.m_Start );
+	Voxel_t voxelEnd = m_pVoxelHash[0].VoxelIndexFromPoint( vecEnd );
+
+	bool bSingleVoxel = ( voxelStart.uiVoxel == voxelEnd.uiVoxel );
+	CIntersectRay intersectRay( this, ray, vecInvDelta );
+
+	// Optimization: Look for single voxel rays
+	if ( bSingleVoxel )
+	{
+		if ( !m_pVoxelHash[0].EnumerateElementsInSingleVoxel( voxelStart, intersectRay, listMask, pIterator ) )
+			return false;
+		voxelStart = ConvertToNextLevel( voxelStart );
+		if ( !m_pVoxelHash[1].EnumerateElementsInSingleVoxel( voxelStart, intersectRay, listMask, pIterator ) )
+			return false;
+		voxelStart = ConvertToNextLevel( voxelStart );
+		if ( !m_pVoxelHash[2].EnumerateElementsInSingleVoxel( voxelStart, intersectRay, listMask, pIterator ) )
+			return false;
+		voxelStart = ConvertToNextLevel( voxelStart );
 		return m_pVoxelHash[3].EnumerateElementsInSingleVoxel( voxelStart, intersectRay, listMask, pIterator );
 	}
 
@@ -2594,7 +2993,7 @@ void CVoxelTree::EnumerateElementsAlongRay( SpatialPartitionListMask_t listMask,
 
 	CPartitionVisits *pPrevVisits = BeginVisit();
 
-	m_lock.LockForRead();
+	LockForRead();
 	if ( ray.m_IsRay )
 	{
 		EnumerateElementsAlongRay_Ray( listMask, clippedRay, vecInvDelta, vecEnd, pIterator );
@@ -2604,7 +3003,7 @@ void CVoxelTree::EnumerateElementsAlongRay( SpatialPartitionListMask_t listMask,
 		EnumerateElementsAlongRay_ExtrudedRay( listMask, clippedRay, vecInvDelta, vecEnd, pIterator );
 	}
 
-	m_lock.UnlockRead();
+	UnlockRead();
 	EndVisit( pPrevVisits );
 }
 
@@ -2622,32 +3021,32 @@ void CVoxelTree::EnumerateElementsAtPoint( SpatialPartitionListMask_t listMask,
 	if ( listMask == 0 )
 		return;
 
-	m_lock.LockForRead();
+	LockForRead();
 	// Callbacks.
 	Voxel_t v = m_pVoxelHash[0].VoxelIndexFromPoint( pt );
 	if ( !m_pVoxelHash[0].EnumerateElementsAtPoint( listMask, v, pt, pIterator ) )
 	{
-		m_lock.UnlockRead();
+		UnlockRead();
 		return;
 	}
 
 	v = ConvertToNextLevel( v );
 	if ( !m_pVoxelHash[1].EnumerateElementsAtPoint( listMask, v, pt, pIterator ) )
 	{
-		m_lock.UnlockRead();
+		UnlockRead();
 		return;
 	}
 
 	v = ConvertToNextLevel( v );
 	if ( !m_pVoxelHash[2].EnumerateElementsAtPoint( listMask, v, pt, pIterator ) )
 	{
-		m_lock.UnlockRead();
+		UnlockRead();
 		return;
 	}
 
 	v = ConvertToNextLevel( v );
 	m_pVoxelHash[3].EnumerateElementsAtPoint( listMask, v, pt, pIterator );
-	m_lock.UnlockRead();
+	UnlockRead();
 }
 
 
@@ -2657,12 +3056,12 @@ void CVoxelTree::EnumerateElementsAtPoint( SpatialPartitionListMask_t listMask,
 void CVoxelTree::RenderAllObjectsInTree( float flTime )
 {
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
-	m_lock.LockForRead();
+	LockForRead();
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
 		m_pVoxelHash[i].RenderAllObjectsInTree( flTime );
 	}
-	m_lock.UnlockRead();
+	UnlockRead();
 }
 
 
@@ -2673,12 +3072,259 @@ void CVoxelTree::RenderAllObjectsInTree( float flTime )
 void CVoxelTree::RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const Vector &vecPlayerMax, float flTime )
 {
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
-	m_lock.LockForRead();
+	LockForRead();
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
 		m_pVoxelHash[i].RenderObjectsInPlayerLeafs( vecPlayerMin, vecPlayerMax, flTime );
 	}
+	UnlockRead();
+}
+
+
+//-----------------------------------------------------------------------------
+// Trigger grid intersection tests, same as CIntersectBox and CIntersectSweptBox
+// without the visit bits
+//-----------------------------------------------------------------------------
+class CTriggerGridBoxTest
+{
+public:
+	CTriggerGridBoxTest( const Vector &vecMins, const Vector &vecMaxs ) : m_vecMins( vecMins ), m_vecMaxs( vecMaxs )
+	{
+	}
+
+	bool Intersects( const float *pMins, const float *pMaxs ) const
+	{
+		return ( pMins[0] <= m_vecMaxs.x ) && ( pMaxs[0] >= m_vecMins.x ) &&
+				( pMins[1] <= m_vecMaxs.y ) && ( pMaxs[1] >= m_vecMins.y ) &&
+				( pMins[2] <= m_vecMaxs.z ) && ( pMaxs[2] >= m_vecMins.z );
+	}
+
+private:
+	const Vector &m_vecMins;
+	const Vector &m_vecMaxs;
+};
+
+class CTriggerGridSweptBoxTest
+{
+public:
+	CTriggerGridSweptBoxTest( const Ray_t &ray )
+	{
+		Vector vecInvDelta;
+		vecInvDelta[0] = ( ray.m_Delta[0] != 0.0f ) ? 1.0f / ray.m_Delta[0] : FLT_MAX;
+		vecInvDelta[1] = ( ray.m_Delta[1] != 0.0f ) ? 1.0f / ray.m_Delta[1] : FLT_MAX;
+		vecInvDelta[2] = ( ray.m_Delta[2] != 0.0f ) ? 1.0f / ray.m_Delta[2] : FLT_MAX;
+
+		m_f4Start = LoadAlignedSIMD( ray.m_Start.Base() );
+		m_f4Delta = LoadAlignedSIMD( ray.m_Delta.Base() );
+		m_f4Extents = LoadAlignedSIMD( ray.m_Extents.Base() );
+		m_f4InvDelta = LoadUnaligned3SIMD( vecInvDelta.Base() );
+	}
+
+	bool Intersects( const float *pMins, const float *pMaxs ) const
+	{
+		fltx4 f4Mins = LoadUnaligned3SIMD( pMins );
+		fltx4 f4Maxs = LoadUnaligned3SIMD( pMaxs );
+		return IsBoxIntersectingRay( SubSIMD(f4Mins, m_f4Extents), AddSIMD(f4Maxs, m_f4Extents), m_f4Start, m_f4Delta, m_f4InvDelta );
+	}
+
+private:
+	fltx4 m_f4Start;
+	fltx4 m_f4Delta;
+	fltx4 m_f4InvDelta;
+	fltx4 m_f4Extents;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void CTriggerGrid::Init( CSpatialPartition *pOwner )
+{
+	Shutdown();
+	m_pOwner = pOwner;
+}
+
+void CTriggerGrid::Shutdown( void )
+{
+	for ( int i = 0; i < ARRAYSIZE( m_Cells ); ++i )
+	{
+		m_Cells[i].Purge();
+	}
+	m_LargeElements.Purge();
+}
+
+inline int CTriggerGrid::CellFromCoord( float flCoord )
+{
+	int nCell = (int)( clamp( flCoord, MIN_COORD_FLOAT, MAX_COORD_FLOAT ) - MIN_COORD_FLOAT ) >> TRIGGERGRID_CELL_SHIFT;
+	return MIN( nCell, TRIGGERGRID_CELL_COUNT - 1 );
+}
+
+void CTriggerGrid::ComputeCells( const Vector &vecMin, const Vector &vecMax, short *pCells )
+{
+	pCells[0] = CellFromCoord( vecMin.x );
+	pCells[1] = CellFromCoord( vecMin.y );
+	pCells[2] = CellFromCoord( vecMax.x );
+	pCells[3] = CellFromCoord( vecMax.y );
+
+	if ( ( pCells[2] - pCells[0] + 1 ) * ( pCells[3] - pCells[1] + 1 ) > TRIGGERGRID_MAX_CELLS )
+	{
+		pCells[0] = pCells[1] = pCells[2] = pCells[3] = TRIGGERGRID_LARGE;
+	}
+}
+
+void CTriggerGrid::Link( SpatialPartitionHandle_t hPartition, const short *pCells )
+{
+	if ( pCells[0] == TRIGGERGRID_NOT_LINKED )
+		return;
+
+	if ( pCells[0] == TRIGGERGRID_LARGE )
+	{
+		m_LargeElements.AddToTail( hPartition );
+		return;
+	}
+
+	for ( int y = pCells[1]; y <= pCells[3]; ++y )
+	{
+		for ( int x = pCells[0]; x <= pCells[2]; ++x )
+		{
+			m_Cells[y * TRIGGERGRID_CELL_COUNT + x].AddToTail( hPartition );
+		}
+	}
+}
+
+void CTriggerGrid::Unlink( SpatialPartitionHandle_t hPartition, const short *pCells )
+{
+	if ( pCells[0] == TRIGGERGRID_NOT_LINKED )
+		return;
+
+	if ( pCells[0] == TRIGGERGRID_LARGE )
+	{
+		m_LargeElements.FindAndFastRemove( hPartition );
+		return;
+	}
+
+	for ( int y = pCells[1]; y <= pCells[3]; ++y )
+	{
+		for ( int x = pCells[0]; x <= pCells[2]; ++x )
+		{
+			m_Cells[y * TRIGGERGRID_CELL_COUNT + x].FindAndFastRemove( hPartition );
+		}
+	}
+}
+
+void CTriggerGrid::Update( SpatialPartitionHandle_t hPartition )
+{
+	EntityInfo_t &info = m_pOwner->EntityInfo( hPartition );
+
+	// Only triggers that have bounds in the server tree are linked
+	short nCells[4] = { TRIGGERGRID_NOT_LINKED, TRIGGERGRID_NOT_LINKED, TRIGGERGRID_NOT_LINKED, TRIGGERGRID_NOT_LINKED };
+	if ( ( info.m_fList & PARTITION_ENGINE_TRIGGER_EDICTS ) && ( info.m_flags & IN_SERVER_TREE ) )
+	{
+		ComputeCells( info.m_vecMin, info.m_vecMax, nCells );
+	}
+
+	if ( !memcmp( nCells, info.m_nTriggerCells, sizeof( nCells ) ) )
+		return;
+
+	m_lock.LockForWrite();
+	Unlink( hPartition, info.m_nTriggerCells );
+	Link( hPartition, nCells );
+	memcpy( info.m_nTriggerCells, nCells, sizeof( nCells ) );
+	m_lock.UnlockWrite();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Tests the triggers in the columns overlapping the bounds, then hands
+//			the ones that pass to the enumerator outside of the lock, so it may
+//			move things around.
+//-----------------------------------------------------------------------------
+template <class T> 
+void CTriggerGrid::EnumerateElements( const Vector &vecMin, const Vector &vecMax, const T &intersectTest, IPartitionEnumerator* pIterator )
+{
+	CUtlVectorFixedGrowable< IHandleEntity *, 64 > elements;
+
+	int x0 = CellFromCoord( vecMin.x );
+	int y0 = CellFromCoord( vecMin.y );
+	int x1 = CellFromCoord( vecMax.x );
+	int y1 = CellFromCoord( vecMax.y );
+
+	m_lock.LockForRead();
+
+	for ( int i = 0; i < m_LargeElements.Count(); ++i )
+	{
+		EntityInfo_t &info = m_pOwner->EntityInfo( m_LargeElements[i] );
+		if ( info.m_flags & ENTITY_HIDDEN )
+			continue;
+
+		Vector vecElementMin, vecElementMax;
+		GetElementBounds( info, vecElementMin, vecElementMax );
+		if ( intersectTest.Intersects( vecElementMin.Base(), vecElementMax.Base() ) )
+		{
+			elements.AddToTail( info.m_pHandleEntity );
+		}
+	}
+
+	for ( int y = y0; y <= y1; ++y )
+	{
+		for ( int x = x0; x <= x1; ++x )
+		{
+			const CUtlVector<SpatialPartitionHandle_t> &cell = m_Cells[y * TRIGGERGRID_CELL_COUNT + x];
+			for ( int i = 0; i < cell.Count(); ++i )
+			{
+				EntityInfo_t &info = m_pOwner->EntityInfo( cell[i] );
+
+				// A trigger spanning several columns is only looked at in the first column it shares with the query
+				if ( MAX( info.m_nTriggerCells[0], x0 ) != x || MAX( info.m_nTriggerCells[1], y0 ) != y )
+					continue;
+
+				if ( info.m_flags & ENTITY_HIDDEN )
+					continue;
+
+				Vector vecElementMin, vecElementMax;
+				GetElementBounds( info, vecElementMin, vecElementMax );
+				if ( intersectTest.Intersects( vecElementMin.Base(), vecElementMax.Base() ) )
+				{
+					elements.AddToTail( info.m_pHandleEntity );
+				}
+			}
+		}
+	}
+
 	m_lock.UnlockRead();
+
+	for ( int i = 0; i < elements.Count(); ++i )
+	{
+		if ( pIterator->EnumElement( elements[i] ) == ITERATION_STOP )
+			break;
+	}
+}
+
+void CTriggerGrid::EnumerateElementsInBox( const Vector& mins, const Vector& maxs, IPartitionEnumerator* pIterator )
+{
+	CTriggerGridBoxTest intersectBox( mins, maxs );
+	EnumerateElements( mins, maxs, intersectBox, pIterator );
+}
+
+void CTriggerGrid::EnumerateElementsAlongRay( const Ray_t& ray, IPartitionEnumerator* pIterator )
+{
+	Vector vecMin, vecMax;
+	if ( !ray.m_IsSwept )
+	{
+		VectorSubtract( ray.m_Start, ray.m_Extents, vecMin );
+		VectorAdd( ray.m_Start, ray.m_Extents, vecMax );
+		EnumerateElementsInBox( vecMin, vecMax, pIterator );
+		return;
+	}
+
+	Vector vecEnd;
+	VectorAdd( ray.m_Start, ray.m_Delta, vecEnd );
+	VectorMin( ray.m_Start, vecEnd, vecMin );
+	VectorMax( ray.m_Start, vecEnd, vecMax );
+	vecMin -= ray.m_Extents;
+	vecMax += ray.m_Extents;
+
+	CTriggerGridSweptBoxTest intersectSweptBox( ray );
+	EnumerateElements( vecMin, vecMax, intersectSweptBox, pIterator );
 }
 
 
@@ -2697,6 +3343,8 @@ ISpatialPartitionInternal *SpatialPartition()
 }
 
 
+static ConVar sv_partition_trigger_grid( "sv_partition_trigger_grid", "1", 0, "Look up triggers touched by moving entities in the trigger grid instead of the voxel tree." );
+
 //-----------------------------------------------------------------------------
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
@@ -2727,6 +3375,7 @@ void CSpatialPartition::Init( const Vector &worldmin, const Vector &worldmax )
 	{
 		m_VoxelTrees[i].Init( this, i, worldmin, worldmax );
 	}
+	m_TriggerGrid.Init( this );
 }
 
 //-----------------------------------------------------------------------------
@@ -2738,6 +3387,7 @@ void CSpatialPartition::Shutdown( void )
 	{
 		m_VoxelTrees[i].Shutdown();
 	}
+	m_TriggerGrid.Shutdown();
 	m_aHandles.Purge();
 }
 
@@ -2811,6 +3461,7 @@ SpatialPartitionHandle_t CSpatialPartition::CreateHandle( IHandleEntity *pHandle
 	m_aHandles[hPartition].m_pHandleEntity = pHandleEntity;
 	m_aHandles[hPartition].m_vecMin.Init( FLT_MAX, FLT_MAX, FLT_MAX );
 	m_aHandles[hPartition].m_vecMax.Init( FLT_MIN, FLT_MIN, FLT_MIN );
+	m_aHandles[hPartition].m_nBoundsVersion = 0;
 	m_aHandles[hPartition].m_fList = 0;
 	m_aHandles[hPartition].m_flags = 0;
 
@@ -2820,6 +3471,11 @@ SpatialPartitionHandle_t CSpatialPartition::CreateHandle( IHandleEntity *pHandle
 		m_aHandles[hPartition].m_nLevel[i] = (uint8)-1;
 		m_aHandles[hPartition].m_iLeafList[i] = CLeafList::InvalidIndex();
 	}
+
+	for ( int i = 0; i < 4; i++ )
+	{
+		m_aHandles[hPartition].m_nTriggerCells[i] = TRIGGERGRID_NOT_LINKED;
+	}
 	
 	return hPartition;
 }
@@ -2878,6 +3534,8 @@ void CSpatialPartition::UpdateListMask( SpatialPartitionHandle_t hPartition, uin
 		{
 			m_VoxelTrees[SERVER_TREE].UpdateListMask( hPartition ); 
 		}
+
+		m_TriggerGrid.Update( hPartition );
 	}
 }
 //-----------------------------------------------------------------------------
@@ -3011,6 +3669,8 @@ void CSpatialPartition::ElementMoved( SpatialPartitionHandle_t handle, const Vec
 		m_VoxelTrees[CLIENT_TREE].ElementMoved( handle, mins, maxs );
 		entityInfo.m_flags |= IN_CLIENT_TREE;
 	}
+
+	m_TriggerGrid.Update( handle );
 }
 
 //-----------------------------------------------------------------------------
@@ -3021,7 +3681,14 @@ void CSpatialPartition::EnumerateElementsInBox( SpatialPartitionListMask_t listM
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	CVoxelTree *pTree = VoxelTree( listMask );
 	InvokeQueryCallbacks( listMask );
-	pTree->EnumerateElementsInBox( listMask, mins, maxs, coarseTest, pIterator );
+	if ( listMask == PARTITION_ENGINE_TRIGGER_EDICTS && sv_partition_trigger_grid.GetBool() )
+	{
+		m_TriggerGrid.EnumerateElementsInBox( mins, maxs, pIterator );
+	}
+	else
+	{
+		pTree->EnumerateElementsInBox( listMask, mins, maxs, coarseTest, pIterator );
+	}
 	InvokeQueryCallbacks( listMask, true );
 }
 
@@ -3037,6 +3704,32 @@ void CSpatialPartition::EnumerateElementsInSphere( SpatialPartitionListMask_t li
 	InvokeQueryCallbacks( listMask, true );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+int CSpatialPartition::GetElementsInBox( SpatialPartitionListMask_t listMask, const Vector& mins, const Vector& maxs, IHandleEntity **pList, int nMaxCount )
+{
+	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
+	CVoxelTree *pTree = VoxelTree( listMask );
+	InvokeQueryCallbacks( listMask );
+	int nCount = pTree->GetElementsInBox( listMask, mins, maxs, pList, nMaxCount );
+	InvokeQueryCallbacks( listMask, true );
+	return nCount;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Like EnumerateElementsInSphere this is a test against the bounds
+//			of the sphere
+//-----------------------------------------------------------------------------
+int CSpatialPartition::GetElementsInSphere( SpatialPartitionListMask_t listMask, const Vector& origin, float radius, IHandleEntity **pList, int nMaxCount )
+{
+	Assert( radius <= MAX_COORD_FLOAT );
+
+	Vector vecMin( origin.x - radius, origin.y - radius, origin.z - radius );
+	Vector vecMax( origin.x + radius, origin.y + radius, origin.z + radius );
+	return GetElementsInBox( listMask, vecMin, vecMax, pList, nMaxCount );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
@@ -3045,7 +3738,14 @@ void CSpatialPartition::EnumerateElementsAlongRay( SpatialPartitionListMask_t li
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	CVoxelTree *pTree = VoxelTree( listMask );
 	InvokeQueryCallbacks( listMask );
-	pTree->EnumerateElementsAlongRay( listMask, ray, coarseTest, pIterator );
+	if ( listMask == PARTITION_ENGINE_TRIGGER_EDICTS && sv_partition_trigger_grid.GetBool() )
+	{
+		m_TriggerGrid.EnumerateElementsAlongRay( ray, pIterator );
+	}
+	else
+	{
+		pTree->EnumerateElementsAlongRay( listMask, ray, coarseTest, pIterator );
+	}
 	InvokeQueryCallbacks( listMask, true );
 }
 
@@ -3089,6 +3789,8 @@ void CSpatialPartition::InsertIntoTree( SpatialPartitionHandle_t hPartition, con
 		m_VoxelTrees[CLIENT_TREE].InsertIntoTree( hPartition, mins, maxs, false );
 		entityInfo.m_flags |= IN_CLIENT_TREE;
 	}
+
+	m_TriggerGrid.Update( hPartition );
 }
 
 //-----------------------------------------------------------------------------
@@ -3109,6 +3811,8 @@ void CSpatialPartition::RemoveFromTree( SpatialPartitionHandle_t hPartition )
 		m_VoxelTrees[SERVER_TREE].RemoveFromTree( hPartition ); 
 		entityInfo.m_flags &= ~IN_SERVER_TREE;
 	}
+
+	m_TriggerGrid.Update( hPartition );
 }
 
 //-----------------------------------------------------------------------------
@@ -3180,7 +3884,7 @@ void CVoxelTree::DrawDebugOverlays()
 	if ( nLevel < 0 )
 		return;
 
-	m_lock.LockForRead();
+	LockForRead();
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
 		if ( ( nLevel >= 0 ) && ( nLevel != i ) )
@@ -3189,7 +3893,7 @@ void CVoxelTree::DrawDebugOverlays()
 		m_pVoxelHash[i].RenderGrid();
 		m_pVoxelHash[i].RenderAllObjectsInTree( 0.01f );
 	}
-	m_lock.UnlockRead();
+	UnlockRead();
 }
 
 void CSpatialPartition::DrawDebugOverlays()
@@ -3213,3 +3917,196 @@ void DestroySpatialPartition( ISpatialPartition *pPartition )
 	Assert( pPartition != (ISpatialPartition*)&g_SpatialPartition );
 	delete pPartition;
 }
+
+
+//-----------------------------------------------------------------------------
+// Stress test for concurrent queries. Job threads query a private partition
+// while this thread keeps moving half of its elements. The other half never
+// moves, so every query has to report exactly the still elements touching its
+// box, plus any of the moving ones, and nothing twice.
+//-----------------------------------------------------------------------------
+#define PARTITION_STRESS_ELEMENTS	2048
+#define PARTITION_STRESS_EXTENT		4096.0f
+#define PARTITION_STRESS_QUERY_MAX	512
+
+class CPartitionStressElement : public IHandleEntity
+{
+public:
+	virtual void SetRefEHandle( const CBaseHandle &handle )	{ m_RefEHandle = handle; }
+	virtual const CBaseHandle& GetRefEHandle() const		{ return m_RefEHandle; }
+
+	CBaseHandle					m_RefEHandle;
+	SpatialPartitionHandle_t	m_hPartition;
+	Vector						m_vecMins;		// as bloated by the tree, still elements only
+	Vector						m_vecMaxs;
+	bool						m_bMoving;
+};
+
+struct PartitionStressTest_t
+{
+	ISpatialPartition			*m_pPartition;
+	CPartitionStressElement		*m_pElements;
+	bool volatile				m_bDone;
+	CInterlockedInt				m_nQueries;
+	CInterlockedInt				m_nErrors;
+};
+
+class CPartitionStressEnum : public IPartitionEnumerator
+{
+public:
+	CPartitionStressEnum( PartitionStressTest_t *pTest, CUniformRandomStream &random ) : m_pTest( pTest ), m_Random( random ), m_nCount( 0 )
+	{
+	}
+
+	virtual IterationRetval_t EnumElement( IHandleEntity *pHandleEntity )
+	{
+		if ( m_nCount < PARTITION_STRESS_QUERY_MAX )
+		{
+			m_pFound[m_nCount++] = pHandleEntity;
+		}
+
+		// Queries from inside a callback run nested on this thread
+		if ( m_Random.RandomInt( 0, 63 ) == 0 )
+		{
+			IHandleEntity *pNested[16];
+			Vector vecCenter = static_cast<CPartitionStressElement*>( pHandleEntity )->m_vecMins;
+			m_pTest->m_pPartition->GetElementsInBox( PARTITION_ENGINE_SOLID_EDICTS, vecCenter - Vector( 64, 64, 64 ), vecCenter + Vector( 64, 64, 64 ), pNested, ARRAYSIZE( pNested ) );
+		}
+		return ITERATION_CONTINUE;
+	}
+
+	PartitionStressTest_t	*m_pTest;
+	CUniformRandomStream	&m_Random;
+	IHandleEntity			*m_pFound[PARTITION_STRESS_QUERY_MAX];
+	int						m_nCount;
+};
+
+static Vector RandomStressPoint( CUniformRandomStream &random, float flExtent )
+{
+	return Vector( random.RandomFloat( -flExtent, flExtent ), random.RandomFloat( -flExtent, flExtent ), random.RandomFloat( -flExtent, flExtent ) );
+}
+
+static bool CheckStressQuery( PartitionStressTest_t *pTest, const Vector &vecMins, const Vector &vecMaxs, IHandleEntity **ppFound, int nFound, CUtlVector<int> &seen, int nStamp )
+{
+	if ( nFound >= PARTITION_STRESS_QUERY_MAX )
+		return true;
+
+	for ( int i = 0; i < nFound; ++i )
+	{
+		int nIndex = static_cast<CPartitionStressElement*>( ppFound[i] ) - pTest->m_pElements;
+		if ( nIndex < 0 || nIndex >= PARTITION_STRESS_ELEMENTS || seen[nIndex] == nStamp )
+			return false;
+		seen[nIndex] = nStamp;
+	}
+
+	for ( int i = 0; i < PARTITION_STRESS_ELEMENTS; ++i )
+	{
+		const CPartitionStressElement &element = pTest->m_pElements[i];
+		if ( element.m_bMoving || seen[i] == nStamp )
+			continue;
+
+		if ( element.m_vecMins.x <= vecMaxs.x && element.m_vecMaxs.x >= vecMins.x &&
+			 element.m_vecMins.y <= vecMaxs.y && element.m_vecMaxs.y >= vecMins.y &&
+			 element.m_vecMins.z <= vecMaxs.z && element.m_vecMaxs.z >= vecMins.z )
+			return false;
+	}
+	return true;
+}
+
+static void PartitionStressReader( PartitionStressTest_t *pTest )
+{
+	CUniformRandomStream random;
+	random.SetSeed( ThreadGetCurrentId() );
+
+	CUtlVector<int> seen;
+	seen.SetCount( PARTITION_STRESS_ELEMENTS );
+	seen.FillWithValue( 0 );
+
+	IHandleEntity *pFound[PARTITION_STRESS_QUERY_MAX];
+	int nStamp = 0;
+	do
+	{
+		Vector vecMins = RandomStressPoint( random, PARTITION_STRESS_EXTENT );
+		Vector vecMaxs = vecMins + RandomStressPoint( random, 512.0f ) + Vector( 512, 512, 512 );
+
+		bool bOk;
+		if ( random.RandomInt( 0, 1 ) )
+		{
+			int nFound = pTest->m_pPartition->GetElementsInBox( PARTITION_ENGINE_SOLID_EDICTS, vecMins, vecMaxs, pFound, ARRAYSIZE( pFound ) );
+			bOk = CheckStressQuery( pTest, vecMins, vecMaxs, pFound, nFound, seen, ++nStamp );
+		}
+		else
+		{
+			CPartitionStressEnum stressEnum( pTest, random );
+			pTest->m_pPartition->EnumerateElementsInBox( PARTITION_ENGINE_SOLID_EDICTS, vecMins, vecMaxs, false, &stressEnum );
+			bOk = CheckStressQuery( pTest, vecMins, vecMaxs, stressEnum.m_pFound, stressEnum.m_nCount, seen, ++nStamp );
+		}
+
+		++pTest->m_nQueries;
+		if ( !bOk )
+		{
+			++pTest->m_nErrors;
+		}
+	} while ( !pTest->m_bDone );
+}
+
+CON_COMMAND_F( partition_stresstest, "Runs queries on all job threads against a private spatial partition while elements move. Arguments: seconds", FCVAR_CHEAT )
+{
+	float flDuration = ( args.ArgC() > 1 ) ? atof( args[1] ) : 5.0f;
+
+	PartitionStressTest_t test;
+	test.m_pPartition = CreateSpatialPartition( s_PartitionMin, s_PartitionMax );
+	test.m_pElements = new CPartitionStressElement[PARTITION_STRESS_ELEMENTS];
+	test.m_bDone = false;
+	test.m_nQueries = 0;
+	test.m_nErrors = 0;
+
+	CUniformRandomStream random;
+	random.SetSeed( 1 );
+	for ( int i = 0; i < PARTITION_STRESS_ELEMENTS; ++i )
+	{
+		CPartitionStressElement &element = test.m_pElements[i];
+		Vector vecMins = RandomStressPoint( random, PARTITION_STRESS_EXTENT );
+		Vector vecMaxs = vecMins + Vector( random.RandomFloat( 1, 600 ), random.RandomFloat( 1, 600 ), random.RandomFloat( 1, 600 ) );
+		element.m_bMoving = ( i & 1 ) != 0;
+		element.m_vecMins.Init( vecMins.x - SPHASH_EPS, vecMins.y - SPHASH_EPS, vecMins.z - SPHASH_EPS );
+		element.m_vecMaxs.Init( vecMaxs.x + SPHASH_EPS, vecMaxs.y + SPHASH_EPS, vecMaxs.z + SPHASH_EPS );
+		element.m_hPartition = test.m_pPartition->CreateHandle( &element, PARTITION_ENGINE_SOLID_EDICTS, vecMins, vecMaxs );
+	}
+
+	int nJobs = MAX( g_pThreadPool->NumThreads(), 1 );
+	CUtlVector<CJob *> jobs;
+	for ( int i = 0; i < nJobs; ++i )
+	{
+		jobs.AddToTail( g_pThreadPool->QueueCall( &PartitionStressReader, &test ) );
+	}
+
+	// Moves of all sizes, so elements change voxels and levels while the readers run
+	int nMoves = 0;
+	double flEnd = Plat_FloatTime() + flDuration;
+	while ( Plat_FloatTime() < flEnd )
+	{
+		for ( int i = 0; i < 256; ++i, ++nMoves )
+		{
+			CPartitionStressElement &element = test.m_pElements[ random.RandomInt( 0, PARTITION_STRESS_ELEMENTS / 2 - 1 ) * 2 + 1 ];
+			Vector vecMins = RandomStressPoint( random, PARTITION_STRESS_EXTENT );
+			float flSize = random.RandomFloatExp( 1.0f, 2048.0f, 3.0f );
+			test.m_pPartition->ElementMoved( element.m_hPartition, vecMins, vecMins + Vector( flSize, flSize, flSize ) );
+		}
+	}
+	test.m_bDone = true;
+
+	for ( int i = 0; i < jobs.Count(); ++i )
+	{
+		jobs[i]->WaitForFinishAndRelease();
+	}
+
+	Msg( "partition_stresstest: %d readers, %d queries, %d moves, %d errors\n", nJobs, (int)test.m_nQueries, nMoves, (int)test.m_nErrors );
+
+	for ( int i = 0; i < PARTITION_STRESS_ELEMENTS; ++i )
+	{
+		test.m_pPartition->DestroyHandle( test.m_pElements[i].m_hPartition );
+	}
+	delete[] test.m_pElements;
+	DestroySpatialPartition( test.m_pPartition );
+}
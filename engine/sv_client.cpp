@@ -417,7 +417,7 @@ void CGameClient::SetupPackInfo( CFrameSnapshot *pSnapshot )
 #endif
 	{
 		// the hltv client doesn't has a ClientFrame list
-		m_pCurrentFrame->transmit_always = new CBitVec<MAX_EDICTS>;
+		m_pCurrentFrame->AllocTransmitAlways();
 		m_PackInfo.m_pTransmitAlways = m_pCurrentFrame->transmit_always;
 	}
 	else
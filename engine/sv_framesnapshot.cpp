@@ -18,6 +18,9 @@
 #include "tier0/memdbgon.h"
 
 DEFINE_FIXEDSIZE_ALLOCATOR( CFrameSnapshot, 64, 64 );
+DEFINE_FIXEDSIZE_ALLOCATOR_MT( CFrameSnapshotArena, 64, 64 );
+
+#define SNAPSHOT_ARENA_HEADER_SIZE	ALIGN_VALUE( sizeof( SnapshotArenaBlock_t ), 16 )
 
 
 static ConVar sv_creationtickcheck( "sv_creationtickcheck", "1", FCVAR_CHEAT | FCVAR_DEVELOPMENTONLY, "Do extended check for encoding of timestamps against tickcount" );
@@ -35,6 +38,8 @@ CFrameSnapshotManager::CFrameSnapshotManager( void ) : m_PackedEntitiesPool( MAX
 	COMPILE_TIME_ASSERT( INVALID_PACKED_ENTITY_HANDLE == 0 );
 	Q_memset( m_pPackedData, 0x00, MAX_EDICTS * sizeof(PackedEntityHandle_t) );
 
+	m_pFreeArenaBlocks = NULL;
+	m_nFreeArenaBlocks = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -46,6 +51,8 @@ CFrameSnapshotManager::~CFrameSnapshotManager( void )
 
 	// TODO: This assert has been failing. HenryG says it's a valid assert and that we're probably leaking memory.
 	AssertMsg1( m_PackedEntitiesPool.Count() == 0 || IsInErrorExit(), "Expected m_PackedEntitiesPool to be empty. It had %i items.", m_PackedEntitiesPool.Count() );
+
+	PurgeArenaBlocks();
 }
 
 //-----------------------------------------------------------------------------
@@ -61,6 +68,9 @@ void CFrameSnapshotManager::LevelChanged()
 	m_PackedEntityCache.RemoveAll();
 	COMPILE_TIME_ASSERT( INVALID_PACKED_ENTITY_HANDLE == 0 );
 	Q_memset( m_pPackedData, 0x00, MAX_EDICTS * sizeof(PackedEntityHandle_t) );
+
+	// entity counts differ between maps, don't hold on to the old sizes
+	PurgeArenaBlocks();
 }
 
 CFrameSnapshot*	CFrameSnapshotManager::NextSnapshot( const CFrameSnapshot *pSnapshot )
@@ -87,7 +97,9 @@ CFrameSnapshot*	CFrameSnapshotManager::CreateEmptySnapshot( int tickcount, int m
 	snap->m_pValidEntities = NULL;
 	snap->m_pHLTVEntityData = NULL;
 	snap->m_pReplayEntityData = NULL;
-	snap->m_pEntities = new CFrameSnapshotEntry[maxEntities];
+	snap->m_pArena = new CFrameSnapshotArena;
+	snap->m_pArena->AddReference();
+	snap->m_pEntities = (CFrameSnapshotEntry *)snap->m_pArena->Alloc( maxEntities * sizeof(CFrameSnapshotEntry) );
 
 	CFrameSnapshotEntry *entry = snap->m_pEntities;
 	
@@ -152,19 +164,19 @@ CFrameSnapshot* CFrameSnapshotManager::TakeTickSnapshot( int tickcount )
 	}
 
 	// create dynamic valid entities array and copy indices
-	snap->m_pValidEntities = new unsigned short[snap->m_nValidEntities];
+	snap->m_pValidEntities = (unsigned short *)snap->m_pArena->Alloc( snap->m_nValidEntities * sizeof(unsigned short) );
 	Q_memcpy( snap->m_pValidEntities, nValidEntities, snap->m_nValidEntities * sizeof(unsigned short) );
 
 	if ( hltv && hltv->IsActive() )
 	{
-		snap->m_pHLTVEntityData = new CHLTVEntityData[snap->m_nValidEntities];
+		snap->m_pHLTVEntityData = (CHLTVEntityData *)snap->m_pArena->Alloc( snap->m_nValidEntities * sizeof(CHLTVEntityData) );
 		Q_memset( snap->m_pHLTVEntityData, 0, snap->m_nValidEntities * sizeof(CHLTVEntityData) );
 	}
 
 #if defined( REPLAY_ENABLED )
 	if ( replay && replay->IsActive() )
 	{
-		snap->m_pReplayEntityData = new CReplayEntityData[snap->m_nValidEntities];
+		snap->m_pReplayEntityData = (CReplayEntityData *)snap->m_pArena->Alloc( snap->m_nValidEntities * sizeof(CReplayEntityData) );
 		Q_memset( snap->m_pReplayEntityData, 0, snap->m_nValidEntities * sizeof(CReplayEntityData) );
 	}
 #endif
@@ -278,7 +290,13 @@ bool CFrameSnapshotManager::UsePreviouslySentPacket( CFrameSnapshot* pSnapshot,
 
 			Assert( entity < pSnapshot->m_nNumEntities );
 			pSnapshot->m_pEntities[entity].m_pPackedData = handle;
-			reinterpret_cast< PackedEntity * >( handle )->m_ReferenceCount++;
+
+			PackedEntity *packedEntity = reinterpret_cast< PackedEntity * >( handle );
+			packedEntity->m_ReferenceCount++;
+
+			// Don't let entities that rarely change keep the memory of the tick
+			// they were packed on alive, move them along once that snapshot is gone.
+			packedEntity->MoveDataToArena( pSnapshot->m_pArena );
 			return true;
 		}
 		else
@@ -441,6 +459,7 @@ CFrameSnapshot::CFrameSnapshot()
 	m_nTempEntities = 0;
 	m_pTempEntities = NULL;
 	m_pValidEntities = NULL;
+	m_pArena = NULL;
 	m_nReferences = 0;
 #if defined( _DEBUG )
 	++g_nAllocatedSnapshots;
@@ -451,9 +470,6 @@ CFrameSnapshot::CFrameSnapshot()
 
 CFrameSnapshot::~CFrameSnapshot()
 {
-	delete [] m_pValidEntities;
-	delete [] m_pEntities;
-
 	if ( m_pTempEntities )
 	{
 		Assert( m_nTempEntities>0 );
@@ -461,18 +477,13 @@ CFrameSnapshot::~CFrameSnapshot()
 		{
 			delete m_pTempEntities[i];
 		}
-
-		delete [] m_pTempEntities;
-	}
-
-	if ( m_pHLTVEntityData )
-	{
-		delete [] m_pHLTVEntityData;
 	}
 
-	if ( m_pReplayEntityData )
+	// entity arrays, temp entity list and HLTV data all live in the arena
+	if ( m_pArena )
 	{
-		delete [] m_pReplayEntityData;
+		m_pArena->Retire();
+		m_pArena->ReleaseReference();
 	}
 	Assert ( m_nReferences == 0 );
 
@@ -506,3 +517,127 @@ CFrameSnapshot* CFrameSnapshot::NextSnapshot() const
 }
 
 
+// ------------------------------------------------------------------------------------------------ //
+// CFrameSnapshotArena
+// ------------------------------------------------------------------------------------------------ //
+
+SnapshotArenaBlock_t *CFrameSnapshotManager::AllocArenaBlock( int nMinSize )
+{
+	{
+		AUTO_LOCK( m_ArenaMutex );
+
+		// first fit, the list is short and the sizes repeat from tick to tick
+		SnapshotArenaBlock_t **ppPrev = &m_pFreeArenaBlocks;
+		for ( SnapshotArenaBlock_t *pBlock = m_pFreeArenaBlocks; pBlock; pBlock = pBlock->m_pNext )
+		{
+			if ( pBlock->m_nSize >= nMinSize )
+			{
+				*ppPrev = pBlock->m_pNext;
+				--m_nFreeArenaBlocks;
+				pBlock->m_pNext = NULL;
+				pBlock->m_nUsed = 0;
+				return pBlock;
+			}
+			ppPrev = &pBlock->m_pNext;
+		}
+	}
+
+	int nSize = MAX( nMinSize, SNAPSHOT_ARENA_BLOCK_SIZE );
+	SnapshotArenaBlock_t *pBlock = (SnapshotArenaBlock_t *)MemAlloc_AllocAligned( SNAPSHOT_ARENA_HEADER_SIZE + nSize, 16 );
+	pBlock->m_pNext = NULL;
+	pBlock->m_nSize = nSize;
+	pBlock->m_nUsed = 0;
+	return pBlock;
+}
+
+void CFrameSnapshotManager::FreeArenaBlocks( SnapshotArenaBlock_t *pBlocks )
+{
+	SnapshotArenaBlock_t *pSurplus = NULL;
+
+	{
+		AUTO_LOCK( m_ArenaMutex );
+
+		while ( pBlocks )
+		{
+			SnapshotArenaBlock_t *pNext = pBlocks->m_pNext;
+			if ( m_nFreeArenaBlocks < SNAPSHOT_ARENA_MAX_FREE_BLOCKS )
+			{
+				pBlocks->m_pNext = m_pFreeArenaBlocks;
+				m_pFreeArenaBlocks = pBlocks;
+				++m_nFreeArenaBlocks;
+			}
+			else
+			{
+				pBlocks->m_pNext = pSurplus;
+				pSurplus = pBlocks;
+			}
+			pBlocks = pNext;
+		}
+	}
+
+	while ( pSurplus )
+	{
+		SnapshotArenaBlock_t *pNext = pSurplus->m_pNext;
+		MemAlloc_FreeAligned( pSurplus );
+		pSurplus = pNext;
+	}
+}
+
+void CFrameSnapshotManager::PurgeArenaBlocks()
+{
+	AUTO_LOCK( m_ArenaMutex );
+
+	while ( m_pFreeArenaBlocks )
+	{
+		SnapshotArenaBlock_t *pNext = m_pFreeArenaBlocks->m_pNext;
+		MemAlloc_FreeAligned( m_pFreeArenaBlocks );
+		m_pFreeArenaBlocks = pNext;
+	}
+	m_nFreeArenaBlocks = 0;
+}
+
+CFrameSnapshotArena::CFrameSnapshotArena()
+{
+	m_pBlocks = NULL;
+	m_nReferences = 0;
+	m_bRetired = false;
+}
+
+CFrameSnapshotArena::~CFrameSnapshotArena()
+{
+	Assert( m_nReferences == 0 );
+	g_FrameSnapshotManager.FreeArenaBlocks( m_pBlocks );
+}
+
+void *CFrameSnapshotArena::Alloc( int nBytes )
+{
+	nBytes = ALIGN_VALUE( MAX( nBytes, 1 ), 16 );
+
+	AUTO_LOCK( m_Mutex );
+
+	if ( !m_pBlocks || m_pBlocks->m_nUsed + nBytes > m_pBlocks->m_nSize )
+	{
+		SnapshotArenaBlock_t *pBlock = g_FrameSnapshotManager.AllocArenaBlock( nBytes );
+		pBlock->m_pNext = m_pBlocks;
+		m_pBlocks = pBlock;
+	}
+
+	void *pMem = (byte *)m_pBlocks + SNAPSHOT_ARENA_HEADER_SIZE + m_pBlocks->m_nUsed;
+	m_pBlocks->m_nUsed += nBytes;
+	return pMem;
+}
+
+void CFrameSnapshotArena::AddReference()
+{
+	++m_nReferences;
+}
+
+void CFrameSnapshotArena::ReleaseReference()
+{
+	Assert( m_nReferences > 0 );
+
+	if ( --m_nReferences == 0 )
+	{
+		delete this;
+	}
+}
@@ -19,6 +19,7 @@
 #include "GameEventManager.h"
 #include "netadr.h"
 #include "zlib/zlib.h"
+#include "tier0/tslist.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -33,9 +34,372 @@ static ConVar sv_logsecret( "sv_logsecret", "0", 0, "If set then include this se
 
 static ConVar sv_logfilename_format( "sv_logfilename_format", "", FCVAR_ARCHIVE, "Log filename format. See strftime for formatting codes." );
 static ConVar sv_logfilecompress( "sv_logfilecompress", "0", FCVAR_ARCHIVE, "Gzip compress logfile and rename to logfilename.log.gz on close." );
+static ConVar sv_logfile_maxsize( "sv_logfile_maxsize", "0", FCVAR_ARCHIVE, "Start a new log file once the current one grows past this many kilobytes (0 = never).", true, 0, false, 0 );
+static ConVar sv_logasync( "sv_logasync", "1", FCVAR_ARCHIVE, "Hand log lines to a background thread for file writes and udp forwarding." );
 
 CLog g_Log;	// global Log object
 
+static bool gzip_file_compress( const CUtlString &Filename );
+
+#define LOG_LINE_LENGTH			1100		// timestamp + 1024 chars of text
+#define LOG_MAX_QUEUED_LINES	8192		// game thread waits for the writer beyond this
+#define LOG_WRITE_BUFFER_SIZE	(64*1024)	// lines are collected into writes of this size
+
+enum
+{
+	LOGLINE_TEXT = 0,	// write to file and/or send to the log addresses
+	LOGLINE_COMPRESS,	// gzip a closed log file, szText holds the filename
+};
+
+struct LogLine_t
+{
+	int		nType;
+	int		nLength;
+	bool	bWriteFile;
+	bool	bSendUDP;
+	char	szText[LOG_LINE_LENGTH];
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Takes file writes, udp forwarding and log compression off the game
+//			thread. Lines are pushed into a lock free queue and the thread
+//			drains them in batches, so a slow disk never stalls a tick.
+//-----------------------------------------------------------------------------
+class CLogWriterThread : public CThread
+{
+public:
+	CLogWriterThread();
+	~CLogWriterThread();
+
+	bool Setup();
+	void Shutdown();
+
+	void QueueLine( const char *pszText, bool bWriteFile, bool bSendUDP );
+	void QueueCompress( const char *pszFilename );
+
+	// blocks until everything queued so far has been handled
+	void Drain();
+
+	void SetLogFile( FileHandle_t hFile );
+	void SetLogAddresses( const CUtlVector< netadr_t > &addresses );
+	void RequestFlush();
+
+	// true once the current file has grown past sv_logfile_maxsize
+	bool ShouldRotate() const { return m_bRotate; }
+
+private:
+	virtual int Run();
+
+	LogLine_t *AllocLine();
+	void ProcessLines();
+	void HandleLine( LogLine_t *pLine );
+	void WriteBatch();
+	void SendBatch();
+
+	CTSQueue< LogLine_t * >		m_QueuedLines;
+	CTSPool< LogLine_t >		m_FreeLines;
+
+	CThreadEvent				m_WakeEvent;
+	CThreadEvent				m_DrainedEvent;
+	volatile bool				m_bThreadShouldExit;
+	volatile bool				m_bFlushRequested;
+	volatile bool				m_bRotate;
+
+	CInterlockedInt				m_nQueued;		// lines handed to the writer
+	CInterlockedInt				m_nHandled;		// lines the writer is done with
+
+	// guards the file handle and the address list, both change on the game thread
+	CThreadFastMutex			m_Mutex;
+	FileHandle_t				m_hFile;
+	int64						m_nFileBytes;
+	CUtlVector< netadr_t >		m_Addresses;
+
+	// writer thread only
+	CUtlVector< LogLine_t * >	m_Batch;
+	char						m_WriteBuffer[LOG_WRITE_BUFFER_SIZE];
+	int							m_nWriteBufferUsed;
+};
+
+static CLogWriterThread g_LogWriter;
+
+CLogWriterThread::CLogWriterThread()
+{
+	SetName( "LogWriter" );
+	m_bThreadShouldExit = false;
+	m_bFlushRequested = false;
+	m_bRotate = false;
+	m_hFile = FILESYSTEM_INVALID_HANDLE;
+	m_nFileBytes = 0;
+	m_nWriteBufferUsed = 0;
+}
+
+CLogWriterThread::~CLogWriterThread()
+{
+	Shutdown();
+}
+
+bool CLogWriterThread::Setup()
+{
+	if ( IsAlive() )
+		return true;
+
+	m_bThreadShouldExit = false;
+	return Start();
+}
+
+void CLogWriterThread::Shutdown()
+{
+	if ( IsAlive() )
+	{
+		// the thread empties the queue before it exits
+		m_bThreadShouldExit = true;
+		m_WakeEvent.Set();
+		Join();
+	}
+
+	// anything still queued was pushed without a running thread
+	ProcessLines();
+	m_FreeLines.Purge();
+}
+
+LogLine_t *CLogWriterThread::AllocLine()
+{
+	// don't let the queue grow without bounds if the disk can't keep up
+	if ( m_nQueued - m_nHandled >= LOG_MAX_QUEUED_LINES )
+	{
+		Drain();
+	}
+
+	return m_FreeLines.GetObject();
+}
+
+void CLogWriterThread::QueueLine( const char *pszText, bool bWriteFile, bool bSendUDP )
+{
+	LogLine_t *pLine = AllocLine();
+	pLine->nType = LOGLINE_TEXT;
+	pLine->bWriteFile = bWriteFile;
+	pLine->bSendUDP = bSendUDP;
+	V_strncpy( pLine->szText, pszText, sizeof( pLine->szText ) );
+	pLine->nLength = V_strlen( pLine->szText );
+
+	++m_nQueued;
+	m_QueuedLines.PushItem( pLine );
+
+	if ( !IsAlive() )
+	{
+		ProcessLines();
+		return;
+	}
+
+	m_WakeEvent.Set();
+
+	if ( !sv_logasync.GetBool() )
+	{
+		// old behavior, wait until the line is on disk
+		Drain();
+	}
+}
+
+void CLogWriterThread::QueueCompress( const char *pszFilename )
+{
+	LogLine_t *pLine = AllocLine();
+	pLine->nType = LOGLINE_COMPRESS;
+	pLine->bWriteFile = false;
+	pLine->bSendUDP = false;
+	V_strncpy( pLine->szText, pszFilename, sizeof( pLine->szText ) );
+	pLine->nLength = V_strlen( pLine->szText );
+
+	++m_nQueued;
+	m_QueuedLines.PushItem( pLine );
+
+	if ( IsAlive() )
+	{
+		m_WakeEvent.Set();
+	}
+	else
+	{
+		ProcessLines();
+	}
+}
+
+void CLogWriterThread::Drain()
+{
+	if ( !IsAlive() )
+	{
+		ProcessLines();
+		return;
+	}
+
+	while ( m_nHandled != m_nQueued && IsAlive() )
+	{
+		m_WakeEvent.Set();
+		m_DrainedEvent.Wait( 50 );
+	}
+}
+
+void CLogWriterThread::SetLogFile( FileHandle_t hFile )
+{
+	AUTO_LOCK( m_Mutex );
+	m_hFile = hFile;
+	m_nFileBytes = 0;
+	m_bRotate = false;
+}
+
+void CLogWriterThread::SetLogAddresses( const CUtlVector< netadr_t > &addresses )
+{
+	AUTO_LOCK( m_Mutex );
+	m_Addresses = addresses;
+}
+
+void CLogWriterThread::RequestFlush()
+{
+	m_bFlushRequested = true;
+	m_WakeEvent.Set();
+}
+
+int CLogWriterThread::Run()
+{
+	for ( ;; )
+	{
+		// wake up now and then even without new lines to handle flush requests
+		m_WakeEvent.Wait( 100 );
+
+		ProcessLines();
+
+		if ( m_bThreadShouldExit )
+		{
+			ProcessLines();
+			break;
+		}
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Empties the queue. Consecutive text lines are collected into one
+//			file write and one burst of udp packets.
+//-----------------------------------------------------------------------------
+void CLogWriterThread::ProcessLines()
+{
+	LogLine_t *pLine;
+
+	while ( m_QueuedLines.PopItem( &pLine ) )
+	{
+		if ( pLine->nType != LOGLINE_TEXT || m_nWriteBufferUsed + pLine->nLength > sizeof( m_WriteBuffer ) )
+		{
+			WriteBatch();
+		}
+
+		if ( pLine->nType == LOGLINE_TEXT )
+		{
+			if ( pLine->bWriteFile )
+			{
+				V_memcpy( m_WriteBuffer + m_nWriteBufferUsed, pLine->szText, pLine->nLength );
+				m_nWriteBufferUsed += pLine->nLength;
+			}
+
+			m_Batch.AddToTail( pLine );
+		}
+		else
+		{
+			HandleLine( pLine );
+			m_FreeLines.PutObject( pLine );
+			++m_nHandled;
+		}
+	}
+
+	WriteBatch();
+
+	if ( m_bFlushRequested )
+	{
+		m_bFlushRequested = false;
+
+		AUTO_LOCK( m_Mutex );
+		if ( m_hFile != FILESYSTEM_INVALID_HANDLE )
+		{
+			g_pFileSystem->Flush( m_hFile );
+		}
+	}
+
+	m_DrainedEvent.Set();
+}
+
+void CLogWriterThread::HandleLine( LogLine_t *pLine )
+{
+	if ( pLine->nType == LOGLINE_COMPRESS )
+	{
+		// Try to compress the closed log file to filename.log.gz.
+		CUtlString filename( pLine->szText );
+		if ( gzip_file_compress( filename ) )
+		{
+			Msg( "  Success. Removing %s.\n", filename.Get() );
+			g_pFileSystem->RemoveFile( filename, "LOGDIR" );
+		}
+	}
+}
+
+void CLogWriterThread::WriteBatch()
+{
+	if ( !m_Batch.Count() )
+		return;
+
+	{
+		AUTO_LOCK( m_Mutex );
+
+		if ( m_nWriteBufferUsed > 0 && m_hFile != FILESYSTEM_INVALID_HANDLE )
+		{
+			g_pFileSystem->Write( m_WriteBuffer, m_nWriteBufferUsed, m_hFile );
+			if ( sv_logflush.GetBool() )
+			{
+				g_pFileSystem->Flush( m_hFile );
+			}
+
+			m_nFileBytes += m_nWriteBufferUsed;
+			if ( sv_logfile_maxsize.GetInt() > 0 && m_nFileBytes >= (int64)sv_logfile_maxsize.GetInt() * 1024 )
+			{
+				m_bRotate = true;
+			}
+		}
+
+		SendBatch();
+	}
+
+	for ( int i = 0; i < m_Batch.Count(); i++ )
+	{
+		m_FreeLines.PutObject( m_Batch[i] );
+	}
+
+	m_nHandled += m_Batch.Count();
+	m_Batch.RemoveAll();
+	m_nWriteBufferUsed = 0;
+}
+
+void CLogWriterThread::SendBatch()
+{
+	if ( !m_Addresses.Count() )
+		return;
+
+	// the log protocol is one line per packet, so the batch goes out back to back
+	bool bSecret = sv_logsecret.GetInt() != 0;
+	const char *pszSecret = sv_logsecret.GetString();
+
+	for ( int i = 0; i < m_Batch.Count(); i++ )
+	{
+		LogLine_t *pLine = m_Batch[i];
+		if ( !pLine->bSendUDP )
+			continue;
+
+		for ( int j = 0; j < m_Addresses.Count(); j++ )
+		{
+			if ( bSecret )
+				NET_OutOfBandPrintf( NS_SERVER, m_Addresses[j], "%c%s%s", S2A_LOGSTRING2, pszSecret, pLine->szText );
+			else
+				NET_OutOfBandPrintf( NS_SERVER, m_Addresses[j], "%c%s", S2A_LOGSTRING, pLine->szText );
+		}
+	}
+}
+
 CON_COMMAND( log, "Enables logging to file, console, and udp < on | off >." )
 {
 	if ( args.ArgC() != 2 )
@@ -291,6 +655,12 @@ void CLog::Init( void )
 {
 	Reset();
 
+	g_LogWriter.SetLogAddresses( m_LogAddresses );
+	if ( !g_LogWriter.Setup() )
+	{
+		Warning( "CLog: couldn't start log writer thread, logging synchronously.\n" );
+	}
+
 	// listen to these events
 	g_GameEventManager.AddListener( this, "server_spawn", true );
 	g_GameEventManager.AddListener( this, "server_shutdown", true );
@@ -304,6 +674,8 @@ void CLog::Shutdown()
 {
 	Close();
 	Reset();
+	g_LogWriter.SetLogAddresses( m_LogAddresses );
+	g_LogWriter.Shutdown();
 	g_GameEventManager.RemoveListener( this );
 }
 
@@ -317,7 +689,14 @@ void CLog::RunFrame()
 	if ( m_bFlushLog && m_hLogFile != FILESYSTEM_INVALID_HANDLE && ( realtime - m_flLastLogFlush ) > 1.0f )
 	{
 		m_flLastLogFlush = realtime;
-		g_pFileSystem->Flush( m_hLogFile );
+		g_LogWriter.RequestFlush();
+	}
+
+	if ( g_LogWriter.ShouldRotate() && m_hLogFile != FILESYSTEM_INVALID_HANDLE )
+	{
+		// current file is full, continue in a new one
+		Close();
+		Open();
 	}
 }
 
@@ -341,6 +720,7 @@ bool CLog::AddLogAddress(netadr_t addr)
 	}
 
 	m_LogAddresses.AddToTail( addr );
+	g_LogWriter.SetLogAddresses( m_LogAddresses );
 	return true;
 }
 
@@ -360,6 +740,7 @@ bool CLog::DelLogAddress(netadr_t addr)
 	if ( i < m_LogAddresses.Count() )
 	{
 		m_LogAddresses.Remove(i);
+		g_LogWriter.SetLogAddresses( m_LogAddresses );
 		return true;
 	}
 
@@ -408,6 +789,7 @@ void CLog::DelAllLogAddress( void )
 	{
 		ConMsg( "logaddress_delall:  all addresses cleared\n" );
 		m_LogAddresses.RemoveAll();
+		g_LogWriter.SetLogAddresses( m_LogAddresses );
 	}
 	else
 	{
@@ -502,28 +884,13 @@ void CLog::Print( const char * text )
 		ConMsg( "%s", string );
 	}
 
-	// Echo to log file
-	if ( sv_logfile.GetInt() && ( m_hLogFile != FILESYSTEM_INVALID_HANDLE ) )
-	{
-		g_pFileSystem->FPrintf( m_hLogFile, "%s", string );
-		if ( sv_logflush.GetBool() )
-		{
-			g_pFileSystem->Flush( m_hLogFile );
-		}
-	}
+	// Echo to log file and UDP port, the writer thread does the actual work
+	bool bWriteFile = sv_logfile.GetInt() && ( m_hLogFile != FILESYSTEM_INVALID_HANDLE );
+	bool bSendUDP = m_LogAddresses.Count() > 0;
 
-	// Echo to UDP port
-	if ( m_LogAddresses.Count() > 0 )
+	if ( bWriteFile || bSendUDP )
 	{
-		// out of band sending
-		for ( int i = 0 ; i < m_LogAddresses.Count() ; i++ )
-		{
-			if ( sv_logsecret.GetInt() != 0 )
-				NET_OutOfBandPrintf(NS_SERVER, m_LogAddresses.Element(i), "%c%s%s", S2A_LOGSTRING2, sv_logsecret.GetString(), string );
-			else
-				NET_OutOfBandPrintf(NS_SERVER, m_LogAddresses.Element(i), "%c%s", S2A_LOGSTRING, string );
-			
-		}
+		g_LogWriter.QueueLine( string, bWriteFile, bSendUDP );
 	}
 }
 
@@ -800,16 +1167,16 @@ void CLog::Close( void )
 	if ( m_hLogFile != FILESYSTEM_INVALID_HANDLE )
 	{
 		Printf( "Log file closed.\n" );
+
+		// write out what's still queued before the handle goes away
+		g_LogWriter.Drain();
+		g_LogWriter.SetLogFile( FILESYSTEM_INVALID_HANDLE );
 		g_pFileSystem->Close( m_hLogFile );
 
 		if ( sv_logfilecompress.GetBool() )
 		{
-			// Try to compress m_LogFilename to m_LogFilename.gz.
-			if ( gzip_file_compress( m_LogFilename ) )
-			{
-				Msg( "  Success. Removing %s.\n", m_LogFilename.Get() );
-				g_pFileSystem->RemoveFile( m_LogFilename, "LOGDIR" );
-			}
+			// compress m_LogFilename to m_LogFilename.gz in the background
+			g_LogWriter.QueueCompress( m_LogFilename );
 		}
 	}
 
@@ -828,6 +1195,7 @@ void CLog::Flush( void )
 {
 	if ( m_hLogFile != FILESYSTEM_INVALID_HANDLE )
 	{
+		g_LogWriter.Drain();
 		g_pFileSystem->Flush( m_hLogFile );
 	}
 }
@@ -897,6 +1265,7 @@ void CLog::Open( void )
 
 	m_hLogFile = info.fh.file;
 	m_LogFilename = info.Filename;
+	g_LogWriter.SetLogFile( m_hLogFile );
 
 	ConMsg( "Server logging data to file %s\n", m_LogFilename.Get() );
 	Printf( "Log file started (file \"%s\") (game \"%s\") (version \"%i\")\n", m_LogFilename.Get(), com_gamedir, build_number() );
@@ -380,6 +380,9 @@ void CGameServer::Clear( void )
 	m_pDynamicModelsTable = NULL;
 	m_bIsLevelMainMenuBackground = false;
 
+	ClearModelPrecacheBatch();
+	m_ModelLoadTimes.RemoveAll();
+
 	m_bLoadgame = false;
 	
 	host_state.SetWorldModel( NULL );	
@@ -786,7 +789,7 @@ void SV_InitSendTables( ServerClass *pClasses )
 	SendTable *pTables[MAX_DATATABLES];
 	int nTables = SV_BuildSendTablesArray( pClasses, pTables, ARRAYSIZE( pTables ) );
 
-	SendTable_Init( pTables, nTables );
+	SendTable_Init( pTables, nTables, serverGameDLL->GetStandardSendProxies() );
 }
 
 
@@ -1293,6 +1296,8 @@ CGameServer::CGameServer()
 	m_pPureServerWhitelist = NULL;
 	m_bHibernating = false;
 	m_bLoadedPlugins = false;
+	m_bBatchModelPrecache = false;
+	m_hModelPrecacheFiles = NULL;
 	V_memset( m_szMapname, 0, sizeof( m_szMapname ) );
 	V_memset( m_szMapFilename, 0, sizeof( m_szMapFilename ) );
 }
@@ -1809,7 +1814,7 @@ void CGameServer::CopyTempEntities( CFrameSnapshot* pSnapshot )
 		// copy temp entities if any
 		pSnapshot->m_nTempEntities = m_TempEntities.Count();
 
-		pSnapshot->m_pTempEntities = new CEventInfo*[pSnapshot->m_nTempEntities];
+		pSnapshot->m_pTempEntities = (CEventInfo **)pSnapshot->m_pArena->Alloc( pSnapshot->m_nTempEntities * sizeof( CEventInfo * ) );
 
 		Q_memcpy( pSnapshot->m_pTempEntities, m_TempEntities.Base(), m_TempEntities.Count() * sizeof( CEventInfo * ) );
 
@@ -2179,6 +2184,9 @@ bool SV_ActivateServer()
 	// Activate the DLL server code
 	g_pServerPluginHandler->ServerActivate( sv.edicts, sv.num_edicts, sv.GetMaxClients() );
 
+	COM_TimestampedLog( "FinishModelPrecacheBatch" );
+	sv.FinishModelPrecacheBatch();
+
 	// all setup is completed, any further precache statements are errors
 	sv.m_State = ss_active;
 	
@@ -2662,6 +2670,9 @@ bool CGameServer::SpawnServer( const char *szMapName, const char *szMapFile, con
 		PrecacheModel( localmodel, RES_FATALIFMISSING | RES_PRELOAD, modelloader->GetModelForName( localmodel, IModelLoader::FMODELLOADER_SERVER ) );
 	}
 
+	// everything the game dll preloads from here on is loaded in SV_ActivateServer
+	BeginModelPrecacheBatch();
+
 #ifndef SWDS
 	EngineVGui()->UpdateProgressBar(PROGRESS_CLEARWORLD);
 #endif
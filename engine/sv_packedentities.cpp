@@ -266,7 +266,7 @@ static inline void SV_PackEntity(
 		PackedEntity *pPackedEntity = framesnapshotmanager->CreatePackedEntity( pSnapshot, edictIdx );
 		pPackedEntity->SetChangeFrameList( pChangeFrame );
 		pPackedEntity->SetServerAndClientClass( pServerClass, NULL );
-		pPackedEntity->AllocAndCopyPadded( packedData, writeBuf.GetNumBytesWritten() );
+		pPackedEntity->AllocAndCopyPadded( packedData, writeBuf.GetNumBytesWritten(), pSnapshot->m_pArena );
 		pPackedEntity->SetRecipients( recip );
 	}
 
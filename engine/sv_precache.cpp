@@ -21,6 +21,8 @@
 #include "tier0/memdbgon.h"
 
 static ConVar sv_forcepreload( "sv_forcepreload", "0", FCVAR_ARCHIVE, "Force server side preloading.");
+static ConVar sv_precache_batch( "sv_precache_batch", "1", 0, "Collect the models preloaded during map load, read their files asynchronously and load them together once the game dll is done precaching." );
+static ConVar sv_precache_times( "sv_precache_times", "0", 0, "Print the load times of the slowest N preloaded models at the end of map load." );
 
 //-----------------------------------------------------------------------------
 // Purpose: 
@@ -227,9 +229,14 @@ int CGameServer::PrecacheModel( char const *name, int flags, model_t *model /*=N
 
 	if ( idx != 0 )
 	{
-		if ( bLoadNow )
+		if ( bLoadNow && m_bBatchModelPrecache && !Q_stricmp( Q_GetFileExtension( name ), "mdl" ) )
 		{
-			slot->SetModel( modelloader->GetModelForName( name, IModelLoader::FMODELLOADER_SERVER ) );
+			QueueModelPrecache( idx, name );
+			MapReslistGenerator().OnModelPrecached(name);
+		}
+		else if ( bLoadNow )
+		{
+			slot->SetModel( LoadPrecacheModel( idx, name ) );
 #ifndef SWDS
 			EngineVGui()->UpdateProgressBar(PROGRESS_PRECACHE); 
 #endif
@@ -270,6 +277,14 @@ model_t *CGameServer::GetModel( int index )
 	char const *modelname = m_pModelPrecacheTable->GetString( index );
 	Assert( modelname );
 
+	// touched before the precache batch got to it
+	if ( m_PendingModelBits.IsBitSet( index ) )
+	{
+		m = LoadPrecacheModel( index, modelname );
+		slot->SetModel( m );
+		return m;
+	}
+
 	if ( host_showcachemiss.GetBool() )
 	{
 		ConDMsg( "server model cache miss on %s\n", modelname );
@@ -281,6 +296,165 @@ model_t *CGameServer::GetModel( int index )
 	return m;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Starts collecting models that would otherwise be loaded right away
+//			in PrecacheModel
+//-----------------------------------------------------------------------------
+void CGameServer::BeginModelPrecacheBatch( void )
+{
+	ClearModelPrecacheBatch();
+
+	if ( !sv_precache_batch.GetBool() || IsX360() )
+		return;
+
+	m_hModelPrecacheFiles = g_pFileSystem->CreateFileCache();
+	m_bBatchModelPrecache = ( m_hModelPrecacheFiles != NULL );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Starts the reads for all files of a studio model and defers loading
+//			it until FinishModelPrecacheBatch or the first GetModel
+//-----------------------------------------------------------------------------
+void CGameServer::QueueModelPrecache( int index, char const *name )
+{
+	if ( m_PendingModelBits.IsBitSet( index ) )
+		return;
+
+	static const char *s_pExtensions[] = { ".mdl", ".vvd", ".phy", ".ani" };
+
+	char szFiles[ ARRAYSIZE( s_pExtensions ) ][ MAX_PATH ];
+	const char *pFiles[ ARRAYSIZE( s_pExtensions ) ];
+	for ( int i = 0; i < ARRAYSIZE( s_pExtensions ); i++ )
+	{
+		Q_StripExtension( name, szFiles[i], sizeof( szFiles[i] ) );
+		Q_strncat( szFiles[i], s_pExtensions[i], sizeof( szFiles[i] ), COPY_ALL_CHARACTERS );
+		pFiles[i] = szFiles[i];
+	}
+
+	// missing files (most models have no .ani) are cached as failed reads
+	g_pFileSystem->AddFilesToFileCache( m_hModelPrecacheFiles, pFiles, ARRAYSIZE( pFiles ), "GAME" );
+
+	modelloader->ReferenceModel( name, IModelLoader::FMODELLOADER_SERVER );
+
+	m_PendingModelPrecache.AddToTail( index );
+	m_PendingModelBits.Set( index );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads every model that was collected since BeginModelPrecacheBatch
+//-----------------------------------------------------------------------------
+void CGameServer::FinishModelPrecacheBatch( void )
+{
+	if ( !m_bBatchModelPrecache )
+		return;
+
+	m_bBatchModelPrecache = false;
+
+	// reads that haven't completed yet don't block, the model loader just
+	// goes to disk for those files
+	bool bReadsDone = g_pFileSystem->IsFileCacheLoaded( m_hModelPrecacheFiles );
+
+	double flStart = Plat_FloatTime();
+	int nLoaded = 0;
+
+	for ( int i = 0; i < m_PendingModelPrecache.Count(); i++ )
+	{
+		int index = m_PendingModelPrecache[i];
+		if ( !m_PendingModelBits.IsBitSet( index ) )
+			continue;
+
+		model_precache[ index ].SetModel( LoadPrecacheModel( index, m_pModelPrecacheTable->GetString( index ) ) );
+		nLoaded++;
+
+#ifndef SWDS
+		EngineVGui()->UpdateProgressBar(PROGRESS_PRECACHE); 
+#endif
+	}
+
+	DevMsg( "Precache: loaded %i of %i batched models in %.2f sec%s\n", nLoaded, m_PendingModelPrecache.Count(),
+		Plat_FloatTime() - flStart, bReadsDone ? "" : " (reads still pending)" );
+
+	// drops the cached file data
+	ClearModelPrecacheBatch();
+
+	if ( sv_precache_times.GetInt() > 0 )
+	{
+		PrintModelLoadTimes( sv_precache_times.GetInt() );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void CGameServer::ClearModelPrecacheBatch( void )
+{
+	if ( m_hModelPrecacheFiles )
+	{
+		g_pFileSystem->DestroyFileCache( m_hModelPrecacheFiles );
+		m_hModelPrecacheFiles = NULL;
+	}
+
+	m_bBatchModelPrecache = false;
+	m_PendingModelPrecache.RemoveAll();
+	m_PendingModelBits.ClearAll();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Loads a preloaded model and remembers how long it took
+//-----------------------------------------------------------------------------
+model_t *CGameServer::LoadPrecacheModel( int index, char const *name )
+{
+	double flStart = Plat_FloatTime();
+
+	model_t *pModel = modelloader->GetModelForName( name, IModelLoader::FMODELLOADER_SERVER );
+
+	ModelLoadTime_t &entry = m_ModelLoadTimes[ m_ModelLoadTimes.AddToTail() ];
+	entry.nIndex = index;
+	entry.flTime = Plat_FloatTime() - flStart;
+
+	m_PendingModelBits.Clear( index );
+	return pModel;
+}
+
+static int __cdecl ModelLoadTimeSortFunc( const ModelLoadTime_t *pA, const ModelLoadTime_t *pB )
+{
+	return ( pA->flTime < pB->flTime ) ? 1 : ( ( pA->flTime > pB->flTime ) ? -1 : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Lists the slowest model loads of the current level
+//-----------------------------------------------------------------------------
+void CGameServer::PrintModelLoadTimes( int nCount )
+{
+	if ( !m_pModelPrecacheTable )
+		return;
+
+	CUtlVector< ModelLoadTime_t > sorted;
+	sorted.CopyArray( m_ModelLoadTimes.Base(), m_ModelLoadTimes.Count() );
+
+	float flTotal = 0.0f;
+	for ( int i = 0; i < sorted.Count(); i++ )
+	{
+		flTotal += sorted[i].flTime;
+	}
+
+	sorted.Sort( ModelLoadTimeSortFunc );
+
+	ConMsg( "%i models preloaded in %.3f sec\n", sorted.Count(), flTotal );
+	for ( int i = 0; i < sorted.Count() && i < nCount; i++ )
+	{
+		ConMsg( "  %8.2f ms  %s\n", sorted[i].flTime * 1000.0f, m_pModelPrecacheTable->GetString( sorted[i].nIndex ) );
+	}
+}
+
+CON_COMMAND( sv_precache_report, "Lists the slowest model loads of the current map. Optional parameter: number of models to list." )
+{
+	if ( !sv.IsActive() )
+		return;
+
+	sv.PrintModelLoadTimes( args.ArgC() > 1 ? atoi( args[1] ) : 20 );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : *name - 
@@ -123,6 +123,10 @@ CBaseFileSystem *BaseFileSystem()
 }
 
 ConVar filesystem_buffer_size( "filesystem_buffer_size", "0", 0, "Size of per file buffers. 0 for none" );
+ConVar fs_resolve_cache( "fs_resolve_cache", "1", 0, "Remember which search path relative file names were found in, and which weren't found at all" );
+
+// the resolve cache is flushed when it grows beyond this
+#define RESOLVE_CACHE_MAX_ENTRIES	32768
 
 #if defined( TRACK_BLOCKING_IO )
 
@@ -331,6 +335,7 @@ CBaseFileSystem::CBaseFileSystem()
 #endif
 
 	m_iMapLoad = 0;
+	m_nResolveCacheGeneration = 0;
 
 	Q_memset( m_PreloadData, 0, sizeof( m_PreloadData ) );
 
@@ -869,6 +874,7 @@ bool CBaseFileSystem::RemoveVPKFile( const char *pPath, const char *pPathID )
 			if ( m_SearchPaths[i].GetPath() == pathIDSym )
 			{
 				m_SearchPaths.Remove( i );
+				InvalidateResolveCache();
 				return true;
 			}
 		}
@@ -939,6 +945,8 @@ bool CBaseFileSystem::AddPackFileFromPath( const char *pPath, const char *pakfil
 	sp->m_pPathIDInfo->SetPathID( pathID );
 	sp->SetPackFile( pf );
 
+	InvalidateResolveCache();
+
 	return true;
 }
 
@@ -1106,6 +1114,8 @@ void CBaseFileSystem::RemoveAllMapSearchPaths( void )
 		
 		m_SearchPaths.Remove( i );
 	}
+
+	InvalidateResolveCache();
 }
 
 //-----------------------------------------------------------------------------
@@ -1272,6 +1282,9 @@ void CBaseFileSystem::BeginMapAccess()
 {
 	if ( m_iMapLoad++ == 0 )
 	{
+		// content may have changed on disk since the last map
+		InvalidateResolveCache();
+
 		int c = m_SearchPaths.Count();
 		for( int i = 0; i < c; i++ )
 		{
@@ -1370,6 +1383,11 @@ void CBaseFileSystem::PrintSearchPaths( void )
 		Msg( "\"%s\" \"%s\" %s%s\n", pSearchPath->GetPathString(), (const char *)pSearchPath->GetPathIDString(), pszType, pszPack );
 	}
 
+	int nHits = m_nResolveCacheHits;
+	int nLookups = nHits + m_nResolveCacheMisses;
+	Msg( "\nResolve cache: %d entries, %d of %d lookups hit (%.1f%%), %d of the hits were files that don't exist\n",
+		m_ResolveCache.Count(), nHits, nLookups, nLookups ? 100.0f * nHits / nLookups : 0.0f, (int)m_nResolveCacheNotFoundHits );
+
 	if ( IsX360() && m_ExcludePaths.Count() )
 	{
 		// dump current list
@@ -1567,6 +1585,8 @@ void CBaseFileSystem::AddSearchPath( const char *pPath, const char *pathID, Sear
 		}
 	}
 
+	InvalidateResolveCache();
+
 	if ( currCount != m_SearchPaths.Count() )
 	{
 #if !defined( DEDICATED )
@@ -1683,6 +1703,8 @@ bool CBaseFileSystem::RemoveSearchPath( const char *pPath, const char *pathID )
 		m_SearchPaths.Remove( i );
 		bret = true;
 	}
+
+	InvalidateResolveCache();
 	return bret;
 }
 
@@ -1703,6 +1725,8 @@ void CBaseFileSystem::RemoveSearchPaths( const char *pathID )
 			m_SearchPaths.FastRemove(i);
 		}
 	}
+
+	InvalidateResolveCache();
 }
 
 
@@ -2123,6 +2147,7 @@ void CBaseFileSystem::RemoveAllSearchPaths( void )
 	AUTO_LOCK( m_SearchPathsMutex );
 	m_SearchPaths.Purge();
 	//m_PackFileHandles.Purge();
+	InvalidateResolveCache();
 }
 
 
@@ -2519,42 +2544,129 @@ FileHandle_t CBaseFileSystem::OpenForRead( const char *pFileNameT, const char *p
 		}
 	}
 
-	CSearchPathsIterator iter( this, &pFileName, pathID, pathFilter );
-	for ( openInfo.m_pSearchPath = iter.GetFirst(); openInfo.m_pSearchPath != NULL; openInfo.m_pSearchPath = iter.GetNext() )
+	// Names carrying their own path ID ("//GAME/...") aren't cached, the iterator rewrites them
+	char szResolveKey[MAX_PATH * 2];
+	int nResolveGeneration = 0;
+	int nCachedStoreId = RESOLVE_CACHE_UNKNOWN;
+	bool bUseResolveCache = fs_resolve_cache.GetBool() && pathFilter == FILTER_NONE && !( pFileName[0] == '/' && pFileName[1] == '/' );
+	if ( bUseResolveCache )
 	{
-		FileHandle_t filehandle = FindFileInSearchPath( openInfo );
-		if ( filehandle )
+		V_snprintf( szResolveKey, sizeof( szResolveKey ), "%s:%s", pathID ? pathID : "", pFileName );
+		nCachedStoreId = LookupResolveCache( szResolveKey, nResolveGeneration );
+		if ( nCachedStoreId == RESOLVE_CACHE_NOT_FOUND )
 		{
-			// Check if search path is excluded due to pure server white list,
-			// then we should make a note of this fact, and keep searching
-			if ( !openInfo.m_pSearchPath->m_bIsTrustedForPureServer && openInfo.m_ePureFileClass == ePureServerFileClass_AnyTrusted )
+			LogFileOpen( "[Failed]", pFileName, "" );
+			return ( FileHandle_t )0;
+		}
+	}
+
+	// A cached search path is tried on its own first, everything is searched if the file isn't there anymore
+	for ( int nPass = ( nCachedStoreId >= 0 ) ? 0 : 1; nPass < 2; nPass++ )
+	{
+		CSearchPathsIterator iter( this, &pFileName, pathID, pathFilter );
+		for ( openInfo.m_pSearchPath = iter.GetFirst(); openInfo.m_pSearchPath != NULL; openInfo.m_pSearchPath = iter.GetNext() )
+		{
+			if ( nPass == 0 && openInfo.m_pSearchPath->m_storeId != nCachedStoreId )
+				continue;
+
+			FileHandle_t filehandle = FindFileInSearchPath( openInfo );
+			if ( filehandle )
 			{
-				#ifdef PURE_SERVER_DEBUG_SPEW
-					Msg( "Ignoring %s from %s for pure server operation\n", openInfo.m_pFileName, openInfo.m_pSearchPath->GetDebugString() );
-				#endif
+				// Check if search path is excluded due to pure server white list,
+				// then we should make a note of this fact, and keep searching
+				if ( !openInfo.m_pSearchPath->m_bIsTrustedForPureServer && openInfo.m_ePureFileClass == ePureServerFileClass_AnyTrusted )
+				{
+					#ifdef PURE_SERVER_DEBUG_SPEW
+						Msg( "Ignoring %s from %s for pure server operation\n", openInfo.m_pFileName, openInfo.m_pSearchPath->GetDebugString() );
+					#endif
+
+					m_FileTracker2.NoteFileIgnoredForPureServer( openInfo.m_pFileName, pathID, openInfo.m_pSearchPath->m_storeId );
+					Close( filehandle );
+					openInfo.m_pFileHandle = NULL;
+					if ( ppszResolvedFilename && *ppszResolvedFilename )
+					{
+						free( *ppszResolvedFilename );
+						*ppszResolvedFilename = NULL;
+					}
+					continue;
+				}
 
-				m_FileTracker2.NoteFileIgnoredForPureServer( openInfo.m_pFileName, pathID, openInfo.m_pSearchPath->m_storeId );
-				Close( filehandle );
-				openInfo.m_pFileHandle = NULL;
-				if ( ppszResolvedFilename && *ppszResolvedFilename )
+				if ( bUseResolveCache && nPass == 1 )
 				{
-					free( *ppszResolvedFilename );
-					*ppszResolvedFilename = NULL;
+					AddToResolveCache( szResolveKey, openInfo.m_pSearchPath->m_storeId, nResolveGeneration );
 				}
-				continue;
-			}
 
-			// 
-			openInfo.HandleFileCRCTracking( openInfo.m_pFileName );
-			return filehandle;
+				// 
+				openInfo.HandleFileCRCTracking( openInfo.m_pFileName );
+				return filehandle;
+			}
 		}
 	}
 
+	if ( bUseResolveCache )
+	{
+		AddToResolveCache( szResolveKey, RESOLVE_CACHE_NOT_FOUND, nResolveGeneration );
+	}
+
 	LogFileOpen( "[Failed]", pFileName, "" );
 	return ( FileHandle_t )0;
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns the store id of the search path the key resolved to,
+//			RESOLVE_CACHE_NOT_FOUND or RESOLVE_CACHE_UNKNOWN. nGeneration has
+//			to be passed to AddToResolveCache once the search is done.
+//-----------------------------------------------------------------------------
+int CBaseFileSystem::LookupResolveCache( const char *pKey, int &nGeneration )
+{
+	AUTO_LOCK( m_ResolveCacheMutex );
+
+	nGeneration = m_nResolveCacheGeneration;
+
+	UtlHashHandle_t h = m_ResolveCache.Find( pKey );
+	if ( h == m_ResolveCache.InvalidHandle() )
+	{
+		++m_nResolveCacheMisses;
+		return RESOLVE_CACHE_UNKNOWN;
+	}
+
+	++m_nResolveCacheHits;
+	if ( m_ResolveCache[h] == RESOLVE_CACHE_NOT_FOUND )
+	{
+		++m_nResolveCacheNotFoundHits;
+	}
+	return m_ResolveCache[h];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Results of searches that overlapped an invalidation are dropped,
+//			they may have been made against the old search paths
+//-----------------------------------------------------------------------------
+void CBaseFileSystem::AddToResolveCache( const char *pKey, int nStoreId, int nGeneration )
+{
+	AUTO_LOCK( m_ResolveCacheMutex );
+
+	if ( nGeneration != m_nResolveCacheGeneration )
+		return;
+
+	if ( m_ResolveCache.Count() >= RESOLVE_CACHE_MAX_ENTRIES )
+	{
+		m_ResolveCache.RemoveAll();
+	}
+
+	m_ResolveCache[ m_ResolveCache.Insert( pKey ) ] = nStoreId;
+}
+
+void CBaseFileSystem::InvalidateResolveCache()
+{
+	AUTO_LOCK( m_ResolveCacheMutex );
+
+	++m_nResolveCacheGeneration;
+	m_ResolveCache.RemoveAll();
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -2589,6 +2701,12 @@ FileHandle_t CBaseFileSystem::OpenForWrite( const char *pFileName, const char *p
 		return ( FileHandle_t )0;
 	}
 
+	// possibly a new file that was cached as not found, appending to an existing one changes nothing
+	if ( size == 0 )
+	{
+		InvalidateResolveCache();
+	}
+
 	CFileHandle *fh = new CFileHandle( this );
 	fh->m_nLength = size;
 	fh->m_type = FT_NORMAL;
@@ -3621,6 +3739,9 @@ void CBaseFileSystem::NotifyFileUnloaded( const char *pszFilename, const char *p
 
 void CBaseFileSystem::SetSearchPathIsTrustedSource( CSearchPath *pSearchPath )
 {
+	// called for every new search path, and trust decides which path a file resolves to
+	InvalidateResolveCache();
+
 #if 1
 	pSearchPath->m_bIsTrustedForPureServer = true;
 #else // Broken, I am lazy to fix this
@@ -4724,6 +4845,7 @@ bool CBaseFileSystem::RenameFile( char const *pOldPath, char const *pNewPath, co
 		return false;
 	}
 
+	InvalidateResolveCache();
 	return true;
 }
 
@@ -5185,6 +5307,7 @@ CBaseFileSystem::CPathIDInfo* CBaseFileSystem::FindOrAddPathIDInfo( const CUtlSy
 void CBaseFileSystem::MarkPathIDByRequestOnly( const char *pPathID, bool bRequestOnly )
 {
 	FindOrAddPathIDInfo( g_PathIDTable.AddString( pPathID ), bRequestOnly );
+	InvalidateResolveCache();
 }
 
 #if defined( TRACK_BLOCKING_IO )
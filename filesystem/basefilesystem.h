@@ -672,6 +672,25 @@ public:
 
 	CSearchPath *FindSearchPathByStoreId( int storeId );
 
+	// Remembers which search path (by store id) a relative file name resolved to for a path ID, or that it wasn't
+	// found in any of them. Flushed whenever the search paths, their pure server trust or the files on disk change.
+	enum
+	{
+		RESOLVE_CACHE_UNKNOWN = -2,
+		RESOLVE_CACHE_NOT_FOUND = -1,
+	};
+
+	int				LookupResolveCache( const char *pKey, int &nGeneration );
+	void			AddToResolveCache( const char *pKey, int nStoreId, int nGeneration );
+	void			InvalidateResolveCache();
+
+	CThreadFastMutex				m_ResolveCacheMutex;
+	CUtlHashtable< CUtlString, int > m_ResolveCache;
+	int								m_nResolveCacheGeneration;
+	CInterlockedInt					m_nResolveCacheHits;
+	CInterlockedInt					m_nResolveCacheNotFoundHits;
+	CInterlockedInt					m_nResolveCacheMisses;
+
 	int m_iMapLoad;
 
 	// Global list of pack file handles
@@ -14,6 +14,7 @@
 #include "tier1/generichash.h"
 
 ConVar fs_monitor_read_from_pack( "fs_monitor_read_from_pack", "0", 0, "0:Off, 1:Any, 2:Sync only" );
+ConVar fs_packfile_mmap( "fs_packfile_mmap", "1", 0, "Memory map zip and .bsp pack files and read from the mapping instead of seeking the file handle." );
 
 // How many bytes we should decode at a time when doing pseudo-reads to seek forward in a compressed file handle,
 // (affects maximum stack allocation by a forward seek)
@@ -132,6 +133,10 @@ CFileHandle *CZipPackFile::OpenFile( const char *pFileName, const char *pOptions
 
 			// !NOTE! Pack files inside of VPK not supported
 		}
+		if ( m_nOpenFiles == 0 && !m_pMappedFile )
+		{
+			MapPackFile();
+		}
 		m_nOpenFiles++;
 		m_mutex.Unlock();
 		CPackFileHandle* ph = NULL;
@@ -268,6 +273,34 @@ int CZipPackFile::ReadFromPack( int nEntryIndex, void* pBuffer, int nDestBytes,
 	}
 #endif
 
+	// The mapping doesn't go away while there are open handles, so no lock is needed
+	if ( m_pMappedFile )
+	{
+		if ( fs_monitor_read_from_pack.GetInt() == 1 )
+		{
+			char szName[MAX_PATH];
+			IndexToFilename( nEntryIndex, szName, sizeof( szName ) );
+			Msg( "Read From Pack: Mapped: Requested:%7d, Offset:0x%16.16llx, %s\n", nBytes, m_nBaseOffset + nOffset, szName );
+		}
+
+		int64 nAvailable = m_FileLength - nOffset;
+		if ( nOffset < 0 || nAvailable <= 0 )
+		{
+			return 0;
+		}
+		if ( nBytes > nAvailable )
+		{
+			nBytes = (int)nAvailable;
+		}
+		if ( nDestBytes >= 0 && nBytes > nDestBytes )
+		{
+			nBytes = nDestBytes;
+		}
+
+		V_memcpy( pBuffer, (byte *)m_pMappedFile + m_nBaseOffset + nOffset, nBytes );
+		return nBytes;
+	}
+
 	// Otherwise, do the read from the pack
 	m_mutex.Lock();
 
@@ -304,29 +337,31 @@ int CZipPackFile::ReadFromPack( int nEntryIndex, void* pBuffer, int nDestBytes,
 //-----------------------------------------------------------------------------
 bool CZipPackFile::GetFileInfo( const char *pFileName, int &nBaseIndex, int64 &nFileOffset, int &nOriginalSize, int &nCompressedSize, unsigned short &nCompressionMethod )
 {
+	// Names that were just looked up and not found skip the clean up below. The directory never changes after
+	// Prepare(), so a miss stays a miss.
+	unsigned int nRawHash = HashStringCaselessConventional( pFileName );
+	if ( IsCachedMiss( pFileName, nRawHash ) )
+	{
+		return false;
+	}
+
+	// We may get passed non-canonicalized filenames, so we need to remove the ../ from the path
 	char szCleanName[MAX_FILEPATH];
 	Q_strncpy( szCleanName, pFileName, sizeof( szCleanName ) );
-#ifdef _WIN32
 	Q_strlower( szCleanName );
-#endif
 	Q_FixSlashes( szCleanName );
 
-	if ( !Q_RemoveDotSlashes( szCleanName, CORRECT_PATH_SEPARATOR, false ) )
+	int idx = -1;
+	if ( Q_RemoveDotSlashes( szCleanName, CORRECT_PATH_SEPARATOR, false ) )
 	{
-		return false;
+		idx = FindFile( szCleanName, HashStringCaselessConventional( szCleanName ) );
 	}
 
-	CZipPackFile::CPackFileEntry lookup;
-
-	// We may get passed non-canonicalized filenames, so we need to remove the ../ from the path
-	char szFixedName[MAX_PATH] = {0};
-	V_strcpy_safe( szFixedName, pFileName );
-	V_RemoveDotSlashes( szFixedName );
-
-	lookup.m_HashName = HashStringCaselessConventional( szFixedName );
-
-	int idx = m_PackFiles.Find( lookup );
-	if ( -1 != idx  )
+	if ( -1 == idx )
+	{
+		AddCachedMiss( pFileName, nRawHash );
+	}
+	else
 	{
 		nFileOffset = m_PackFiles[idx].m_nPosition;
 		nOriginalSize = m_PackFiles[idx].m_nOriginalSize;
@@ -339,6 +374,132 @@ bool CZipPackFile::GetFileInfo( const char *pFileName, int &nBaseIndex, int64 &n
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+//	Miss cache, the names are compared so a colliding hash can't hide a file
+//-----------------------------------------------------------------------------
+bool CZipPackFile::IsCachedMiss( const char *pFileName, unsigned int nRawHash )
+{
+	if ( !nRawHash )
+	{
+		return false;
+	}
+
+	CPackFileMiss &miss = m_MissCache[ ( nRawHash ^ ( nRawHash >> 16 ) ) & ( PACKFILE_MISS_CACHE_SIZE - 1 ) ];
+	AUTO_LOCK( m_MissCacheMutex );
+	return miss.m_nHash == nRawHash && !V_strcmp( miss.m_szName, pFileName );
+}
+
+void CZipPackFile::AddCachedMiss( const char *pFileName, unsigned int nRawHash )
+{
+	if ( !nRawHash || V_strlen( pFileName ) >= PACKFILE_MISS_CACHE_NAME_LENGTH )
+	{
+		return;
+	}
+
+	CPackFileMiss &miss = m_MissCache[ ( nRawHash ^ ( nRawHash >> 16 ) ) & ( PACKFILE_MISS_CACHE_SIZE - 1 ) ];
+	AUTO_LOCK( m_MissCacheMutex );
+	miss.m_nHash = nRawHash;
+	V_strncpy( miss.m_szName, pFileName, sizeof( miss.m_szName ) );
+}
+
+//-----------------------------------------------------------------------------
+//	Hash lookup in the directory, names are compared to resolve collisions
+//-----------------------------------------------------------------------------
+int CZipPackFile::FindFile( const char *pCleanName, unsigned int nHash ) const
+{
+	if ( !m_DirectoryHash.Count() )
+	{
+		return -1;
+	}
+
+	unsigned int nMask = m_DirectoryHash.Count() - 1;
+	for ( unsigned int nSlot = nHash & nMask; m_DirectoryHash[nSlot] != -1; nSlot = ( nSlot + 1 ) & nMask )
+	{
+		const CPackFileEntry &entry = m_PackFiles[ m_DirectoryHash[nSlot] ];
+		if ( entry.m_HashName == nHash && !V_strcmp( &m_DirectoryNames[entry.m_nNameOffset], pCleanName ) )
+		{
+			return m_DirectoryHash[nSlot];
+		}
+	}
+
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+//	Size the table to at most half full so probe sequences stay short
+//-----------------------------------------------------------------------------
+void CZipPackFile::BuildDirectoryHash()
+{
+	int nSize = 16;
+	while ( nSize < m_PackFiles.Count() * 2 )
+	{
+		nSize <<= 1;
+	}
+
+	m_DirectoryHash.SetCount( nSize );
+	for ( int i = 0; i < nSize; i++ )
+	{
+		m_DirectoryHash[i] = -1;
+	}
+
+	unsigned int nMask = nSize - 1;
+	FOR_EACH_VEC( m_PackFiles, i )
+	{
+		const CPackFileEntry &entry = m_PackFiles[i];
+
+		// the first of several identically named entries wins
+		if ( FindFile( &m_DirectoryNames[entry.m_nNameOffset], entry.m_HashName ) != -1 )
+		{
+			continue;
+		}
+
+		unsigned int nSlot = entry.m_HashName & nMask;
+		while ( m_DirectoryHash[nSlot] != -1 )
+		{
+			nSlot = ( nSlot + 1 ) & nMask;
+		}
+		m_DirectoryHash[nSlot] = i;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	Map the file containing the pack, falls back to file handle reads on failure
+//-----------------------------------------------------------------------------
+void CZipPackFile::MapPackFile()
+{
+	if ( m_pMappedFile || m_ZipName.IsEmpty() || !fs_packfile_mmap.GetBool() )
+	{
+		return;
+	}
+
+	uint64 nSize = 0;
+	void *pData = Plat_MapFile( m_ZipName.Get(), &nSize );
+	if ( !pData )
+	{
+		return;
+	}
+
+	if ( nSize < (uint64)( m_nBaseOffset + m_FileLength ) )
+	{
+		// file changed underneath us
+		Plat_UnmapFile( pData, nSize );
+		return;
+	}
+
+	m_nMappedFileSize = nSize;
+	m_pMappedFile = pData;
+}
+
+void CZipPackFile::UnmapPackFile()
+{
+	if ( m_pMappedFile )
+	{
+		Plat_UnmapFile( m_pMappedFile, m_nMappedFileSize );
+		m_pMappedFile = NULL;
+		m_nMappedFileSize = 0;
+	}
+}
+
 bool CZipPackFile::IndexToFilename( int nIndex, char *pBuffer, int nBufferSize )
 {
 	AssertMsg( nIndex >= 0 && nIndex < m_PackFiles.Count(), "Out of bounds vector access in IndexToFilename" );
@@ -618,6 +779,9 @@ bool CZipPackFile::Prepare( int64 fileLen, int64 nFileOfs )
 	m_FileLength = fileLen;
 	m_nBaseOffset = nFileOfs;
 
+	// directory parsing below does a lot of small reads
+	MapPackFile();
+
 	ZIP_EndOfCentralDirRecord rec = { 0 };
 
 	// Find and read the central header directory from its expected position at end of the file
@@ -739,6 +903,7 @@ bool CZipPackFile::Prepare( int64 fileLen, int64 nFileOfs )
 	char tmpString[MAX_PATH] = { 0 };
 
 	m_PackFiles.EnsureCapacity( numFilesInZip );
+	m_DirectoryNames.EnsureCapacity( rec.centralDirectorySize );
 
 	for ( int i = firstFileIdx; i < numFilesInZip; ++i )
 	{
@@ -767,6 +932,8 @@ bool CZipPackFile::Prepare( int64 fileLen, int64 nFileOfs )
 
 		lookup.m_hFileName = m_fs->FindOrAddFileName( tmpString );
 		lookup.m_HashName = HashStringCaselessConventional( tmpString );
+		lookup.m_nNameOffset = m_DirectoryNames.AddMultipleToTail( fileNameLen + 1, tmpString );
+		Q_strlower( &m_DirectoryNames[lookup.m_nNameOffset] );
 		lookup.m_nOriginalSize = zipFileHeader.uncompressedSize;
 		lookup.m_nCompressedSize = zipFileHeader.compressedSize;
 		lookup.m_nPosition = zipFileHeader.relativeOffsetOfLocalHeader +
@@ -784,13 +951,19 @@ bool CZipPackFile::Prepare( int64 fileLen, int64 nFileOfs )
 		{
 			lookup.m_nPreloadIdx = INVALID_PRELOAD_ENTRY;
 		}
-		m_PackFiles.InsertNoSort( lookup );
+		m_PackFiles.AddToTail( lookup );
 
 		int nextOffset = bCompatibleFormat ? zipFileHeader.extraFieldLength + zipFileHeader.fileCommentLength : 0;
 		zipDirBuff.SeekGet( CUtlBuffer::SEEK_CURRENT, nextOffset );
 	}
 
-	m_PackFiles.RedoSort();
+	BuildDirectoryHash();
+
+	// map paks get mapped again when files in them are opened
+	if ( m_bIsMapPath )
+	{
+		UnmapPackFile();
+	}
 
 	return bSuccess;
 }
@@ -809,6 +982,9 @@ CZipPackFile::CZipPackFile( CBaseFileSystem* fs, void *pSection )
 	m_pPreloadRemapTable = NULL;
 	m_nPreloadSectionOffset = 0;
 	m_nPreloadSectionSize = 0;
+	m_pMappedFile = NULL;
+	m_nMappedFileSize = 0;
+	V_memset( m_MissCache, 0, sizeof( m_MissCache ) );
 
 #if defined( _X360 )
 	m_pSection = pSection;
@@ -818,17 +994,7 @@ CZipPackFile::CZipPackFile( CBaseFileSystem* fs, void *pSection )
 CZipPackFile::~CZipPackFile()
 {
 	DiscardPreloadData();
-}
-
-//-----------------------------------------------------------------------------
-// Purpose:
-// Input  : src1 -
-//			src2 -
-// Output : Returns true on success, false on failure.
-//-----------------------------------------------------------------------------
-bool CZipPackFile::CPackFileLessFunc::Less( CZipPackFile::CPackFileEntry const& src1, CZipPackFile::CPackFileEntry const& src2, void *pCtx )
-{
-	return ( src1.m_HashName < src2.m_HashName );
+	UnmapPackFile();
 }
 
 //-----------------------------------------------------------------------------
@@ -856,6 +1022,7 @@ CZipPackFileHandle::~CZipPackFileHandle()
 			m_pOwner->FileSystem()->Trace_FClose( m_pOwner->m_hPackFileHandleFS );
 			m_pOwner->m_hPackFileHandleFS = NULL;
 		}
+		m_pOwner->UnmapPackFile();
 	}
 	m_pOwner->Release();
 	m_pOwner->m_mutex.Unlock();
@@ -23,6 +23,11 @@
 // memory characteristics.
 #define PACKFILE_COMPRESSED_FILE_HANDLES_WARNING 20
 
+// Number of recently missed file names each zip remembers, must be a power of two. Map paks are searched before every
+// other path, so most lookups in them are misses. Longer names aren't remembered.
+#define PACKFILE_MISS_CACHE_SIZE 256
+#define PACKFILE_MISS_CACHE_NAME_LENGTH 124
+
 #include "basefilesystem.h"
 #include "tier1/refcount.h"
 #include "tier1/utlbuffer.h"
@@ -236,26 +241,48 @@ protected:
 		unsigned int		m_nOriginalSize;
 		unsigned int		m_nCompressedSize;
 		unsigned int		m_HashName;
+		unsigned int		m_nNameOffset;	// lowercased name in m_DirectoryNames
 		unsigned short		m_nPreloadIdx;
-		unsigned short		pad;
 		unsigned short		m_nCompressionMethod;
 		FileNameHandle_t	m_hFileName;
 	};
 
-	class CPackFileLessFunc
+	// Find a file inside a pack file, takes a cleaned up lowercase name. Returns the entry index or -1.
+	int FindFile( const char *pCleanName, unsigned int nHash ) const;
+
+	// Builds m_DirectoryHash once all entries are added
+	void BuildDirectoryHash();
+
+	// Entries to the individual files stored inside the pack file, in zip directory order.
+	CUtlVector< CPackFileEntry > m_PackFiles;
+
+	// Open addressed table of indices into m_PackFiles, keyed by m_HashName
+	CUtlVector< int >			m_DirectoryHash;
+	CUtlVector< char >			m_DirectoryNames;
+
+	// Raw (not cleaned up) names of recent lookups that found nothing, slot picked by name hash
+	struct CPackFileMiss
 	{
-	public:
-		bool Less( CPackFileEntry const& src1, CPackFileEntry const& src2, void *pCtx );
+		unsigned int		m_nHash;	// 0 marks an empty slot
+		char				m_szName[ PACKFILE_MISS_CACHE_NAME_LENGTH ];
 	};
 
-	// Find a file inside a pack file:
-	const CPackFileEntry* FindFile( const char* pFileName );
+	CThreadFastMutex			m_MissCacheMutex;
+	CPackFileMiss				m_MissCache[ PACKFILE_MISS_CACHE_SIZE ];
 
-	// Entries to the individual files stored inside the pack file.
-	CUtlSortVector< CPackFileEntry, CPackFileLessFunc > m_PackFiles;
+	bool						IsCachedMiss( const char *pFileName, unsigned int nRawHash );
+	void						AddCachedMiss( const char *pFileName, unsigned int nRawHash );
 
 	bool						GetFileInfo( const char *pFileName, int &nBaseIndex, int64 &nFileOffset, int &nOriginalSize, int &nCompressedSize, unsigned short &nCompressionMethod );
 
+	// The whole zip (or the .bsp containing it) mapped read only, reads are served from here without locking. Map
+	// paks only stay mapped while files in them are open, like m_hPackFileHandleFS.
+	void						MapPackFile();
+	void						UnmapPackFile();
+
+	void						*m_pMappedFile;
+	uint64						m_nMappedFileSize;
+
 	// Preload Support
 	void						SetupPreloadData() OVERRIDE;
 	void						DiscardPreloadData() OVERRIDE;
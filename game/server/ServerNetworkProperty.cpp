@@ -15,6 +15,8 @@
 
 extern CTimedEventMgr g_NetworkPropertyEventMgr;
 
+CNetworkHotData g_NetworkHotData;
+
 
 //-----------------------------------------------------------------------------
 // Save/load
@@ -84,12 +86,14 @@ void CServerNetworkProperty::AttachEdict( edict_t *pRequiredEdict )
 
 	m_pPev = pRequiredEdict;
 	m_pPev->SetEdict( GetBaseEntity(), true );
+	UpdateHotData();
 }
 
 void CServerNetworkProperty::DetachEdict()
 {
 	if ( m_pPev )
 	{
+		g_NetworkHotData.Clear( entindex() );
 		m_pPev->SetEdict( NULL, false );
 		engine->RemoveEdict( m_pPev );
 		m_pPev = NULL;
@@ -144,9 +148,62 @@ void CServerNetworkProperty::RecomputePVSInformation()
 	{
 		m_pPev->m_fStateFlags &= ~FL_EDICT_DIRTY_PVS_INFORMATION;
 		engine->BuildEntityClusterList( edict(), &m_PVSInfo );
+		g_NetworkHotData.SetPVSInfo( entindex(), m_PVSInfo );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Hot data
+//-----------------------------------------------------------------------------
+void CServerNetworkProperty::UpdateHotData()
+{
+	if ( m_pPev )
+	{
+		g_NetworkHotData.SetPVSInfo( entindex(), m_PVSInfo );
+		g_NetworkHotData.SetParent( entindex(), m_hParent );
+	}
+}
+
+void CServerNetworkProperty::OnRestore()
+{
+	UpdateHotData();
+}
+
+void CNetworkHotData::Clear( int iEdict )
+{
+	m_nAreaNum[iEdict] = 0;
+	m_nAreaNum2[iEdict] = 0;
+	m_Clusters[iEdict].m_nHeadNode = 0;
+	m_Clusters[iEdict].m_nClusterCount = 0;
+	m_Clusters[iEdict].m_pClusters = NULL;
+	m_hParent[iEdict].Term();
+}
+
+void CNetworkHotData::SetPVSInfo( int iEdict, const PVSInfo_t &info )
+{
+	m_nAreaNum[iEdict] = info.m_nAreaNum;
+	m_nAreaNum2[iEdict] = info.m_nAreaNum2;
+
+	NetworkClusterList_t &clusters = m_Clusters[iEdict];
+	clusters.m_nHeadNode = info.m_nHeadNode;
+	clusters.m_nClusterCount = info.m_nClusterCount;
+	clusters.m_pClusters = info.m_pClusters;
+	if ( info.m_nClusterCount > 0 && info.m_nClusterCount <= MAX_FAST_ENT_CLUSTERS )
+	{
+		memcpy( clusters.m_Clusters, info.m_pClusters, info.m_nClusterCount * sizeof( unsigned short ) );
 	}
 }
 
+int CNetworkHotData::GetParent( int iEdict ) const
+{
+	const CBaseHandle &hParent = m_hParent[iEdict];
+	if ( !hParent.IsValid() || hParent.GetEntryIndex() >= MAX_EDICTS || !g_pEntityList->LookupEntity( hParent ) )
+		return -1;
+
+	return hParent.GetEntryIndex();
+}
+
 
 //-----------------------------------------------------------------------------
 // Serverclass
@@ -281,6 +338,68 @@ bool CServerNetworkProperty::IsInPVS( const CCheckTransmitInfo *pInfo )
 }
 
 
+//-----------------------------------------------------------------------------
+// PVS: CServerNetworkProperty::IsInPVS on the hot data
+//-----------------------------------------------------------------------------
+bool CNetworkHotData::IsInPVS( int iEdict, const CCheckTransmitInfo *pInfo ) const
+{
+	int i;
+	int nAreaNum = m_nAreaNum[iEdict];
+	int nAreaNum2 = m_nAreaNum2[iEdict];
+
+	// Early out if the areas are connected
+	if ( !nAreaNum2 )
+	{
+		for ( i=0; i< pInfo->m_AreasNetworked; i++ )
+		{
+			int clientArea = pInfo->m_Areas[i];
+			if ( clientArea == nAreaNum || engine->CheckAreasConnected( clientArea, nAreaNum ) )
+				break;
+		}
+	}
+	else
+	{
+		// doors can legally straddle two areas
+		for ( i=0; i< pInfo->m_AreasNetworked; i++ )
+		{
+			int clientArea = pInfo->m_Areas[i];
+			if ( clientArea == nAreaNum || clientArea == nAreaNum2 )
+				break;
+
+			if ( engine->CheckAreasConnected( clientArea, nAreaNum ) )
+				break;
+
+			if ( engine->CheckAreasConnected( clientArea, nAreaNum2 ) )
+				break;
+		}
+	}
+
+	if ( i == pInfo->m_AreasNetworked )
+	{
+		// areas not connected
+		return false;
+	}
+
+	const NetworkClusterList_t &clusters = m_Clusters[iEdict];
+	unsigned char *pPVS = ( unsigned char * )pInfo->m_PVS;
+
+	if ( clusters.m_nClusterCount < 0 )   // too many clusters, use headnode
+	{
+		return (engine->CheckHeadnodeVisible( clusters.m_nHeadNode, pPVS, pInfo->m_nPVSSize ) != 0);
+	}
+
+	const unsigned short *pClusters = ( clusters.m_nClusterCount <= MAX_FAST_ENT_CLUSTERS ) ? clusters.m_Clusters : clusters.m_pClusters;
+	for ( i = clusters.m_nClusterCount; --i >= 0; )
+	{
+		int nCluster = pClusters[i];
+		if ( ((int)(pPVS[nCluster >> 3])) & BitVec_BitInByte( nCluster ) )
+			return true;
+	}
+
+	return false;		// not visible
+}
+
+
 void CServerNetworkProperty::SetUpdateInterval( float val )
 {
 	if ( val == 0 )
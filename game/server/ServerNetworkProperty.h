@@ -16,6 +16,48 @@
 #include "edict.h"
 #include "timedeventmgr.h"
 
+class CCheckTransmitInfo;
+
+
+//-----------------------------------------------------------------------------
+// Copies of the networkable state CServerGameEnts::CheckTransmit looks at, one
+// array per field, indexed by edict. The transmit loop can cull entities
+// with these without touching them. CServerNetworkProperty keeps its slot up
+// to date; the transmit state flags stay in the edicts, which are dense already.
+//-----------------------------------------------------------------------------
+struct NetworkClusterList_t
+{
+	short					m_nHeadNode;
+	short					m_nClusterCount;		// -1 if too many, use the headnode
+	unsigned short			m_Clusters[MAX_FAST_ENT_CLUSTERS];
+	const unsigned short	*m_pClusters;			// the networkable's own list if there are more
+};
+
+class CNetworkHotData
+{
+public:
+	void	Clear( int iEdict );
+	void	SetPVSInfo( int iEdict, const PVSInfo_t &info );
+	void	SetParent( int iEdict, const CBaseHandle &hParent );
+
+	// Edict index of the network parent, -1 if there is none
+	int		GetParent( int iEdict ) const;
+
+	// Same as CServerNetworkProperty::IsInPVS, the PVS information must be up to date
+	bool	IsInPVS( int iEdict, const CCheckTransmitInfo *pInfo ) const;
+
+	int		AreaNum( int iEdict ) const;
+
+private:
+	short					m_nAreaNum[MAX_EDICTS];
+	short					m_nAreaNum2[MAX_EDICTS];
+	NetworkClusterList_t	m_Clusters[MAX_EDICTS];
+	CBaseHandle				m_hParent[MAX_EDICTS];
+};
+
+extern CNetworkHotData g_NetworkHotData;
+
+
 //
 // Lightweight base class for networkable data on the server.
 //
@@ -101,6 +143,9 @@ public:
 	// Recomputes PVS information
 	void RecomputePVSInformation();
 
+	// Brings the hot data back in line with restored fields
+	void OnRestore();
+
 private:
 	// Detaches the edict.. should only be called by CBaseNetworkable's destructor.
 	void DetachEdict();
@@ -109,6 +154,9 @@ private:
 	// Marks the networkable that it will should transmit
 	void SetTransmit( CCheckTransmitInfo *pInfo );
 
+	// Copies this networkable into g_NetworkHotData
+	void UpdateHotData();
+
 private:
 	CBaseEntity *m_pOuter;
 	// CBaseTransmitProxy *m_pTransmitProxy;
@@ -170,6 +218,10 @@ inline void CServerNetworkProperty::MarkPVSInformationDirty()
 inline void CServerNetworkProperty::SetNetworkParent( EHANDLE hParent )
 {
 	m_hParent = hParent;
+	if ( m_pPev )
+	{
+		g_NetworkHotData.SetParent( entindex(), hParent );
+	}
 }
 
 
@@ -245,6 +297,7 @@ inline const edict_t *CServerNetworkProperty::edict() const
 inline void CServerNetworkProperty::SetEdict( edict_t *pEdict )
 {
 	m_pPev = pEdict;
+	UpdateHotData();
 }
 
 
@@ -255,4 +308,18 @@ inline int CServerNetworkProperty::AreaNum() const
 }
 
 
+//-----------------------------------------------------------------------------
+// Hot data accessors
+//-----------------------------------------------------------------------------
+inline void CNetworkHotData::SetParent( int iEdict, const CBaseHandle &hParent )
+{
+	m_hParent[iEdict] = hParent;
+}
+
+inline int CNetworkHotData::AreaNum( int iEdict ) const
+{
+	return m_nAreaNum[iEdict];
+}
+
+
 #endif // SERVERNETWORKPROPERTY_H
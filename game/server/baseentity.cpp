@@ -613,6 +613,13 @@ CBaseEntity *CBaseEntity::GetFollowedEntity()
 void CBaseEntity::SetClassname( const char *className )
 {
 	m_iClassname = AllocPooledString( className );
+	gEntList.UpdateEntityNames( this );
+}
+
+void CBaseEntity::SetName( string_t newName )
+{
+	m_iName = newName;
+	gEntList.UpdateEntityNames( this );
 }
 
 void CBaseEntity::SetModelIndex( int index )
@@ -3258,6 +3265,8 @@ void CBaseEntity::OnRestore()
 #endif
 
 	SimThink_EntityChanged( this );
+	gEntList.UpdateEntityNames( this );
+	NetworkProp()->OnRestore();
 
 	// touchlinks get recomputed
 	if ( IsEFlagSet( EFL_CHECK_UNTOUCH ) )
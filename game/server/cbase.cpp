@@ -644,8 +644,7 @@ CEventQueue g_EventQueue;
 
 CEventQueue::CEventQueue()
 {
-	m_Events.m_flFireTime = -FLT_MAX;
-	m_Events.m_pNext = NULL;
+	m_nNextSerial = 0;
 
 	Init();
 }
@@ -759,21 +758,25 @@ void CEventQueue::Init( void )
 void CEventQueue::Clear( void )
 {
 	// delete all the events in the queue
-	EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext;
-	
-	while ( pe != NULL )
+	for ( int i = 0; i < m_Heap.Count(); i++ )
 	{
-		EventQueuePrioritizedEvent_t *next = pe->m_pNext;
-		delete pe;
-		pe = next;
+		delete m_Heap[i];
 	}
 
-	m_Events.m_pNext = NULL;
+	m_Heap.RemoveAll();
+	for ( int i = 0; i < EVENTQUEUE_NUM_INDEXES; i++ )
+	{
+		m_Indexes[i].RemoveAll();
+	}
+
+	memset( &m_CurTick, 0, sizeof( m_CurTick ) );
+	memset( &m_LastTick, 0, sizeof( m_LastTick ) );
 }
 
 void CEventQueue::Dump( void )
 {
-	EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext;
+	CUtlVector< EventQueuePrioritizedEvent_t * > events;
+	GetEventsInFireOrder( events );
 
 	Msg("Dumping event queue. Current time is: %.2f\n",
 #ifdef TF_DLL
@@ -783,9 +786,12 @@ void CEventQueue::Dump( void )
 #endif
 		);
 
-	while ( pe != NULL )
+	Msg("%d events pending. Last tick: %d added, %d fired, %d cancelled, peak %d pending.\n",
+		events.Count(), m_LastTick.m_nAdded, m_LastTick.m_nFired, m_LastTick.m_nCancelled, m_LastTick.m_nPeakCount );
+
+	for ( int i = 0; i < events.Count(); i++ )
 	{
-		EventQueuePrioritizedEvent_t *next = pe->m_pNext;
+		EventQueuePrioritizedEvent_t *pe = events[i];
 
 		Msg("   (%.2f) Target: '%s', Input: '%s', Parameter '%s'. Activator: '%s', Caller '%s'.  \n", 
 			pe->m_flFireTime, 
@@ -794,8 +800,6 @@ void CEventQueue::Dump( void )
 			pe->m_VariantValue.String(),
 			pe->m_pActivator ? pe->m_pActivator->GetDebugName() : "None", 
 			pe->m_pCaller ? pe->m_pCaller->GetDebugName() : "None"  );
-
-		pe = next;
 	}
 
 	Msg("Finished dump.\n");
@@ -862,35 +866,195 @@ void CEventQueue::AddEvent( CBaseEntity *target, const char *action, float fireD
 //-----------------------------------------------------------------------------
 void CEventQueue::AddEvent( EventQueuePrioritizedEvent_t *newEvent )
 {
-	// loop through the actions looking for a place to insert
-	EventQueuePrioritizedEvent_t *pe;
-	for ( pe = &m_Events; pe->m_pNext != NULL; pe = pe->m_pNext )
+	// events with the same fire time go after the ones already queued
+	newEvent->m_nSerial = m_nNextSerial++;
+
+	int iIndex = m_Heap.AddToTail( newEvent );
+	HeapUp( iIndex );
+
+	for ( int i = 0; i < EVENTQUEUE_NUM_INDEXES; i++ )
 	{
-		if ( pe->m_pNext->m_flFireTime > newEvent->m_flFireTime )
-		{
+		LinkIndex( i, newEvent );
+	}
+
+	m_CurTick.m_nAdded++;
+	m_CurTick.m_nPeakCount = MAX( m_CurTick.m_nPeakCount, m_Heap.Count() );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: private function, takes an event out of the queue without deleting it
+//-----------------------------------------------------------------------------
+void CEventQueue::RemoveEvent( EventQueuePrioritizedEvent_t *pe )
+{
+	int iIndex = pe->m_iHeapIndex;
+	Assert( m_Heap[iIndex] == pe );
+
+	// move the last event into the hole and let it settle
+	int iLast = m_Heap.Count() - 1;
+	if ( iIndex != iLast )
+	{
+		SetHeapIndex( iIndex, m_Heap[iLast] );
+	}
+	m_Heap.Remove( iLast );
+
+	if ( iIndex < m_Heap.Count() )
+	{
+		HeapUp( iIndex );
+		HeapDown( iIndex );
+	}
+
+	for ( int i = 0; i < EVENTQUEUE_NUM_INDEXES; i++ )
+	{
+		UnlinkIndex( i, pe );
+	}
+}
+
+bool CEventQueue::FiresBefore( const EventQueuePrioritizedEvent_t *pA, const EventQueuePrioritizedEvent_t *pB )
+{
+	if ( pA->m_flFireTime != pB->m_flFireTime )
+		return pA->m_flFireTime < pB->m_flFireTime;
+
+	// serial numbers may wrap
+	return (int)( pA->m_nSerial - pB->m_nSerial ) < 0;
+}
+
+int __cdecl CEventQueue::SortFireOrder( EventQueuePrioritizedEvent_t * const *ppA, EventQueuePrioritizedEvent_t * const *ppB )
+{
+	if ( FiresBefore( *ppA, *ppB ) )
+		return -1;
+	if ( FiresBefore( *ppB, *ppA ) )
+		return 1;
+	return 0;
+}
+
+void CEventQueue::SetHeapIndex( int iIndex, EventQueuePrioritizedEvent_t *pe )
+{
+	m_Heap[iIndex] = pe;
+	pe->m_iHeapIndex = iIndex;
+}
+
+void CEventQueue::HeapUp( int iIndex )
+{
+	EventQueuePrioritizedEvent_t *pe = m_Heap[iIndex];
+	while ( iIndex > 0 )
+	{
+		int iParent = ( iIndex - 1 ) / 2;
+		if ( !FiresBefore( pe, m_Heap[iParent] ) )
 			break;
+
+		SetHeapIndex( iIndex, m_Heap[iParent] );
+		iIndex = iParent;
+	}
+	SetHeapIndex( iIndex, pe );
+}
+
+void CEventQueue::HeapDown( int iIndex )
+{
+	EventQueuePrioritizedEvent_t *pe = m_Heap[iIndex];
+	int nCount = m_Heap.Count();
+	while ( true )
+	{
+		int iChild = iIndex * 2 + 1;
+		if ( iChild >= nCount )
+			break;
+
+		if ( iChild + 1 < nCount && FiresBefore( m_Heap[iChild + 1], m_Heap[iChild] ) )
+		{
+			iChild++;
 		}
+
+		if ( !FiresBefore( m_Heap[iChild], pe ) )
+			break;
+
+		SetHeapIndex( iIndex, m_Heap[iChild] );
+		iIndex = iChild;
 	}
+	SetHeapIndex( iIndex, pe );
+}
 
-	Assert( pe );
+//-----------------------------------------------------------------------------
+// Purpose: copies the pending events out in the order they will fire
+//-----------------------------------------------------------------------------
+void CEventQueue::GetEventsInFireOrder( CUtlVector< EventQueuePrioritizedEvent_t * > &events )
+{
+	events.CopyArray( m_Heap.Base(), m_Heap.Count() );
+	events.Sort( SortFireOrder );
+}
+
+int CEventQueue::GetIndexKey( const EventQueuePrioritizedEvent_t *pe, int iIndex )
+{
+	if ( iIndex == EVENTQUEUE_INDEX_CALLER )
+		return pe->m_pCaller.ToInt();
+
+	return pe->m_pEntTarget.ToInt();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: returns the first pending event with the entity as caller or target
+//-----------------------------------------------------------------------------
+EventQueuePrioritizedEvent_t *CEventQueue::FindInIndex( int iIndex, CBaseEntity *pEntity )
+{
+	EventIndex_t &index = m_Indexes[iIndex];
+	UtlHashHandle_t h = index.Find( pEntity->GetRefEHandle().ToInt() );
+	if ( h == index.InvalidHandle() )
+		return NULL;
+
+	return index[h];
+}
+
+void CEventQueue::LinkIndex( int iIndex, EventQueuePrioritizedEvent_t *pe )
+{
+	pe->m_pNextInIndex[iIndex] = NULL;
+	pe->m_pPrevInIndex[iIndex] = NULL;
+
+	int iKey = GetIndexKey( pe, iIndex );
+	if ( iKey == (int)INVALID_EHANDLE_INDEX )
+		return;
 
-	// insert
-	newEvent->m_pNext = pe->m_pNext;
-	newEvent->m_pPrev = pe;
-	pe->m_pNext = newEvent;
-	if ( newEvent->m_pNext )
+	EventIndex_t &index = m_Indexes[iIndex];
+	UtlHashHandle_t h = index.Find( iKey );
+	if ( h == index.InvalidHandle() )
 	{
-		newEvent->m_pNext->m_pPrev = newEvent;
+		index.Insert( iKey, pe );
+		return;
 	}
+
+	EventQueuePrioritizedEvent_t *pHead = index[h];
+	pe->m_pNextInIndex[iIndex] = pHead;
+	pHead->m_pPrevInIndex[iIndex] = pe;
+	index[h] = pe;
 }
 
-void CEventQueue::RemoveEvent( EventQueuePrioritizedEvent_t *pe )
+void CEventQueue::UnlinkIndex( int iIndex, EventQueuePrioritizedEvent_t *pe )
 {
-	Assert( pe->m_pPrev );
-	pe->m_pPrev->m_pNext = pe->m_pNext;
-	if ( pe->m_pNext )
+	int iKey = GetIndexKey( pe, iIndex );
+	if ( iKey == (int)INVALID_EHANDLE_INDEX )
+		return;
+
+	EventQueuePrioritizedEvent_t *pNext = pe->m_pNextInIndex[iIndex];
+	EventQueuePrioritizedEvent_t *pPrev = pe->m_pPrevInIndex[iIndex];
+	if ( pNext )
 	{
-		pe->m_pNext->m_pPrev = pe->m_pPrev;
+		pNext->m_pPrevInIndex[iIndex] = pPrev;
+	}
+
+	if ( pPrev )
+	{
+		pPrev->m_pNextInIndex[iIndex] = pNext;
+		return;
+	}
+
+	// it was the head of its chain
+	EventIndex_t &index = m_Indexes[iIndex];
+	UtlHashHandle_t h = index.Find( iKey );
+	Assert( h != index.InvalidHandle() && index[h] == pe );
+	if ( pNext )
+	{
+		index[h] = pNext;
+	}
+	else
+	{
+		index.RemoveByHandle( h );
 	}
 }
 
@@ -900,21 +1064,28 @@ void CEventQueue::RemoveEvent( EventQueuePrioritizedEvent_t *pe )
 //-----------------------------------------------------------------------------
 void CEventQueue::ServiceEvents( void )
 {
+	m_LastTick = m_CurTick;
+	memset( &m_CurTick, 0, sizeof( m_CurTick ) );
+	m_CurTick.m_nPeakCount = m_Heap.Count();
+
 	if (!CBaseEntity::Debug_ShouldStep())
 	{
 		return;
 	}
 
-	EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext;
-
 #ifdef TF_DLL
-	while ( pe != NULL && pe->m_flFireTime <= engine->GetServerTime() )
+	while ( m_Heap.Count() && m_Heap[0]->m_flFireTime <= engine->GetServerTime() )
 #else
-	while ( pe != NULL && pe->m_flFireTime <= gpGlobals->curtime )
+	while ( m_Heap.Count() && m_Heap[0]->m_flFireTime <= gpGlobals->curtime )
 #endif
 	{
 		MDLCACHE_CRITICAL_SECTION();
 
+		// take the event out of the queue before firing it, the inputs may add to or cancel from the queue
+		EventQueuePrioritizedEvent_t *pe = m_Heap[0];
+		RemoveEvent( pe );
+		m_CurTick.m_nFired++;
+
 		bool targetFound = false;
 
 		// find the targets
@@ -978,8 +1149,6 @@ void CEventQueue::ServiceEvents( void )
 			ADD_DEBUG_HISTORY( HISTORY_ENTITY_IO, szBuffer );
 		}
 
-		// remove the event from the list (remembering that the queue may have been added to)
-		RemoveEvent( pe );
 		delete pe;
 
 		//
@@ -992,9 +1161,6 @@ void CEventQueue::ServiceEvents( void )
 				break;
 			}
 		}
-
-		// restart the list (to catch any new items have probably been added to the queue)
-		pe = m_Events.m_pNext;	
 	}
 }
 
@@ -1022,30 +1188,17 @@ void CEventQueue::CancelEvents( CBaseEntity *pCaller )
 	if (!pCaller)
 		return;
 
-	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	// every event in the caller's chain matches
+	EventQueuePrioritizedEvent_t *pCur = FindInIndex( EVENTQUEUE_INDEX_CALLER, pCaller );
 
 	while (pCur != NULL)
 	{
-		bool bDelete = false;
-		if (pCur->m_pCaller == pCaller)
-		{
-			// Pointers match; make sure everything else matches.
-			if (!stricmp(STRING(pCur->m_pCaller->GetEntityName()), STRING(pCaller->GetEntityName())) &&
-				!stricmp(pCur->m_pCaller->GetClassname(), pCaller->GetClassname()))
-			{
-				// Found a matching event; delete it from the queue.
-				bDelete = true;
-			}
-		}
-
 		EventQueuePrioritizedEvent_t *pCurSave = pCur;
-		pCur = pCur->m_pNext;
+		pCur = pCur->m_pNextInIndex[EVENTQUEUE_INDEX_CALLER];
 
-		if (bDelete)
-		{
-			RemoveEvent( pCurSave );
-			delete pCurSave;
-		}
+		RemoveEvent( pCurSave );
+		delete pCurSave;
+		m_CurTick.m_nCancelled++;
 	}
 }
 
@@ -1060,27 +1213,25 @@ void CEventQueue::CancelEventOn( CBaseEntity *pTarget, const char *sInputName )
 	if (!pTarget)
 		return;
 
-	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	EventQueuePrioritizedEvent_t *pCur = FindInIndex( EVENTQUEUE_INDEX_TARGET, pTarget );
 
 	while (pCur != NULL)
 	{
 		bool bDelete = false;
-		if (pCur->m_pEntTarget == pTarget)
+		if ( !Q_strncmp( STRING(pCur->m_iTargetInput), sInputName, strlen(sInputName) ) )
 		{
-			if ( !Q_strncmp( STRING(pCur->m_iTargetInput), sInputName, strlen(sInputName) ) )
-			{
-				// Found a matching event; delete it from the queue.
-				bDelete = true;
-			}
+			// Found a matching event; delete it from the queue.
+			bDelete = true;
 		}
 
 		EventQueuePrioritizedEvent_t *pCurSave = pCur;
-		pCur = pCur->m_pNext;
+		pCur = pCur->m_pNextInIndex[EVENTQUEUE_INDEX_TARGET];
 
 		if (bDelete)
 		{
 			RemoveEvent( pCurSave );
 			delete pCurSave;
+			m_CurTick.m_nCancelled++;
 		}
 	}
 }
@@ -1095,20 +1246,17 @@ bool CEventQueue::HasEventPending( CBaseEntity *pTarget, const char *sInputName
 	if (!pTarget)
 		return false;
 
-	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	EventQueuePrioritizedEvent_t *pCur = FindInIndex( EVENTQUEUE_INDEX_TARGET, pTarget );
 
 	while (pCur != NULL)
 	{
-		if (pCur->m_pEntTarget == pTarget)
-		{
-			if ( !sInputName )
-				return true;
+		if ( !sInputName )
+			return true;
 
-			if ( !Q_strncmp( STRING(pCur->m_iTargetInput), sInputName, strlen(sInputName) ) )
-				return true;
-		}
+		if ( !Q_strncmp( STRING(pCur->m_iTargetInput), sInputName, strlen(sInputName) ) )
+			return true;
 
-		pCur = pCur->m_pNext;
+		pCur = pCur->m_pNextInIndex[EVENTQUEUE_INDEX_TARGET];
 	}
 
 	return false;
@@ -1126,7 +1274,7 @@ void ServiceEventQueue( void )
 // save data description for the event queue
 BEGIN_SIMPLE_DATADESC( CEventQueue )
 	// These are saved explicitly in CEventQueue::Save below
-	// DEFINE_FIELD( m_Events, EventQueuePrioritizedEvent_t ),
+	// DEFINE_FIELD( m_Heap, EventQueuePrioritizedEvent_t ),
 
 	DEFINE_FIELD( m_iListCount, FIELD_INTEGER ),	// this value is only used during save/restore
 END_DATADESC()
@@ -1143,29 +1291,27 @@ BEGIN_SIMPLE_DATADESC( EventQueuePrioritizedEvent_t )
 	DEFINE_FIELD( m_iOutputID, FIELD_INTEGER ),
 	DEFINE_CUSTOM_FIELD( m_VariantValue, variantFuncs ),
 
-//	DEFINE_FIELD( m_pNext, FIELD_??? ),
-//	DEFINE_FIELD( m_pPrev, FIELD_??? ),
+//	DEFINE_FIELD( m_nSerial, FIELD_INTEGER ),		// the restore re-adds events in the saved order
+//	DEFINE_FIELD( m_iHeapIndex, FIELD_INTEGER ),
 END_DATADESC()
 
 
 int CEventQueue::Save( ISave &save )
 {
-	// count the number of items in the queue
-	EventQueuePrioritizedEvent_t *pe;
+	// save the events in the order they fire, so the restore keeps the order of events with the same fire time
+	CUtlVector< EventQueuePrioritizedEvent_t * > events;
+	GetEventsInFireOrder( events );
 
-	m_iListCount = 0;
-	for ( pe = m_Events.m_pNext; pe != NULL; pe = pe->m_pNext )
-	{
-		m_iListCount++;
-	}
+	m_iListCount = events.Count();
 
 	// save that value out to disk, so we know how many to restore
 	if ( !save.WriteFields( "EventQueue", this, NULL, m_DataMap.dataDesc, m_DataMap.dataNumFields ) )
 		return 0;
 	
 	// cycle through all the events, saving them all
-	for ( pe = m_Events.m_pNext; pe != NULL; pe = pe->m_pNext )
+	for ( int i = 0; i < events.Count(); i++ )
 	{
+		EventQueuePrioritizedEvent_t *pe = events[i];
 		if ( !save.WriteFields( "PEvent", pe, NULL, pe->m_DataMap.dataDesc, pe->m_DataMap.dataNumFields ) )
 			return 0;
 	}
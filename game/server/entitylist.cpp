@@ -17,6 +17,7 @@
 #include "ai_initutils.h"
 #include "globalstate.h"
 #include "datacache/imdlcache.h"
+#include "bitvec.h"
 
 #ifdef HL2_DLL
 #include "npc_playercompanion.h"
@@ -123,10 +124,238 @@ void AimTarget_ForceRepopulateList()
 }
 
 
+// Schedules entries (entinfo indices) by the tick they next need to run on. Level 0
+// has a slot per tick, each coarser level has a slot per 64 slots of the level below.
+// When the wheel reaches a slot its entries cascade down a level, so an entry is only
+// touched a few times no matter how far out it was scheduled. Entries scheduled at or
+// before the current tick sit on the due list until they are rescheduled or removed.
+class CThinkTimerWheel
+{
+public:
+	enum
+	{
+		INVALID_INDEX = 0xFFFF,
+
+		LEVEL0_BITS = 8,
+		LEVEL_BITS = 6,
+		NUM_LEVELS = 4,
+		LEVEL0_SLOTS = 1 << LEVEL0_BITS,
+		LEVEL_SLOTS = 1 << LEVEL_BITS,
+
+		BUCKET_DUE = LEVEL0_SLOTS + (NUM_LEVELS - 1) * LEVEL_SLOTS,
+		BUCKET_OVERFLOW,		// too far out for the top level, looked at again each time it cascades
+		NUM_BUCKETS,
+
+		MAX_ADVANCE_TICKS = LEVEL0_SLOTS,	// larger jumps (level load, restore) rebuild the wheel
+	};
+
+	CThinkTimerWheel()
+	{
+		Clear( 0 );
+	}
+
+	void Clear( int nTick )
+	{
+		for ( int i = 0; i < ARRAYSIZE(m_nHead); i++ )
+		{
+			m_nHead[i] = INVALID_INDEX;
+		}
+		for ( int i = 0; i < ARRAYSIZE(m_nodes); i++ )
+		{
+			m_nodes[i].bucket = INVALID_INDEX;
+		}
+		m_nTick = nTick;
+	}
+
+	bool IsScheduled( int index ) const
+	{
+		return m_nodes[index].bucket != INVALID_INDEX;
+	}
+
+	// Adds the entry or moves it to a new tick
+	void Schedule( int index, int nTick )
+	{
+		if ( IsScheduled( index ) )
+		{
+			if ( m_nodes[index].nTick == nTick )
+				return;
+			Unlink( index );
+		}
+		m_nodes[index].nTick = nTick;
+		Link( index, GetBucket( nTick ) );
+	}
+
+	void Remove( int index )
+	{
+		if ( IsScheduled( index ) )
+		{
+			Unlink( index );
+		}
+	}
+
+	// After this everything scheduled at or before nTick is on the due list
+	void AdvanceTo( int nTick )
+	{
+		if ( nTick < m_nTick || nTick - m_nTick > MAX_ADVANCE_TICKS )
+		{
+			Rebuild( nTick );
+			return;
+		}
+
+		while ( m_nTick < nTick )
+		{
+			m_nTick++;
+			Turn();
+		}
+	}
+
+	int FirstDue() const
+	{
+		return m_nHead[BUCKET_DUE];
+	}
+
+	int NextDue( int index ) const
+	{
+		Assert( m_nodes[index].bucket == BUCKET_DUE );
+		return m_nodes[index].next;
+	}
+
+private:
+	struct node_t
+	{
+		int				nTick;
+		unsigned short	next;
+		unsigned short	prev;
+		unsigned short	bucket;
+	};
+
+	static int LevelShift( int nLevel )
+	{
+		return LEVEL0_BITS + (nLevel - 1) * LEVEL_BITS;
+	}
+
+	static int LevelBucket( int nLevel, int nTick )
+	{
+		return LEVEL0_SLOTS + (nLevel - 1) * LEVEL_SLOTS + ((nTick >> LevelShift( nLevel )) & (LEVEL_SLOTS - 1));
+	}
+
+	int GetBucket( int nTick ) const
+	{
+		int delta = nTick - m_nTick;
+		if ( delta <= 0 )
+			return BUCKET_DUE;
+
+		if ( delta < LEVEL0_SLOTS )
+			return nTick & (LEVEL0_SLOTS - 1);
+
+		for ( int nLevel = 1; nLevel < NUM_LEVELS; nLevel++ )
+		{
+			if ( delta < (1 << (LevelShift( nLevel ) + LEVEL_BITS)) )
+				return LevelBucket( nLevel, nTick );
+		}
+		return BUCKET_OVERFLOW;
+	}
+
+	void Link( int index, int bucket )
+	{
+		node_t &node = m_nodes[index];
+		node.bucket = bucket;
+		node.prev = INVALID_INDEX;
+		node.next = m_nHead[bucket];
+		if ( node.next != INVALID_INDEX )
+		{
+			m_nodes[node.next].prev = index;
+		}
+		m_nHead[bucket] = index;
+	}
+
+	void Unlink( int index )
+	{
+		node_t &node = m_nodes[index];
+		if ( node.prev != INVALID_INDEX )
+		{
+			m_nodes[node.prev].next = node.next;
+		}
+		else
+		{
+			m_nHead[node.bucket] = node.next;
+		}
+		if ( node.next != INVALID_INDEX )
+		{
+			m_nodes[node.next].prev = node.prev;
+		}
+		node.bucket = INVALID_INDEX;
+	}
+
+	// re-files everything in a bucket against the current tick
+	void Cascade( int bucket )
+	{
+		int index = m_nHead[bucket];
+		m_nHead[bucket] = INVALID_INDEX;
+		while ( index != INVALID_INDEX )
+		{
+			int next = m_nodes[index].next;
+			Link( index, GetBucket( m_nodes[index].nTick ) );
+			index = next;
+		}
+	}
+
+	// called once per tick after m_nTick moved forward
+	void Turn()
+	{
+		// coarse levels first, their entries can land in the finer slots that cascade next
+		if ( !(m_nTick & ((1 << LevelShift( NUM_LEVELS - 1 )) - 1)) )
+		{
+			Cascade( BUCKET_OVERFLOW );
+		}
+		for ( int nLevel = NUM_LEVELS - 1; nLevel > 0; nLevel-- )
+		{
+			if ( !(m_nTick & ((1 << LevelShift( nLevel )) - 1)) )
+			{
+				Cascade( LevelBucket( nLevel, m_nTick ) );
+			}
+		}
+
+		// everything left in this tick's slot is due now
+		int index = m_nHead[m_nTick & (LEVEL0_SLOTS - 1)];
+		m_nHead[m_nTick & (LEVEL0_SLOTS - 1)] = INVALID_INDEX;
+		while ( index != INVALID_INDEX )
+		{
+			int next = m_nodes[index].next;
+			Assert( m_nodes[index].nTick == m_nTick );
+			Link( index, BUCKET_DUE );
+			index = next;
+		}
+	}
+
+	void Rebuild( int nTick )
+	{
+		m_nTick = nTick;
+		for ( int i = 0; i < ARRAYSIZE(m_nHead); i++ )
+		{
+			m_nHead[i] = INVALID_INDEX;
+		}
+		for ( int i = 0; i < ARRAYSIZE(m_nodes); i++ )
+		{
+			if ( m_nodes[i].bucket != INVALID_INDEX )
+			{
+				Link( i, GetBucket( m_nodes[i].nTick ) );
+			}
+		}
+	}
+
+	int				m_nTick;
+	unsigned short	m_nHead[NUM_BUCKETS];
+	node_t			m_nodes[NUM_ENT_ENTRIES];
+};
+
+
 // Manages a list of all entities currently doing game simulation or thinking
 // NOTE: This is usually a small subset of the global entity list, so it's
 // an optimization to maintain this list incrementally rather than polling each
 // frame.
+// Entities that only think are kept on a timer wheel by their first think tick,
+// so finding the ones due this tick doesn't touch the ones that aren't.
 struct simthinkentry_t
 {
 	unsigned short	entEntry;
@@ -147,6 +376,7 @@ public:
 		{
 			m_entinfoIndex[i] = 0xFFFF;
 		}
+		m_thinkWheel.Clear( 0 );
 	}
 	void LevelInitPreEntity()
 	{
@@ -177,6 +407,7 @@ public:
 			Assert(m_simThinkList[listHandle].entEntry == index);
 			m_simThinkList.FastRemove( listHandle );
 			m_entinfoIndex[index] = 0xFFFF;
+			m_thinkWheel.Remove( index );
 			
 			// fast remove shifted someone, update that someone
 			if ( listHandle < m_simThinkList.Count() )
@@ -192,21 +423,26 @@ public:
 
 	int ListCopy( CBaseEntity *pList[], int listMax )
 	{
+		// The wheel's due list has every entity that will simulate or think this frame.
+		// Copy them out in list order so they run in the same order as before.
+		m_thinkWheel.AdvanceTo( gpGlobals->tickcount );
+		m_dueHandles.ClearAll();
+		for ( int index = m_thinkWheel.FirstDue(); index != CThinkTimerWheel::INVALID_INDEX; index = m_thinkWheel.NextDue( index ) )
+		{
+			m_dueHandles.Set( m_entinfoIndex[index] );
+		}
+
 		int count = MIN(listMax, ListCount());
 		int out = 0;
-		for ( int i = 0; i < count; i++ )
+		for ( int i = m_dueHandles.FindNextSetBit( 0 ); i >= 0 && i < count; i = m_dueHandles.FindNextSetBit( i + 1 ) )
 		{
-			// only copy out entities that will simulate or think this frame
-			if ( m_simThinkList[i].nextThinkTick <= gpGlobals->tickcount )
-			{
-				Assert(m_simThinkList[i].nextThinkTick>=0);
-				int entinfoIndex = m_simThinkList[i].entEntry;
-				const CEntInfo *pInfo = gEntList.GetEntInfoPtrByIndex( entinfoIndex );
-				pList[out] = (CBaseEntity *)pInfo->m_pEntity;
-				Assert(m_simThinkList[i].nextThinkTick==0 || pList[out]->GetFirstThinkTick()==m_simThinkList[i].nextThinkTick);
-				Assert( gEntList.IsEntityPtr( pList[out] ) );
-				out++;
-			}
+			Assert(m_simThinkList[i].nextThinkTick>=0);
+			int entinfoIndex = m_simThinkList[i].entEntry;
+			const CEntInfo *pInfo = gEntList.GetEntInfoPtrByIndex( entinfoIndex );
+			pList[out] = (CBaseEntity *)pInfo->m_pEntity;
+			Assert(m_simThinkList[i].nextThinkTick==0 || pList[out]->GetFirstThinkTick()==m_simThinkList[i].nextThinkTick);
+			Assert( gEntList.IsEntityPtr( pList[out] ) );
+			out++;
 		}
 
 		return out;
@@ -255,12 +491,17 @@ public:
 					m_simThinkList[m_entinfoIndex[index]].nextThinkTick = 0;
 				}
 			}
+
+			// simulating entities stay due every tick, thinkers wait on the wheel
+			m_thinkWheel.Schedule( index, m_simThinkList[m_entinfoIndex[index]].nextThinkTick );
 		}
 	}
 
 private:
 	unsigned short m_entinfoIndex[NUM_ENT_ENTRIES];
 	CUtlVector<simthinkentry_t>	m_simThinkList;
+	CThinkTimerWheel m_thinkWheel;
+	CBitVec<NUM_ENT_ENTRIES> m_dueHandles;
 };
 
 CSimThinkManager g_SimThinkManager;
@@ -290,10 +531,125 @@ CBaseEntityClassList::~CBaseEntityClassList()
 {
 }
 
+CEntityNameIndex::CEntityNameIndex()
+{
+	Purge();
+}
+
+void CEntityNameIndex::Purge()
+{
+	m_Chains.Purge();
+	for ( int i = 0; i < ARRAYSIZE(m_Nodes); i++ )
+	{
+		m_Nodes[i].pszName = NULL;
+	}
+}
+
+void CEntityNameIndex::Update( int iSlot, const char *pszName, unsigned int nListOrder )
+{
+	node_t &node = m_Nodes[iSlot];
+	if ( node.pszName && pszName && !Q_stricmp( node.pszName, pszName ) )
+		return;
+
+	Remove( iSlot );
+	if ( !pszName || !pszName[0] )
+		return;
+
+	// Keep a pooled copy, the entity's string isn't necessarily pooled
+	pszName = STRING( AllocPooledString( pszName ) );
+
+	UtlHashHandle_t hChain = m_Chains.Find( pszName );
+	if ( hChain == m_Chains.InvalidHandle() )
+	{
+		chain_t empty = { INVALID_SLOT, INVALID_SLOT };
+		hChain = m_Chains.Insert( pszName, empty );
+	}
+	chain_t &chain = m_Chains[hChain];
+
+	// New entities go on the end, renamed ones walk back to their place in the list
+	unsigned short prev = chain.tail;
+	while ( prev != INVALID_SLOT && m_Nodes[prev].nListOrder > nListOrder )
+	{
+		prev = m_Nodes[prev].prev;
+	}
+
+	node.pszName = pszName;
+	node.nListOrder = nListOrder;
+	node.prev = prev;
+	node.next = ( prev != INVALID_SLOT ) ? m_Nodes[prev].next : chain.head;
+
+	if ( node.prev != INVALID_SLOT )
+		m_Nodes[node.prev].next = iSlot;
+	else
+		chain.head = iSlot;
+
+	if ( node.next != INVALID_SLOT )
+		m_Nodes[node.next].prev = iSlot;
+	else
+		chain.tail = iSlot;
+}
+
+void CEntityNameIndex::Remove( int iSlot )
+{
+	node_t &node = m_Nodes[iSlot];
+	if ( !node.pszName )
+		return;
+
+	UtlHashHandle_t hChain = m_Chains.Find( node.pszName );
+	Assert( hChain != m_Chains.InvalidHandle() );
+	chain_t &chain = m_Chains[hChain];
+
+	if ( node.prev != INVALID_SLOT )
+		m_Nodes[node.prev].next = node.next;
+	else
+		chain.head = node.next;
+
+	if ( node.next != INVALID_SLOT )
+		m_Nodes[node.next].prev = node.prev;
+	else
+		chain.tail = node.prev;
+
+	if ( chain.head == INVALID_SLOT )
+	{
+		m_Chains.RemoveByHandle( hChain );
+	}
+
+	node.pszName = NULL;
+}
+
+int CEntityNameIndex::FindNext( const char *pszName, int iStartSlot, unsigned int nStartOrder ) const
+{
+	UtlHashHandle_t hChain = m_Chains.Find( pszName );
+	if ( hChain == m_Chains.InvalidHandle() )
+		return -1;
+
+	unsigned short next = m_Chains[hChain].head;
+	if ( iStartSlot >= 0 )
+	{
+		// Searches usually continue from the last match, which is in this chain
+		const node_t &start = m_Nodes[iStartSlot];
+		if ( start.pszName && !Q_stricmp( start.pszName, pszName ) )
+		{
+			next = start.next;
+		}
+		else
+		{
+			while ( next != INVALID_SLOT && m_Nodes[next].nListOrder <= nStartOrder )
+			{
+				next = m_Nodes[next].next;
+			}
+		}
+	}
+
+	return ( next != INVALID_SLOT ) ? next : -1;
+}
+
+
 CGlobalEntityList::CGlobalEntityList()
 {
 	m_iHighestEnt = m_iNumEnts = m_iNumEdicts = 0;
 	m_bClearingEntities = false;
+	m_nNextListOrder = 0;
 }
 
 
@@ -481,6 +837,14 @@ bool CGlobalEntityList::IsEntityPtr( void *pTest )
 //-----------------------------------------------------------------------------
 CBaseEntity *CGlobalEntityList::FindEntityByClassname( CBaseEntity *pStartEntity, const char *szName )
 {
+	// Wildcards and the empty name still need to look at every entity
+	if ( szName && szName[0] && !strchr( szName, '*' ) )
+	{
+		int iStartSlot = pStartEntity ? pStartEntity->GetRefEHandle().GetEntryIndex() : -1;
+		int iSlot = m_ClassnameIndex.FindNext( szName, iStartSlot, ( iStartSlot >= 0 ) ? m_nListOrder[iStartSlot] : 0 );
+		return ( iSlot >= 0 ) ? (CBaseEntity *)GetEntInfoPtrByIndex( iSlot )->m_pEntity : NULL;
+	}
+
 	const CEntInfo *pInfo = pStartEntity ? GetEntInfoPtr( pStartEntity->GetRefEHandle() )->m_pNext : FirstEntInfo();
 
 	for ( ;pInfo; pInfo = pInfo->m_pNext )
@@ -590,6 +954,20 @@ CBaseEntity *CGlobalEntityList::FindEntityByName( CBaseEntity *pStartEntity, con
 
 		return NULL;
 	}
+
+	if ( !strchr( szName, '*' ) )
+	{
+		int iSlot = pStartEntity ? pStartEntity->GetRefEHandle().GetEntryIndex() : -1;
+		while ( ( iSlot = m_TargetnameIndex.FindNext( szName, iSlot, ( iSlot >= 0 ) ? m_nListOrder[iSlot] : 0 ) ) >= 0 )
+		{
+			CBaseEntity *ent = (CBaseEntity *)GetEntInfoPtrByIndex( iSlot )->m_pEntity;
+			if ( pFilter && !pFilter->ShouldFindEntity(ent) )
+				continue;
+
+			return ent;
+		}
+		return NULL;
+	}
 	
 	const CEntInfo *pInfo = pStartEntity ? GetEntInfoPtr( pStartEntity->GetRefEHandle() )->m_pNext : FirstEntInfo();
 
@@ -1088,6 +1466,9 @@ void CGlobalEntityList::OnAddEntity( IHandleEntity *pEnt, CBaseHandle handle )
 	if ( i > m_iHighestEnt )
 		m_iHighestEnt = i;
 
+	// the entity list appends, so this slot is now the last one
+	m_nListOrder[i] = m_nNextListOrder++;
+
 	// If it's a CBaseEntity, notify the listeners.
 	CBaseEntity *pBaseEnt = static_cast<IServerUnknown*>(pEnt)->GetBaseEntity();
 	if ( pBaseEnt->edict() )
@@ -1095,6 +1476,8 @@ void CGlobalEntityList::OnAddEntity( IHandleEntity *pEnt, CBaseHandle handle )
 	
 	// NOTE: Must be a CBaseEntity on server
 	Assert( pBaseEnt );
+	UpdateEntityNames( pBaseEnt );
+
 	//DevMsg(2,"Created %s\n", pBaseEnt->GetClassname() );
 	for ( i = m_entityListeners.Count()-1; i >= 0; i-- )
 	{
@@ -1126,6 +1509,9 @@ void CGlobalEntityList::OnRemoveEntity( IHandleEntity *pEnt, CBaseHandle handle
 		m_iNumEdicts--;
 
 	m_iNumEnts--;
+
+	m_ClassnameIndex.Remove( handle.GetEntryIndex() );
+	m_TargetnameIndex.Remove( handle.GetEntryIndex() );
 }
 
 void CGlobalEntityList::NotifyCreateEntity( CBaseEntity *pEnt )
@@ -1145,6 +1531,9 @@ void CGlobalEntityList::NotifySpawn( CBaseEntity *pEnt )
 	if ( !pEnt )
 		return;
 
+	// keyvalues can write the classname straight into the entity
+	UpdateEntityNames( pEnt );
+
 	//DevMsg(2,"Deleted %s\n", pBaseEnt->GetClassname() );
 	for ( int i = m_entityListeners.Count()-1; i >= 0; i-- )
 	{
@@ -1152,6 +1541,18 @@ void CGlobalEntityList::NotifySpawn( CBaseEntity *pEnt )
 	}
 }
 
+void CGlobalEntityList::UpdateEntityNames( CBaseEntity *pEnt )
+{
+	// entities that aren't in the list yet get filed when they're added
+	const CBaseHandle &hEnt = pEnt->GetRefEHandle();
+	if ( !hEnt.IsValid() || LookupEntity( hEnt ) != pEnt )
+		return;
+
+	int iSlot = hEnt.GetEntryIndex();
+	m_ClassnameIndex.Update( iSlot, pEnt->GetClassname(), m_nListOrder[iSlot] );
+	m_TargetnameIndex.Update( iSlot, STRING( pEnt->GetEntityName() ), m_nListOrder[iSlot] );
+}
+
 // NOTE: This doesn't happen in OnRemoveEntity() specifically because 
 // listeners may want to reference the object as it's being deleted
 // OnRemoveEntity isn't called until the destructor and all data is invalid.
@@ -14,6 +14,7 @@
 #endif
 
 #include "baseentity.h"
+#include "utlhashtable.h"
 
 class IEntityListener;
 
@@ -66,6 +67,49 @@ public:
 	virtual CBaseEntity *GetFilterResult( void ) = 0;
 };
 
+//-----------------------------------------------------------------------------
+// Purpose: Finds the entities with a given classname or targetname without
+//			walking the whole entity list. The entities of each name are chained
+//			in entity list order, so searches return them in the same order
+//			as a scan of the list would.
+//-----------------------------------------------------------------------------
+class CEntityNameIndex
+{
+public:
+	CEntityNameIndex();
+
+	void	Purge();
+
+	// Files the slot under pszName (NULL or empty removes it). nListOrder is the
+	// slot's position in the entity list, larger is later.
+	void	Update( int iSlot, const char *pszName, unsigned int nListOrder );
+	void	Remove( int iSlot );
+
+	// Returns the first slot with this name that comes after iStartSlot in the
+	// entity list (iStartSlot -1 starts at the beginning), or -1.
+	int		FindNext( const char *pszName, int iStartSlot, unsigned int nStartOrder ) const;
+
+private:
+	enum { INVALID_SLOT = 0xFFFF };
+
+	struct chain_t
+	{
+		unsigned short	head;
+		unsigned short	tail;
+	};
+
+	struct node_t
+	{
+		const char		*pszName;	// pooled copy, NULL if the slot isn't indexed
+		unsigned int	nListOrder;
+		unsigned short	next;
+		unsigned short	prev;
+	};
+
+	CUtlHashtable< const char *, chain_t, CaselessStringHashFunctor, CaselessStringEqualFunctor > m_Chains;
+	node_t m_Nodes[NUM_ENT_ENTRIES];
+};
+
 //-----------------------------------------------------------------------------
 // Purpose: a global list of all the entities in the game.  All iteration through
 //			entities is done through this object.
@@ -81,6 +125,12 @@ private:
 	bool m_bClearingEntities;
 	CUtlVector<IEntityListener *>	m_entityListeners;
 
+	// Position of each slot in the entity list, for the name lookups
+	unsigned int m_nListOrder[NUM_ENT_ENTRIES];
+	unsigned int m_nNextListOrder;
+	CEntityNameIndex m_ClassnameIndex;
+	CEntityNameIndex m_TargetnameIndex;
+
 public:
 	IServerNetworkable* GetServerNetworkable( CBaseHandle hEnt ) const;
 	CBaseNetworkable* GetBaseNetworkable( CBaseHandle hEnt ) const;
@@ -112,6 +162,10 @@ public:
 	void NotifyCreateEntity( CBaseEntity *pEnt );
 	void NotifySpawn( CBaseEntity *pEnt );
 	void NotifyRemoveEntity( CBaseHandle hEnt );
+
+	// re-files the entity in the classname and targetname lookups after either changed
+	void UpdateEntityNames( CBaseEntity *pEnt );
+
 	// iteration functions
 
 	// returns the next entity after pCurrentEnt;  if pCurrentEnt is NULL, return the first entity
@@ -15,6 +15,16 @@
 #endif
 
 #include "mempool.h"
+#include "utlvector.h"
+#include "utlhashtable.h"
+
+enum EventQueueIndex_t
+{
+	EVENTQUEUE_INDEX_CALLER = 0,
+	EVENTQUEUE_INDEX_TARGET,		// only events targeting an entity by pointer
+
+	EVENTQUEUE_NUM_INDEXES
+};
 
 struct EventQueuePrioritizedEvent_t
 {
@@ -28,8 +38,12 @@ struct EventQueuePrioritizedEvent_t
 
 	variant_t m_VariantValue;	// variable-type parameter
 
-	EventQueuePrioritizedEvent_t *m_pNext;
-	EventQueuePrioritizedEvent_t *m_pPrev;
+	unsigned int m_nSerial;		// secondary priority key, keeps events with the same fire time in the order they were added
+	int m_iHeapIndex;
+
+	// chains of the pending events by caller and by target entity, see EventQueueIndex_t
+	EventQueuePrioritizedEvent_t *m_pNextInIndex[EVENTQUEUE_NUM_INDEXES];
+	EventQueuePrioritizedEvent_t *m_pPrevInIndex[EVENTQUEUE_NUM_INDEXES];
 
 	DECLARE_SIMPLE_DATADESC();
 
@@ -68,12 +82,40 @@ public:
 
 private:
 
+	typedef CUtlHashtable< int, EventQueuePrioritizedEvent_t * > EventIndex_t;
+
 	void AddEvent( EventQueuePrioritizedEvent_t *event );
 	void RemoveEvent( EventQueuePrioritizedEvent_t *pe );
 
+	// binary heap ordered by fire time, then by serial
+	static bool FiresBefore( const EventQueuePrioritizedEvent_t *pA, const EventQueuePrioritizedEvent_t *pB );
+	static int __cdecl SortFireOrder( EventQueuePrioritizedEvent_t * const *ppA, EventQueuePrioritizedEvent_t * const *ppB );
+	void HeapUp( int iIndex );
+	void HeapDown( int iIndex );
+	void SetHeapIndex( int iIndex, EventQueuePrioritizedEvent_t *pe );
+	void GetEventsInFireOrder( CUtlVector< EventQueuePrioritizedEvent_t * > &events );
+
+	static int GetIndexKey( const EventQueuePrioritizedEvent_t *pe, int iIndex );
+	EventQueuePrioritizedEvent_t *FindInIndex( int iIndex, CBaseEntity *pEntity );
+	void LinkIndex( int iIndex, EventQueuePrioritizedEvent_t *pe );
+	void UnlinkIndex( int iIndex, EventQueuePrioritizedEvent_t *pe );
+
 	DECLARE_SIMPLE_DATADESC();
-	EventQueuePrioritizedEvent_t m_Events;
+	CUtlVector< EventQueuePrioritizedEvent_t * > m_Heap;
+	EventIndex_t m_Indexes[EVENTQUEUE_NUM_INDEXES];		// chain heads keyed by ehandle
+	unsigned int m_nNextSerial;
 	int m_iListCount;
+
+	// per tick counters, the previous tick's values are shown by dumpeventqueue
+	struct TickCounters_t
+	{
+		int m_nAdded;
+		int m_nFired;
+		int m_nCancelled;
+		int m_nPeakCount;
+	};
+	TickCounters_t m_CurTick;
+	TickCounters_t m_LastTick;
 };
 
 extern CEventQueue g_EventQueue;
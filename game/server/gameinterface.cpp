@@ -2439,12 +2439,29 @@ inline void CServerNetworkProperty::CheckTransmit( CCheckTransmitInfo *pInfo )
 	}
 } */
 
+//-----------------------------------------------------------------------------
+// Brings an edict's hot data up to date if its PVS information is dirty
+//-----------------------------------------------------------------------------
+static inline void CheckTransmit_RecomputePVSInformation( edict_t *pEdict )
+{
+	if ( pEdict->m_fStateFlags & FL_EDICT_DIRTY_PVS_INFORMATION )
+	{
+		CServerNetworkProperty *pNetProp = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
+		if ( pNetProp )
+		{
+			pNetProp->RecomputePVSInformation();
+		}
+	}
+}
+
 void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts )
 {
 	// NOTE: for speed's sake, this assumes that all networkables are CBaseEntities and that the edict list
 	// is consecutive in memory. If either of these things change, then this routine needs to change, but
 	// ideally we won't be calling any virtual from this routine. This speedy routine was added as an
 	// optimization which would be nice to keep.
+	// Culling reads the state flags from the edicts and everything else from g_NetworkHotData,
+	// entities are only touched for FL_EDICT_FULLCHECK and to mark them for sending.
 	edict_t *pBaseEdict = engine->PEntityOfEntIndex( 0 );
 
 	// get recipient player's skybox:
@@ -2487,7 +2504,7 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 		{
 			// FIXME: Hey! Shouldn't this be using SetTransmit so as 
 			// to also force network down dependent entities?
-			while ( true )
+			while ( iEdict >= 0 )
 			{
 				// mark entity for sending
 				pInfo->m_pTransmitEdict->Set( iEdict );
@@ -2498,16 +2515,7 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 					pInfo->m_pTransmitAlways->Set( iEdict );
 				}
 #endif	
-				CServerNetworkProperty *pEnt = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
-				if ( !pEnt )
-					break;
-
-				CServerNetworkProperty *pParent = pEnt->GetNetworkParent();
-				if ( !pParent )
-					break;
-
-				pEdict = pParent->edict();
-				iEdict = pParent->entindex();
+				iEdict = g_NetworkHotData.GetParent( iEdict );
 			}
 			continue;
 		}
@@ -2534,13 +2542,14 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 		if ( !( nFlags & FL_EDICT_PVSCHECK ) )
 			continue;
 
-		CServerNetworkProperty *netProp = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
+		// Ensures that PVS data is up to date for this entity
+		CheckTransmit_RecomputePVSInformation( pEdict );
 
 #ifndef _X360
 		if ( bIsHLTV || bIsReplay )
 		{
 			// for the HLTV/Replay we don't cull against PVS
-			if ( netProp->AreaNum() == skyBoxArea )
+			if ( g_NetworkHotData.AreaNum( iEdict ) == skyBoxArea )
 			{
 				pEnt->SetTransmit( pInfo, true );
 			}
@@ -2553,15 +2562,14 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 #endif
 
 		// Always send entities in the player's 3d skybox.
-		// Sidenote: call of AreaNum() ensures that PVS data is up to date for this entity
-		bool bSameAreaAsSky = netProp->AreaNum() == skyBoxArea;
+		bool bSameAreaAsSky = g_NetworkHotData.AreaNum( iEdict ) == skyBoxArea;
 		if ( bSameAreaAsSky )
 		{
 			pEnt->SetTransmit( pInfo, true );
 			continue;
 		}
 
-		bool bInPVS = netProp->IsInPVS( pInfo );
+		bool bInPVS = g_NetworkHotData.IsInPVS( iEdict, pInfo );
 		if ( bInPVS || sv_force_transmit_ents.GetBool() )
 		{
 			// only send if entity is in PVS
@@ -2571,43 +2579,40 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 
 		// If the entity is marked "check PVS" but it's in hierarchy, walk up the hierarchy looking for the
 		//  for any parent which is also in the PVS.  If none are found, then we don't need to worry about sending ourself
-		CBaseEntity *orig = pEnt;
-		CServerNetworkProperty *check = netProp->GetNetworkParent();
+		int checkIndex = g_NetworkHotData.GetParent( iEdict );
 
 		// BUG BUG:  I think it might be better to build up a list of edict indices which "depend" on other answers and then
 		// resolve them in a second pass.  Not sure what happens if an entity has two parents who both request PVS check?
-        while ( check )
+		while ( checkIndex >= 0 )
 		{
-			int checkIndex = check->entindex();
-
 			// Parent already being sent
 			if ( pInfo->m_pTransmitEdict->Get( checkIndex ) )
 			{
-				orig->SetTransmit( pInfo, true );
+				pEnt->SetTransmit( pInfo, true );
 				break;
 			}
 
-			edict_t *checkEdict = check->edict();
+			edict_t *checkEdict = &pBaseEdict[checkIndex];
 			int checkFlags = checkEdict->m_fStateFlags & (FL_EDICT_DONTSEND|FL_EDICT_ALWAYS|FL_EDICT_PVSCHECK|FL_EDICT_FULLCHECK);
 			if ( checkFlags & FL_EDICT_DONTSEND )
 				break;
 
 			if ( checkFlags & FL_EDICT_ALWAYS )
 			{
-				orig->SetTransmit( pInfo, true );
+				pEnt->SetTransmit( pInfo, true );
 				break;
 			}
 
 			if ( checkFlags == FL_EDICT_FULLCHECK )
 			{
 				// do a full ShouldTransmit() check, may return FL_EDICT_CHECKPVS
-				CBaseEntity *pCheckEntity = check->GetBaseEntity();
+				CBaseEntity *pCheckEntity = ( CBaseEntity * )checkEdict->GetUnknown();
 				nFlags = pCheckEntity->ShouldTransmit( pInfo );
 				Assert( !(nFlags & FL_EDICT_FULLCHECK) );
 				if ( nFlags & FL_EDICT_ALWAYS )
 				{
 					pCheckEntity->SetTransmit( pInfo, true );
-					orig->SetTransmit( pInfo, true );
+					pEnt->SetTransmit( pInfo, true );
 				}
 				break;
 			}
@@ -2615,17 +2620,17 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 			if ( checkFlags & FL_EDICT_PVSCHECK )
 			{
 				// Check pvs
-				check->RecomputePVSInformation();
-				bool bMoveParentInPVS = check->IsInPVS( pInfo );
+				CheckTransmit_RecomputePVSInformation( checkEdict );
+				bool bMoveParentInPVS = g_NetworkHotData.IsInPVS( checkIndex, pInfo );
 				if ( bMoveParentInPVS )
 				{
-					orig->SetTransmit( pInfo, true );
+					pEnt->SetTransmit( pInfo, true );
 					break;
 				}
 			}
 
 			// Continue up chain just in case the parent itself has a parent that's in the PVS...
-			check = check->GetNetworkParent();
+			checkIndex = g_NetworkHotData.GetParent( checkIndex );
 		}
 	}
 
@@ -277,8 +277,26 @@ float UTIL_GetSimulationInterval()
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
+#define UTIL_ENTITY_QUERY_MAX	1024		// candidates fetched by one bulk partition query
+
+static int UTIL_EnumerateCandidates( IHandleEntity **ppCandidates, int nCandidates, CFlaggedEntitiesEnum *pEnum )
+{
+	for ( int i = 0; i < nCandidates; ++i )
+	{
+		if ( pEnum->EnumElement( ppCandidates[i] ) == ITERATION_STOP )
+			break;
+	}
+	return pEnum->GetCount();
+}
+
 int UTIL_EntitiesInBox( const Vector &mins, const Vector &maxs, CFlaggedEntitiesEnum *pEnum )
 {
+	IHandleEntity *pCandidates[UTIL_ENTITY_QUERY_MAX];
+	int nCandidates = partition->GetElementsInBox( PARTITION_ENGINE_NON_STATIC_EDICTS, mins, maxs, pCandidates, ARRAYSIZE( pCandidates ) );
+	if ( nCandidates < ARRAYSIZE( pCandidates ) )
+		return UTIL_EnumerateCandidates( pCandidates, nCandidates, pEnum );
+
+	// The list may have been cut off
 	partition->EnumerateElementsInBox( PARTITION_ENGINE_NON_STATIC_EDICTS, mins, maxs, false, pEnum );
 	return pEnum->GetCount();
 }
@@ -291,6 +309,12 @@ int UTIL_EntitiesAlongRay( const Ray_t &ray, CFlaggedEntitiesEnum *pEnum )
 
 int UTIL_EntitiesInSphere( const Vector &center, float radius, CFlaggedEntitiesEnum *pEnum )
 {
+	IHandleEntity *pCandidates[UTIL_ENTITY_QUERY_MAX];
+	int nCandidates = partition->GetElementsInSphere( PARTITION_ENGINE_NON_STATIC_EDICTS, center, radius, pCandidates, ARRAYSIZE( pCandidates ) );
+	if ( nCandidates < ARRAYSIZE( pCandidates ) )
+		return UTIL_EnumerateCandidates( pCandidates, nCandidates, pEnum );
+
+	// The list may have been cut off
 	partition->EnumerateElementsInSphere( PARTITION_ENGINE_NON_STATIC_EDICTS, center, radius, false, pEnum );
 	return pEnum->GetCount();
 }
@@ -45,6 +45,47 @@ float IntersectRayWithTriangle( const Ray_t& ray,
 		                        const Vector& v1, const Vector& v2, const Vector& v3, 
 								bool oneSided );
 
+// SIMD version, 4 triangles against a ray without extents. Same math as above,
+// returns the fraction of each hit or -1.
+FORCEINLINE fltx4 IntersectRayWithFourTriangles( const FourVectors &rayStart, const FourVectors &rayDelta, const FourVectors &v1, const FourVectors &v2, const FourVectors &v3, bool bOneSided )
+{
+	FourVectors edge1 = v2;
+	edge1 -= v1;
+	FourVectors edge2 = v3;
+	edge2 -= v1;
+
+	// the denominator of Cramer's rule, IntersectRayWithTriangle skips |denom| < 1e-6
+	FourVectors dirCrossEdge2 = rayDelta ^ edge2;
+	fltx4 denom = dirCrossEdge2 * edge1;
+	fltx4 active = CmpGtSIMD( fabs( denom ), ReplicateX4( 1e-6f ) );
+
+	if ( bOneSided )
+	{
+		FourVectors normal = edge1 ^ edge2;
+		active = AndSIMD( active, CmpLtSIMD( normal * rayDelta, Four_Zeros ) );
+	}
+
+	fltx4 invDenom = DivSIMD( Four_Ones, denom );
+	FourVectors org = rayStart;
+	org -= v1;
+
+	// barycentric u and v have to be inside the triangle
+	fltx4 u = MulSIMD( dirCrossEdge2 * org, invDenom );
+	active = AndSIMD( active, AndSIMD( CmpGeSIMD( u, Four_Zeros ), CmpLeSIMD( u, Four_Ones ) ) );
+
+	FourVectors orgCrossEdge1 = org ^ edge1;
+	fltx4 v = MulSIMD( orgCrossEdge1 * rayDelta, invDenom );
+	active = AndSIMD( active, AndSIMD( CmpGeSIMD( v, Four_Zeros ), CmpLeSIMD( AddSIMD( v, u ), Four_Ones ) ) );
+
+	// the same fudge ComputeBoxOffset uses for rays
+	fltx4 boxT = ReplicateX4( 1e-3f );
+	fltx4 t = MulSIMD( orgCrossEdge1 * edge2, invDenom );
+	active = AndSIMD( active, AndSIMD( CmpGeSIMD( t, NegSIMD( boxT ) ), CmpLeSIMD( t, AddSIMD( Four_Ones, boxT ) ) ) );
+
+	t = MinSIMD( MaxSIMD( t, Four_Zeros ), Four_Ones );
+	return MaskedAssign( active, t, Four_NegativeOnes );
+}
+
 //-----------------------------------------------------------------------------
 //
 // ComputeIntersectionBarycentricCoordinates
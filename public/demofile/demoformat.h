@@ -16,6 +16,8 @@
 
 #define DEMO_HEADER_ID		"HL2DEMO"
 #define DEMO_PROTOCOL		3
+#define DEMO_PROTOCOL_BLOCKS	4	// same commands, stored in compressed blocks (see demoblocktrailer_t)
+#define DEMO_PROTOCOL_KEYFRAMES	5	// adds dem_keyframe and the keyframe index (see demokeyframetrailer_t)
 
 #if !defined( MAX_OSPATH )
 #define	MAX_OSPATH		260			// max length of a filesystem pathname
@@ -41,8 +43,11 @@ enum
 
 	dem_stringtables,
 
+	// full client state to restore when seeking, see CDemoFile::WriteKeyframe
+	dem_keyframe,
+
 	// Last command
-	dem_lastcmd		= dem_stringtables
+	dem_lastcmd		= dem_keyframe
 };
 
 struct demoheader_t
@@ -70,6 +75,82 @@ inline void ByteSwap_demoheader_t( demoheader_t &swap )
 	swap.signonlength = LittleDWord( swap.signonlength );
 }
 
+// Block compressed demos (DEMO_PROTOCOL_BLOCKS) keep the header uncompressed
+// at the start of the file, followed by the command stream split into
+// independently compressed blocks. Blocks always start on a command boundary.
+// The file ends with an array of demoblock_t and a demoblocktrailer_t, so any
+// position in the command stream can be found without decompressing the
+// blocks in front of it.
+#define DEMO_BLOCKS_ID			(('K'<<24)+('L'<<16)+('B'<<8)+'D')	// little-endian "DBLK"
+#define DEMO_BLOCK_SIZE			(256*1024)	// blocks are closed once they reach this size
+
+#define FDEMOBLOCK_STORED		0			// raw bytes
+#define FDEMOBLOCK_COMPRESSED	(1<<0)		// COM_BufferToBufferCompress_Snappy output
+
+struct demoblock_t
+{
+	int		dataoffset;		// offset of the first byte in the uncompressed stream
+	int		datalength;		// uncompressed length
+	int		fileoffset;		// where the block starts in the file
+	int		filelength;		// length in the file
+	int		flags;			// FDEMOBLOCK_*
+};
+
+struct demoblocktrailer_t
+{
+	int		id;				// DEMO_BLOCKS_ID
+	int		numblocks;		// number of demoblock_t in the index
+	int		indexoffset;	// file offset of the index
+	int		datalength;		// total length of the uncompressed stream, header included
+};
+
+inline void ByteSwap_demoblock_t( demoblock_t &swap )
+{
+	swap.dataoffset = LittleDWord( swap.dataoffset );
+	swap.datalength = LittleDWord( swap.datalength );
+	swap.fileoffset = LittleDWord( swap.fileoffset );
+	swap.filelength = LittleDWord( swap.filelength );
+	swap.flags = LittleDWord( swap.flags );
+}
+
+inline void ByteSwap_demoblocktrailer_t( demoblocktrailer_t &swap )
+{
+	swap.id = LittleDWord( swap.id );
+	swap.numblocks = LittleDWord( swap.numblocks );
+	swap.indexoffset = LittleDWord( swap.indexoffset );
+	swap.datalength = LittleDWord( swap.datalength );
+}
+
+// Demos with keyframes end with an index of them after the dem_stop command,
+// so players can jump to the closest keyframe instead of reading every
+// packet in front of a tick. Only demos that have keyframes are written as
+// DEMO_PROTOCOL_KEYFRAMES, all others stay DEMO_PROTOCOL for older readers.
+#define DEMO_KEYFRAMES_ID		(('F'<<24)+('Y'<<16)+('E'<<8)+'K')	// little-endian "KEYF"
+
+struct demokeyframe_t
+{
+	int		tick;			// recording tick of the keyframe
+	int		offset;			// stream offset of its dem_keyframe command
+};
+
+struct demokeyframetrailer_t
+{
+	int		id;				// DEMO_KEYFRAMES_ID
+	int		numkeyframes;	// number of demokeyframe_t in front of the trailer
+};
+
+inline void ByteSwap_demokeyframe_t( demokeyframe_t &swap )
+{
+	swap.tick = LittleDWord( swap.tick );
+	swap.offset = LittleDWord( swap.offset );
+}
+
+inline void ByteSwap_demokeyframetrailer_t( demokeyframetrailer_t &swap )
+{
+	swap.id = LittleDWord( swap.id );
+	swap.numkeyframes = LittleDWord( swap.numkeyframes );
+}
+
 #define FDEMO_NORMAL		0
 #define FDEMO_USE_ORIGIN2	(1<<0)
 #define FDEMO_USE_ANGLES2	(1<<1)
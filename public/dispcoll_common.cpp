@@ -149,7 +149,7 @@ void CDispCollTri::FindMinMax( CDispVector<Vector> &m_aVerts )
 
 
 // SIMD Routines for intersecting with the quad tree
-FORCEINLINE int IntersectRayWithFourBoxes( const FourVectors &rayStart, const FourVectors &invDelta, const FourVectors &rayExtents, const FourVectors &boxMins, const FourVectors &boxMaxs )
+FORCEINLINE int IntersectRayWithFourBoxes( const FourVectors &rayStart, const FourVectors &invDelta, const FourVectors &rayExtents, const fltx4 &endFrac, const FourVectors &boxMins, const FourVectors &boxMaxs )
 {
 	// SIMD Test ray against all four boxes at once
 	// each node stores the bboxes of its four children
@@ -180,7 +180,7 @@ FORCEINLINE int IntersectRayWithFourBoxes( const FourVectors &rayStart, const Fo
 	fltx4 boxExitT = MinSIMD(maxTemp, exitT.z);
 
 	boxEntryT = MaxSIMD(boxEntryT,Four_Zeros);
-	boxExitT = MinSIMD(boxExitT,Four_Ones);
+	boxExitT = MinSIMD(boxExitT,endFrac);
 
 	// if entry<=exit for the box, we've got a hit
 	fltx4 active = CmpLeSIMD(boxEntryT,boxExitT);			// mask of which boxes are active
@@ -243,6 +243,31 @@ FORCEINLINE int IntersectFourBoxSpherePairs( const FourVectors &center, const fl
 	return TestSignSIMD(active);
 }
 
+// This does the early outs of SweepAABBTriIntersect for 4 triangles at once: the box
+// moving away from the face, or staying outside one of the triangle's axial planes for
+// the whole sweep. Returns the mask of triangles that still need the full test. Every
+// comparison has DISPCOLL_DIST_EPSILON of slack, so with fast math rounding differently
+// than the scalar test it only keeps more triangles, never drops one the full test hits.
+FORCEINLINE int SweepAABBWithFourTriangleBounds( const FourVectors &rayStart, const FourVectors &rayDelta, const FourVectors &rayExtents, const FourVectors &triNormals, const FourVectors &triMins, const FourVectors &triMaxs )
+{
+	fltx4 slack = ReplicateX4( DISPCOLL_DIST_EPSILON );
+	fltx4 active = CmpLeSIMD( triNormals * rayDelta, AddSIMD( slack, slack ) );
+
+	for ( int iAxis = 0; iAxis < 3; ++iAxis )
+	{
+		// Min plane
+		fltx4 start = SubSIMD( SubSIMD( triMins[iAxis], rayExtents[iAxis] ), rayStart[iAxis] );
+		fltx4 end = SubSIMD( start, rayDelta[iAxis] );
+		active = AndSIMD( active, OrSIMD( CmpLeSIMD( start, slack ), CmpLeSIMD( end, slack ) ) );
+
+		// Max plane
+		start = SubSIMD( rayStart[iAxis], AddSIMD( triMaxs[iAxis], rayExtents[iAxis] ) );
+		end = AddSIMD( start, rayDelta[iAxis] );
+		active = AndSIMD( active, OrSIMD( CmpLeSIMD( start, slack ), CmpLeSIMD( end, slack ) ) );
+	}
+
+	return TestSignSIMD( active );
+}
 
 int FORCEINLINE CDispCollTree::BuildRayLeafList( int iNode, rayleaflist_t &list )
 {
@@ -257,7 +282,7 @@ int FORCEINLINE CDispCollTree::BuildRayLeafList( int iNode, rayleaflist_t &list
 			return listIndex;
 		listIndex++;
 		const CDispCollNode &node = m_nodes[iNode];
-		int mask = IntersectRayWithFourBoxes( list.rayStart, list.invDelta, list.rayExtents, node.m_mins, node.m_maxs );
+		int mask = IntersectRayWithFourBoxes( list.rayStart, list.invDelta, list.rayExtents, list.endFrac, node.m_mins, node.m_maxs );
 		if ( mask )
 		{
 			int child = Nodes_GetChild( iNode, 0 );
@@ -602,6 +627,7 @@ void CDispCollTree::AABBTree_TreeTrisRayBarycentricTest( const Ray_t &ray, const
 	list.rayStart.DuplicateVector(ray.m_Start);
 	Vector ext = ray.m_Extents + Vector(DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON);
 	list.rayExtents.DuplicateVector(ext);
+	list.endFrac = Four_Ones;
 	int listIndex = BuildRayLeafList( iNode, list );
 
 	float flU, flV, flT;
@@ -688,25 +714,67 @@ void CDispCollTree::AABBTree_TreeTrisRayTest( const Ray_t &ray, const Vector &ve
 	list.rayStart.DuplicateVector(ray.m_Start);
 	Vector ext = ray.m_Extents + Vector(DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON,DISPCOLL_DIST_EPSILON);
 	list.rayExtents.DuplicateVector(ext);
+	// Nothing past the current hit can be closer, the triangles are inside their boxes
+	list.endFrac = ReplicateX4( pTrace->fraction );
 	int listIndex = BuildRayLeafList( iNode, list );
 
-	for ( ;listIndex <= list.maxIndex; listIndex++ )
+	if ( !ray.m_IsRay )
 	{
-		int leafIndex = list.nodeList[listIndex] - m_nodes.Count();
-		CDispCollTri *pTri0 = &m_aTris[m_leaves[leafIndex].m_tris[0]];
-		CDispCollTri *pTri1 = &m_aTris[m_leaves[leafIndex].m_tris[1]];
-		float flFrac = IntersectRayWithTriangle( ray, m_aVerts[pTri0->GetVert( 0 )], m_aVerts[pTri0->GetVert( 2 )], m_aVerts[pTri0->GetVert( 1 )], bSide );
-		if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+		for ( ;listIndex <= list.maxIndex; listIndex++ )
 		{
-			pTrace->fraction = flFrac;
-			(*pImpactTri) = pTri0;
+			int leafIndex = list.nodeList[listIndex] - m_nodes.Count();
+			CDispCollTri *pTri0 = &m_aTris[m_leaves[leafIndex].m_tris[0]];
+			CDispCollTri *pTri1 = &m_aTris[m_leaves[leafIndex].m_tris[1]];
+			float flFrac = IntersectRayWithTriangle( ray, m_aVerts[pTri0->GetVert( 0 )], m_aVerts[pTri0->GetVert( 2 )], m_aVerts[pTri0->GetVert( 1 )], bSide );
+			if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+			{
+				pTrace->fraction = flFrac;
+				(*pImpactTri) = pTri0;
+			}
+			
+			flFrac = IntersectRayWithTriangle( ray, m_aVerts[pTri1->GetVert( 0 )], m_aVerts[pTri1->GetVert( 2 )], m_aVerts[pTri1->GetVert( 1 )], bSide );
+			if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+			{
+				pTrace->fraction = flFrac;
+				(*pImpactTri) = pTri1;
+			}
 		}
-		
-		flFrac = IntersectRayWithTriangle( ray, m_aVerts[pTri1->GetVert( 0 )], m_aVerts[pTri1->GetVert( 2 )], m_aVerts[pTri1->GetVert( 1 )], bSide );
-		if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+		return;
+	}
+
+	// Two leaves at a time, the last pass repeats a leaf if the count is odd
+	FourVectors rayDelta;
+	rayDelta.DuplicateVector( ray.m_Delta );
+	for ( ; listIndex <= list.maxIndex; listIndex += 2 )
+	{
+		int leafIndex0 = list.nodeList[listIndex] - m_nodes.Count();
+		int leafIndex1 = ( listIndex < list.maxIndex ) ? list.nodeList[listIndex + 1] - m_nodes.Count() : leafIndex0;
+		CDispCollTri *pTris[4] =
+		{
+			&m_aTris[m_leaves[leafIndex0].m_tris[0]],
+			&m_aTris[m_leaves[leafIndex0].m_tris[1]],
+			&m_aTris[m_leaves[leafIndex1].m_tris[0]],
+			&m_aTris[m_leaves[leafIndex1].m_tris[1]],
+		};
+
+		FourVectors v1, v2, v3;
+		v1.LoadAndSwizzle( m_aVerts[pTris[0]->GetVert( 0 )], m_aVerts[pTris[1]->GetVert( 0 )], m_aVerts[pTris[2]->GetVert( 0 )], m_aVerts[pTris[3]->GetVert( 0 )] );
+		v2.LoadAndSwizzle( m_aVerts[pTris[0]->GetVert( 2 )], m_aVerts[pTris[1]->GetVert( 2 )], m_aVerts[pTris[2]->GetVert( 2 )], m_aVerts[pTris[3]->GetVert( 2 )] );
+		v3.LoadAndSwizzle( m_aVerts[pTris[0]->GetVert( 1 )], m_aVerts[pTris[1]->GetVert( 1 )], m_aVerts[pTris[2]->GetVert( 1 )], m_aVerts[pTris[3]->GetVert( 1 )] );
+
+		fltx4 fracs = IntersectRayWithFourTriangles( list.rayStart, rayDelta, v1, v2, v3, bSide );
+		if ( !TestSignSIMD( CmpGeSIMD( fracs, Four_Zeros ) ) )
+			continue;
+
+		// same order as testing one triangle at a time, so ties resolve the same way
+		for ( int i = 0; i < 4; i++ )
 		{
-			pTrace->fraction = flFrac;
-			(*pImpactTri) = pTri1;
+			float flFrac = SubFloat( fracs, i );
+			if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+			{
+				pTrace->fraction = flFrac;
+				(*pImpactTri) = pTris[i];
+			}
 		}
 	}
 }
@@ -909,21 +977,62 @@ bool CDispCollTree::AABBTree_SweepAABB( const Ray_t &ray, const Vector &vecInvDe
 	list.rayStart.DuplicateVector(ray.m_Start);
 	Vector ext = ray.m_Extents + g_Vec3DispCollEpsilons;
 	list.rayExtents.DuplicateVector(ext);
+	list.endFrac = Four_Ones;
 	int listIndex = BuildRayLeafList( 0, list );
 
 	if ( listIndex <= list.maxIndex )
 	{
+		FourVectors rayStart, rayDelta, rayExtents;
+		rayStart.DuplicateVector( ray.m_Start );
+		rayDelta.DuplicateVector( ray.m_Delta );
+		rayExtents.DuplicateVector( ray.m_Extents );
+
 		LockCache();
-		for ( ; listIndex <= list.maxIndex; listIndex++ )
+		// Two leaves at a time, the cheap rejections are done for all four triangles
+		// at once and only the survivors get the full test, in the same order as before.
+		for ( ; listIndex <= list.maxIndex; listIndex += 2 )
 		{
-			int leafIndex = list.nodeList[listIndex] - m_nodes.Count();
-			int iTri0 = m_leaves[leafIndex].m_tris[0];
-			int iTri1 = m_leaves[leafIndex].m_tris[1];
-			CDispCollTri *pTri0 = &m_aTris[iTri0];
-			CDispCollTri *pTri1 = &m_aTris[iTri1];
+			bool bPair = ( listIndex < list.maxIndex );
+			int leafIndex0 = list.nodeList[listIndex] - m_nodes.Count();
+			int leafIndex1 = bPair ? list.nodeList[listIndex + 1] - m_nodes.Count() : leafIndex0;
+			int iTris[4] =
+			{
+				m_leaves[leafIndex0].m_tris[0],
+				m_leaves[leafIndex0].m_tris[1],
+				m_leaves[leafIndex1].m_tris[0],
+				m_leaves[leafIndex1].m_tris[1],
+			};
+
+			Vector vecTriMins[4], vecTriMaxs[4];
+			for ( int i = 0; i < 4; i++ )
+			{
+				const CDispCollTri *pTri = &m_aTris[iTris[i]];
+				for ( int iAxis = 0; iAxis < 3; ++iAxis )
+				{
+					vecTriMins[i][iAxis] = m_aVerts[pTri->GetVert( pTri->GetMin( iAxis ) )][iAxis];
+					vecTriMaxs[i][iAxis] = m_aVerts[pTri->GetVert( pTri->GetMax( iAxis ) )][iAxis];
+				}
+			}
+
+			FourVectors triNormals, triMins, triMaxs;
+			triNormals.LoadAndSwizzle( m_aTris[iTris[0]].m_vecNormal, m_aTris[iTris[1]].m_vecNormal, m_aTris[iTris[2]].m_vecNormal, m_aTris[iTris[3]].m_vecNormal );
+			triMins.LoadAndSwizzle( vecTriMins[0], vecTriMins[1], vecTriMins[2], vecTriMins[3] );
+			triMaxs.LoadAndSwizzle( vecTriMaxs[0], vecTriMaxs[1], vecTriMaxs[2], vecTriMaxs[3] );
 
-			SweepAABBTriIntersect( ray, rayDir, iTri0, pTri0, pTrace );
-			SweepAABBTriIntersect( ray, rayDir, iTri1, pTri1, pTrace );
+			int mask = SweepAABBWithFourTriangleBounds( rayStart, rayDelta, rayExtents, triNormals, triMins, triMaxs );
+			if ( !bPair )
+			{
+				// the second leaf is a copy of the first
+				mask &= 0x3;
+			}
+
+			for ( int i = 0; i < 4; i++ )
+			{
+				if ( mask & ( 1 << i ) )
+				{
+					SweepAABBTriIntersect( ray, rayDir, iTris[i], &m_aTris[iTris[i]], pTrace );
+				}
+			}
 		}
 		UnlockCache();
 	}
@@ -1490,6 +1599,91 @@ void CDispCollTree::GetVirtualMeshList( virtualmeshlist_t *pList )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Bytes SaveToBuffer writes for a tree of the given power
+//-----------------------------------------------------------------------------
+int CDispCollTree::GetBufferSize( int nPower )
+{
+	int nSize = sizeof( int );
+	if ( nPower == 0 )
+		return nSize;
+
+	int nWidth = ( 1 << nPower ) + 1;
+	int nLeaves = ( 1 << nPower ) * ( 1 << nPower );
+	int nNodes = ( ( 1 << ( ( nPower + 1 ) << 1 ) ) / 3 ) - nLeaves;
+	nSize += sizeof( int ) * 3 + sizeof( Vector ) * 7 + sizeof( unsigned int );
+	nSize += sizeof( Vector ) * nWidth * nWidth;
+	nSize += sizeof( CDispCollTri ) * nLeaves * 2;
+	nSize += sizeof( CDispCollNode ) * nNodes;
+	nSize += sizeof( CDispCollLeaf ) * nLeaves;
+	return nSize;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the tree as it is in memory, trees that were never created
+//			(power 0) only write the power
+//-----------------------------------------------------------------------------
+void CDispCollTree::SaveToBuffer( CUtlBuffer &buf )
+{
+	buf.PutInt( m_nPower );
+	if ( m_nPower == 0 )
+		return;
+
+	buf.PutInt( m_nFlags );
+	buf.PutInt( m_nContents );
+	buf.PutInt( m_nodes.Count() );
+	buf.Put( m_vecSurfPoints, sizeof( m_vecSurfPoints ) );
+	buf.Put( &m_vecStabDir, sizeof( m_vecStabDir ) );
+	buf.Put( &m_mins, sizeof( m_mins ) );
+	buf.Put( &m_maxs, sizeof( m_maxs ) );
+	buf.PutUnsignedInt( m_nSize );
+	buf.Put( m_aVerts.Base(), m_aVerts.Count() * sizeof( Vector ) );
+	buf.Put( m_aTris.Base(), m_aTris.Count() * sizeof( CDispCollTri ) );
+	buf.Put( m_nodes.Base(), m_nodes.Count() * sizeof( CDispCollNode ) );
+	buf.Put( m_leaves.Base(), m_leaves.Count() * sizeof( CDispCollLeaf ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Counterpart of SaveToBuffer, replaces AABBTree_Create
+//-----------------------------------------------------------------------------
+bool CDispCollTree::LoadFromBuffer( CUtlBuffer &buf )
+{
+	int nPower = buf.GetInt();
+	if ( nPower == 0 )
+		return buf.IsValid();
+
+	if ( nPower < 2 || nPower > 4 || buf.GetBytesRemaining() < GetBufferSize( nPower ) - (int)sizeof( int ) )
+		return false;
+
+	m_nPower = nPower;
+	m_nFlags = buf.GetInt();
+	m_nContents = buf.GetInt();
+	int nNodes = buf.GetInt();
+	buf.Get( m_vecSurfPoints, sizeof( m_vecSurfPoints ) );
+	buf.Get( &m_vecStabDir, sizeof( m_vecStabDir ) );
+	buf.Get( &m_mins, sizeof( m_mins ) );
+	buf.Get( &m_maxs, sizeof( m_maxs ) );
+	m_nSize = buf.GetUnsignedInt();
+
+	int numLeaves = ( GetWidth() - 1 ) * ( GetHeight() - 1 );
+	if ( nNodes != Nodes_CalcCount( m_nPower ) - numLeaves )
+		return false;
+
+	{
+	MEM_ALLOC_CREDIT();
+	m_aVerts.SetSize( GetSize() );
+	m_aTris.SetSize( GetTriSize() );
+	m_leaves.SetCount( numLeaves );
+	m_nodes.SetCount( nNodes );
+	}
+
+	buf.Get( m_aVerts.Base(), m_aVerts.Count() * sizeof( Vector ) );
+	buf.Get( m_aTris.Base(), m_aTris.Count() * sizeof( CDispCollTri ) );
+	buf.Get( m_nodes.Base(), m_nodes.Count() * sizeof( CDispCollNode ) );
+	buf.Get( m_leaves.Base(), m_leaves.Count() * sizeof( CDispCollLeaf ) );
+	return buf.IsValid();
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 #ifdef ENGINE_DLL
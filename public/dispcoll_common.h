@@ -12,6 +12,7 @@
 #include "trace.h"
 #include "builddisp.h"
 #include "bitvec.h"
+#include "tier1/utlbuffer.h"
 #ifdef ENGINE_DLL
 #include "../engine/zone.h"
 #endif
@@ -144,6 +145,7 @@ struct rayleaflist_t
 	FourVectors rayStart;
 	FourVectors rayExtents;
 	FourVectors invDelta;
+	fltx4 endFrac;					// boxes entered past this fraction are skipped
 	int nodeList[MAX_AABB_LIST];
 	int maxIndex;
 };
@@ -208,6 +210,12 @@ public:
 	void GetVirtualMeshList( struct virtualmeshlist_t *pList );
 	int AABBTree_GetTrisInSphere( const Vector &center, float radius, unsigned short *pIndexOut, int indexMax );
 
+	// Flat copy of a built tree, for the engine's collision cache. Surface props
+	// and the edge plane cache are not part of it.
+	void SaveToBuffer( CUtlBuffer &buf );
+	bool LoadFromBuffer( CUtlBuffer &buf );
+	static int GetBufferSize( int nPower );
+
 public:
 
 	inline int Nodes_GetChild( int iNode, int nDirection );
@@ -37,6 +37,17 @@ public:
 };
 
 
+//-----------------------------------------------------------------------------
+// Used to get told when a single convar changes, so its value can be cached
+// instead of looking the convar up all the time
+//-----------------------------------------------------------------------------
+abstract_class IConVarChangeListener
+{
+public:
+	virtual void OnConVarChanged( IConVar *pVar, const char *pOldValue, float flOldValue ) = 0;
+};
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Applications can implement this to modify behavior in ICvar
 //-----------------------------------------------------------------------------
@@ -155,6 +166,12 @@ protected:
 
 	virtual ICVarIteratorInternal	*FactoryInternalIterator( void ) = 0;
 	friend class Iterator;
+
+public:
+	// Install a listener for changes of the named convar. The convar doesn't
+	// need to be registered yet. (These come last to keep the vtable layout.)
+	virtual void			InstallConVarChangeListener( const char *pVarName, IConVarChangeListener *pListener ) = 0;
+	virtual void			RemoveConVarChangeListener( const char *pVarName, IConVarChangeListener *pListener ) = 0;
 };
 
 inline ICvar::Iterator::Iterator(ICvar *icvar)
@@ -211,6 +211,12 @@ public:
 	virtual void ReportStats( const char *pFileName ) = 0;
 
 	virtual void InstallQueryCallback( IPartitionQueryCallback *pCallback ) = 0;
+
+	// Same results as EnumerateElementsInBox/InSphere with coarseTest == false,
+	// but written to pList without a callback per element. Stops once nMaxCount
+	// elements have been found and returns how many were written.
+	virtual int GetElementsInBox( SpatialPartitionListMask_t listMask, const Vector& mins, const Vector& maxs, IHandleEntity **pList, int nMaxCount ) = 0;
+	virtual int GetElementsInSphere( SpatialPartitionListMask_t listMask, const Vector& origin, float radius, IHandleEntity **pList, int nMaxCount ) = 0;
 };
 
 #endif
@@ -1422,6 +1422,14 @@ inline bool Plat_IsInDebugSession( bool bForceRecheck = false ) { return false;
 //-----------------------------------------------------------------------------
 PLATFORM_INTERFACE bool Is64BitOS();
 
+//-----------------------------------------------------------------------------
+// Maps a whole file into memory. Pages are private copy on write, so writes
+// never reach the file. Returns NULL if the file can't be mapped, callers
+// are expected to fall back to reading it.
+//-----------------------------------------------------------------------------
+PLATFORM_INTERFACE void *Plat_MapFile( const char *pszFilename, uint64 *pnSize );
+PLATFORM_INTERFACE void Plat_UnmapFile( void *pData, uint64 nSize );
+
 
 //-----------------------------------------------------------------------------
 // XBOX Components valid in PC compilation space
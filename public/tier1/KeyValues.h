@@ -39,6 +39,7 @@ class CUtlBuffer;
 class Color;
 typedef void * FileHandle_t;
 class CKeyValuesGrowableStringTable;
+class CKeyValuesChildIndex;
 
 //-----------------------------------------------------------------------------
 // Purpose: Simple recursive data access class
@@ -137,6 +138,14 @@ public:
 	void AddSubKey( KeyValues *pSubkey );	// Adds a subkey. Make sure the subkey isn't a child of some other keyvalues
 	void RemoveSubKey(KeyValues *subKey);	// removes a subkey from the list, DOES NOT DELETE IT
 
+	// Keeps a name symbol -> child lookup table on this key so FindKey doesn't have to walk
+	// the subkey list. Only worth it for keys with many children that are searched often.
+	// While enabled, children must be added and removed through this key's own methods;
+	// linking peers in directly with SetNextKey() bypasses the index. Renamed children are
+	// picked up on lookup, but if one takes the name of a later sibling already in the
+	// index, FindKey returns that sibling rather than the first match.
+	void SetUsesChildIndex( bool bEnable );
+
 	// Key iteration.
 	//
 	// NOTE: GetFirstSubKey/GetNextKey will iterate keys AND values. Use the functions 
@@ -281,6 +290,12 @@ private:
 	void CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char* tmpBuffer );
 
 	void RemoveEverything();
+
+	// child index maintenance, see SetUsesChildIndex()
+	void BuildChildIndex() const;
+	KeyValues *FindKeyInChildIndex( intp keySymbol ) const;
+	void AddToChildIndex( KeyValues *pSubkey );
+	void InvalidateChildIndex();
 //	void RecursiveSaveToFile( IBaseFileSystem *filesystem, CUtlBuffer &buffer, int indentLevel );
 //	void WriteConvertedString( CUtlBuffer &buffer, const char *pszString );
 	
@@ -334,6 +349,7 @@ private:
 	KeyValues *m_pPeer;	// pointer to next key in list
 	KeyValues *m_pSub;	// pointer to Start of a new sub key list
 	KeyValues *m_pChain;// Search here if it's not in our list
+	CKeyValuesChildIndex *m_pChildIndex; // optional fast lookup of m_pSub's list, usually NULL
 
 private:
 	// Statics to implement the optional growable string table
@@ -567,6 +567,10 @@ public:
 
 	unsigned int	ReadUBitLong( int numbits ) RESTRICT;
 	unsigned int	ReadUBitLongNoInline( int numbits ) RESTRICT;
+
+	// Unmasked bits at iBit, a 64-bit load when iBit's byte <= iLastWindowByte.
+	static unsigned int LoadBitWindow( const unsigned char *pData, int iBit, int numbits, int iLastWindowByte );
+
 	unsigned int	PeekUBitLong( int numbits );
 	int				ReadSBitLong( int numbits );
 
@@ -778,12 +782,9 @@ BITBUF_INLINE unsigned int bf_read::ReadUBitLong( int numbits ) RESTRICT
 		return 0;
 	}
 
-	unsigned int iStartBit = m_iCurBit & 31u;
-	int iLastBit = m_iCurBit + numbits - 1;
-	unsigned int iWordOffset1 = m_iCurBit >> 5;
-	unsigned int iWordOffset2 = iLastBit >> 5;
+	unsigned int nResult = LoadBitWindow( m_pData, m_iCurBit, numbits, m_nDataBytes - (int)sizeof(uint64) );
 	m_iCurBit += numbits;
-	
+
 #if __i386__
 	unsigned int bitmask = (2 << (numbits-1)) - 1;
 #else
@@ -791,10 +792,26 @@ BITBUF_INLINE unsigned int bf_read::ReadUBitLong( int numbits ) RESTRICT
 	unsigned int bitmask = g_ExtraMasks[numbits];
 #endif
 
-	unsigned int dw1 = LoadLittleDWord( (uint32* RESTRICT)m_pData, iWordOffset1 ) >> iStartBit;
-	unsigned int dw2 = LoadLittleDWord( (uint32* RESTRICT)m_pData, iWordOffset2 ) << (32 - iStartBit);
+	return nResult & bitmask;
+}
+
+// Returns at least 32 bits starting at iBit, unmasked. One unaligned 64-bit
+// load when the window fits in the buffer, the dwords holding the first
+// and last bit near the end.
+BITBUF_INLINE unsigned int bf_read::LoadBitWindow( const unsigned char *pData, int iBit, int numbits, int iLastWindowByte )
+{
+	int iByte = iBit >> 3;
+	if ( iByte <= iLastWindowByte )
+	{
+		uint64 nWindow;
+		memcpy( &nWindow, pData + iByte, sizeof(nWindow) );
+		return (unsigned int)( LittleQWord( nWindow ) >> ( iBit & 7 ) );
+	}
 
-	return (dw1 | dw2) & bitmask;
+	unsigned int iWordOffset1 = iBit >> 5;
+	unsigned int iWordOffset2 = ( iBit + numbits - 1 ) >> 5;
+	uint64 nWindow = ( (uint64)LoadLittleDWord( (uint32* RESTRICT)pData, iWordOffset2 ) << 32 ) | LoadLittleDWord( (uint32* RESTRICT)pData, iWordOffset1 );
+	return (unsigned int)( nWindow >> ( iBit & 31 ) );
 }
 
 BITBUF_INLINE int bf_read::CompareBits( bf_read * RESTRICT other, int numbits ) RESTRICT
@@ -803,6 +820,147 @@ BITBUF_INLINE int bf_read::CompareBits( bf_read * RESTRICT other, int numbits )
 }
 
 
+//-----------------------------------------------------------------------------
+// Sequential writer for hot loops. Pending bits are collected in a 64-bit
+// register and only complete dwords are stored, instead of the masked
+// read-modify-write of one or two dwords bf_write does per field. The
+// bf_write isn't up to date until Flush(), don't use it in the meantime.
+//-----------------------------------------------------------------------------
+class CBitWriteAccumulator
+{
+public:
+	CBitWriteAccumulator( bf_write *pBuf );
+	~CBitWriteAccumulator() { Flush(); }
+
+	// numbits is 1..32, data must fit in numbits (not checked)
+	void			WriteUBitLong( uint32 data, int numbits );
+	void			WriteOneBit( int nValue ) { WriteUBitLong( nValue ? 1 : 0, 1 ); }
+
+	// Merges the partial dword into the buffer and moves the bf_write
+	// to the end of the written bits. Bits past that are left untouched.
+	void			Flush();
+
+	int				GetNumBitsWritten() const { return m_iCurBit; }
+
+private:
+	bf_write		*m_pBuf;
+	uint32			*m_pOut;		// dword the low bits of m_nAccum go to
+	uint64			m_nAccum;
+	int				m_nAccumBits;	// < 32 between calls
+	int				m_iCurBit;
+	int				m_nDataBits;
+};
+
+BITBUF_INLINE CBitWriteAccumulator::CBitWriteAccumulator( bf_write *pBuf )
+{
+	extern uint32 g_ExtraMasks[33];
+
+	m_pBuf = pBuf;
+	m_iCurBit = pBuf->m_iCurBit;
+	m_nDataBits = pBuf->m_nDataBits;
+	m_pOut = pBuf->m_pData + ( m_iCurBit >> 5 );
+	m_nAccumBits = m_iCurBit & 31;
+	m_nAccum = m_nAccumBits ? ( LoadLittleDWord( m_pOut, 0 ) & g_ExtraMasks[m_nAccumBits] ) : 0;
+}
+
+BITBUF_INLINE void CBitWriteAccumulator::WriteUBitLong( uint32 data, int numbits )
+{
+	Assert( numbits > 0 && numbits <= 32 );
+
+	if ( m_iCurBit + numbits > m_nDataBits )
+	{
+		m_iCurBit = m_nDataBits;
+		m_pBuf->SetOverflowFlag();
+		CallErrorHandler( BITBUFERROR_BUFFER_OVERRUN, m_pBuf->GetDebugName() );
+		return;
+	}
+
+	m_nAccum |= (uint64)data << m_nAccumBits;
+	m_nAccumBits += numbits;
+	m_iCurBit += numbits;
+
+	if ( m_nAccumBits >= 32 )
+	{
+		StoreLittleDWord( m_pOut, 0, (uint32)m_nAccum );
+		++m_pOut;
+		m_nAccum >>= 32;
+		m_nAccumBits -= 32;
+	}
+}
+
+BITBUF_INLINE void CBitWriteAccumulator::Flush()
+{
+	extern uint32 g_ExtraMasks[33];
+
+	if ( m_nAccumBits )
+	{
+		uint32 mask = g_ExtraMasks[m_nAccumBits];
+		uint32 dword = LoadLittleDWord( m_pOut, 0 );
+		dword ^= mask & ( (uint32)m_nAccum ^ dword );
+		StoreLittleDWord( m_pOut, 0, dword );
+	}
+
+	m_pBuf->m_iCurBit = m_iCurBit;
+}
+
+
+//-----------------------------------------------------------------------------
+// Sequential reader for hot loops, keeps the read position in a register
+// instead of the bf_read. Each read takes a 64-bit window with one unaligned
+// load at the byte position, so there is no refill branch and no dependency
+// between reads other than the position. Moves the bf_read on Flush().
+//-----------------------------------------------------------------------------
+class CBitReadAccumulator
+{
+public:
+	CBitReadAccumulator( bf_read *pBuf );
+	~CBitReadAccumulator() { Flush(); }
+
+	// numbits is 1..32
+	uint32			ReadUBitLong( int numbits );
+	int				ReadOneBit() { return ReadUBitLong( 1 ); }
+
+	void			Flush() { m_pBuf->m_iCurBit = m_iCurBit; }
+
+	int				GetNumBitsRead() const { return m_iCurBit; }
+	int				GetNumBitsLeft() const { return m_nDataBits - m_iCurBit; }
+
+private:
+	bf_read				*m_pBuf;
+	const unsigned char	*m_pIn;
+	int					m_iCurBit;
+	int					m_nDataBits;
+	int					m_iLastWindowByte;	// last byte a 64-bit window can start at
+};
+
+BITBUF_INLINE CBitReadAccumulator::CBitReadAccumulator( bf_read *pBuf )
+{
+	m_pBuf = pBuf;
+	m_pIn = pBuf->m_pData;
+	m_iCurBit = pBuf->m_iCurBit;
+	m_nDataBits = pBuf->m_nDataBits;
+	m_iLastWindowByte = pBuf->m_nDataBytes - (int)sizeof(uint64);
+}
+
+BITBUF_INLINE uint32 CBitReadAccumulator::ReadUBitLong( int numbits )
+{
+	Assert( numbits > 0 && numbits <= 32 );
+	extern uint32 g_ExtraMasks[33];
+
+	if ( m_iCurBit + numbits > m_nDataBits )
+	{
+		m_iCurBit = m_nDataBits;
+		m_pBuf->SetOverflowFlag();
+		CallErrorHandler( BITBUFERROR_BUFFER_OVERRUN, m_pBuf->GetDebugName() );
+		return 0;
+	}
+
+	uint32 nResult = bf_read::LoadBitWindow( m_pIn, m_iCurBit, numbits, m_iLastWindowByte );
+	m_iCurBit += numbits;
+	return nResult & g_ExtraMasks[numbits];
+}
+
+
 #endif
 
 
@@ -235,6 +235,48 @@ struct tm *Plat_localtime( const time_t *timep, struct tm *result )
 }
 
 
+void *Plat_MapFile( const char *pszFilename, uint64 *pnSize )
+{
+#ifdef _X360
+	return NULL;
+#else
+	HANDLE hFile = CreateFileA( pszFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	void *pData = NULL;
+	LARGE_INTEGER size;
+	if ( GetFileSizeEx( hFile, &size ) && size.QuadPart > 0 )
+	{
+		HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+		if ( hMapping )
+		{
+			pData = MapViewOfFile( hMapping, FILE_MAP_COPY, 0, 0, 0 );
+			if ( pData )
+			{
+				*pnSize = size.QuadPart;
+			}
+
+			// the view keeps the mapping alive
+			CloseHandle( hMapping );
+		}
+	}
+
+	CloseHandle( hFile );
+	return pData;
+#endif
+}
+
+void Plat_UnmapFile( void *pData, uint64 nSize )
+{
+#ifndef _X360
+	if ( pData )
+	{
+		UnmapViewOfFile( pData );
+	}
+#endif
+}
+
 bool vtune( bool resume )
 {
 #ifndef _X360
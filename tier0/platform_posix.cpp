@@ -14,6 +14,9 @@
 
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #if defined(OSX) || defined(PLATFORM_BSD)
@@ -384,6 +387,40 @@ bool vtune( bool resume )
   return 0;
 }
 
+void *Plat_MapFile( const char *pszFilename, uint64 *pnSize )
+{
+	int fd = open( pszFilename, O_RDONLY );
+	if ( fd < 0 )
+		return NULL;
+
+	void *pData = NULL;
+	struct stat st;
+	if ( fstat( fd, &st ) == 0 && st.st_size > 0 )
+	{
+		pData = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+		if ( pData == MAP_FAILED )
+		{
+			pData = NULL;
+		}
+		else
+		{
+			*pnSize = st.st_size;
+		}
+	}
+
+	// the mapping stays valid without the descriptor
+	close( fd );
+	return pData;
+}
+
+void Plat_UnmapFile( void *pData, uint64 nSize )
+{
+	if ( pData )
+	{
+		munmap( pData, nSize );
+	}
+}
+
 
 // -------------------------------------------------------------------------------------------------- //
 // Memory stuff.
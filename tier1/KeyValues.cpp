@@ -26,6 +26,7 @@
 #include "tier0/mem.h"
 #include "utlbuffer.h"
 #include "utlhash.h"
+#include "utlhashtable.h"
 #include "utlvector.h"
 #include "utlqueue.h"
 #include "UtlSortVector.h"
@@ -318,6 +319,22 @@ private:
 };
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Optional lookup table for a key's children, see KeyValues::SetUsesChildIndex().
+//	Built lazily on the first search after it is enabled or invalidated.
+//-----------------------------------------------------------------------------
+class CKeyValuesChildIndex
+{
+public:
+	CKeyValuesChildIndex() : m_pLastChild( NULL ), m_bValid( false ) {}
+
+	// first child with each name, which is what a walk of the subkey list finds
+	CUtlHashtable< intp, KeyValues * > m_Children;
+	KeyValues *m_pLastChild;
+	bool m_bValid;
+};
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Sets whether the KeyValues system should use an arbitrarily growable
 //	string table. See the comment in the header for more info.
@@ -454,6 +471,7 @@ void KeyValues::Init()
 	m_pSub = NULL;
 	m_pPeer = NULL;
 	m_pChain = NULL;
+	m_pChildIndex = NULL;
 
 	m_sValue = NULL;
 	m_wsValue = NULL;
@@ -501,6 +519,9 @@ void KeyValues::RemoveEverything()
 	m_sValue = NULL;
 	delete [] m_wsValue;
 	m_wsValue = NULL;
+
+	delete m_pChildIndex;
+	m_pChildIndex = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -972,6 +993,9 @@ void KeyValues::SaveKeyToFile( KeyValues *dat, IBaseFileSystem *filesystem, File
 //-----------------------------------------------------------------------------
 KeyValues *KeyValues::FindKey(intp keySymbol) const
 {
+	if ( m_pChildIndex )
+		return FindKeyInChildIndex( keySymbol );
+
 	for (KeyValues *dat = m_pSub; dat != NULL; dat = dat->m_pPeer)
 	{
 		if (dat->m_iKeyName == keySymbol)
@@ -1017,15 +1041,26 @@ KeyValues *KeyValues::FindKey(const char *keyName, bool bCreate)
 
 	KeyValues *lastItem = NULL;
 	KeyValues *dat;
-	// find the searchStr in the current peer list
-	for (dat = m_pSub; dat != NULL; dat = dat->m_pPeer)
+	if ( m_pChildIndex )
 	{
-		lastItem = dat;	// record the last item looked at (for if we need to append to the end of the list)
-
-		// symbol compare
-		if (dat->m_iKeyName == iSearchStr)
+		dat = FindKeyInChildIndex( iSearchStr );
+		if ( !dat )
 		{
-			break;
+			lastItem = FindLastSubKey();
+		}
+	}
+	else
+	{
+		// find the searchStr in the current peer list
+		for (dat = m_pSub; dat != NULL; dat = dat->m_pPeer)
+		{
+			lastItem = dat;	// record the last item looked at (for if we need to append to the end of the list)
+
+			// symbol compare
+			if (dat->m_iKeyName == iSearchStr)
+			{
+				break;
+			}
 		}
 	}
 
@@ -1056,6 +1091,7 @@ KeyValues *KeyValues::FindKey(const char *keyName, bool bCreate)
 				m_pSub = dat;
 			}
 			dat->m_pPeer = NULL;
+			AddToChildIndex( dat );
 
 			// a key graduates to be a submsg as soon as it's m_pSub is set
 			// this should be the only place m_pSub is set
@@ -1161,6 +1197,8 @@ void KeyValues::AddSubkeyUsingKnownLastChild( KeyValues *pSubkey, KeyValues *pLa
 
 		pLastChild->SetNextKey( pSubkey );
 	}
+
+	AddToChildIndex( pSubkey );
 }
 
 
@@ -1180,14 +1218,10 @@ void KeyValues::AddSubKey( KeyValues *pSubkey )
 	}
 	else
 	{
-		KeyValues *pTempDat = m_pSub;
-		while ( pTempDat->GetNextKey() != NULL )
-		{
-			pTempDat = pTempDat->GetNextKey();
-		}
-
-		pTempDat->SetNextKey( pSubkey );
+		FindLastSubKey()->SetNextKey( pSubkey );
 	}
+
+	AddToChildIndex( pSubkey );
 }
 
 
@@ -1222,6 +1256,9 @@ void KeyValues::RemoveSubKey(KeyValues *subKey)
 	}
 
 	subKey->m_pPeer = NULL;
+
+	// a later child with the same name may now be the one FindKey should return
+	InvalidateChildIndex();
 }
 
 
@@ -1236,6 +1273,12 @@ KeyValues *KeyValues::FindLastSubKey()
 	if ( m_pSub == NULL )
 		return NULL;
 
+	if ( m_pChildIndex && m_pChildIndex->m_bValid )
+	{
+		Assert( m_pChildIndex->m_pLastChild && m_pChildIndex->m_pLastChild->m_pPeer == NULL );
+		return m_pChildIndex->m_pLastChild;
+	}
+
 	// Scan for the last one
 	KeyValues *pLastChild = m_pSub;
 	while ( pLastChild->m_pPeer )
@@ -1252,6 +1295,102 @@ void KeyValues::SetNextKey( KeyValues *pDat )
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Enables or disables the child lookup table for this key
+//-----------------------------------------------------------------------------
+void KeyValues::SetUsesChildIndex( bool bEnable )
+{
+	if ( bEnable && !m_pChildIndex )
+	{
+		m_pChildIndex = new CKeyValuesChildIndex;
+	}
+	else if ( !bEnable )
+	{
+		delete m_pChildIndex;
+		m_pChildIndex = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Rebuilds the child lookup table from the subkey list
+//-----------------------------------------------------------------------------
+void KeyValues::BuildChildIndex() const
+{
+	Assert( m_pChildIndex );
+
+	m_pChildIndex->m_Children.RemoveAll();
+	m_pChildIndex->m_pLastChild = NULL;
+	for ( KeyValues *dat = m_pSub; dat != NULL; dat = dat->m_pPeer )
+	{
+		// Insert keeps the existing entry, so duplicates resolve to the first one
+		m_pChildIndex->m_Children.Insert( dat->m_iKeyName, dat );
+		m_pChildIndex->m_pLastChild = dat;
+	}
+	m_pChildIndex->m_bValid = true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: looks up a child by symbol through the child lookup table
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::FindKeyInChildIndex( intp keySymbol ) const
+{
+	Assert( m_pChildIndex );
+
+	if ( !m_pChildIndex->m_bValid )
+	{
+		BuildChildIndex();
+	}
+
+	KeyValues *dat = m_pChildIndex->m_Children.Get( keySymbol, NULL );
+	if ( dat && dat->m_iKeyName == keySymbol )
+		return dat;
+
+	// Not in the index, or that child was renamed through SetName(), which we can't
+	// see from here. Another child may have been renamed to this name, so walk the
+	// list and fix up the entry.
+	for ( dat = m_pSub; dat != NULL; dat = dat->m_pPeer )
+	{
+		if ( dat->m_iKeyName == keySymbol )
+			break;
+	}
+
+	if ( dat )
+	{
+		UtlHashHandle_t hChild = m_pChildIndex->m_Children.Insert( keySymbol, dat );
+		m_pChildIndex->m_Children.Element( hChild ) = dat;
+	}
+	else
+	{
+		m_pChildIndex->m_Children.Remove( keySymbol );
+	}
+
+	return dat;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: records a key that was just appended to the end of the subkey list
+//-----------------------------------------------------------------------------
+void KeyValues::AddToChildIndex( KeyValues *pSubkey )
+{
+	if ( !m_pChildIndex || !m_pChildIndex->m_bValid )
+		return;
+
+	m_pChildIndex->m_Children.Insert( pSubkey->m_iKeyName, pSubkey );
+	m_pChildIndex->m_pLastChild = pSubkey;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the subkey list changed in a way the index can't follow, rebuild it on next use
+//-----------------------------------------------------------------------------
+void KeyValues::InvalidateChildIndex()
+{
+	if ( m_pChildIndex )
+	{
+		m_pChildIndex->m_bValid = false;
+	}
+}
+
+
 KeyValues* KeyValues::GetFirstTrueSubKey()
 {
 	KeyValues *pRet = m_pSub;
@@ -1876,9 +2015,11 @@ void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char*
 
 KeyValues& KeyValues::operator=( const KeyValues& src )
 {
+	bool bUsesChildIndex = ( m_pChildIndex != NULL );
 	RemoveEverything();
 	Init();	// reset all values
 	CopyKeyValuesFromRecursive( src );
+	SetUsesChildIndex( bUsesChildIndex );
 	return *this;
 }
 
@@ -1908,6 +2049,8 @@ void KeyValues::CopySubkeys( KeyValues *pParent ) const
 		dat->m_pPeer = NULL;
 		pPrev = dat;
 	}
+
+	pParent->InvalidateChildIndex();
 }
 
 
@@ -2020,6 +2163,7 @@ void KeyValues::Clear( void )
 	delete m_pSub;
 	m_pSub = NULL;
 	m_iDataType = TYPE_NONE;
+	InvalidateChildIndex();
 }
 
 //-----------------------------------------------------------------------------
@@ -2604,6 +2748,7 @@ void KeyValues::RecursiveLoadFromBuffer( char const *resourceName, CUtlBuffer &b
 				Assert( pLastChild->m_pPeer == dat );
 				pLastChild->m_pPeer = NULL;
 			}
+			InvalidateChildIndex();
 
 			dat->deleteThis();
 			dat = NULL;
@@ -3016,6 +3161,7 @@ bool KeyValues::ProcessResolutionKeys( const char *pResString )
 
 				// rename the marked key
 				pSubKey->SetName( normalKeyName );
+				InvalidateChildIndex();
 			}
 		}
 	}
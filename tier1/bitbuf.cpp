@@ -482,40 +482,20 @@ bool bf_write::WriteBits(const void *pInData, int nBits)
 		m_iCurBit += numbits;
 	}
 
-	// X360TBD: Can't write dwords in WriteBits because they'll get swapped
-	if ( IsPC() && nBitsLeft >= 32 )
+	if ( nBitsLeft >= 32 )
 	{
-		uint32 iBitsRight = (m_iCurBit & 31);
-        uint32 iBitsLeft = 32 - iBitsRight;
-        uint32 bitMaskLeft = g_BitWriteMasks[iBitsRight][32];
-        uint32 bitMaskRight = g_BitWriteMasks[0][iBitsRight];
-
-        uint32 *pData = &m_pData[m_iCurBit>>5];
-
-		// Read dwords.
-		while(nBitsLeft >= 32)
+		// Unaligned destination, shift whole source dwords in through
+		// a 64-bit register. Loading them little endian keeps the bit
+		// order right on every platform.
+		CBitWriteAccumulator out( this );
+		while ( nBitsLeft >= 32 )
 		{
-            uint32 curData = *(uint32*)pOut;
+			out.WriteUBitLong( LoadLittleDWord( (uint32*)pOut, 0 ), 32 );
 			pOut += sizeof(uint32);
-
-			*pData &= bitMaskLeft;
-			*pData |= curData << iBitsRight;
-
-			pData++; 
-
-			if ( iBitsLeft < 32 )
-			{
-				curData >>= iBitsLeft;
-				*pData &= bitMaskRight;
-				*pData |= curData;
-			}
-
 			nBitsLeft -= 32;
-			m_iCurBit += 32;
 		}
 	}
 
-
 	// write remaining bytes
 	while ( nBitsLeft >= 8 )
 	{
@@ -536,14 +516,43 @@ bool bf_write::WriteBits(const void *pInData, int nBits)
 
 bool bf_write::WriteBitsFromBuffer( bf_read *pIn, int nBits )
 {
-	// This could be optimized a little by
+	// The bulk paths need both sides in range, leave the overflow
+	// handling to the per dword loop below.
+	if ( nBits > 32 && nBits <= GetNumBitsLeft() && nBits <= pIn->GetNumBitsLeft() )
+	{
+		if ( ( ( m_iCurBit | pIn->m_iCurBit ) & 7 ) == 0 )
+		{
+			// both byte aligned, straight copy
+			int numbytes = nBits >> 3;
+			Q_memcpy( (char*)m_pData + ( m_iCurBit >> 3 ), pIn->m_pData + ( pIn->m_iCurBit >> 3 ), numbytes );
+			m_iCurBit += numbytes << 3;
+			pIn->m_iCurBit += numbytes << 3;
+			nBits -= numbytes << 3;
+		}
+		else
+		{
+			CBitReadAccumulator in( pIn );
+			CBitWriteAccumulator out( this );
+			while ( nBits > 32 )
+			{
+				out.WriteUBitLong( in.ReadUBitLong( 32 ), 32 );
+				nBits -= 32;
+			}
+			out.WriteUBitLong( in.ReadUBitLong( nBits ), nBits );
+			nBits = 0;
+		}
+	}
+
 	while ( nBits > 32 )
 	{
 		WriteUBitLong( pIn->ReadUBitLong( 32 ), 32 );
 		nBits -= 32;
 	}
 
-	WriteUBitLong( pIn->ReadUBitLong( nBits ), nBits );
+	if ( nBits )
+	{
+		WriteUBitLong( pIn->ReadUBitLong( nBits ), nBits );
+	}
 	return !IsOverflowed() && !pIn->IsOverflowed();
 }
 
@@ -892,15 +901,30 @@ void bf_read::ReadBits(void *pOutData, int nBits)
 		nBitsLeft -= 8;
 	}
 
-	// X360TBD: Can't read dwords in ReadBits because they'll get swapped
-	if ( IsPC() )
+	// The bulk paths need the whole range in the buffer, overflows are
+	// left to the per byte reads below.
+	if ( nBitsLeft >= 32 && nBitsLeft <= GetNumBitsLeft() )
 	{
-		// read dwords
-		while ( nBitsLeft >= 32 )
+		if ( ( m_iCurBit & 7 ) == 0 )
 		{
-			*((uint32*)pOut) = ReadUBitLong(32);
-			pOut += sizeof(uint32);
-			nBitsLeft -= 32;
+			// byte aligned, block copy
+			int numbytes = nBitsLeft >> 3;
+			Q_memcpy( pOut, m_pData + ( m_iCurBit >> 3 ), numbytes );
+			pOut += numbytes;
+			nBitsLeft -= numbytes << 3;
+			m_iCurBit += numbytes << 3;
+		}
+		else
+		{
+			// read dwords through a 64-bit register, storing them
+			// little endian keeps the byte order on every platform
+			CBitReadAccumulator in( this );
+			while ( nBitsLeft >= 32 )
+			{
+				StoreLittleDWord( (uint32*)pOut, 0, in.ReadUBitLong( 32 ) );
+				pOut += sizeof(uint32);
+				nBitsLeft -= 32;
+			}
 		}
 	}
 
@@ -0,0 +1,90 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test program for the SIMD collision routines
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "unitlib/unitlib.h"
+#include "mathlib/mathlib.h"
+#include "mathlib/ssemath.h"
+#include "collisionutils.h"
+#include "cmodel.h"
+
+DEFINE_TESTSUITE( CollisionUtilsTestSuite )
+
+// Own generator so the triangles don't depend on the state of the random stream
+static unsigned int s_nSeed = 1;
+
+static float RandomCoord( float flMin, float flMax )
+{
+	s_nSeed = s_nSeed * 1664525 + 1013904223;
+	return flMin + ( flMax - flMin ) * ( float )( s_nSeed >> 8 ) / ( float )( 1 << 24 );
+}
+
+static Vector RandomPoint( float flMin, float flMax )
+{
+	float x = RandomCoord( flMin, flMax );
+	float y = RandomCoord( flMin, flMax );
+	float z = RandomCoord( flMin, flMax );
+	return Vector( x, y, z );
+}
+
+//-----------------------------------------------------------------------------
+// IntersectRayWithFourTriangles has to hit the triangles IntersectRayWithTriangle
+// hits, including back faces and degenerate ones, at the same fraction. Release
+// builds use fast math, so the fractions may differ in the last bits.
+//-----------------------------------------------------------------------------
+DEFINE_TESTCASE( IntersectRayWithFourTrianglesTest, CollisionUtilsTestSuite )
+{
+	int nMismatches = 0;
+	int nHits = 0;
+
+	for ( int nPass = 0; nPass < 65536; ++nPass )
+	{
+		Ray_t ray;
+		ray.Init( RandomPoint( -64.0f, 64.0f ), RandomPoint( -64.0f, 64.0f ) );
+
+		Vector v1[4], v2[4], v3[4];
+		for ( int i = 0; i < 4; ++i )
+		{
+			v1[i] = RandomPoint( -32.0f, 32.0f );
+			v2[i] = RandomPoint( -32.0f, 32.0f );
+			v3[i] = RandomPoint( -32.0f, 32.0f );
+
+			// Every fifth triangle is degenerate
+			if ( ( nPass * 4 + i ) % 5 == 0 )
+			{
+				v3[i] = v1[i] + ( v2[i] - v1[i] ) * RandomCoord( -1.0f, 2.0f );
+			}
+		}
+
+		FourVectors rayStart, rayDelta, fourV1, fourV2, fourV3;
+		rayStart.DuplicateVector( ray.m_Start );
+		rayDelta.DuplicateVector( ray.m_Delta );
+		fourV1.LoadAndSwizzle( v1[0], v1[1], v1[2], v1[3] );
+		fourV2.LoadAndSwizzle( v2[0], v2[1], v2[2], v2[3] );
+		fourV3.LoadAndSwizzle( v3[0], v3[1], v3[2], v3[3] );
+
+		for ( int nOneSided = 0; nOneSided < 2; ++nOneSided )
+		{
+			fltx4 fracs = IntersectRayWithFourTriangles( rayStart, rayDelta, fourV1, fourV2, fourV3, nOneSided != 0 );
+			for ( int i = 0; i < 4; ++i )
+			{
+				float flFrac = IntersectRayWithTriangle( ray, v1[i], v2[i], v3[i], nOneSided != 0 );
+				if ( flFrac >= 0.0f )
+				{
+					++nHits;
+				}
+				float flFourFrac = SubFloat( fracs, i );
+				if ( ( flFrac >= 0.0f ) != ( flFourFrac >= 0.0f ) || fabs( flFrac - flFourFrac ) > 1e-5f )
+				{
+					++nMismatches;
+				}
+			}
+		}
+	}
+
+	Shipping_Assert( nHits > 0 );
+	Shipping_Assert( nMismatches == 0 );
+}
@@ -0,0 +1,177 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Performance test for bf_write/bf_read and the bit accumulators
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "unitlib/unitlib.h"
+#include "tier1/bitbuf.h"
+#include "tier0/platform.h"
+#include "tier0/fasttimer.h"
+
+DEFINE_TESTSUITE( BitBufPerformanceTestSuite )
+
+#define BITBUF_PERF_PASSES	200
+#define BITBUF_PERF_FIELDS	4096
+#define BITBUF_PERF_BYTES	65536
+
+static uint32 s_nPerfSeed;
+
+static uint32 NextPerfRandom()
+{
+	s_nPerfSeed = s_nPerfSeed * 1664525 + 1013904223;
+	return s_nPerfSeed;
+}
+
+static void PrintCycles( const char *pszName, CFastTimer &timer )
+{
+	Msg( "%s Cycles: %llu\n", pszName, (unsigned long long)timer.GetDuration().GetLongCycles() );
+}
+
+// Field at a time writes and reads, through bf_write/bf_read and through the accumulators
+static void FieldPerformance()
+{
+	static uint32 data[BITBUF_PERF_BYTES / 4];
+	static uint32 values[BITBUF_PERF_FIELDS];
+	static int widths[BITBUF_PERF_FIELDS];
+
+	s_nPerfSeed = 3;
+	for ( int i = 0; i < BITBUF_PERF_FIELDS; ++i )
+	{
+		widths[i] = 1 + ( NextPerfRandom() % 32 );
+		values[i] = NextPerfRandom();
+		if ( widths[i] < 32 )
+		{
+			values[i] &= ( 1u << widths[i] ) - 1;
+		}
+	}
+
+	CFastTimer timer;
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_write buf( data, sizeof( data ) );
+		for ( int i = 0; i < BITBUF_PERF_FIELDS; ++i )
+		{
+			buf.WriteUBitLong( values[i], widths[i] );
+		}
+	}
+	timer.End();
+	PrintCycles( "bf_write::WriteUBitLong", timer );
+
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_write buf( data, sizeof( data ) );
+		CBitWriteAccumulator out( &buf );
+		for ( int i = 0; i < BITBUF_PERF_FIELDS; ++i )
+		{
+			out.WriteUBitLong( values[i], widths[i] );
+		}
+	}
+	timer.End();
+	PrintCycles( "CBitWriteAccumulator::WriteUBitLong", timer );
+
+	uint32 nCheck = 0;
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_read buf( data, sizeof( data ) );
+		for ( int i = 0; i < BITBUF_PERF_FIELDS; ++i )
+		{
+			nCheck += buf.ReadUBitLong( widths[i] );
+		}
+	}
+	timer.End();
+	PrintCycles( "bf_read::ReadUBitLong", timer );
+
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_read buf( data, sizeof( data ) );
+		CBitReadAccumulator in( &buf );
+		for ( int i = 0; i < BITBUF_PERF_FIELDS; ++i )
+		{
+			nCheck -= in.ReadUBitLong( widths[i] );
+		}
+	}
+	timer.End();
+	PrintCycles( "CBitReadAccumulator::ReadUBitLong", timer );
+
+	// Both readers have to see the same fields
+	Shipping_Assert( nCheck == 0 );
+}
+
+// Unaligned bulk copies, against the dword at a time loops they used to be
+static void BulkCopyPerformance()
+{
+	static uint32 data[BITBUF_PERF_BYTES / 4];
+	static uint32 copy[BITBUF_PERF_BYTES / 4];
+	const int nCopyBits = ( sizeof( data ) - 16 ) * 8;
+
+	s_nPerfSeed = 5;
+	for ( int i = 0; i < ARRAYSIZE( data ); ++i )
+	{
+		data[i] = NextPerfRandom();
+	}
+
+	CFastTimer timer;
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_write out( copy, sizeof( copy ) );
+		out.SeekToBit( 13 );
+		for ( int i = 0; i < nCopyBits / 32; ++i )
+		{
+			out.WriteUBitLong( data[i], 32 );
+		}
+	}
+	timer.End();
+	PrintCycles( "WriteBits unaligned, dword loop", timer );
+
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_write out( copy, sizeof( copy ) );
+		out.SeekToBit( 13 );
+		out.WriteBits( data, nCopyBits );
+	}
+	timer.End();
+	PrintCycles( "WriteBits unaligned", timer );
+
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_read in( data, sizeof( data ) );
+		bf_write out( copy, sizeof( copy ) );
+		in.Seek( 3 );
+		out.SeekToBit( 13 );
+		for ( int i = 0; i < nCopyBits / 32; ++i )
+		{
+			out.WriteUBitLong( in.ReadUBitLong( 32 ), 32 );
+		}
+	}
+	timer.End();
+	PrintCycles( "WriteBitsFromBuffer unaligned, dword loop", timer );
+
+	timer.Start();
+	for ( int nPass = 0; nPass < BITBUF_PERF_PASSES; ++nPass )
+	{
+		bf_read in( data, sizeof( data ) );
+		bf_write out( copy, sizeof( copy ) );
+		in.Seek( 3 );
+		out.SeekToBit( 13 );
+		out.WriteBitsFromBuffer( &in, nCopyBits );
+	}
+	timer.End();
+	PrintCycles( "WriteBitsFromBuffer unaligned", timer );
+}
+
+DEFINE_TESTCASE( BitBufPerformanceTest, BitBufPerformanceTestSuite )
+{
+	Msg( "Running bf_write/bf_read performance tests\n" );
+
+	FieldPerformance();
+	BulkCopyPerformance();
+}
@@ -0,0 +1,185 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test program for bf_write/bf_read and the bit accumulators
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "tier0/dbg.h"
+#include "unitlib/unitlib.h"
+#include "tier1/bitbuf.h"
+
+DEFINE_TESTSUITE( BitBufTestSuite )
+
+#define BITBUF_TEST_BYTES	4096
+
+static uint32 s_nSeed;
+
+static uint32 NextRandom()
+{
+	s_nSeed = s_nSeed * 1664525 + 1013904223;
+	return s_nSeed;
+}
+
+static uint32 RandomBits( int nBits )
+{
+	uint32 nValue = NextRandom() ^ ( NextRandom() >> 16 );
+	return nBits < 32 ? ( nValue & ( ( 1u << nBits ) - 1 ) ) : nValue;
+}
+
+static int GetBit( const void *pData, int iBit )
+{
+	return ( ((const unsigned char*)pData)[iBit >> 3] >> ( iBit & 7 ) ) & 1;
+}
+
+static bool CompareBitRange( const void *pA, int iA, const void *pB, int iB, int nBits )
+{
+	for ( int i = 0; i < nBits; ++i )
+	{
+		if ( GetBit( pA, iA + i ) != GetBit( pB, iB + i ) )
+			return false;
+	}
+	return true;
+}
+
+static void AccumulatorTests()
+{
+	ALIGN16 uint32 refData[BITBUF_TEST_BYTES / 4];
+	ALIGN16 uint32 accumData[BITBUF_TEST_BYTES / 4];
+	uint32 values[1024];
+	int widths[1024];
+
+	s_nSeed = 1;
+	for ( int iStart = 0; iStart < 64; ++iStart )
+	{
+		// the bits in front of the start and past the end must survive
+		memset( refData, 0xA5, sizeof( refData ) );
+		memset( accumData, 0xA5, sizeof( accumData ) );
+
+		bf_write ref( refData, sizeof( refData ) );
+		bf_write buf( accumData, sizeof( accumData ) );
+		ref.SeekToBit( iStart );
+		buf.SeekToBit( iStart );
+
+		{
+			CBitWriteAccumulator out( &buf );
+			for ( int i = 0; i < ARRAYSIZE( values ); ++i )
+			{
+				widths[i] = 1 + ( NextRandom() % 32 );
+				values[i] = RandomBits( widths[i] );
+				ref.WriteUBitLong( values[i], widths[i] );
+				out.WriteUBitLong( values[i], widths[i] );
+			}
+		}
+
+		Shipping_Assert( !buf.IsOverflowed() );
+		Shipping_Assert( buf.GetNumBitsWritten() == ref.GetNumBitsWritten() );
+		Shipping_Assert( memcmp( refData, accumData, sizeof( refData ) ) == 0 );
+
+		bf_read read( accumData, sizeof( accumData ) );
+		read.Seek( iStart );
+		CBitReadAccumulator in( &read );
+		bool bMatch = true;
+		for ( int i = 0; i < ARRAYSIZE( values ); ++i )
+		{
+			bMatch &= ( in.ReadUBitLong( widths[i] ) == values[i] );
+		}
+		in.Flush();
+		Shipping_Assert( bMatch );
+		Shipping_Assert( read.GetNumBitsRead() == ref.GetNumBitsWritten() );
+	}
+
+	// overflow on both ends
+	bf_write small( accumData, 8 );
+	{
+		CBitWriteAccumulator out( &small );
+		out.WriteUBitLong( 0x12345678, 32 );
+		out.WriteUBitLong( 0x1234567, 31 );
+		Shipping_Assert( !small.IsOverflowed() );
+		out.WriteUBitLong( 3, 2 );
+	}
+	Shipping_Assert( small.IsOverflowed() );
+
+	bf_read smallRead( accumData, 7 );
+	{
+		CBitReadAccumulator in( &smallRead );
+		Shipping_Assert( in.ReadUBitLong( 32 ) == 0x12345678 );
+		in.ReadUBitLong( 24 );
+		Shipping_Assert( !smallRead.IsOverflowed() );
+		Shipping_Assert( in.ReadUBitLong( 1 ) == 0 );
+	}
+	Shipping_Assert( smallRead.IsOverflowed() );
+}
+
+static void BulkCopyTests()
+{
+	ALIGN16 unsigned char src[512];
+	ALIGN16 unsigned char dst[1024];
+	ALIGN16 unsigned char out[1024];
+
+	s_nSeed = 2;
+	for ( int i = 0; i < sizeof( src ); ++i )
+	{
+		src[i] = (unsigned char)NextRandom();
+	}
+
+	for ( int iDst = 0; iDst < 40; ++iDst )
+	{
+		for ( int iSrc = 0; iSrc < 40; ++iSrc )
+		{
+			int nBits = 1 + ( NextRandom() % ( sizeof( src ) * 8 - 64 ) );
+
+			memset( dst, 0x5A, sizeof( dst ) );
+			bf_read in( src, sizeof( src ) );
+			bf_write buf( dst, sizeof( dst ) );
+			in.Seek( iSrc );
+			buf.SeekToBit( iDst );
+
+			Shipping_Assert( buf.WriteBitsFromBuffer( &in, nBits ) );
+			Shipping_Assert( in.GetNumBitsRead() == iSrc + nBits );
+			Shipping_Assert( buf.GetNumBitsWritten() == iDst + nBits );
+			Shipping_Assert( CompareBitRange( src, iSrc, dst, iDst, nBits ) );
+
+			// untouched around the copied range
+			Shipping_Assert( dst[sizeof( dst ) - 1] == 0x5A );
+			for ( int i = 0; i < iDst; ++i )
+			{
+				Shipping_Assert( GetBit( dst, i ) == ( ( 0x5A >> ( i & 7 ) ) & 1 ) );
+			}
+			int iEnd = iDst + nBits;
+			for ( int i = iEnd; i < ( ( iEnd + 31 ) & ~31 ); ++i )
+			{
+				Shipping_Assert( GetBit( dst, i ) == ( ( 0x5A >> ( i & 7 ) ) & 1 ) );
+			}
+
+			// read it back out through ReadBits, from an odd output address too
+			memset( out, 0, sizeof( out ) );
+			bf_read back( dst, sizeof( dst ) );
+			back.Seek( iDst );
+			back.ReadBits( out + ( iSrc & 3 ), nBits );
+			Shipping_Assert( !back.IsOverflowed() );
+			Shipping_Assert( CompareBitRange( src, iSrc, out + ( iSrc & 3 ), 0, nBits ) );
+
+			// and WriteBits from memory
+			memset( out, 0x5A, sizeof( out ) );
+			bf_write raw( out, sizeof( out ) );
+			raw.SeekToBit( iDst );
+			Shipping_Assert( raw.WriteBits( src + ( iSrc & 3 ), nBits ) );
+			Shipping_Assert( CompareBitRange( src + ( iSrc & 3 ), 0, out, iDst, nBits ) );
+		}
+	}
+
+	// copies that don't fit still overflow
+	bf_read in( src, 16 );
+	bf_write buf( dst, 8 );
+	Shipping_Assert( !buf.WriteBitsFromBuffer( &in, 100 ) );
+	Shipping_Assert( buf.IsOverflowed() );
+}
+
+DEFINE_TESTCASE( BitBufTest, BitBufTestSuite )
+{
+	Msg( "Running bf_write/bf_read tests\n" );
+
+	AccumulatorTests();
+	BulkCopyTests();
+}
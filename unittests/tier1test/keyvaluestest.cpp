@@ -0,0 +1,75 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test program for KeyValues lookups
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "tier0/dbg.h"
+#include "unitlib/unitlib.h"
+#include "tier1/KeyValues.h"
+#include "tier1/strtools.h"
+
+DEFINE_TESTSUITE( KeyValuesTestSuite )
+
+// FindKey has to give the same answers with and without the child index
+static void ChildIndexTests( bool bUsesChildIndex )
+{
+	KeyValues *pKV = new KeyValues( "root" );
+	pKV->SetUsesChildIndex( bUsesChildIndex );
+
+	char szName[32];
+	for ( int i = 0; i < 64; ++i )
+	{
+		V_snprintf( szName, sizeof( szName ), "key%d", i );
+		pKV->SetInt( szName, i );
+	}
+
+	for ( int i = 0; i < 64; ++i )
+	{
+		V_snprintf( szName, sizeof( szName ), "key%d", i );
+		KeyValues *pChild = pKV->FindKey( szName );
+		Shipping_Assert( pChild && pChild->GetInt() == i );
+	}
+	Shipping_Assert( pKV->FindKey( "missing" ) == NULL );
+
+	// A renamed child is found under its new name and not under its old one,
+	// and FindKey( newName, true ) doesn't append a second key with that name
+	KeyValues *pRenamed = pKV->FindKey( "key10" );
+	pRenamed->SetName( "renamed" );
+	Shipping_Assert( pKV->FindKey( "key10" ) == NULL );
+	Shipping_Assert( pKV->FindKey( "renamed" ) == pRenamed );
+	Shipping_Assert( pKV->FindKey( "renamed", true ) == pRenamed );
+
+	// Renaming to a name that was looked up and missed before
+	KeyValues *pLate = pKV->FindKey( "key20" );
+	Shipping_Assert( pKV->FindKey( "late" ) == NULL );
+	pLate->SetName( "late" );
+	Shipping_Assert( pKV->FindKey( "late", true ) == pLate );
+
+	// Nothing was appended by the lookups above
+	int nChildren = 0;
+	for ( KeyValues *pChild = pKV->GetFirstSubKey(); pChild; pChild = pChild->GetNextKey() )
+	{
+		++nChildren;
+	}
+	Shipping_Assert( nChildren == 64 );
+
+	// Removed children can't be found any more, the next one with the name can
+	KeyValues *pFirst = pKV->FindKey( "key30" );
+	KeyValues *pSecond = pKV->CreateNewKey();
+	pSecond->SetName( "key30" );
+	pKV->RemoveSubKey( pFirst );
+	pFirst->deleteThis();
+	Shipping_Assert( pKV->FindKey( "key30" ) == pSecond );
+
+	pKV->deleteThis();
+}
+
+DEFINE_TESTCASE( KeyValuesChildIndexTest, KeyValuesTestSuite )
+{
+	Msg( "Running KeyValues child index tests\n" );
+
+	ChildIndexTests( false );
+	ChildIndexTests( true );
+}
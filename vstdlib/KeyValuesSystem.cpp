@@ -14,6 +14,7 @@
 #include "tier1/utlmap.h"
 #include "tier1/utlstring.h"
 #include "tier1/fmtstr.h"
+#include "tier1/generichash.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -65,15 +66,29 @@ private:
 	int m_iMaxKeyValuesSize;
 
 	// string hash table
+	// Open addressed with linear probing. Slots are only ever filled, never cleared or
+	// moved, so lookups probe without taking m_mutex. Growing publishes a new table and
+	// retires the old one, which stays readable until the system is destroyed.
 	CMemoryStack m_Strings;
 	struct hash_item_t
 	{
-		intp stringIndex;
-		hash_item_t *next;
+		uint32 hash;
+		int32 stringIndex;	// 0 means the slot is empty
 	};
-	CUtlMemoryPool m_HashItemMemPool;
-	CUtlVector<hash_item_t> m_HashTable;
-	int CaseInsensitiveHash(const char *string, int iBounds);
+	struct hash_table_t
+	{
+		uint32 mask;
+		hash_item_t *items;
+	};
+	hash_table_t * volatile m_pHashTable;
+	CUtlVector<hash_table_t *> m_RetiredHashTables;
+	int m_nHashItems;
+
+	static hash_table_t *AllocHashTable( int nSize );
+	static void FreeHashTable( hash_table_t *pTable );
+	HKeySymbol FindSymbol( const hash_table_t *pTable, const char *name, uint32 hash ) const;
+	static void InsertSymbol( hash_table_t *pTable, int32 stringIndex, uint32 hash );
+	void GrowHashTable();
 
 	void DoInvalidateCache();
 
@@ -109,17 +124,12 @@ IKeyValuesSystem *KeyValuesSystem()
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
 CKeyValuesSystem::CKeyValuesSystem()
-: m_HashItemMemPool(sizeof(hash_item_t), 64, CUtlMemoryPool::GROW_FAST, "CKeyValuesSystem::m_HashItemMemPool")
-, m_KeyValuesTrackingList(0, 0, MemoryLeakTrackerLessFunc)
+: m_KeyValuesTrackingList(0, 0, MemoryLeakTrackerLessFunc)
 , m_KeyValueCache( UtlStringLessFunc )
 {
 	// initialize hash table
-	m_HashTable.AddMultipleToTail(2047);
-	for (int i = 0; i < m_HashTable.Count(); i++)
-	{
-		m_HashTable[i].stringIndex = 0;
-		m_HashTable[i].next = NULL;
-	}
+	m_pHashTable = AllocHashTable( 4096 );
+	m_nHashItems = 0;
 
 	m_Strings.Init( 4*1024*1024, 64*1024, 0, 4 );
 	char *pszEmpty = ((char *)m_Strings.Alloc(1));
@@ -158,6 +168,12 @@ CKeyValuesSystem::~CKeyValuesSystem()
 #endif
 
 	DoInvalidateCache();
+
+	FreeHashTable( m_pHashTable );
+	for ( int i = 0; i < m_RetiredHashTables.Count(); i++ )
+	{
+		FreeHashTable( m_RetiredHashTables[i] );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -228,55 +244,48 @@ HKeySymbol CKeyValuesSystem::GetSymbolForString( const char *name, bool bCreate
 		return (-1);
 	}
 
-	AUTO_LOCK( m_mutex );
+	// the empty string is always the first thing in the string pool
+	if ( !name[0] )
+	{
+		return 0;
+	}
 
-	int hash = CaseInsensitiveHash(name, m_HashTable.Count());
-	int i = 0;
-	hash_item_t *item = &m_HashTable[hash];
-	while (1)
+	// lock-free lookup; nearly every call ends here
+	uint32 hash = HashStringCaseless( name );
+	HKeySymbol symbol = FindSymbol( m_pHashTable, name, hash );
+	if ( symbol != INVALID_KEY_SYMBOL || !bCreate )
 	{
-		if (!stricmp(name, (char *)m_Strings.GetBase() + item->stringIndex ))
-		{
-			return (HKeySymbol)item->stringIndex;
-		}
+		return symbol;
+	}
 
-		i++;
+	AUTO_LOCK( m_mutex );
 
-		if (item->next == NULL)
-		{
-			if ( !bCreate )
-			{
-				// not found
-				return -1;
-			}
-
-			// we're not in the table
-			if (item->stringIndex != 0)
-			{
-				// first item is used, an new item
-				item->next = (hash_item_t *)m_HashItemMemPool.Alloc(sizeof(hash_item_t));
-				item = item->next;
-			}
-
-			// build up the new item
-			item->next = NULL;
-			char *pString = (char *)m_Strings.Alloc( V_strlen(name) + 1 );
-			if ( !pString )
-			{
-				Error( "Out of keyvalue string space" );
-				return -1;
-			}
-			item->stringIndex = pString - (char *)m_Strings.GetBase();
-			strcpy(pString, name);
-			return (HKeySymbol)item->stringIndex;
-		}
+	// another thread may have added it while we were waiting for the lock
+	symbol = FindSymbol( m_pHashTable, name, hash );
+	if ( symbol != INVALID_KEY_SYMBOL )
+	{
+		return symbol;
+	}
 
-		item = item->next;
+	// we're not in the table
+	char *pString = (char *)m_Strings.Alloc( V_strlen(name) + 1 );
+	if ( !pString )
+	{
+		Error( "Out of keyvalue string space" );
+		return -1;
 	}
+	strcpy(pString, name);
+	int32 stringIndex = pString - (char *)m_Strings.GetBase();
 
-	// shouldn't be able to get here
-	Assert(0);
-	return (-1);
+	// keep the load at or below one half so probe sequences stay short
+	if ( ( m_nHashItems + 1 ) * 2 > (int)( m_pHashTable->mask + 1 ) )
+	{
+		GrowHashTable();
+	}
+
+	InsertSymbol( m_pHashTable, stringIndex, hash );
+	m_nHashItems++;
+	return (HKeySymbol)stringIndex;
 }
 
 //-----------------------------------------------------------------------------
@@ -376,25 +385,84 @@ void CKeyValuesSystem::InvalidateCache()
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: generates a simple hash value for a string
+// Purpose: allocates an empty symbol hash table, nSize must be a power of two
 //-----------------------------------------------------------------------------
-int CKeyValuesSystem::CaseInsensitiveHash(const char *string, int iBounds)
+CKeyValuesSystem::hash_table_t *CKeyValuesSystem::AllocHashTable( int nSize )
 {
-	unsigned int hash = 0;
+	Assert( IsPowerOfTwo( nSize ) );
 
-	for ( ; *string != 0; string++ )
+	hash_table_t *pTable = new hash_table_t;
+	pTable->mask = nSize - 1;
+	pTable->items = new hash_item_t[nSize];
+	memset( pTable->items, 0, nSize * sizeof(hash_item_t) );
+	return pTable;
+}
+
+void CKeyValuesSystem::FreeHashTable( hash_table_t *pTable )
+{
+	delete [] pTable->items;
+	delete pTable;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: probes the table for a string, safe to call without holding m_mutex
+//-----------------------------------------------------------------------------
+HKeySymbol CKeyValuesSystem::FindSymbol( const hash_table_t *pTable, const char *name, uint32 hash ) const
+{
+	const char *pBase = (const char *)m_Strings.GetBase();
+	for ( uint32 i = hash & pTable->mask; ; i = ( i + 1 ) & pTable->mask )
 	{
-		if (*string >= 'A' && *string <= 'Z')
+		const hash_item_t &item = pTable->items[i];
+		int32 stringIndex = *(volatile int32 *)&item.stringIndex;
+		if ( !stringIndex )
 		{
-			hash = (hash << 1) + (*string - 'A' + 'a');
+			// the table is never full, so every probe ends on an empty slot
+			return INVALID_KEY_SYMBOL;
 		}
-		else
+
+		if ( item.hash == hash && !stricmp( name, pBase + stringIndex ) )
 		{
-			hash = (hash << 1) + *string;
+			return (HKeySymbol)stringIndex;
 		}
 	}
-	  
-	return hash % iBounds;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: adds a string to the table, m_mutex must be held
+//-----------------------------------------------------------------------------
+void CKeyValuesSystem::InsertSymbol( hash_table_t *pTable, int32 stringIndex, uint32 hash )
+{
+	uint32 i = hash & pTable->mask;
+	while ( pTable->items[i].stringIndex != 0 )
+	{
+		i = ( i + 1 ) & pTable->mask;
+	}
+
+	// the hash has to be visible before the index publishes the slot to readers
+	pTable->items[i].hash = hash;
+	ThreadInterlockedExchange( &pTable->items[i].stringIndex, stringIndex );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: doubles the hash table, m_mutex must be held
+//			Readers may still be probing the old table, so it is retired rather than freed.
+//-----------------------------------------------------------------------------
+void CKeyValuesSystem::GrowHashTable()
+{
+	hash_table_t *pOldTable = m_pHashTable;
+	hash_table_t *pNewTable = AllocHashTable( ( pOldTable->mask + 1 ) * 2 );
+
+	for ( uint32 i = 0; i <= pOldTable->mask; i++ )
+	{
+		const hash_item_t &item = pOldTable->items[i];
+		if ( item.stringIndex )
+		{
+			InsertSymbol( pNewTable, item.stringIndex, item.hash );
+		}
+	}
+
+	ThreadInterlockedExchangePointer( (void * volatile *)&m_pHashTable, pNewTable );
+	m_RetiredHashTables.AddToTail( pOldTable );
 }
 
 //-----------------------------------------------------------------------------
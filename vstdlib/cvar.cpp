@@ -16,6 +16,8 @@
 #include "tier0/vprof.h"
 #include "tier1/tier1.h"
 #include "tier1/utlbuffer.h"
+#include "tier1/utlhashtable.h"
+#include "tier1/UtlSortVector.h"
 
 #ifdef _X360
 #include "xbox/xbox_console.h"
@@ -24,6 +26,15 @@
 #ifdef POSIX
 #include <wctype.h>
 #include <wchar.h>
+#include <dlfcn.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma intrinsic( _ReturnAddress )
+#define CVAR_CALLER_ADDRESS()	_ReturnAddress()
+#else
+#define CVAR_CALLER_ADDRESS()	__builtin_return_address( 0 )
 #endif
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -86,6 +97,8 @@ public:
 	virtual void			InstallGlobalChangeCallback( FnChangeCallback_t callback );
 	virtual void			RemoveGlobalChangeCallback( FnChangeCallback_t callback );
 	virtual void			CallGlobalChangeCallbacks( ConVar *var, const char *pOldString, float flOldValue );
+	virtual void			InstallConVarChangeListener( const char *pVarName, IConVarChangeListener *pListener );
+	virtual void			RemoveConVarChangeListener( const char *pVarName, IConVarChangeListener *pListener );
 	virtual void			InstallConsoleDisplayFunc( IConsoleDisplayFunc* pDisplayFunc );
 	virtual void			RemoveConsoleDisplayFunc( IConsoleDisplayFunc* pDisplayFunc );
 	virtual void			ConsoleColorPrintf( const Color& clr, const char *pFormat, ... ) const;
@@ -114,10 +127,38 @@ private:
 
 	void DisplayQueuedMessages( );
 
+	// Name index over m_pConCommandList, holds the first command in the list for each name
+	typedef CUtlHashtable< const char *, ConCommandBase *, CaselessStringHashFunctor, CaselessStringEqualFunctor > CConCommandHash;
+
+	ConCommandBase *FindCommandBaseInternal( const char *name ) const;
+	void HashConCommand( ConCommandBase *pCommand );
+	void UnhashConCommand( ConCommandBase *pCommand );
+	void TrackLookup( void *pCaller, const char *pName, bool bFound ) const;
+
+	struct ConVarListener_t
+	{
+		CUtlString				m_Name;
+		IConVarChangeListener	*m_pListener;
+	};
+
+	struct LookupCaller_t
+	{
+		int		m_nLookups;
+		int		m_nMisses;
+		char	m_szLastName[64];
+	};
+
 	CUtlVector< FnChangeCallback_t >	m_GlobalChangeCallbacks;
+	CUtlVector< ConVarListener_t >		m_ConVarListeners;
 	CUtlVector< IConsoleDisplayFunc* >	m_DisplayFuncs;
 	int									m_nNextDLLIdentifier;
 	ConCommandBase						*m_pConCommandList;
+	CConCommandHash						m_CommandHash;
+
+	// lookup statistics, only collected while "cvar_lookupstats start" is active
+	bool										m_bTrackLookups;
+	mutable CThreadFastMutex					m_LookupStatsMutex;
+	mutable CUtlHashtable< void *, LookupCaller_t >	m_LookupCallers;
 
 	// temporary console area so we can store prints before console display funs are installed
 	mutable CUtlBuffer					m_TempConsoleBuffer;
@@ -167,6 +208,7 @@ protected:
 private:
 	// Standard console commands -- DO NOT PLACE ANY HIGHER THAN HERE BECAUSE THESE MUST BE THE FIRST TO DESTRUCT
 	CON_COMMAND_MEMBER_F( CCvar, "find", Find, "Find concommands with the specified string in their name/help text.", 0 )
+	CON_COMMAND_MEMBER_F( CCvar, "cvar_lookupstats", LookupStats, "Shows the callers doing the most convar/concommand lookups by name. Usage: cvar_lookupstats [start|stop|reset]", 0 )
 };
 
 void CCvar::CCVarIteratorInternal::SetFirst( void ) RESTRICT
@@ -223,6 +265,7 @@ CCvar::CCvar() : m_TempConsoleBuffer( 0, 1024 )
 {
 	m_nNextDLLIdentifier = 0;
 	m_pConCommandList = NULL;
+	m_bTrackLookups = false;
 
 	m_bMaterialSystemThreadSetAllowed = false;
 }
@@ -405,6 +448,8 @@ void CCvar::RegisterConCommand( ConCommandBase *variable )
 	// link the variable in
 	variable->m_pNext = m_pConCommandList;
 	m_pConCommandList = variable;
+
+	HashConCommand( variable );
 }
 
 void CCvar::UnregisterConCommand( ConCommandBase *pCommandToRemove )
@@ -434,6 +479,7 @@ void CCvar::UnregisterConCommand( ConCommandBase *pCommandToRemove )
 			pPrev->m_pNext = pCommand->m_pNext;
 		}
 		pCommand->m_pNext = NULL;
+		UnhashConCommand( pCommand );
 		break;
 	}
 }
@@ -471,35 +517,85 @@ void CCvar::UnregisterConCommands( CVarDLLIdentifier_t id )
 	}
 
 	m_pConCommandList = pNewList;
+
+	// the list was reversed above, rebuild the index so it matches the list order
+	m_CommandHash.RemoveAll();
+	for ( pCommand = m_pConCommandList; pCommand; pCommand = pCommand->m_pNext )
+	{
+		m_CommandHash.Insert( pCommand->GetName(), pCommand );
+	}
 }
 #ifdef WIN32
 #pragma optimize( "", on )
 #endif
 
 
+//-----------------------------------------------------------------------------
+// Keeps the name index in sync with m_pConCommandList 
+//-----------------------------------------------------------------------------
+void CCvar::HashConCommand( ConCommandBase *pCommand )
+{
+	// newly linked commands sit at the head of the list, so they win the name.
+	// The key points into the command's own name, so it is replaced along with
+	// the command, otherwise it would dangle once the older command goes away.
+	UtlHashHandle_t h = m_CommandHash.Find( pCommand->GetName() );
+	if ( h != m_CommandHash.InvalidHandle() )
+	{
+		m_CommandHash.RemoveByHandle( h );
+	}
+	m_CommandHash.Insert( pCommand->GetName(), pCommand );
+}
+
+void CCvar::UnhashConCommand( ConCommandBase *pCommand )
+{
+	const char *pName = pCommand->GetName();
+	UtlHashHandle_t h = m_CommandHash.Find( pName );
+	if ( h == m_CommandHash.InvalidHandle() || m_CommandHash.Element( h ) != pCommand )
+		return;
+
+	m_CommandHash.RemoveByHandle( h );
+
+	// fall back to another command of the same name if there is one
+	for ( ConCommandBase *pOther = m_pConCommandList; pOther; pOther = pOther->m_pNext )
+	{
+		if ( !Q_stricmp( pName, pOther->GetName() ) )
+		{
+			m_CommandHash.Insert( pOther->GetName(), pOther );
+			break;
+		}
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Finds base commands 
 //-----------------------------------------------------------------------------
+ConCommandBase *CCvar::FindCommandBaseInternal( const char *name ) const
+{
+	if ( !name )
+		return NULL;
+
+	return m_CommandHash.Get( name, NULL );
+}
+
 const ConCommandBase *CCvar::FindCommandBase( const char *name ) const
 {
-	const ConCommandBase *cmd = GetCommands();
-	for ( ; cmd; cmd = cmd->GetNext() )
+	ConCommandBase *cmd = FindCommandBaseInternal( name );
+	if ( m_bTrackLookups )
 	{
-		if ( !Q_stricmp( name, cmd->GetName() ) )
-			return cmd;
+		TrackLookup( CVAR_CALLER_ADDRESS(), name, cmd != NULL );
 	}
-	return NULL;
+	return cmd;
 }
 
 ConCommandBase *CCvar::FindCommandBase( const char *name )
 {
-	ConCommandBase *cmd = GetCommands();
-	for ( ; cmd; cmd = cmd->GetNext() )
+	ConCommandBase *cmd = FindCommandBaseInternal( name );
+	if ( m_bTrackLookups )
 	{
-		if ( !Q_stricmp( name, cmd->GetName() ) )
-			return cmd;
+		TrackLookup( CVAR_CALLER_ADDRESS(), name, cmd != NULL );
 	}
-	return NULL;
+	return cmd;
 }
 
 
@@ -510,7 +606,11 @@ const ConVar *CCvar::FindVar( const char *var_name ) const
 {
 	VPROF_INCREMENT_COUNTER( "CCvar::FindVar", 1 );
 	VPROF( "CCvar::FindVar" );
-	const ConCommandBase *var = FindCommandBase( var_name );
+	const ConCommandBase *var = FindCommandBaseInternal( var_name );
+	if ( m_bTrackLookups )
+	{
+		TrackLookup( CVAR_CALLER_ADDRESS(), var_name, var != NULL );
+	}
 	if ( !var || var->IsCommand() )
 		return NULL;
 	
@@ -521,7 +621,11 @@ ConVar *CCvar::FindVar( const char *var_name )
 {
 	VPROF_INCREMENT_COUNTER( "CCvar::FindVar", 1 );
 	VPROF( "CCvar::FindVar" );
-	ConCommandBase *var = FindCommandBase( var_name );
+	ConCommandBase *var = FindCommandBaseInternal( var_name );
+	if ( m_bTrackLookups )
+	{
+		TrackLookup( CVAR_CALLER_ADDRESS(), var_name, var != NULL );
+	}
 	if ( !var || var->IsCommand() )
 		return NULL;
 	
@@ -534,7 +638,11 @@ ConVar *CCvar::FindVar( const char *var_name )
 //-----------------------------------------------------------------------------
 const ConCommand *CCvar::FindCommand( const char *pCommandName ) const
 {
-	const ConCommandBase *var = FindCommandBase( pCommandName );
+	const ConCommandBase *var = FindCommandBaseInternal( pCommandName );
+	if ( m_bTrackLookups )
+	{
+		TrackLookup( CVAR_CALLER_ADDRESS(), pCommandName, var != NULL );
+	}
 	if ( !var || !var->IsCommand() )
 		return NULL;
 
@@ -543,7 +651,11 @@ const ConCommand *CCvar::FindCommand( const char *pCommandName ) const
 
 ConCommand *CCvar::FindCommand( const char *pCommandName )
 {
-	ConCommandBase *var = FindCommandBase( pCommandName );
+	ConCommandBase *var = FindCommandBaseInternal( pCommandName );
+	if ( m_bTrackLookups )
+	{
+		TrackLookup( CVAR_CALLER_ADDRESS(), pCommandName, var != NULL );
+	}
 	if ( !var || !var->IsCommand() )
 		return NULL;
 
@@ -551,6 +663,32 @@ ConCommand *CCvar::FindCommand( const char *pCommandName )
 }
 
 
+//-----------------------------------------------------------------------------
+// Lookup statistics, per calling code address
+//-----------------------------------------------------------------------------
+void CCvar::TrackLookup( void *pCaller, const char *pName, bool bFound ) const
+{
+	AUTO_LOCK( m_LookupStatsMutex );
+
+	UtlHashHandle_t h = m_LookupCallers.Find( pCaller );
+	if ( h == m_LookupCallers.InvalidHandle() )
+	{
+		LookupCaller_t caller;
+		caller.m_nLookups = 0;
+		caller.m_nMisses = 0;
+		h = m_LookupCallers.Insert( pCaller, caller );
+	}
+
+	LookupCaller_t &caller = m_LookupCallers.Element( h );
+	caller.m_nLookups++;
+	if ( !bFound )
+	{
+		caller.m_nMisses++;
+	}
+	Q_strncpy( caller.m_szLastName, pName ? pName : "", sizeof( caller.m_szLastName ) );
+}
+
+
 const char* CCvar::GetCommandLineValue( const char *pVariableName )
 {
 	int nLen = Q_strlen(pVariableName);
@@ -591,6 +729,31 @@ void CCvar::RemoveGlobalChangeCallback( FnChangeCallback_t callback )
 }
 
 
+//-----------------------------------------------------------------------------
+// Install, remove listeners for a single convar
+//-----------------------------------------------------------------------------
+void CCvar::InstallConVarChangeListener( const char *pVarName, IConVarChangeListener *pListener )
+{
+	Assert( pVarName && pListener );
+
+	int i = m_ConVarListeners.AddToTail();
+	m_ConVarListeners[i].m_Name = pVarName;
+	m_ConVarListeners[i].m_pListener = pListener;
+}
+
+void CCvar::RemoveConVarChangeListener( const char *pVarName, IConVarChangeListener *pListener )
+{
+	for ( int i = m_ConVarListeners.Count(); --i >= 0; )
+	{
+		if ( m_ConVarListeners[i].m_pListener == pListener && !Q_stricmp( m_ConVarListeners[i].m_Name, pVarName ) )
+		{
+			m_ConVarListeners.Remove( i );
+			break;
+		}
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -601,6 +764,15 @@ void CCvar::CallGlobalChangeCallbacks( ConVar *var, const char *pOldString, floa
 	{
 		(*m_GlobalChangeCallbacks[i])( var, pOldString, flOldValue );
 	}
+
+	// walk backwards, listeners may remove themselves
+	for ( int i = m_ConVarListeners.Count(); --i >= 0; )
+	{
+		if ( !Q_stricmp( m_ConVarListeners[i].m_Name, var->GetName() ) )
+		{
+			m_ConVarListeners[i].m_pListener->OnConVarChanged( var, pOldString, flOldValue );
+		}
+	}
 }
 
 
@@ -897,3 +1069,90 @@ void CCvar::Find( const CCommand &args )
 }
 
 
+//-----------------------------------------------------------------------------
+// Sorts lookup callers, busiest first
+//-----------------------------------------------------------------------------
+class CLookupCallerLess
+{
+public:
+	bool Less( const UtlHashHandle_t &lhs, const UtlHashHandle_t &rhs, void *pCtx )
+	{
+		const CUtlHashtable< void *, int > *pCounts = (const CUtlHashtable< void *, int > *)pCtx;
+		return pCounts->Element( lhs ) > pCounts->Element( rhs );
+	}
+};
+
+void CCvar::LookupStats( const CCommand &args )
+{
+	if ( args.ArgC() >= 2 )
+	{
+		if ( !Q_stricmp( args[1], "start" ) )
+		{
+			m_bTrackLookups = true;
+			ConMsg( "cvar_lookupstats: collecting lookup statistics\n" );
+		}
+		else if ( !Q_stricmp( args[1], "stop" ) )
+		{
+			m_bTrackLookups = false;
+			ConMsg( "cvar_lookupstats: stopped collecting\n" );
+		}
+		else if ( !Q_stricmp( args[1], "reset" ) )
+		{
+			AUTO_LOCK( m_LookupStatsMutex );
+			m_LookupCallers.RemoveAll();
+		}
+		else
+		{
+			ConMsg( "Usage:  cvar_lookupstats [start|stop|reset]\n" );
+		}
+		return;
+	}
+
+	AUTO_LOCK( m_LookupStatsMutex );
+
+	if ( !m_LookupCallers.Count() )
+	{
+		ConMsg( "cvar_lookupstats: no lookups recorded%s\n", m_bTrackLookups ? "" : " (use \"cvar_lookupstats start\")" );
+		return;
+	}
+
+	// sort a copy of the counts, the stats table itself keeps changing while lookups happen
+	CUtlHashtable< void *, int > counts;
+	FOR_EACH_HASHTABLE( m_LookupCallers, it )
+	{
+		counts.Insert( m_LookupCallers.Key( it ), m_LookupCallers.Element( it ).m_nLookups );
+	}
+
+	CUtlSortVector< UtlHashHandle_t, CLookupCallerLess > sorted( &counts );
+	FOR_EACH_HASHTABLE( counts, it )
+	{
+		sorted.Insert( it );
+	}
+
+	int nShown = MIN( sorted.Count(), 32 );
+	ConMsg( "%i callers, top %i:\n", sorted.Count(), nShown );
+	ConMsg( "  lookups   misses  last name                         caller\n" );
+	for ( int i = 0; i < nShown; i++ )
+	{
+		void *pCaller = counts.Key( sorted[i] );
+		const LookupCaller_t &caller = m_LookupCallers.Element( m_LookupCallers.Find( pCaller ) );
+
+		char szCaller[256];
+		Q_snprintf( szCaller, sizeof( szCaller ), "%p", pCaller );
+#ifdef POSIX
+		Dl_info info;
+		if ( dladdr( pCaller, &info ) && info.dli_fname )
+		{
+			if ( info.dli_sname )
+			{
+				Q_snprintf( szCaller, sizeof( szCaller ), "%s!%s+0x%x", V_UnqualifiedFileName( info.dli_fname ), info.dli_sname, (unsigned int)( (uintp)pCaller - (uintp)info.dli_saddr ) );
+			}
+			else
+			{
+				Q_snprintf( szCaller, sizeof( szCaller ), "%s+0x%x", V_UnqualifiedFileName( info.dli_fname ), (unsigned int)( (uintp)pCaller - (uintp)info.dli_fbase ) );
+			}
+		}
+#endif
+		ConMsg( "  %7i  %7i  %-32s  %s\n", caller.m_nLookups, caller.m_nMisses, caller.m_szLastName, szCaller );
+	}
+}